@@ -0,0 +1,368 @@
+/**
+   @file
+*/
+
+#include "Benchmark.h"
+#include "EditableModelItem.h"
+#include "EditableModelBase.h"
+#include "JointItem.h"
+#include "SensorItem.h"
+#include "ModelNode.h"
+#include "URDFLoader.h"
+#include "Trace.h"
+#include <cnoid/RootItem>
+#include <cnoid/ItemTreeView>
+#include <cnoid/MessageView>
+#include <cnoid/BodyLoader>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <QElapsedTimer>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const int numDragSteps = 100;
+
+struct BenchmarkResult
+{
+    string name;
+    int operations;
+    vector<double> samples; // [ms]
+};
+
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(const SyntheticModelSpec& spec, int repeat);
+    ~BenchmarkRunner();
+    bool run();
+    bool writeResults(const string& filename);
+
+private:
+    SyntheticModelSpec spec;
+    int repeat;
+    filesystem::path workDir;
+    string modelFile;
+    string urdfFile;
+    EditableModelItemPtr modelItem;
+    int numItems;
+    vector<BenchmarkResult> results;
+    ModelMemoryUsage loadedMemory;
+    ModelMemoryUsage compactMemory;
+
+    void measure(const char* name, int operations, boost::function<void()> func);
+    void measure(const char* name, int operations, boost::function<void()> setup, boost::function<void()> func);
+
+    void generate();
+    void load();
+    void loadURDF();
+    void loadModelTree();
+    void prepareModelItem();
+    void buildItemTree();
+    void buildLazyItemTree();
+    void changeSelection();
+    void selectRootJoint();
+    void dragUpdate();
+    void exportVRML();
+    void exportURDF();
+    void exportURDFWithGLB();
+    void exportSDF();
+    void exportBody();
+    void exportMJCF();
+};
+
+}
+
+
+bool ModelEditBenchmark::run(const SyntheticModelSpec& spec, int repeat, const std::string& resultFile)
+{
+    BenchmarkRunner runner(spec, repeat);
+    if(!runner.run()){
+        return false;
+    }
+    return runner.writeResults(resultFile);
+}
+
+
+BenchmarkRunner::BenchmarkRunner(const SyntheticModelSpec& spec, int repeat)
+    : spec(spec),
+      repeat(repeat),
+      numItems(0)
+{
+    workDir = filesystem::temp_directory_path() / filesystem::unique_path("modeledit-benchmark-%%%%-%%%%");
+    filesystem::create_directories(workDir);
+    modelFile = (workDir / "synthetic.wrl").string();
+    urdfFile = (workDir / "synthetic.urdf").string();
+}
+
+
+BenchmarkRunner::~BenchmarkRunner()
+{
+    if(modelItem){
+        modelItem->detachFromParentItem();
+    }
+    boost::system::error_code ec;
+    filesystem::remove_all(workDir, ec);
+}
+
+
+void BenchmarkRunner::measure(const char* name, int operations, boost::function<void()> func)
+{
+    measure(name, operations, boost::function<void()>(), func);
+}
+
+
+void BenchmarkRunner::measure
+(const char* name, int operations, boost::function<void()> setup, boost::function<void()> func)
+{
+    MessageView::instance()->putln(format(_("Benchmark: %1%")) % name);
+
+    BenchmarkResult result;
+    result.name = name;
+    result.operations = operations;
+    QElapsedTimer timer;
+    for(int i=0; i < repeat; ++i){
+        if(setup){
+            setup();
+        }
+        MODELEDIT_TRACE_SPAN(name);
+        timer.start();
+        func();
+        result.samples.push_back(timer.nsecsElapsed() * 1.0e-6);
+    }
+    results.push_back(result);
+}
+
+
+bool BenchmarkRunner::run()
+{
+    measure("generate", 1, boost::bind(&BenchmarkRunner::generate, this));
+    if(!filesystem::exists(modelFile)){
+        return false;
+    }
+    measure("load", 1, boost::bind(&BenchmarkRunner::load, this));
+    measure("load_urdf", 1, boost::bind(&BenchmarkRunner::loadURDF, this));
+    measure("load_model_tree", 1, boost::bind(&BenchmarkRunner::loadModelTree, this));
+    measure("build_item_tree_lazy", 1,
+            boost::bind(&BenchmarkRunner::prepareModelItem, this),
+            boost::bind(&BenchmarkRunner::buildLazyItemTree, this));
+    measure("build_item_tree", 1,
+            boost::bind(&BenchmarkRunner::prepareModelItem, this),
+            boost::bind(&BenchmarkRunner::buildItemTree, this));
+
+    numItems = modelItem->findItems<EditableModelBase>().size();
+    if(numItems == 0){
+        return false;
+    }
+
+    measure("selection_change", modelItem->findItems<JointItem>().size(),
+            boost::bind(&BenchmarkRunner::changeSelection, this));
+    measure("drag_update", numDragSteps,
+            boost::bind(&BenchmarkRunner::selectRootJoint, this),
+            boost::bind(&BenchmarkRunner::dragUpdate, this));
+    measure("export_vrml", 1, boost::bind(&BenchmarkRunner::exportVRML, this));
+    measure("export_urdf", 1, boost::bind(&BenchmarkRunner::exportURDF, this));
+    measure("export_urdf_glb", 1, boost::bind(&BenchmarkRunner::exportURDFWithGLB, this));
+    measure("export_sdf", 1, boost::bind(&BenchmarkRunner::exportSDF, this));
+    measure("export_body", 1, boost::bind(&BenchmarkRunner::exportBody, this));
+    measure("export_mjcf", 1, boost::bind(&BenchmarkRunner::exportMJCF, this));
+
+    // the exports after this regenerate the geometry from the scene meshes
+    loadedMemory = modelItem->memoryUsage();
+    modelItem->releaseOriginalNodes();
+    compactMemory = modelItem->memoryUsage();
+    measure("export_vrml_compact", 1, boost::bind(&BenchmarkRunner::exportVRML, this));
+
+    return true;
+}
+
+
+void BenchmarkRunner::generate()
+{
+    writeSyntheticModel(modelFile, spec);
+    writeSyntheticModelURDF(urdfFile, spec);
+}
+
+
+void BenchmarkRunner::load()
+{
+    BodyLoader loader;
+    loader.load(modelFile);
+}
+
+
+/// Same tree as the VRML model imported from URDF with a mesh file per link
+void BenchmarkRunner::loadURDF()
+{
+    ostringstream messages;
+    loadURDFModelTree(urdfFile, messages);
+}
+
+
+/// Loading without the items, which is the cost of the batch tools
+void BenchmarkRunner::loadModelTree()
+{
+    ostringstream messages;
+    cnoid::loadModelTree(modelFile, messages);
+}
+
+
+void BenchmarkRunner::prepareModelItem()
+{
+    if(modelItem){
+        modelItem->detachFromParentItem();
+    }
+    modelItem = new EditableModelItem;
+    modelItem->setName("synthetic");
+    RootItem::instance()->addChildItem(modelItem);
+}
+
+
+void BenchmarkRunner::buildItemTree()
+{
+    modelItem->loadModelFile(modelFile);
+}
+
+
+/// Same as buildItemTree but the items below the root joints are deferred
+void BenchmarkRunner::buildLazyItemTree()
+{
+    const bool orgMode = EditableModelItem::isLazyItemMode();
+    EditableModelItem::setLazyItemMode(true);
+    modelItem->loadModelFile(modelFile);
+    EditableModelItem::setLazyItemMode(orgMode);
+}
+
+
+void BenchmarkRunner::changeSelection()
+{
+    ItemTreeView* itemTreeView = ItemTreeView::instance();
+    ItemList<JointItem> joints = modelItem->findItems<JointItem>();
+    for(size_t i=0; i < joints.size(); ++i){
+        itemTreeView->clearSelection();
+        itemTreeView->selectItem(joints.get(i));
+    }
+    itemTreeView->clearSelection();
+}
+
+
+void BenchmarkRunner::selectRootJoint()
+{
+    ItemTreeView* itemTreeView = ItemTreeView::instance();
+    itemTreeView->clearSelection();
+    for(Item* item = modelItem->childItem(); item; item = item->nextItem()){
+        if(JointItem* joint = dynamic_cast<JointItem*>(item)){
+            itemTreeView->selectItem(joint);
+            break;
+        }
+    }
+}
+
+
+/// Drag of the root joint through the same path as the position dragger of the model
+void BenchmarkRunner::dragUpdate()
+{
+    if(!modelItem->beginDrag()){
+        return;
+    }
+    const Affine3 T0 = modelItem->dragPivot();
+    for(int step=0; step < numDragSteps; ++step){
+        Affine3 T = T0;
+        T.translation().x() += (step % 2) ? 0.0 : 0.001;
+        modelItem->dragTo(T);
+    }
+    modelItem->endDrag();
+}
+
+
+void BenchmarkRunner::exportVRML()
+{
+    modelItem->saveModelFile((workDir / "export.wrl").string());
+}
+
+
+void BenchmarkRunner::exportURDF()
+{
+    modelItem->saveModelFileURDF((workDir / "export.urdf").string());
+}
+
+
+void BenchmarkRunner::exportURDFWithGLB()
+{
+    const LinkNode::VisualMeshFormat orgFormat = LinkNode::visualMeshFormat();
+    LinkNode::setVisualMeshFormat(LinkNode::QUANTIZED_GLB);
+    modelItem->saveModelFileURDF((workDir / "export_glb.urdf").string());
+    LinkNode::setVisualMeshFormat(orgFormat);
+}
+
+
+void BenchmarkRunner::exportSDF()
+{
+    modelItem->saveModelFileSDF((workDir / "export.sdf").string());
+}
+
+
+void BenchmarkRunner::exportBody()
+{
+    modelItem->saveModelFileBody((workDir / "export.body").string());
+}
+
+
+void BenchmarkRunner::exportMJCF()
+{
+    modelItem->saveModelFileMJCF((workDir / "export_mjcf.xml").string());
+}
+
+
+bool BenchmarkRunner::writeResults(const string& filename)
+{
+    FILE* fp = fopen(filename.c_str(), "w");
+    if(!fp){
+        MessageView::instance()->putln(format(_("Cannot write the benchmark results to \"%1%\".")) % filename);
+        return false;
+    }
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"model\": { \"joints\": %d, \"branching\": %d, \"meshDensity\": %d, \"sensors\": %d, \"items\": %d },\n",
+            spec.numJoints, spec.branchingFactor, spec.meshDensity, spec.numSensors, numItems);
+    fprintf(fp, "  \"memory\": { \"loaded\": %lu, \"compact\": %lu, \"loadedVRMLNodes\": %lu, \"meshes\": %lu },\n",
+            (unsigned long)loadedMemory.totalBytes(), (unsigned long)compactMemory.totalBytes(),
+            (unsigned long)loadedMemory.numVRMLNodes, (unsigned long)compactMemory.numMeshes);
+    fprintf(fp, "  \"repeat\": %d,\n", repeat);
+    fprintf(fp, "  \"unit\": \"ms\",\n");
+    fprintf(fp, "  \"results\": [\n");
+    for(size_t i=0; i < results.size(); ++i){
+        const BenchmarkResult& r = results[i];
+        const vector<double>& s = r.samples;
+        double sum = 0.0;
+        for(size_t j=0; j < s.size(); ++j){
+            sum += s[j];
+        }
+        vector<double> sorted(s);
+        sort(sorted.begin(), sorted.end());
+        fprintf(fp, "    { \"name\": \"%s\", \"operations\": %d, \"min\": %.6f, \"median\": %.6f, \"mean\": %.6f, \"max\": %.6f, \"samples\": [",
+                r.name.c_str(), r.operations, sorted.front(), sorted[sorted.size() / 2],
+                sum / s.size(), sorted.back());
+        for(size_t j=0; j < s.size(); ++j){
+            fprintf(fp, (j == 0) ? "%.6f" : ", %.6f", s[j]);
+        }
+        fprintf(fp, "] }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+    bool ok = !ferror(fp);
+    fclose(fp);
+
+    MessageView::instance()->putln(format(_("The benchmark results have been written to \"%1%\".")) % filename);
+    return ok;
+}
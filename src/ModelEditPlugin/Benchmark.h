@@ -0,0 +1,37 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_BENCHMARK_H
+#define CNOID_EDITMODEL_PLUGIN_BENCHMARK_H
+
+#include <string>
+#include "ModelGenerator.h"
+
+namespace cnoid {
+
+/**
+   Benchmarks of the model editing operations on a synthetic model.
+   The benchmarks are built as the executable choreonoid-modeledit-benchmark,
+   which is run as
+
+     choreonoid-modeledit-benchmark [--model <joints,branching,density,sensors>]
+                                    [--repeat <n>] <result.json>
+
+   and quits after writing the results in JSON.
+*/
+class ModelEditBenchmark
+{
+public:
+    /**
+       Runs all the benchmarks and writes the results to the file.
+       The temporary files are created in the system temporary directory.
+       This must be called in the event loop of the application where the
+       plugin has been loaded.
+    */
+    static bool run(const SyntheticModelSpec& spec, int repeat, const std::string& resultFile);
+};
+
+}
+
+#endif
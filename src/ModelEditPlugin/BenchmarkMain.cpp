@@ -0,0 +1,86 @@
+/**
+   @file
+   The executable of the model edit benchmarks. The application is started with
+   the plugins of the plugin path, runs the benchmarks in its event loop and
+   quits with the exit code 1 when any of them fails.
+*/
+
+#include "Benchmark.h"
+#include <cnoid/App>
+#include <cnoid/LazyCaller>
+#include <boost/program_options.hpp>
+#include <boost/bind.hpp>
+#include <QCoreApplication>
+#include <QIcon>
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+namespace po = boost::program_options;
+
+namespace {
+
+#ifdef _WIN32
+const char* PATH_DELIMITER = ";";
+#else
+const char* PATH_DELIMITER = ":";
+#endif
+
+void runAndExit(const SyntheticModelSpec& spec, int repeat, const string& resultFile)
+{
+    QCoreApplication::exit(ModelEditBenchmark::run(spec, repeat, resultFile) ? 0 : 1);
+}
+
+}
+
+
+int main(int argc, char* argv[])
+{
+    po::options_description options("Options");
+    options.add_options()
+        ("help,h", "show this help")
+        ("model", po::value<string>(), "synthetic model given as joints,branching,density,sensors")
+        ("repeat", po::value<int>()->default_value(5), "number of the samples of each benchmark")
+        ("result", po::value<string>(), "JSON file of the results");
+    po::positional_options_description positional;
+    positional.add("result", 1);
+
+    po::variables_map v;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), v);
+        po::notify(v);
+    } catch(const std::exception& ex){
+        cerr << ex.what() << endl;
+        return 2;
+    }
+    if(v.count("help") || !v.count("result")){
+        cout << "Usage: " << argv[0] << " [options] <result.json>\n" << options << endl;
+        return v.count("help") ? 0 : 2;
+    }
+    SyntheticModelSpec spec;
+    if(v.count("model") && !spec.parse(v["model"].as<string>())){
+        cerr << "Invalid model specification: " << v["model"].as<string>() << endl;
+        return 2;
+    }
+    const int repeat = std::max(v["repeat"].as<int>(), 1);
+
+    // the plugin built with this executable is found before the installed ones
+    string pluginPath = MODELEDIT_PLUGIN_DIR;
+    if(const char* path = getenv("CNOID_PLUGIN_PATH")){
+        pluginPath += PATH_DELIMITER;
+        pluginPath += path;
+    }
+
+    // the options of the benchmark are not passed to the application
+    int appArgc = 1;
+    App app(appArgc, argv);
+    app.initialize("Choreonoid", "Choreonoid", QIcon(), pluginPath.c_str());
+
+    // run after the main window has been shown
+    callLater(boost::bind(runAndExit, spec, repeat, v["result"].as<string>()));
+
+    return app.exec();
+}
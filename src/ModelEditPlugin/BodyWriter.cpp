@@ -0,0 +1,330 @@
+/**
+   @file
+*/
+
+#include "BodyWriter.h"
+#include "Trace.h"
+#include <cnoid/VRMLWriter>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+string quote(const string& s)
+{
+    string quoted = "\"";
+    for(size_t i=0; i < s.size(); ++i){
+        if(s[i] == '"' || s[i] == '\\'){
+            quoted += '\\';
+        }
+        quoted += s[i];
+    }
+    return quoted + "\"";
+}
+
+struct List
+{
+    vector<double> values;
+    List(const Vector3& v) : values(v.data(), v.data() + 3) { }
+    List(const Vector3f& v) : values(v.data(), v.data() + 3) { }
+    List(const Matrix3& m) : values(m.data(), m.data() + 9) { }
+};
+
+ostream& operator<<(ostream& os, const List& list)
+{
+    os << "[ ";
+    for(size_t i=0; i < list.values.size(); ++i){
+        os << (i > 0 ? ", " : "") << list.values[i];
+    }
+    return os << " ]";
+}
+
+const char* bodyJointType(const string& type)
+{
+    if(type == "rotate"){
+        return "revolute";
+    } else if(type == "slide"){
+        return "prismatic";
+    } else if(type == "free"){
+        return "free";
+    }
+    return "fixed";
+}
+
+class BodyWriter
+{
+public:
+    BodyWriter(const ModelRootNode* root, const string& filename, ostream& messages);
+    bool write();
+
+private:
+    const ModelRootNode* root;
+    string filename;
+    ostream& messages;
+    ostringstream body;
+    map<string, int> deviceIds;
+    bool isMeshWritingFailed;
+
+    void writeJoint(const JointNode* joint, const JointNode* parent);
+    void writePosition(const string& indent, const Affine3& T);
+    void writePrimitive(const string& indent, const PrimitiveShapeNode* primitive);
+    void writeSensor(const string& indent, const SensorNode* sensor);
+    string writeMeshFile(const JointNode* joint, const LinkNode* link, int index);
+};
+
+}
+
+
+BodyWriter::BodyWriter(const ModelRootNode* root, const string& filename, ostream& messages)
+    : root(root),
+      filename(filename),
+      messages(messages),
+      isMeshWritingFailed(false)
+{
+    body.precision(10);
+}
+
+
+bool BodyWriter::write()
+{
+    vector<const JointNode*> rootJoints;
+    for(int i=0; i < root->numChildren(); ++i){
+        if(const JointNode* joint = dynamic_cast<const JointNode*>(root->child(i))){
+            rootJoints.push_back(joint);
+        }
+    }
+    if(rootJoints.empty()){
+        messages << "[Body] the model has no joint" << endl;
+        return false;
+    }
+    if(rootJoints.size() > 1){
+        messages << "[Body] only the first root joint " << rootJoints.front()->name << " is written" << endl;
+    }
+
+    body << "format: ChoreonoidBody" << endl;
+    body << "formatVersion: 1.0" << endl;
+    body << "angleUnit: radian" << endl;
+    body << "name: " << quote(root->name) << endl;
+    body << "rootLink: " << quote(rootJoints.front()->name) << endl;
+    body << endl;
+    body << "links:" << endl;
+    writeJoint(rootJoints.front(), 0);
+
+    std::ofstream of(filename.c_str(), std::ios::out);
+    of << body.str();
+    of.close();
+    return !of.fail() && !isMeshWritingFailed;
+}
+
+
+void BodyWriter::writePosition(const string& indent, const Affine3& T)
+{
+    body << indent << "translation: " << List(T.translation()) << endl;
+    const AngleAxis aa(T.linear());
+    if(aa.angle() != 0.0){
+        body << indent << "rotation: [ " << aa.axis()[0] << ", " << aa.axis()[1] << ", "
+             << aa.axis()[2] << ", " << aa.angle() << " ]" << endl;
+    }
+}
+
+
+void BodyWriter::writeJoint(const JointNode* joint, const JointNode* parent)
+{
+    MODELEDIT_TRACE_SPAN("BodyWriter::writeJoint");
+
+    const string jointType = bodyJointType(joint->jointType);
+    body << "  -" << endl;
+    body << "    name: " << quote(joint->name) << endl;
+    if(parent){
+        body << "    parent: " << quote(parent->name) << endl;
+    }
+    writePosition("    ", joint->relativePosition());
+    body << "    jointType: " << jointType << endl;
+    if(jointType == "revolute" || jointType == "prismatic"){
+        if(joint->jointId >= 0){
+            body << "    jointId: " << joint->jointId << endl;
+        }
+        body << "    jointAxis: " << List(joint->jointAxis) << endl;
+        body << "    jointRange: [ " << joint->llimit << ", " << joint->ulimit << " ]" << endl;
+        body << "    jointVelocityRange: [ " << joint->lvlimit << ", " << joint->uvlimit << " ]" << endl;
+        body << "    gearRatio: " << joint->gearRatio << endl;
+        body << "    rotorInertia: " << joint->rotorInertia << endl;
+    }
+
+    double mass;
+    Vector3 c;
+    Matrix3 I;
+    joint->getMassProperties(mass, c, I);
+    vector<const JointNode*> childJoints;
+    vector<string> meshFiles(joint->numChildren());
+    bool hasElements = false;
+    int numMeshes = 0;
+    for(int i=0; i < joint->numChildren(); ++i){
+        const ModelNode* child = joint->child(i);
+        if(const LinkNode* link = dynamic_cast<const LinkNode*>(child)){
+            meshFiles[i] = writeMeshFile(joint, link, numMeshes++);
+            hasElements |= !meshFiles[i].empty();
+        } else if(dynamic_cast<const PrimitiveShapeNode*>(child)){
+            hasElements = true;
+        } else if(const JointNode* childJoint = dynamic_cast<const JointNode*>(child)){
+            childJoints.push_back(childJoint);
+        } else if(dynamic_cast<const SensorNode*>(child)){
+            hasElements = true;
+        }
+    }
+    body << "    mass: " << mass << endl;
+    body << "    centerOfMass: " << List(c) << endl;
+    body << "    inertia: " << List(I) << endl;
+
+    if(hasElements){
+        body << "    elements:" << endl;
+    }
+    for(int i=0; i < joint->numChildren(); ++i){
+        const ModelNode* child = joint->child(i);
+        if(const LinkNode* link = dynamic_cast<const LinkNode*>(child)){
+            if(!meshFiles[i].empty()){
+                body << "      -" << endl;
+                body << "        type: Transform" << endl;
+                writePosition("        ", link->relativePosition());
+                body << "        elements:" << endl;
+                body << "          -" << endl;
+                body << "            type: Resource" << endl;
+                body << "            uri: " << quote(meshFiles[i]) << endl;
+            }
+        } else if(const PrimitiveShapeNode* primitive = dynamic_cast<const PrimitiveShapeNode*>(child)){
+            writePrimitive("      ", primitive);
+        } else if(const SensorNode* sensor = dynamic_cast<const SensorNode*>(child)){
+            writeSensor("      ", sensor);
+        }
+    }
+
+    for(size_t i=0; i < childJoints.size(); ++i){
+        writeJoint(childJoints[i], joint);
+    }
+}
+
+
+void BodyWriter::writePrimitive(const string& indent, const PrimitiveShapeNode* primitive)
+{
+    const string& pt = primitive->primitiveType;
+    body << indent << "-" << endl;
+    body << indent << "  type: Transform" << endl;
+    writePosition(indent + "  ", primitive->relativePosition());
+    body << indent << "  elements:" << endl;
+    body << indent << "    -" << endl;
+    body << indent << "      type: Shape" << endl;
+    body << indent << "      geometry:" << endl;
+    body << indent << "        type: " << pt << endl;
+    if(pt == "Box"){
+        body << indent << "        size: " << List(primitive->boxSize) << endl;
+    } else {
+        body << indent << "        radius: " << primitive->primitiveRadius << endl;
+        if(pt != "Sphere"){
+            body << indent << "        height: " << primitive->primitiveHeight << endl;
+        }
+    }
+    body << indent << "      appearance:" << endl;
+    body << indent << "        material:" << endl;
+    body << indent << "          diffuseColor: " << List(primitive->primitiveColor) << endl;
+}
+
+
+void BodyWriter::writeSensor(const string& indent, const SensorNode* sensor)
+{
+    const string& st = sensor->sensorType;
+    string type;
+    if(st == "force"){
+        type = "ForceSensor";
+    } else if(st == "gyro"){
+        type = "RateGyroSensor";
+    } else if(st == "acceleration"){
+        type = "AccelerationSensor";
+    } else if(st == "range"){
+        type = "RangeSensor";
+    } else if(st == "camera"){
+        type = "Camera";
+    } else {
+        messages << "[Body] unsupported sensor type " << st << " of " << sensor->name << endl;
+        return;
+    }
+    body << indent << "-" << endl;
+    body << indent << "  type: " << type << endl;
+    body << indent << "  name: " << quote(sensor->name) << endl;
+    body << indent << "  id: " << deviceIds[type]++ << endl;
+    writePosition(indent + "  ", sensor->relativePosition());
+    if(st == "force"){
+        body << indent << "  maxForce: " << List(sensor->maxForce) << endl;
+        body << indent << "  maxTorque: " << List(sensor->maxTorque) << endl;
+    } else if(st == "gyro"){
+        body << indent << "  maxAngularVelocity: " << List(sensor->maxAngularVelocity) << endl;
+    } else if(st == "acceleration"){
+        body << indent << "  maxAcceleration: " << List(sensor->maxAcceleration) << endl;
+    } else if(st == "range"){
+        body << indent << "  scanAngle: " << sensor->scanAngle << endl;
+        body << indent << "  scanStep: " << sensor->scanStep << endl;
+        body << indent << "  scanRate: " << sensor->scanRate << endl;
+        body << indent << "  minDistance: " << sensor->minDistance << endl;
+        body << indent << "  maxDistance: " << sensor->maxDistance << endl;
+    } else {
+        body << indent << "  format: " << sensor->cameraType << endl;
+        body << indent << "  width: " << sensor->resolutionX << endl;
+        body << indent << "  height: " << sensor->resolutionY << endl;
+        body << indent << "  fieldOfView: " << sensor->fieldOfView << endl;
+        body << indent << "  nearClipDistance: " << sensor->nearDistance << endl;
+        body << indent << "  farClipDistance: " << sensor->farDistance << endl;
+        body << indent << "  frameRate: " << sensor->frameRate << endl;
+    }
+}
+
+
+/**
+   Returns the file name relative to the body file, or an empty string when
+   the link has no geometry.
+*/
+string BodyWriter::writeMeshFile(const JointNode* joint, const LinkNode* link, int index)
+{
+    MODELEDIT_TRACE_SPAN("BodyWriter::writeMeshFile");
+
+    MFNode shapes;
+    link->getShapeVRML(shapes);
+    if(shapes.empty()){
+        return string();
+    }
+    const filesystem::path path(filename);
+    ostringstream name;
+    name << path.stem().string() << "_" << joint->name;
+    if(index > 0){
+        name << "_" << index;
+    }
+    name << ".wrl";
+    const filesystem::path meshPath = path.parent_path() / name.str();
+
+    std::ofstream of(meshPath.string().c_str(), std::ios::out);
+    VRMLWriter writer(of);
+    writer.setOutFileName(meshPath.string());
+    writer.writeHeader();
+    for(size_t i=0; i < shapes.size(); ++i){
+        writer.writeNode(shapes[i]);
+    }
+    of.close();
+    if(of.fail()){
+        messages << "[Body] cannot write " << meshPath.string() << endl;
+        isMeshWritingFailed = true;
+    }
+    return name.str();
+}
+
+
+bool cnoid::writeBodyFile(const ModelRootNode* root, const std::string& filename, std::ostream& os)
+{
+    MODELEDIT_TRACE_SPAN("writeBodyFile");
+    BodyWriter writer(root, filename, os);
+    return writer.write();
+}
@@ -0,0 +1,27 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_BODY_WRITER_H
+#define CNOID_EDITMODEL_PLUGIN_BODY_WRITER_H
+
+#include "ModelNode.h"
+#include <string>
+#include <ostream>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Writes a model tree in the YAML body format of Choreonoid. Each joint node
+   becomes a link whose mass properties are composed from its link and primitive
+   nodes. The geometry of the link nodes is written to the VRML files next to
+   the body file, which are referred by the Resource elements. The primitive
+   shapes are written as Shape elements and the sensors as device elements.
+   The messages of the unsupported nodes are put to os.
+*/
+CNOID_EXPORT bool writeBodyFile(const ModelRootNode* root, const std::string& filename, std::ostream& os);
+
+}
+
+#endif
@@ -0,0 +1,229 @@
+/**
+   \file
+   Helpers to apply a property edit to all the selected items of the same class.
+   The item implementation classes provide "static Impl* implOf(Item* item)" to be
+   used with these templates.
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_BULK_EDIT_H
+#define CNOID_EDITMODEL_PLUGIN_BULK_EDIT_H
+
+#include <cnoid/ItemTreeView>
+#include <cnoid/ItemList>
+#include <cnoid/PutPropertyFunction>
+#include <cnoid/Selection>
+#include <boost/function.hpp>
+#include "EditableModelBase.h"
+#include "PropertyFormat.h"
+
+namespace cnoid {
+
+/**
+   Returns the selected items of the same class as the item when the item itself is
+   selected. Otherwise only the item is returned.
+*/
+template<class ItemType>
+ItemList<ItemType> bulkEditTargets(ItemType* self)
+{
+    ItemList<ItemType> selected = ItemTreeView::mainInstance()->selectedItems<ItemType>();
+    for(size_t i=0; i < selected.size(); ++i){
+        if(selected.get(i) == self){
+            return selected;
+        }
+    }
+    ItemList<ItemType> targets;
+    targets.push_back(self);
+    return targets;
+}
+
+
+template<class ValueType>
+bool isSameBulkValue(const ValueType& value1, const ValueType& value2)
+{
+    return value1 == value2;
+}
+
+inline bool isSameBulkValue(const Selection& value1, const Selection& value2)
+{
+    return value1.selectedIndex() == value2.selectedIndex();
+}
+
+/**
+   Returns true when the field has the same value in all the edit targets
+*/
+template<class ItemType, class ImplType, class ValueType>
+bool isUniformBulkValue(const ItemList<ItemType>& targets, ValueType ImplType::* field)
+{
+    for(size_t i=1; i < targets.size(); ++i){
+        if(!isSameBulkValue(ImplType::implOf(targets.get(i))->*field, ImplType::implOf(targets.get(0))->*field)){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+template<class ItemType, class ImplType, class ValueType>
+class BulkFieldSetter
+{
+public:
+    BulkFieldSetter(ItemType* self, ValueType ImplType::* field) : self(self), field(field) { }
+    bool operator()(const ValueType& value) const {
+        ItemList<ItemType> targets = bulkEditTargets(self);
+        EditableModelBase::EditBatch batch;
+        for(size_t i=0; i < targets.size(); ++i){
+            batch.add(targets.get(i));
+            ImplType::implOf(targets.get(i))->*field = value;
+            targets.get(i)->requestUpdate();
+        }
+        return true;
+    }
+private:
+    ItemType* self;
+    ValueType ImplType::* field;
+};
+
+
+/**
+   Parses the text into the value, which is then checked by the filter function
+   before any target is changed. The filter may also normalize the value.
+*/
+template<class ItemType, class ImplType, class ValueType>
+class BulkTextSetter
+{
+public:
+    typedef bool (*Filter)(ValueType& value);
+    BulkTextSetter(ItemType* self, ValueType ImplType::* field, Filter filter)
+        : self(self), field(field), filter(filter) { }
+    bool operator()(const std::string& text) const {
+        ValueType value;
+        if(!parseProperty(text, value)){
+            return false;
+        }
+        if(filter && !filter(value)){
+            return false;
+        }
+        return BulkFieldSetter<ItemType, ImplType, ValueType>(self, field)(value);
+    }
+private:
+    ItemType* self;
+    ValueType ImplType::* field;
+    Filter filter;
+};
+
+
+template<class ItemType, class ImplType>
+class BulkSelectionSetter
+{
+public:
+    BulkSelectionSetter(ItemType* self, Selection ImplType::* field) : self(self), field(field) { }
+    bool operator()(int index) const {
+        ItemList<ItemType> targets = bulkEditTargets(self);
+        for(size_t i=0; i < targets.size(); ++i){
+            if(index < 0 || index >= (ImplType::implOf(targets.get(i))->*field).size()){
+                return false;
+            }
+        }
+        return apply(targets, index);
+    }
+    bool operator()(const std::string& symbol) const {
+        ItemList<ItemType> targets = bulkEditTargets(self);
+        int index = -1;
+        for(size_t i=0; i < targets.size(); ++i){
+            int found = (ImplType::implOf(targets.get(i))->*field).index(symbol);
+            if(found < 0 || (i > 0 && found != index)){
+                return false;
+            }
+            index = found;
+        }
+        return apply(targets, index);
+    }
+private:
+    ItemType* self;
+    Selection ImplType::* field;
+
+    bool apply(const ItemList<ItemType>& targets, int index) const {
+        EditableModelBase::EditBatch batch;
+        for(size_t i=0; i < targets.size(); ++i){
+            batch.add(targets.get(i));
+            (ImplType::implOf(targets.get(i))->*field).selectIndex(index);
+            targets.get(i)->requestUpdate();
+        }
+        return true;
+    }
+};
+
+
+/**
+   Counterpart of changeProperty() which applies the value to all the edit targets
+*/
+template<class ItemType, class ImplType, class ValueType>
+boost::function<bool(ValueType)> changeBulkProperty(ItemType* self, ValueType ImplType::* field)
+{
+    return BulkFieldSetter<ItemType, ImplType, ValueType>(self, field);
+}
+
+template<class ItemType, class ImplType, class ValueType>
+boost::function<bool(const std::string&)> changeBulkTextProperty
+(ItemType* self, ValueType ImplType::* field, bool (*filter)(ValueType& value) = 0)
+{
+    return BulkTextSetter<ItemType, ImplType, ValueType>(self, field, filter);
+}
+
+template<class ItemType, class ImplType>
+boost::function<bool(int)> changeBulkSelection(ItemType* self, Selection ImplType::* field)
+{
+    return BulkSelectionSetter<ItemType, ImplType>(self, field);
+}
+
+
+/**
+   Puts the value of the field as it is when all the edit targets have the same value.
+   Otherwise the property is shown as a blank text, which accepts a value for all
+   the targets. The settings such as decimals() are given to putProperty beforehand.
+*/
+template<class ItemType, class ImplType, class ValueType>
+void putBulkProperty(PutPropertyFunction& putProperty, const std::string& name,
+                     ItemType* self, ValueType ImplType::* field)
+{
+    if(isUniformBulkValue(bulkEditTargets(self), field)){
+        putProperty(name, ImplType::implOf(self)->*field, changeBulkProperty(self, field));
+    } else {
+        putProperty(name, std::string(), changeBulkTextProperty(self, field));
+    }
+}
+
+/**
+   Counterpart of putBulkProperty() for the fixed size Eigen types, which are edited
+   as text. The filter checks the value before any target is changed.
+*/
+template<class ItemType, class ImplType, class ValueType>
+void putBulkVectorProperty(PutPropertyFunction& putProperty, const std::string& name,
+                           ItemType* self, ValueType ImplType::* field,
+                           bool (*filter)(ValueType& value) = 0)
+{
+    std::string text;
+    if(isUniformBulkValue(bulkEditTargets(self), field)){
+        text = formatProperty(ImplType::implOf(self)->*field).str();
+    }
+    putProperty(name, text, changeBulkTextProperty(self, field, filter));
+}
+
+/**
+   A mixed selection is shown as a blank text which accepts one of the symbols.
+*/
+template<class ItemType, class ImplType>
+void putBulkSelection(PutPropertyFunction& putProperty, const std::string& name,
+                      ItemType* self, Selection ImplType::* field)
+{
+    if(isUniformBulkValue(bulkEditTargets(self), field)){
+        putProperty(name, ImplType::implOf(self)->*field, changeBulkSelection(self, field));
+    } else {
+        putProperty(name, std::string(),
+                    boost::function<bool(const std::string&)>(BulkSelectionSetter<ItemType, ImplType>(self, field)));
+    }
+}
+
+}
+
+#endif
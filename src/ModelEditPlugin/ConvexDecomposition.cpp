@@ -0,0 +1,449 @@
+/**
+   @file
+*/
+
+#include "ConvexDecomposition.h"
+#include "MeshTransform.h"
+#include "Trace.h"
+#include <set>
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+typedef Eigen::Vector3i Triangle;
+
+struct SourceMesh
+{
+    vector<Vector3> points;
+    vector<Triangle> triangles;
+};
+
+struct HullFace
+{
+    int v[3];
+    Vector3 n;
+    double d;
+    vector<int> outside;
+    bool isAlive;
+
+    double distance(const Vector3& p) const { return n.dot(p) - d; }
+};
+
+/**
+   Quickhull which adds the farthest outside point first and stops at the vertex
+   limit, so a limited hull keeps the most significant points.
+*/
+class HullBuilder
+{
+public:
+    const vector<Vector3>& points;
+    vector<HullFace> faces;
+    double eps;
+
+    HullBuilder(const vector<Vector3>& points, double eps) : points(points), eps(eps) { }
+    bool build(int maxVertices);
+    double distanceInside(const Vector3& p) const;
+    SgMesh* createMesh() const;
+
+private:
+    bool addFace(int a, int b, int c);
+    void assignPoints(const vector<int>& candidates, size_t firstFace);
+};
+
+
+bool HullBuilder::addFace(int a, int b, int c)
+{
+    HullFace face;
+    face.v[0] = a;
+    face.v[1] = b;
+    face.v[2] = c;
+    Vector3 n = (points[b] - points[a]).cross(points[c] - points[a]);
+    const double norm = n.norm();
+    if(norm <= 0.0){
+        return false;
+    }
+    face.n = n / norm;
+    face.d = face.n.dot(points[a]);
+    face.isAlive = true;
+    faces.push_back(face);
+    return true;
+}
+
+
+void HullBuilder::assignPoints(const vector<int>& candidates, size_t firstFace)
+{
+    for(size_t i=0; i < candidates.size(); ++i){
+        const Vector3& p = points[candidates[i]];
+        int best = -1;
+        double maxDistance = eps;
+        for(size_t j=firstFace; j < faces.size(); ++j){
+            if(faces[j].isAlive){
+                const double d = faces[j].distance(p);
+                if(d > maxDistance){
+                    maxDistance = d;
+                    best = j;
+                }
+            }
+        }
+        if(best >= 0){
+            faces[best].outside.push_back(candidates[i]);
+        }
+    }
+}
+
+
+bool HullBuilder::build(int maxVertices)
+{
+    const int n = points.size();
+    if(n < 4){
+        return false;
+    }
+
+    // initial tetrahedron from the extreme points
+    int i0 = 0, i1 = 0;
+    for(int i=1; i < n; ++i){
+        if(points[i].x() < points[i0].x()) i0 = i;
+        if(points[i].x() > points[i1].x()) i1 = i;
+    }
+    if((points[i1] - points[i0]).norm() <= eps){
+        for(int i=0; i < n; ++i){
+            if((points[i] - points[i0]).norm() > (points[i1] - points[i0]).norm()) i1 = i;
+        }
+    }
+    const Vector3 axis = (points[i1] - points[i0]).normalized();
+    int i2 = -1;
+    double maxDistance = eps;
+    for(int i=0; i < n; ++i){
+        const Vector3 v = points[i] - points[i0];
+        const double d = (v - axis * axis.dot(v)).norm();
+        if(d > maxDistance){
+            maxDistance = d;
+            i2 = i;
+        }
+    }
+    if(i2 < 0){
+        return false;
+    }
+    const Vector3 normal = (points[i1] - points[i0]).cross(points[i2] - points[i0]).normalized();
+    int i3 = -1;
+    maxDistance = eps;
+    for(int i=0; i < n; ++i){
+        const double d = fabs(normal.dot(points[i] - points[i0]));
+        if(d > maxDistance){
+            maxDistance = d;
+            i3 = i;
+        }
+    }
+    if(i3 < 0){
+        return false;
+    }
+
+    const int simplex[4] = { i0, i1, i2, i3 };
+    for(int k=0; k < 4; ++k){
+        int a = simplex[k], b = simplex[(k + 1) % 4], c = simplex[(k + 2) % 4];
+        const int opposite = simplex[(k + 3) % 4];
+        const Vector3 fn = (points[b] - points[a]).cross(points[c] - points[a]);
+        if(fn.dot(points[opposite] - points[a]) > 0.0){
+            std::swap(b, c);
+        }
+        if(!addFace(a, b, c)){
+            return false;
+        }
+    }
+    vector<int> candidates;
+    candidates.reserve(n);
+    for(int i=0; i < n; ++i){
+        if(i != i0 && i != i1 && i != i2 && i != i3){
+            candidates.push_back(i);
+        }
+    }
+    assignPoints(candidates, 0);
+
+    int numVertices = 4;
+    while(numVertices < maxVertices){
+        // the farthest outside point of all the faces
+        int apex = -1;
+        double apexDistance = 0.0;
+        for(size_t i=0; i < faces.size(); ++i){
+            const HullFace& face = faces[i];
+            if(!face.isAlive){
+                continue;
+            }
+            for(size_t j=0; j < face.outside.size(); ++j){
+                const double d = face.distance(points[face.outside[j]]);
+                if(d > apexDistance){
+                    apexDistance = d;
+                    apex = face.outside[j];
+                }
+            }
+        }
+        if(apex < 0){
+            break;
+        }
+        const Vector3& p = points[apex];
+
+        set< pair<int, int> > visibleEdges;
+        candidates.clear();
+        const size_t numFaces = faces.size();
+        for(size_t i=0; i < numFaces; ++i){
+            HullFace& face = faces[i];
+            if(face.isAlive && face.distance(p) > eps){
+                for(int k=0; k < 3; ++k){
+                    visibleEdges.insert(make_pair(face.v[k], face.v[(k + 1) % 3]));
+                }
+                for(size_t j=0; j < face.outside.size(); ++j){
+                    if(face.outside[j] != apex){
+                        candidates.push_back(face.outside[j]);
+                    }
+                }
+                face.outside.clear();
+                face.isAlive = false;
+            }
+        }
+        for(set< pair<int, int> >::iterator q = visibleEdges.begin(); q != visibleEdges.end(); ++q){
+            if(!visibleEdges.count(make_pair(q->second, q->first))){
+                addFace(q->first, q->second, apex);
+            }
+        }
+        assignPoints(candidates, numFaces);
+        ++numVertices;
+    }
+    return true;
+}
+
+
+/// Distance from the hull surface to a point inside, which is zero for the points outside
+double HullBuilder::distanceInside(const Vector3& p) const
+{
+    double minDistance = numeric_limits<double>::max();
+    for(size_t i=0; i < faces.size(); ++i){
+        if(faces[i].isAlive){
+            const double d = -faces[i].distance(p);
+            if(d <= 0.0){
+                return 0.0;
+            }
+            minDistance = std::min(minDistance, d);
+        }
+    }
+    return minDistance == numeric_limits<double>::max() ? 0.0 : minDistance;
+}
+
+
+SgMesh* HullBuilder::createMesh() const
+{
+    SgMesh* mesh = new SgMesh;
+    SgVertexArray* vertices = new SgVertexArray;
+    SgNormalArray* normals = new SgNormalArray;
+    SgIndexArray& triangles = mesh->triangleVertices();
+    SgIndexArray& normalIndices = mesh->normalIndices();
+    vector<int> indices(points.size(), -1);
+
+    for(size_t i=0; i < faces.size(); ++i){
+        const HullFace& face = faces[i];
+        if(!face.isAlive){
+            continue;
+        }
+        for(int k=0; k < 3; ++k){
+            int& index = indices[face.v[k]];
+            if(index < 0){
+                index = vertices->size();
+                vertices->push_back(points[face.v[k]].cast<float>());
+            }
+            triangles.push_back(index);
+            normalIndices.push_back(normals->size());
+        }
+        // flat shading
+        normals->push_back(face.n.cast<float>());
+    }
+    mesh->setVertices(vertices);
+    mesh->setNormals(normals);
+    mesh->updateBoundingBox();
+    return mesh;
+}
+
+
+struct Part
+{
+    vector<int> triangles;
+    vector<Vector3> points;
+    SgMeshPtr hull;
+    double concavity;
+    bool isSplittable;
+};
+
+
+class Decomposer
+{
+public:
+    const SourceMesh& source;
+    const ConvexDecompositionParams& params;
+    double eps;
+    double thickness;
+
+    Decomposer(const SourceMesh& source, const ConvexDecompositionParams& params, double size)
+        : source(source), params(params) {
+        eps = 1.0e-6 * size;
+        thickness = 1.0e-3 * size;
+    }
+
+    void updatePart(Part& part);
+    bool split(const Part& part, Part& part1, Part& part2);
+};
+
+
+void Decomposer::updatePart(Part& part)
+{
+    vector<char> used(source.points.size(), 0);
+    part.points.clear();
+    for(size_t i=0; i < part.triangles.size(); ++i){
+        const Triangle& t = source.triangles[part.triangles[i]];
+        for(int k=0; k < 3; ++k){
+            if(!used[t[k]]){
+                used[t[k]] = 1;
+                part.points.push_back(source.points[t[k]]);
+            }
+        }
+    }
+    part.hull = 0;
+    part.concavity = 0.0;
+    part.isSplittable = part.triangles.size() > 1;
+
+    HullBuilder builder(part.points, eps);
+    if(builder.build(params.maxVerticesPerHull)){
+        part.hull = builder.createMesh();
+        for(size_t i=0; i < part.points.size(); ++i){
+            part.concavity = std::max(part.concavity, builder.distanceInside(part.points[i]));
+        }
+        return;
+    }
+
+    // a flat part is thickened so that it still collides
+    const Triangle& t = source.triangles[part.triangles.front()];
+    Vector3 n = (source.points[t[1]] - source.points[t[0]]).cross(source.points[t[2]] - source.points[t[0]]);
+    if(n.norm() <= 0.0){
+        part.isSplittable = false;
+        return;
+    }
+    n.normalize();
+    vector<Vector3> thickened(part.points);
+    for(size_t i=0; i < part.points.size(); ++i){
+        thickened.push_back(part.points[i] + n * thickness);
+    }
+    HullBuilder flatBuilder(thickened, eps);
+    if(flatBuilder.build(params.maxVerticesPerHull)){
+        part.hull = flatBuilder.createMesh();
+    }
+    part.isSplittable = false;
+}
+
+
+bool Decomposer::split(const Part& part, Part& part1, Part& part2)
+{
+    Vector3 min = part.points.front();
+    Vector3 max = min;
+    for(size_t i=1; i < part.points.size(); ++i){
+        min = min.cwiseMin(part.points[i]);
+        max = max.cwiseMax(part.points[i]);
+    }
+    int axis;
+    (max - min).maxCoeff(&axis);
+
+    double mean = 0.0;
+    for(size_t i=0; i < part.triangles.size(); ++i){
+        const Triangle& t = source.triangles[part.triangles[i]];
+        mean += source.points[t[0]][axis] + source.points[t[1]][axis] + source.points[t[2]][axis];
+    }
+    mean /= part.triangles.size() * 3.0;
+
+    for(size_t i=0; i < part.triangles.size(); ++i){
+        const Triangle& t = source.triangles[part.triangles[i]];
+        const double c = (source.points[t[0]][axis] + source.points[t[1]][axis] + source.points[t[2]][axis]) / 3.0;
+        if(c < mean){
+            part1.triangles.push_back(part.triangles[i]);
+        } else {
+            part2.triangles.push_back(part.triangles[i]);
+        }
+    }
+    return !part1.triangles.empty() && !part2.triangles.empty();
+}
+
+}
+
+
+ConvexDecompositionParams::ConvexDecompositionParams()
+    : maxHulls(16),
+      maxVerticesPerHull(32),
+      maxConcavity(0.02)
+{
+
+}
+
+
+void cnoid::decomposeConvex
+(SgNode* scene, const ConvexDecompositionParams& params, std::vector<SgMeshPtr>& out_hulls)
+{
+    MODELEDIT_TRACE_SPAN("decomposeConvex");
+
+    out_hulls.clear();
+    if(!scene){
+        return;
+    }
+    SourceMesh source;
+    collectSceneTriangles(scene, source.points, source.triangles);
+    if(source.triangles.empty()){
+        return;
+    }
+    Vector3 min = source.points.front();
+    Vector3 max = min;
+    for(size_t i=1; i < source.points.size(); ++i){
+        min = min.cwiseMin(source.points[i]);
+        max = max.cwiseMax(source.points[i]);
+    }
+    const double size = (max - min).norm();
+    if(size <= 0.0){
+        return;
+    }
+
+    Decomposer decomposer(source, params, size);
+    vector<Part> parts(1);
+    for(size_t i=0; i < source.triangles.size(); ++i){
+        parts[0].triangles.push_back(i);
+    }
+    decomposer.updatePart(parts[0]);
+
+    const double maxConcavity = params.maxConcavity * size;
+    while((int)parts.size() < params.maxHulls){
+        int worst = -1;
+        for(size_t i=0; i < parts.size(); ++i){
+            if(parts[i].isSplittable && parts[i].concavity > maxConcavity &&
+               (worst < 0 || parts[i].concavity > parts[worst].concavity)){
+                worst = i;
+            }
+        }
+        if(worst < 0){
+            break;
+        }
+        Part part1, part2;
+        if(!decomposer.split(parts[worst], part1, part2)){
+            parts[worst].isSplittable = false;
+            continue;
+        }
+        decomposer.updatePart(part1);
+        decomposer.updatePart(part2);
+        parts[worst] = part1;
+        parts.push_back(part2);
+    }
+
+    for(size_t i=0; i < parts.size(); ++i){
+        if(parts[i].hull){
+            out_hulls.push_back(parts[i].hull);
+        }
+    }
+    MODELEDIT_TRACE_COUNTER("Convex hulls", out_hulls.size());
+}
@@ -0,0 +1,45 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_CONVEX_DECOMPOSITION_H
+#define CNOID_EDITMODEL_PLUGIN_CONVEX_DECOMPOSITION_H
+
+#include <cnoid/SceneGraph>
+#include <cnoid/SceneShape>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class CNOID_EXPORT ConvexDecompositionParams
+{
+public:
+    ConvexDecompositionParams();
+
+    /// Maximum number of the convex hulls of a shape
+    int maxHulls;
+    /// Maximum number of the vertices of a hull
+    int maxVerticesPerHull;
+    /**
+       A part is split while a vertex of it is farther from its hull surface than
+       this ratio to the diagonal of the bounding box of the shape.
+    */
+    double maxConcavity;
+};
+
+/**
+   Approximate convex decomposition of the triangles in a scene subtree.
+   The part whose hull deviates most from its triangles is split by the plane
+   perpendicular to its longest extent until the hull count reaches the limit or
+   all the parts are convex enough. The hulls are in the coordinate of the
+   subtree root.
+
+   The scene is only read, so this can be called in a worker thread.
+*/
+CNOID_EXPORT void decomposeConvex(
+    SgNode* scene, const ConvexDecompositionParams& params, std::vector<SgMeshPtr>& out_hulls);
+
+}
+
+#endif
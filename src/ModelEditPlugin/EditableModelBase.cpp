@@ -3,14 +3,21 @@
 */
 
 #include "EditableModelBase.h"
+#include "JointItem.h"
+#include "LinkItem.h"
+#include "SensorItem.h"
+#include "PrimitiveShapeItem.h"
+#include "EditableModelItem.h"
+#include "PropertyFormat.h"
+#include "Trace.h"
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
 #include <cnoid/VRML>
+#include <cnoid/ItemTreeView>
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 #include <bitset>
 #include <deque>
-#include <iostream>
 #include <algorithm>
 #include "gettext.h"
 
@@ -23,90 +30,378 @@ const bool TRACE_FUNCTIONS = false;
 
 inline double radian(double deg) { return (3.14159265358979 * deg / 180.0); }
 
-vector<double> readvector(const std::string& value)
+/// Moves the nodes of the subtree by x' = R x + p
+void moveModelNodes(ModelNode* node, const Matrix3& R, const Vector3& p)
 {
-    double v;
-    vector<double> ret;
-    
-    stringstream ss(value);
-    
-    while(!ss.eof()){
-        ss >> v;
-        ret.push_back(v);
-        ss.ignore();
+    node->translation = R * node->translation + p;
+    node->rotation = R * node->rotation;
+    for(int i=0; i < node->numChildren(); ++i){
+        moveModelNodes(node->child(i), R, p);
+    }
+}
+
+
+/**
+   The exported nodes are relative to the parent joint, so the subtree is put
+   under a node of the parent item.
+*/
+ModelNodePtr createExportedSubtree(const EditableModelBase* item, ModelNodePtr& holder)
+{
+    ModelNodePtr node = item->createModelSubtree();
+    EditableModelBase* parent = dynamic_cast<EditableModelBase*>(item->parentItem());
+    if(node && parent){
+        holder = parent->createModelNode();
+        if(holder){
+            holder->name = parent->name();
+            holder->translation = parent->translation;
+            holder->rotation = parent->rotation;
+            holder->addChild(node);
+        }
     }
-    return ret;
+    return node;
 }
+
 }
 
 EditableModelBase::EditableModelBase()
-    : translation(),
-      rotation()
+    : translation(Vector3::Zero()),
+      rotation(Matrix3::Identity()),
+      isUpdatePending(false),
+      pendingTranslation(Vector3::Zero()),
+      pendingRotation(Matrix3::Identity())
+{}
+
+
+EditableModelBase::EditableModelBase(const EditableModelBase& org)
+    : Item(org),
+      originalNode(org.originalNode),
+      translation(org.translation),
+      rotation(org.rotation),
+      isUpdatePending(false),
+      pendingChildren(org.pendingChildren ? org.pendingChildren->cloneSubtree() : ModelNodePtr()),
+      pendingTranslation(org.pendingTranslation),
+      pendingRotation(org.pendingRotation)
 {}
 
 
+ModelNodePtr EditableModelBase::createModelNode() const
+{
+    return 0;
+}
+
+
+void EditableModelBase::adjustDraggerSize(PositionDragger* dragger)
+{
+    dragger->setRadius(0.1);
+}
+
+
+void EditableModelBase::readModelNode(const ModelNode* node)
+{
+    if(name().empty()){
+        setName(node->name);
+    }
+    translation = node->translation;
+    rotation = node->rotation;
+    originalNode = node->originalNode;
+}
+
+
+EditableModelBase* EditableModelBase::createItemTree
+(ModelNode* node, Item* parentItem, bool isLazy, const Affine3& motion)
+{
+    EditableModelBasePtr item;
+    if(JointNode* joint = dynamic_cast<JointNode*>(node)){
+        item = new JointItem(joint);
+    } else if(LinkNode* link = dynamic_cast<LinkNode*>(node)){
+        item = new LinkItem(link);
+    } else if(SensorNode* sensor = dynamic_cast<SensorNode*>(node)){
+        item = new SensorItem(sensor);
+    } else if(PrimitiveShapeNode* primitive = dynamic_cast<PrimitiveShapeNode*>(node)){
+        item = new PrimitiveShapeItem(primitive);
+    }
+    if(!item){
+        return 0;
+    }
+    item->translation = motion.linear() * item->translation + motion.translation();
+    item->rotation = motion.linear() * item->rotation;
+    // the node is kept before the item is shown so that the scene has the deferred shapes
+    if(isLazy && node->numChildren() > 0 &&
+       dynamic_cast<JointItem*>(item.get()) && dynamic_cast<JointItem*>(parentItem)){
+        item->pendingChildren = node;
+        item->setPendingMotion(motion);
+    }
+    parentItem->addChildItem(item);
+    // the collision shapes under the links are not shown by default
+    if(!dynamic_cast<LinkNode*>(node->parent())){
+        ItemTreeView::instance()->checkItem(item, true);
+    }
+    if(item->pendingChildren){
+        return item.get();
+    }
+    for(int i=0; i < node->numChildren(); ++i){
+        createItemTree(node->child(i), item, isLazy, motion);
+    }
+    return item.get();
+}
+
+
+void EditableModelBase::materializeChildren() const
+{
+    if(!pendingChildren){
+        return;
+    }
+    MODELEDIT_TRACE_SPAN("EditableModelBase::materializeChildren");
+    ModelNodePtr node = pendingChildren;
+    const Affine3 motion = pendingMotion();
+    EditableModelBase* self = const_cast<EditableModelBase*>(this);
+    pendingChildren = 0;
+    self->setPendingMotion(Affine3::Identity());
+    for(int i=0; i < node->numChildren(); ++i){
+        createItemTree(node->child(i), self, true, motion);
+    }
+    // the joint item replaces the shapes of the deferred subtree with the items
+    self->requestUpdate();
+}
+
+
+void EditableModelBase::materializeSubtree() const
+{
+    materializeChildren();
+    for(Item* child = childItem(); child; child = child->nextItem()){
+        if(EditableModelBase* item = dynamic_cast<EditableModelBase*>(child)){
+            item->materializeSubtree();
+        } else {
+            materializeItems(child);
+        }
+    }
+}
+
+
+void EditableModelBase::materializeItems(Item* item)
+{
+    if(EditableModelBase* model = dynamic_cast<EditableModelBase*>(item)){
+        model->materializeSubtree();
+        return;
+    }
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        materializeItems(child);
+    }
+}
+
+
+Affine3 EditableModelBase::pendingMotion() const
+{
+    Affine3 T;
+    T.translation() = pendingTranslation;
+    T.linear() = pendingRotation;
+    return T;
+}
+
+
+void EditableModelBase::setPendingMotion(const Affine3& T)
+{
+    pendingTranslation = T.translation();
+    pendingRotation = T.linear();
+}
+
+
+ModelNodePtr EditableModelBase::createModelSubtree() const
+{
+    ModelNodePtr node = createModelNode();
+    if(!node){
+        return 0;
+    }
+    node->name = name();
+    node->translation = translation;
+    node->rotation = rotation;
+    node->originalNode = originalNode;
+    // the deferred children are exported from the copies of their nodes without the items
+    if(pendingChildren){
+        for(int i=0; i < pendingChildren->numChildren(); ++i){
+            ModelNodePtr childNode = pendingChildren->child(i)->cloneSubtree();
+            moveModelNodes(childNode.get(), pendingRotation, pendingTranslation);
+            node->addChild(childNode.get());
+        }
+    }
+    for(Item* child = childItem(); child; child = child->nextItem()){
+        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
+        if(item){
+            ModelNodePtr childNode = item->createModelSubtree();
+            if(childNode){
+                node->addChild(childNode);
+            }
+        }
+    }
+    return node;
+}
+
+
+VRMLNodePtr EditableModelBase::toVRML() const
+{
+    ModelNodePtr holder;
+    ModelNodePtr node = createExportedSubtree(this, holder);
+    if(!node){
+        return 0;
+    }
+    return node->toVRML();
+}
+
+
+std::string EditableModelBase::toURDF(std::ostream& os) const
+{
+    ModelNodePtr holder;
+    ModelNodePtr node = createExportedSubtree(this, holder);
+    if(!node){
+        return std::string();
+    }
+    return node->toURDF(os);
+}
+
+
+void EditableModelBase::requestUpdate()
+{
+    EditBatchState& batch = editBatchState();
+    if(!batch.isOpen()){
+        notifyUpdate();
+    } else if(!isUpdatePending){
+        isUpdatePending = true;
+        batch.pendingUpdates.push_back(this);
+    }
+}
+
+
+Item* EditableModelBase::editBatchOwner(EditBatchState*& out_state)
+{
+    EditableModelBase* top = this;
+    for(Item* item = parentItem(); item; item = item->parentItem()){
+        if(EditableModelItem* model = dynamic_cast<EditableModelItem*>(item)){
+            out_state = &model->editBatchState();
+            return model;
+        }
+        if(EditableModelBase* base = dynamic_cast<EditableModelBase*>(item)){
+            top = base;
+        }
+    }
+    out_state = &top->ownEditBatch;
+    return top;
+}
+
+
+EditBatchState& EditableModelBase::editBatchState()
+{
+    EditBatchState* state;
+    editBatchOwner(state);
+    return *state;
+}
+
+
+void EditBatchState::begin()
+{
+    ++depth;
+}
+
+
+void EditBatchState::end()
+{
+    if(depth == 0 || --depth > 0){
+        return;
+    }
+    MODELEDIT_TRACE_SPAN("EditBatchState::end");
+    MODELEDIT_TRACE_COUNTER("Batched updates", pendingUpdates.size());
+    vector<EditableModelBasePtr> items;
+    items.swap(pendingUpdates);
+    for(size_t i=0; i < items.size(); ++i){
+        items[i]->isUpdatePending = false;
+        items[i]->notifyUpdate();
+    }
+}
+
+
+void EditableModelBase::EditBatch::add(EditableModelBase* item)
+{
+    EditBatchState* state;
+    Item* owner = item->editBatchOwner(state);
+    if(std::find(states.begin(), states.end(), state) == states.end()){
+        owners.push_back(owner);
+        states.push_back(state);
+        state->begin();
+    }
+}
+
+
+EditableModelBase::EditBatch::~EditBatch()
+{
+    for(size_t i=states.size(); i > 0; --i){
+        states[i - 1]->end();
+    }
+}
+
+
 void EditableModelBase::doPutProperties(PutPropertyFunction& putProperty)
 {
-    ostringstream oss;
-    putProperty(_("Translation"), str(Vector3(translation)),
+    putProperty(_("Translation"), formatProperty(translation).str(),
                 boost::bind(&EditableModelBase::onTranslationChanged, this, _1));
     SFRotation rotaxis;
     rotaxis = rotation;
-    oss.str("");
-    oss << rotaxis.angle() << " " << str(rotaxis.axis());
-    putProperty(_("Rotation (Axis)"), oss.str(),
+    Vector4 angleAxis;
+    angleAxis << rotaxis.angle(), rotaxis.axis();
+    putProperty(_("Rotation (Axis)"), formatProperty(angleAxis).str(),
                 boost::bind(&EditableModelBase::onRotationAxisChanged, this, _1));
-    Vector3 rpy(rpyFromRot(rotation));
-    putProperty("Rotation (RPY)", str(TO_DEGREE * rpy), boost::bind(&EditableModelBase::onRotationRPYChanged, this, _1));
-    oss.str("");
-    oss << rotation;
-    putProperty(_("Rotation (Matrix)"), oss.str(),
+    Vector3 rpy(TO_DEGREE * rpyFromRot(rotation));
+    putProperty("Rotation (RPY)", formatProperty(rpy).str(),
+                boost::bind(&EditableModelBase::onRotationRPYChanged, this, _1));
+    putProperty(_("Rotation (Matrix)"), formatProperty(rotation).str(),
                 boost::bind(&EditableModelBase::onRotationChanged, this, _1));
 }
 
 
+/**
+   Reflects the pose by x' = S x + offset. The rotation is conjugated by S
+   so that it stays a proper rotation matrix.
+*/
+void EditableModelBase::applyMirror(const Matrix3& S, const Vector3& offset)
+{
+    translation = S * translation + offset;
+    rotation = S * rotation * S;
+}
+
+
 bool EditableModelBase::onTranslationChanged(const std::string& value)
 {
-    Vector3 p;
-    if(toVector3(value, p)){
-        translation = p;
-        return true;
-    }
-    return false;
+    return parseProperty(value, translation);
 }
 
 
 bool EditableModelBase::onRotationChanged(const std::string& value)
 {
-    vector<double> v = readvector(value);
-    if (v.size() != 9) {
+    Matrix3 R;
+    if(!parseProperty(value, R)){
         return false;
     }
-    rotation << v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8];
+    // accept only proper rotation matrices (up to the precision of the displayed values)
+    if((R * R.transpose() - Matrix3::Identity()).cwiseAbs().maxCoeff() > 1.0e-4 || R.determinant() < 0.0){
+        return false;
+    }
+    rotation = R;
     return true;
 }
 
 
 bool EditableModelBase::onRotationAxisChanged(const std::string& value)
 {
-    vector<double> v = readvector(value);
-    if (v.size() != 4) {
+    Vector4 v;
+    if(!parseProperty(value, v)){
         return false;
     }
-    SFRotation rot;
-    SFRotation::Vector3& axis = rot.axis();
-    axis[0] = v[1];
-    axis[1] = v[2];
-    axis[2] = v[3];
-    rot.angle() = v[0];
-
+    Vector3 axis(v[1], v[2], v[3]);
     double size = axis.norm();
     if(size < 1.0e-6){
         return false;
     }
     axis /= size; // normalize
     
-    rotation = rot.toRotationMatrix();
+    rotation = AngleAxis(v[0], axis).toRotationMatrix();
     return true;
 }
 
@@ -114,7 +409,7 @@ bool EditableModelBase::onRotationAxisChanged(const std::string& value)
 bool EditableModelBase::onRotationRPYChanged(const std::string& value)
 {
     Vector3 rpy;
-    if(toVector3(value, rpy)){
+    if(parseProperty(value, rpy)){
         rotation = rotFromRpy(TO_RADIAN * rpy);
         return true;
     }
@@ -9,28 +9,154 @@
 #include <cnoid/Body>
 #include <cnoid/Link>
 #include <cnoid/SceneProvider>
+#include <cnoid/PositionDragger>
 #include <cnoid/VRML>
 #include <cnoid/VRMLBodyLoader>
 #include <boost/optional.hpp>
 #include <string>
+#include <ostream>
+#include <vector>
+#include "ModelNode.h"
 #include "exportdecl.h"
 
 namespace cnoid {
 
+class EditableModelBase;
+typedef ref_ptr<EditableModelBase> EditableModelBasePtr;
+
+/**
+   Edit batch of a model. The update notifications of the items of the model are
+   deferred while the batch is open and each item is notified once when the
+   outermost batch is closed. A model item owns the batch of its items and an
+   item outside a model uses the batch of the topmost item of its subtree.
+*/
+class CNOID_EXPORT EditBatchState
+{
+public:
+    EditBatchState() : depth(0) { }
+    void begin();
+    void end();
+    bool isOpen() const { return depth > 0; }
+
+private:
+    int depth;
+    std::vector<EditableModelBasePtr> pendingUpdates;
+
+    EditBatchState(const EditBatchState&);
+    EditBatchState& operator=(const EditBatchState&);
+
+    friend class EditableModelBase;
+};
+
 class CNOID_EXPORT EditableModelBase : public Item
 {
 public:
     EditableModelBase();
+    EditableModelBase(const EditableModelBase& org);
     VRMLNodePtr originalNode;
     Vector3 translation;
     Matrix3 rotation;
-    virtual VRMLNodePtr toVRML() {};
-    virtual std::string toURDF() {};
+
+    /**
+       Creates the model node with the data specific to the item class.
+       The name, the pose and the original node are set by createModelSubtree().
+    */
+    virtual ModelNodePtr createModelNode() const;
+
+    /// Creates the model nodes of this item and its descendant items
+    ModelNodePtr createModelSubtree() const;
+
+    VRMLNodePtr toVRML() const;
+    std::string toURDF(std::ostream& os) const;
+
+    virtual void applyMirror(const Matrix3& S, const Vector3& offset);
+
+    /// Sets the size of the dragger of the model when it is put on this item alone
+    virtual void adjustDraggerSize(PositionDragger* dragger);
     bool onTranslationChanged(const std::string& value);
     bool onRotationChanged(const std::string& value);
     bool onRotationAxisChanged(const std::string& value);
     bool onRotationRPYChanged(const std::string& value);
     void doPutProperties(PutPropertyFunction& putProperty);
+
+    /**
+       Calls notifyUpdate() now or, while the edit batch of the model is open,
+       once when the outermost batch is closed.
+    */
+    void requestUpdate();
+
+    /// Batch of the model item which contains this item
+    EditBatchState& editBatchState();
+    bool isInEditBatch() { return editBatchState().isOpen(); }
+
+    /**
+       Keeps the edit batches of the models of the added items open while the
+       object is alive, so that they are also closed when the scope is left by
+       an early return or an exception. The items of several models may be added.
+    */
+    class CNOID_EXPORT EditBatch
+    {
+    public:
+        EditBatch() { }
+        explicit EditBatch(EditableModelBase* item) { add(item); }
+        ~EditBatch();
+        void add(EditableModelBase* item);
+    private:
+        // the owners keep the states alive until the batches are closed
+        std::vector<ItemPtr> owners;
+        std::vector<EditBatchState*> states;
+        EditBatch(const EditBatch&);
+        EditBatch& operator=(const EditBatch&);
+    };
+
+    /**
+       Creates the item of the node and the items of its descendants under the
+       parent item. When isLazy is true, a joint under another joint item keeps
+       its node as a compact descriptor of the subtree and its child items are
+       created on demand by materializeChildren(). The items are put at the
+       poses of the nodes moved by the motion.
+    */
+    static EditableModelBase* createItemTree(
+        ModelNode* node, Item* parentItem, bool isLazy, const Affine3& motion = Affine3::Identity());
+
+    /// True while the child items are kept as the model node
+    bool hasPendingChildren() const { return pendingChildren.get() != 0; }
+    /// Model node whose children have not been created as the items yet
+    const ModelNode* pendingModelNode() const { return pendingChildren.get(); }
+
+    /**
+       Rigid motion of the deferred subtree since it was loaded. The nodes are
+       kept as loaded and the motion is applied when they are shown, exported or
+       created as the items, so a dragged joint moves its deferred descendants
+       in the same way as its child items.
+    */
+    Affine3 pendingMotion() const;
+    void setPendingMotion(const Affine3& T);
+
+    /**
+       Creates the child items kept as the model node. The deferred items are a
+       part of the model logically, so these are const as the accessors of a cache.
+    */
+    void materializeChildren() const;
+    void materializeSubtree() const;
+    /// Creates all the deferred items in the subtree of any item
+    static void materializeItems(Item* item);
+
+protected:
+    /// Reads the name, the pose and the original node of the item from the node
+    void readModelNode(const ModelNode* node);
+
+private:
+    bool isUpdatePending;
+    mutable ModelNodePtr pendingChildren;
+    Vector3 pendingTranslation;
+    Matrix3 pendingRotation;
+    // used when this is the topmost item outside a model
+    EditBatchState ownEditBatch;
+
+    Item* editBatchOwner(EditBatchState*& out_state);
+
+    friend class EditBatchState;
 };
 
 }
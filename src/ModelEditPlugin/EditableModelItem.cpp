@@ -7,17 +7,27 @@
 #include "JointItem.h"
 #include "LinkItem.h"
 #include "SensorItem.h"
+#include "PrimitiveShapeItem.h"
+#include "PrimitiveFitter.h"
+#include "MeshTransform.h"
+#include "GeometryTransform.h"
+#include "BodyWriter.h"
+#include "MJCFWriter.h"
+#include "ModelFileStream.h"
 #include <cnoid/YAMLReader>
 #include <cnoid/EigenArchive>
 #include <cnoid/Archive>
 #include <cnoid/RootItem>
 #include <cnoid/LazySignal>
 #include <cnoid/LazyCaller>
+#include <cnoid/ConnectionSet>
 #include <cnoid/MessageView>
 #include <cnoid/ItemManager>
 #include <cnoid/ItemTreeView>
+#include <cnoid/SceneView>
 #include <cnoid/OptionManager>
 #include <cnoid/MenuManager>
+#include <cnoid/Action>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/JointPath>
 #include <cnoid/BodyLoader>
@@ -25,31 +35,37 @@
 #include <cnoid/BodyState>
 #include <cnoid/SceneBody>
 #include "ModelEditDragger.h"
+#include "Trace.h"
+#include "WorkerPool.h"
 #include <cnoid/VRML>
 #include <cnoid/VRMLBody>
-#include <cnoid/VRMLBodyWriter>
 #include <cnoid/FileUtil>
-#include <sdf/sdf.hh>
-#include <sdf/parser_urdf.hh>
+#include <boost/format.hpp>
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/filesystem.hpp>
 #include <bitset>
 #include <deque>
+#include <set>
 #include <iostream>
-#include <fstream>
 #include <algorithm>
 #include "gettext.h"
 
 using namespace std;
 using namespace cnoid;
+using boost::format;
 namespace filesystem = boost::filesystem;
+namespace po = boost::program_options;
 
 namespace {
 
 const bool TRACE_FUNCTIONS = false;
 
-BodyLoader bodyLoader;
+bool compactMemoryMode = false;
+bool lazyItemMode = false;
+
+// parameters of the "Generate Collision Hulls" menu
+ConvexDecompositionParams collisionParams;
 
 inline double radian(double deg) { return (3.14159265358979 * deg / 180.0); }
 
@@ -62,9 +78,20 @@ bool loadEditableModelItem(EditableModelItem* item, const std::string& filename)
 }
 
 
+bool checkCompression(const std::string& filename)
+{
+    if(modelFileCompression(filename) == ZSTD_COMPRESSION && !isZstdSupported()){
+        MessageView::instance()->putln(
+            format(_("%1% cannot be written because the plugin is built without libzstd.")) % filename);
+        return false;
+    }
+    return true;
+}
+
+
 bool saveEditableModelItem(EditableModelItem* item, const std::string& filename)
 {
-    if(item->saveModelFile(filename)){
+    if(checkCompression(filename) && item->saveModelFile(filename)){
         return true;
     }
     return false;
@@ -72,7 +99,7 @@ bool saveEditableModelItem(EditableModelItem* item, const std::string& filename)
     
 bool saveEditableModelItemURDF(EditableModelItem* item, const std::string& filename)
 {
-    if(item->saveModelFileURDF(filename)){
+    if(checkCompression(filename) && item->saveModelFileURDF(filename)){
         return true;
     }
     return false;
@@ -80,12 +107,499 @@ bool saveEditableModelItemURDF(EditableModelItem* item, const std::string& filen
 
 bool saveEditableModelItemSDF(EditableModelItem* item, const std::string& filename)
 {
-    if(item->saveModelFileSDF(filename)){
+    if(checkCompression(filename) && item->saveModelFileSDF(filename)){
+        return true;
+    }
+    return false;
+}
+
+bool saveEditableModelItemBody(EditableModelItem* item, const std::string& filename)
+{
+    if(item->saveModelFileBody(filename)){
+        return true;
+    }
+    return false;
+}
+
+
+bool saveEditableModelItemMJCF(EditableModelItem* item, const std::string& filename)
+{
+    if(item->saveModelFileMJCF(filename)){
         return true;
     }
     return false;
 }
 
+
+void onOptionsParsed(po::variables_map& v)
+{
+    if(v.count("modeledit-compact-memory")){
+        EditableModelItem::setCompactMemoryMode(true);
+    }
+    if(v.count("modeledit-lazy-items")){
+        EditableModelItem::setLazyItemMode(true);
+    }
+    if(v.count("modeledit-collision-hulls")){
+        collisionParams.maxHulls = std::max(v["modeledit-collision-hulls"].as<int>(), 1);
+    }
+    if(v.count("modeledit-collision-hull-vertices")){
+        collisionParams.maxVerticesPerHull = std::max(v["modeledit-collision-hull-vertices"].as<int>(), 4);
+    }
+    if(v.count("modeledit-compression-level")){
+        setModelFileCompressionLevel(v["modeledit-compression-level"].as<int>());
+    }
+    if(v.count("modeledit-urdf-mesh-format")){
+        const string meshFormat = v["modeledit-urdf-mesh-format"].as<string>();
+        if(meshFormat == "glb"){
+            LinkNode::setVisualMeshFormat(LinkNode::GLB);
+        } else if(meshFormat == "glb-quantized"){
+            LinkNode::setVisualMeshFormat(LinkNode::QUANTIZED_GLB);
+        } else if(meshFormat == "dae"){
+            LinkNode::setVisualMeshFormat(LinkNode::COLLADA);
+        } else {
+            MessageView::instance()->putln(format(_("Unknown URDF mesh format %1%")) % meshFormat);
+        }
+    }
+}
+
+
+void materializeSelectedItems()
+{
+    ItemList<EditableModelBase> selected = ItemTreeView::mainInstance()->selectedItems<EditableModelBase>();
+    for(size_t i=0; i < selected.size(); ++i){
+        selected.get(i)->materializeChildren();
+    }
+}
+
+
+/// The deferred items are not created while the item tree view is emitting the signal
+void onItemSelectionChanged()
+{
+    if(lazyItemMode){
+        callLater(materializeSelectedItems);
+    }
+}
+
+
+int countModelItems(Item* item)
+{
+    int n = 0;
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        n += (dynamic_cast<EditableModelBase*>(child) ? 1 : 0) + countModelItems(child);
+    }
+    return n;
+}
+
+
+/// The selected model items whose ancestors are not selected
+ItemList<Item> selectedModelSubtrees()
+{
+    ItemList<Item> selected = ItemTreeView::mainInstance()->selectedItems();
+    ItemList<Item> roots;
+    for(size_t i=0; i < selected.size(); ++i){
+        Item* item = selected.get(i);
+        if(!dynamic_cast<EditableModelItem*>(item) && !dynamic_cast<EditableModelBase*>(item)){
+            continue;
+        }
+        bool isAncestorSelected = false;
+        for(Item* p = item->parentItem(); p && !isAncestorSelected; p = p->parentItem()){
+            for(size_t j=0; j < selected.size(); ++j){
+                if(selected.get(j) == p){
+                    isAncestorSelected = true;
+                    break;
+                }
+            }
+        }
+        if(!isAncestorSelected){
+            roots.push_back(item);
+        }
+    }
+    return roots;
+}
+
+
+void onConvertMillimetersTriggered()
+{
+    ItemList<Item> roots = selectedModelSubtrees();
+    for(size_t i=0; i < roots.size(); ++i){
+        if(scaleModelGeometry(roots.get(i), Vector3::Constant(0.001))){
+            MessageView::instance()->putln(
+                format(_("%1% has been converted from millimeters to meters.")) % roots.get(i)->name());
+        }
+    }
+}
+
+
+void onBakeTransformsTriggered()
+{
+    ItemList<Item> roots = selectedModelSubtrees();
+    for(size_t i=0; i < roots.size(); ++i){
+        int n = bakeModelTransforms(roots.get(i));
+        MessageView::instance()->putln(
+            format(_("The transforms of %1% links of %2% have been baked.")) % n % roots.get(i)->name());
+    }
+}
+
+
+void putCollisionHullsGenerated(EditableModelItemPtr model, int numGenerated)
+{
+    MessageView::instance()->putln(
+        format(_("Collision hulls of %1% links of %2% have been generated.")) % numGenerated % model->name());
+}
+
+
+void onGenerateCollisionHullsTriggered()
+{
+    ItemList<EditableModelItem> models = ItemTreeView::mainInstance()->selectedItems<EditableModelItem>();
+    for(size_t i=0; i < models.size(); ++i){
+        EditableModelItemPtr model = models.get(i);
+        model->generateCollisionShapes(collisionParams, boost::bind(putCollisionHullsGenerated, model, _1));
+    }
+}
+
+
+void putPrimitiveShapesProposed(EditableModelItemPtr model, int numProposed)
+{
+    MessageView::instance()->putln(
+        format(_("Primitive shapes of %1% links of %2% have been proposed.")) % numProposed % model->name());
+}
+
+
+void onFitPrimitiveShapesTriggered()
+{
+    ItemList<EditableModelItem> models = ItemTreeView::mainInstance()->selectedItems<EditableModelItem>();
+    for(size_t i=0; i < models.size(); ++i){
+        EditableModelItemPtr model = models.get(i);
+        model->fitPrimitiveShapes(boost::bind(putPrimitiveShapesProposed, model, _1));
+    }
+}
+
+
+void onAcceptPrimitiveProposalsTriggered()
+{
+    ItemList<EditableModelItem> models = ItemTreeView::mainInstance()->selectedItems<EditableModelItem>();
+    for(size_t i=0; i < models.size(); ++i){
+        int n = models.get(i)->acceptPrimitiveProposals();
+        MessageView::instance()->putln(
+            format(_("%1% primitive shapes of %2% have been accepted as the collision shapes.")) % n % models.get(i)->name());
+    }
+}
+
+
+void onMergeFixedJointsTriggered()
+{
+    ItemList<EditableModelItem> models = ItemTreeView::mainInstance()->selectedItems<EditableModelItem>();
+    for(size_t i=0; i < models.size(); ++i){
+        ModelReductionReport report;
+        int n = models.get(i)->mergeFixedJoints(&report);
+        MessageView::instance()->putln(
+            format(_("%1% fixed joints of %2% have been merged: links %3% -> %4%, triangles %5% -> %6%"))
+            % n % models.get(i)->name() % report.numLinksBefore % report.numLinksAfter
+            % report.numTrianglesBefore % report.numTrianglesAfter);
+    }
+}
+
+
+struct PrimitiveFitJob
+{
+    vector<LinkItemPtr> links;
+    vector<SgNodePtr> shapes;
+    vector< vector<PrimitiveFit> > fits;
+    string errorMessage;
+    boost::function<void(int numProposed)> onFinished;
+};
+typedef boost::shared_ptr<PrimitiveFitJob> PrimitiveFitJobPtr;
+
+
+void fitShape(PrimitiveFitJob* job, int index)
+{
+    fitPrimitives(job->shapes[index].get(), job->fits[index]);
+}
+
+
+void runPrimitiveFitJob(PrimitiveFitJobPtr job, ModelEditWorkerTask* task)
+{
+    try {
+        ModelEditWorkerPool::instance()->parallelFor(
+            job->links.size(), boost::bind(fitShape, job.get(), _1));
+    } catch(const std::exception& ex){
+        job->errorMessage = ex.what();
+    }
+}
+
+
+void removePrimitiveProposals(Item* link)
+{
+    Item* child = link->childItem();
+    while(child){
+        Item* next = child->nextItem();
+        if(dynamic_cast<PrimitiveShapeItem*>(child) && child->name() == "collision proposal"){
+            child->detachFromParentItem();
+        }
+        child = next;
+    }
+}
+
+
+/**
+   Every candidate becomes a proposal and only the best one is checked.
+   The candidates are sorted by the error.
+*/
+void onPrimitiveFitJobCompleted(PrimitiveFitJobPtr job, bool canceled)
+{
+    MODELEDIT_TRACE_SPAN("EditableModelItem::onPrimitiveFitJobCompleted");
+    MessageView* mv = MessageView::instance();
+    int numProposed = 0;
+    if(!job->errorMessage.empty()){
+        mv->putln(format(_("Primitive fitting failed: %1%")) % job->errorMessage);
+    } else if(!canceled){
+        // degenerated extents of flat meshes are not accepted by the item
+        const double minSize = 1.0e-4;
+        for(size_t i=0; i < job->links.size(); ++i){
+            const vector<PrimitiveFit>& fits = job->fits[i];
+            if(fits.empty()){
+                continue;
+            }
+            LinkItem* link = job->links[i];
+            removePrimitiveProposals(link);
+            for(size_t j=0; j < fits.size(); ++j){
+                const PrimitiveFit& fit = fits[j];
+                mv->putln(format(_("%1%: %2% error %3$.4f volume %4$.6f"))
+                          % link->name() % fit.typeName() % fit.error % fit.volume);
+                PrimitiveShapeItemPtr proposal = new PrimitiveShapeItem;
+                proposal->setName("collision proposal");
+                proposal->translation = link->translation + link->rotation * fit.translation;
+                proposal->rotation = link->rotation * fit.rotation;
+                proposal->setPrimitiveType(fit.typeName());
+                proposal->setBoxSize(fit.boxSize.cwiseMax(Vector3::Constant(minSize)));
+                proposal->setPrimitiveRadius(std::max(fit.radius, minSize));
+                proposal->setPrimitiveHeight(std::max(fit.height, minSize));
+                proposal->setPrimitiveColor(Vector3f(0.2f, 0.8f, 0.2f));
+                proposal->setFitError(fit.error);
+                link->addChildItem(proposal);
+                ItemTreeView::instance()->checkItem(proposal, j == 0);
+            }
+            ++numProposed;
+        }
+    }
+    if(job->onFinished){
+        job->onFinished(numProposed);
+    }
+}
+
+
+/**
+   The links and their visual shapes are referred by the job until the completion,
+   where the job is released in the GUI thread. The shapes are only read by the workers.
+*/
+struct CollisionHullJob
+{
+    vector<LinkItemPtr> links;
+    vector<SgNodePtr> shapes;
+    ConvexDecompositionParams params;
+    vector< vector<SgMeshPtr> > hulls;
+    string errorMessage;
+    boost::function<void(int numGenerated)> onFinished;
+};
+typedef boost::shared_ptr<CollisionHullJob> CollisionHullJobPtr;
+
+
+void decomposeShape(CollisionHullJob* job, int index)
+{
+    decomposeConvex(job->shapes[index].get(), job->params, job->hulls[index]);
+}
+
+
+void runCollisionHullJob(CollisionHullJobPtr job, ModelEditWorkerTask* task)
+{
+    try {
+        ModelEditWorkerPool::instance()->parallelFor(
+            job->links.size(), boost::bind(decomposeShape, job.get(), _1));
+    } catch(const std::exception& ex){
+        job->errorMessage = ex.what();
+    }
+}
+
+
+void onCollisionHullJobCompleted(CollisionHullJobPtr job, bool canceled)
+{
+    MODELEDIT_TRACE_SPAN("EditableModelItem::onCollisionHullJobCompleted");
+    int numGenerated = 0;
+    if(!job->errorMessage.empty()){
+        MessageView::instance()->putln(format(_("Convex decomposition failed: %1%")) % job->errorMessage);
+    } else if(!canceled){
+        SgMaterialPtr material = new SgMaterial;
+        material->setDiffuseColor(Vector3f(0.2f, 0.8f, 0.2f));
+        material->setTransparency(0.5f);
+        for(size_t i=0; i < job->links.size(); ++i){
+            if(job->hulls[i].empty()){
+                continue;
+            }
+            SgGroup* group = new SgGroup;
+            for(size_t j=0; j < job->hulls[i].size(); ++j){
+                SgShape* shape = new SgShape;
+                shape->setMesh(job->hulls[i][j]);
+                shape->setMaterial(material);
+                group->addChild(shape);
+            }
+            job->links[i]->setCollisionShape(group);
+            ++numGenerated;
+        }
+    }
+    if(job->onFinished){
+        job->onFinished(numGenerated);
+    }
+}
+
+
+int countTriangles(SgNode* node)
+{
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        return shape->mesh() ? shape->mesh()->numTriangles() : 0;
+    }
+    int n = 0;
+    if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            n += countTriangles(group->child(i));
+        }
+    }
+    return n;
+}
+
+
+/// The links and the triangles of their visual shapes, where the shared meshes are counted for each use
+void countLinks(EditableModelItem* model, int& out_numLinks, int& out_numTriangles)
+{
+    ItemList<LinkItem> links = model->findItems<LinkItem>();
+    out_numLinks = 0;
+    out_numTriangles = 0;
+    for(size_t i=0; i < links.size(); ++i){
+        if(!links.get(i)->isCollisionItem()){
+            ++out_numLinks;
+            out_numTriangles += countTriangles(links.get(i)->link()->visualShape());
+        }
+    }
+}
+
+
+LinkItem* findLinkItem(JointItem* joint)
+{
+    for(Item* child = joint->childItem(); child; child = child->nextItem()){
+        if(LinkItem* link = dynamic_cast<LinkItem*>(child)){
+            return link;
+        }
+    }
+    return 0;
+}
+
+
+Affine3 itemPosition(const EditableModelBase* item)
+{
+    Affine3 T;
+    T.translation() = item->translation;
+    T.linear() = item->rotation;
+    return T;
+}
+
+
+void collectDescendants(Item* parent, vector<EditableModelBasePtr>& items, set<EditableModelBase*>& collected)
+{
+    for(Item* child = parent->childItem(); child; child = child->nextItem()){
+        if(EditableModelBase* item = dynamic_cast<EditableModelBase*>(child)){
+            if(collected.insert(item).second){
+                items.push_back(item);
+            }
+            collectDescendants(child, items, collected);
+        }
+    }
+}
+
+
+/// Inertia about the new center of mass by the parallel axis theorem
+Matrix3 shiftInertia(const Matrix3& I, double mass, const Vector3& d)
+{
+    return I + mass * (d.squaredNorm() * Matrix3::Identity() - d * d.transpose());
+}
+
+
+double kiB(size_t bytes)
+{
+    return bytes / 1024.0;
+}
+
+
+void putMemoryUsage(MessageView* mv, const char* label, const ModelMemoryUsage& usage)
+{
+    mv->putln(format(_("%1%: %2$.1f KiB (VRML nodes: %3% / %4$.1f KiB, meshes: %5% / %6$.1f KiB)"))
+              % label % kiB(usage.totalBytes())
+              % usage.numVRMLNodes % kiB(usage.vrmlBytes)
+              % usage.numMeshes % kiB(usage.meshBytes));
+}
+
+
+/// Model item which contains the item, or null when the item is outside any model
+EditableModelItem* findModelItem(Item* item)
+{
+    for(Item* p = item->parentItem(); p; p = p->parentItem()){
+        if(EditableModelItem* model = dynamic_cast<EditableModelItem*>(p)){
+            return model;
+        }
+    }
+    return 0;
+}
+
+
+/**
+   The position dragger shared by the selected items of a model, which is put at
+   the pivot in the scene of the scene view. The handler without the model item
+   drags the items which are not in any model, such as the ones created by the
+   creation panels. A single selection connection is made for each handler.
+*/
+class ModelDragHandler
+{
+public:
+    ModelDragHandler(EditableModelItem* model);
+    ~ModelDragHandler();
+
+    bool beginDrag();
+    void dragTo(const Affine3& pivot);
+    void endDrag();
+    Affine3 dragPivot() const;
+
+private:
+    EditableModelItem* model;
+    // the scene of the scene view while the dragger is shown
+    SgGroupPtr scene;
+    SgPosTransformPtr draggerFrame;
+    ModelEditDraggerPtr positionDragger;
+    vector<EditableModelBasePtr> dragTargets;
+    // the targets and the descendants of the joint targets moved by the drag
+    vector<EditableModelBasePtr> draggedItems;
+    // the fixed size vectorizable Affine3 is not kept in the containers
+    vector<Vector3> dragStartTranslations;
+    vector<Matrix3> dragStartRotations;
+    // motions of the deferred subtrees of the dragged joints
+    vector<Vector3> dragStartPendingTranslations;
+    vector<Matrix3> dragStartPendingRotations;
+    Vector3 dragStartPivotTranslation;
+    Matrix3 dragStartPivotRotation;
+    bool isDragging;
+    ConnectionSet targetConnections;
+    Connection conSelectUpdate;
+
+    void ensureDragger();
+    void onSelectionChanged();
+    void hideDragger();
+    void adjustDraggerSize();
+    void updateDraggerPosition();
+    void onDraggerStarted();
+    void onDraggerDragged();
+    void onDraggerFinished();
+};
+
+// the handler of the items outside the models, which is never deleted
+ModelDragHandler* standaloneDragHandler = 0;
+
 }
 
 
@@ -95,6 +609,13 @@ class EditableModelItemImpl
 {
 public:
     EditableModelItem* self;
+    // the meshes of the loaded model in the shared asset cache
+    ModelAssetLeasePtr assets;
+    // the batch of the update notifications of the items of this model
+    EditBatchState editBatchState;
+
+    // the dragger shared by the selected items of the model
+    ModelDragHandler dragHandler;
 
     EditableModelItemImpl(EditableModelItem* self);
     EditableModelItemImpl(EditableModelItem* self, const EditableModelItemImpl& org);
@@ -104,10 +625,16 @@ public:
     bool saveModelFile(const std::string& filename);
     bool saveModelFileURDF(const std::string& filename);
     bool saveModelFileSDF(const std::string& filename);
-    VRMLNodePtr toVRML();
-    string toURDF();
-    void setLinkTree(Link* link, VRMLBodyLoader* vloader);
-    void setLinkTreeSub(Link* link, VRMLBodyLoader* vloader, Item* parentItem);
+    bool saveModelFileBody(const std::string& filename);
+    bool saveModelFileMJCF(const std::string& filename);
+    bool contains(Item* item) const;
+    bool moveItem(Item* item, Item* newParent);
+    ModelEditWorkerTaskPtr generateCollisionShapes(
+        const ConvexDecompositionParams& params, const boost::function<void(int numGenerated)>& onFinished);
+    ModelEditWorkerTaskPtr fitPrimitiveShapes(const boost::function<void(int numProposed)>& onFinished);
+    int acceptPrimitiveProposals();
+    int mergeFixedJoints(ModelReductionReport* out_report);
+    void mergeLink(LinkItem* parentLink, LinkItem* link);
     void doAssign(Item* srcItem);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool store(Archive& archive);
@@ -123,15 +650,60 @@ void EditableModelItem::initializeClass(ExtensionManager* ext)
 
     if(!initialized){
         ext->itemManager().registerClass<EditableModelItem>(N_("EditableBodyItem"));
+        standaloneDragHandler = new ModelDragHandler(0);
         ext->itemManager().addCreationPanel<EditableModelItem>();
         ext->itemManager().addLoader<EditableModelItem>(
-            _("OpenHRP Model File for Editing"), "OpenHRP-VRML-MODEL", "wrl;dae;stl", boost::bind(loadEditableModelItem, _1, _2));
+            _("OpenHRP Model File for Editing"), "OpenHRP-VRML-MODEL", "wrl;wrz;gz;zst;dae;stl", boost::bind(loadEditableModelItem, _1, _2));
+        ext->itemManager().addLoader<EditableModelItem>(
+            _("URDF Model File for Editing"), "URDF-MODEL", "urdf", boost::bind(loadEditableModelItem, _1, _2));
+        ext->itemManager().addLoader<EditableModelItem>(
+            _("SDF Model File for Editing"), "SDF-MODEL", "sdf", boost::bind(loadEditableModelItem, _1, _2));
         ext->itemManager().addSaver<EditableModelItem>(
             _("OpenHRP Model File"), "OpenHRP-VRML-MODEL", "wrl", boost::bind(saveEditableModelItem, _1, _2));
+        ext->itemManager().addSaver<EditableModelItem>(
+            _("Compressed OpenHRP Model File"), "OpenHRP-VRML-MODEL-GZIP", "wrz;gz", boost::bind(saveEditableModelItem, _1, _2));
+        if(isZstdSupported()){
+            ext->itemManager().addSaver<EditableModelItem>(
+                _("Zstandard OpenHRP Model File"), "OpenHRP-VRML-MODEL-ZSTD", "zst", boost::bind(saveEditableModelItem, _1, _2));
+        }
         ext->itemManager().addSaver<EditableModelItem>(
             _("URDF Model File"), "URDF-MODEL", "urdf", boost::bind(saveEditableModelItemURDF, _1, _2));
         ext->itemManager().addSaver<EditableModelItem>(
             _("SDF Model File"), "SDF-MODEL", "sdf", boost::bind(saveEditableModelItemSDF, _1, _2));
+        ext->itemManager().addSaver<EditableModelItem>(
+            _("Choreonoid Body File"), "CHOREONOID-BODY", "body", boost::bind(saveEditableModelItemBody, _1, _2));
+        ext->itemManager().addSaver<EditableModelItem>(
+            _("MuJoCo MJCF File"), "MJCF-MODEL", "xml", boost::bind(saveEditableModelItemMJCF, _1, _2));
+
+        OptionManager& om = ext->optionManager();
+        om.addOption("modeledit-compact-memory", "release the parsed VRML nodes of the edited models after loading");
+        om.addOption("modeledit-lazy-items", "create the items of the joint subtrees of the loaded models on demand");
+        om.addOption("modeledit-collision-hulls", po::value<int>(),
+                     "maximum number of the convex hulls generated for a link");
+        om.addOption("modeledit-collision-hull-vertices", po::value<int>(),
+                     "maximum number of the vertices of a generated convex hull");
+        om.addOption("modeledit-urdf-mesh-format", po::value<string>(),
+                     "format of the visual meshes of the URDF export: dae, glb or glb-quantized");
+        om.addOption("modeledit-compression-level", po::value<int>(),
+                     "compression level of the model files saved with the .gz, .wrz or .zst extension");
+        om.sigOptionsParsed().connect(onOptionsParsed);
+
+        ItemTreeView::mainInstance()->sigSelectionChanged().connect(onItemSelectionChanged);
+
+        MenuManager& mm = ext->menuManager();
+        mm.setPath("/Tools").setPath(N_("Model Edit"));
+        mm.addItem(_("Generate Collision Hulls"))
+            ->sigTriggered().connect(onGenerateCollisionHullsTriggered);
+        mm.addItem(_("Fit Primitive Shapes"))
+            ->sigTriggered().connect(onFitPrimitiveShapesTriggered);
+        mm.addItem(_("Accept Primitive Proposals"))
+            ->sigTriggered().connect(onAcceptPrimitiveProposalsTriggered);
+        mm.addItem(_("Merge Fixed Joints"))
+            ->sigTriggered().connect(onMergeFixedJointsTriggered);
+        mm.addItem(_("Convert Millimeters to Meters"))
+            ->sigTriggered().connect(onConvertMillimetersTriggered);
+        mm.addItem(_("Bake Transforms"))
+            ->sigTriggered().connect(onBakeTransformsTriggered);
         initialized = true;
     }
 }
@@ -144,8 +716,10 @@ EditableModelItem::EditableModelItem()
 
 
 EditableModelItemImpl::EditableModelItemImpl(EditableModelItem* self)
-    : self(self)
+    : self(self),
+      dragHandler(self)
 {
+
 }
 
 
@@ -157,8 +731,11 @@ EditableModelItem::EditableModelItem(const EditableModelItem& org)
 
 
 EditableModelItemImpl::EditableModelItemImpl(EditableModelItem* self, const EditableModelItemImpl& org)
-    : self(self)
+    : self(self),
+      assets(org.assets),
+      dragHandler(self)
 {
+
 }
 
 
@@ -170,43 +747,274 @@ EditableModelItem::~EditableModelItem()
 
 EditableModelItemImpl::~EditableModelItemImpl()
 {
+
 }
 
 
-void EditableModelItemImpl::setLinkTree(Link* link, VRMLBodyLoader* vloader)
+ModelDragHandler::ModelDragHandler(EditableModelItem* model)
+    : model(model),
+      isDragging(false)
 {
-    setLinkTreeSub(link, vloader, self);
-    self->notifyUpdate();
+    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(
+        boost::bind(&ModelDragHandler::onSelectionChanged, this));
+}
+
+
+ModelDragHandler::~ModelDragHandler()
+{
+    targetConnections.disconnect();
+    conSelectUpdate.disconnect();
+    hideDragger();
 }
 
 
-void EditableModelItemImpl::setLinkTreeSub(Link* link, VRMLBodyLoader* vloader, Item* parentItem)
+/// The dragger is created when the items are selected first
+void ModelDragHandler::ensureDragger()
 {
-    // first, create joint item
-    JointItemPtr item = new JointItem(link);
-    item->originalNode = vloader->getOriginalNode(link);
-    parentItem->addChildItem(item);
-    ItemTreeView::instance()->checkItem(item, true);
-    // next, create link item under the joint item
-    LinkItemPtr litem = new LinkItem(link);
-    litem->originalNode = vloader->getOriginalNode(link);
-    item->addChildItem(litem);
-    SgNode* collisionShape = link->collisionShape();
-    if (collisionShape != link->visualShape()) {
-        LinkItemPtr citem = new LinkItem(link);
-        citem->originalNode = vloader->getOriginalNode(link);
-        citem->setName("collision");
-        litem->addChildItem(citem);
+    if(draggerFrame){
+        return;
     }
-    ItemTreeView::instance()->checkItem(litem, true);
+    MODELEDIT_TRACE_SPAN("EditableModelItem::ensureDragger");
+    draggerFrame = new SgPosTransform;
+    positionDragger = new ModelEditDragger;
+    positionDragger->sigDragStarted().connect(boost::bind(&ModelDragHandler::onDraggerStarted, this));
+    positionDragger->sigPositionDragged().connect(boost::bind(&ModelDragHandler::onDraggerDragged, this));
+    positionDragger->sigDragFinished().connect(boost::bind(&ModelDragHandler::onDraggerFinished, this));
+    positionDragger->setDraggerAlwaysShown(true);
+    draggerFrame->addChild(positionDragger);
+}
+
 
-    if(link->child()){
-        for(Link* child = link->child(); child; child = child->sibling()){
-            setLinkTreeSub(child, vloader, item);
+/**
+   The dragged items are the selected items of the model whose ancestors are not
+   selected, because the descendants of a joint are moved with it.
+*/
+void ModelDragHandler::onSelectionChanged()
+{
+    if(isDragging){
+        return;
+    }
+    MODELEDIT_TRACE_SPAN("EditableModelItem::onSelectionChanged");
+    targetConnections.disconnect();
+    dragTargets.clear();
+    ItemList<Item> roots = selectedModelSubtrees();
+    for(size_t i=0; i < roots.size(); ++i){
+        EditableModelBase* item = dynamic_cast<EditableModelBase*>(roots.get(i));
+        if(item && findModelItem(item) == model){
+            dragTargets.push_back(item);
+            targetConnections.add(
+                item->sigUpdated().connect(boost::bind(&ModelDragHandler::updateDraggerPosition, this)));
         }
     }
+    if(dragTargets.empty()){
+        hideDragger();
+        return;
+    }
+    ensureDragger();
+    adjustDraggerSize();
+    updateDraggerPosition();
+    // the dragger is drawn in the scene view regardless of the check of the model item
+    if(!scene){
+        scene = SceneView::instance()->scene();
+        scene->addChild(draggerFrame);
+        scene->notifyUpdate();
+    }
 }
 
+
+void ModelDragHandler::hideDragger()
+{
+    if(scene){
+        scene->removeChild(draggerFrame);
+        scene->notifyUpdate();
+        scene = 0;
+    }
+}
+
+
+/**
+   A single item keeps the dragger size of its class and a group of the items is
+   covered by the dragger sized by the bounding box of their scenes.
+*/
+void ModelDragHandler::adjustDraggerSize()
+{
+    if(dragTargets.size() == 1){
+        dragTargets.front()->adjustDraggerSize(positionDragger);
+        return;
+    }
+    BoundingBox bb;
+    for(size_t i=0; i < dragTargets.size(); ++i){
+        if(SceneProvider* provider = dynamic_cast<SceneProvider*>(dragTargets[i].get())){
+            bb.expandBy(provider->getScene()->boundingBox());
+        }
+    }
+    if(bb.empty()){
+        positionDragger->setRadius(0.1);
+    } else {
+        positionDragger->adjustSize(bb);
+    }
+}
+
+
+/**
+   The pivot is the pose of a single item or the centroid of the items in the
+   model axes. The dragger is moved by the drag itself while it is dragged.
+   The size of a single item such as the axis radius of a joint is followed,
+   and the size of a group is kept to the one at the selection.
+*/
+void ModelDragHandler::updateDraggerPosition()
+{
+    if(isDragging || dragTargets.empty() || !draggerFrame){
+        return;
+    }
+    if(dragTargets.size() == 1){
+        draggerFrame->setTranslation(dragTargets.front()->translation);
+        draggerFrame->setRotation(dragTargets.front()->rotation);
+        dragTargets.front()->adjustDraggerSize(positionDragger);
+    } else {
+        Vector3 c = Vector3::Zero();
+        for(size_t i=0; i < dragTargets.size(); ++i){
+            c += dragTargets[i]->translation;
+        }
+        draggerFrame->setTranslation(c / dragTargets.size());
+        draggerFrame->setRotation(Matrix3::Identity());
+    }
+    draggerFrame->notifyUpdate();
+}
+
+
+void ModelDragHandler::onDraggerStarted()
+{
+    beginDrag();
+}
+
+
+void ModelDragHandler::onDraggerDragged()
+{
+    dragTo(positionDragger->draggedPosition());
+}
+
+
+void ModelDragHandler::onDraggerFinished()
+{
+    endDrag();
+}
+
+
+bool ModelDragHandler::beginDrag()
+{
+    if(isDragging || dragTargets.empty() || !draggerFrame){
+        return false;
+    }
+    MODELEDIT_TRACE_SPAN("EditableModelItem::beginDrag");
+    isDragging = true;
+    dragStartPivotTranslation = draggerFrame->translation();
+    dragStartPivotRotation = draggerFrame->rotation();
+    draggedItems = dragTargets;
+    set<EditableModelBase*> collected;
+    for(size_t i=0; i < dragTargets.size(); ++i){
+        collected.insert(dragTargets[i].get());
+    }
+    for(size_t i=0; i < dragTargets.size(); ++i){
+        EditableModelBase* item = dragTargets[i];
+        // the descendants of a joint are moved with it, and the deferred ones by its pending motion
+        if(dynamic_cast<JointItem*>(item)){
+            collectDescendants(item, draggedItems, collected);
+        }
+    }
+    const size_t n = draggedItems.size();
+    dragStartTranslations.resize(n);
+    dragStartRotations.resize(n);
+    dragStartPendingTranslations.resize(n);
+    dragStartPendingRotations.resize(n);
+    for(size_t i=0; i < n; ++i){
+        EditableModelBase* item = draggedItems[i];
+        dragStartTranslations[i] = item->translation;
+        dragStartRotations[i] = item->rotation;
+        const Affine3 motion = item->pendingMotion();
+        dragStartPendingTranslations[i] = motion.translation();
+        dragStartPendingRotations[i] = motion.linear();
+    }
+    return true;
+}
+
+
+/**
+   The targets and the descendants of the joint targets are moved rigidly
+   about the pivot, so a dragged joint carries its subtree with the rotation.
+*/
+void ModelDragHandler::dragTo(const Affine3& pivot)
+{
+    if(!isDragging){
+        return;
+    }
+    MODELEDIT_TRACE_SPAN("EditableModelItem::dragTo");
+    const Matrix3 R = pivot.linear() * dragStartPivotRotation.transpose();
+    const Vector3 p = pivot.translation();
+    {
+        EditableModelBase::EditBatch batch;
+        for(size_t i=0; i < draggedItems.size(); ++i){
+            EditableModelBase* item = draggedItems[i];
+            batch.add(item);
+            item->translation = p + R * (dragStartTranslations[i] - dragStartPivotTranslation);
+            item->rotation = R * dragStartRotations[i];
+            if(item->hasPendingChildren()){
+                Affine3 motion;
+                motion.translation() = p + R * (dragStartPendingTranslations[i] - dragStartPivotTranslation);
+                motion.linear() = R * dragStartPendingRotations[i];
+                item->setPendingMotion(motion);
+            }
+            item->requestUpdate();
+        }
+    }
+    draggerFrame->setTranslation(pivot.translation());
+    draggerFrame->setRotation(pivot.linear());
+    draggerFrame->notifyUpdate();
+}
+
+
+void ModelDragHandler::endDrag()
+{
+    isDragging = false;
+    draggedItems.clear();
+    updateDraggerPosition();
+}
+
+
+Affine3 ModelDragHandler::dragPivot() const
+{
+    Affine3 T = Affine3::Identity();
+    if(draggerFrame){
+        T = draggerFrame->T();
+    }
+    return T;
+}
+
+
+bool EditableModelItem::beginDrag()
+{
+    return impl->dragHandler.beginDrag();
+}
+
+
+void EditableModelItem::dragTo(const Affine3& pivot)
+{
+    impl->dragHandler.dragTo(pivot);
+}
+
+
+void EditableModelItem::endDrag()
+{
+    impl->dragHandler.endDrag();
+}
+
+
+Affine3 EditableModelItem::dragPivot() const
+{
+    return impl->dragHandler.dragPivot();
+}
+
+
 bool EditableModelItem::loadModelFile(const std::string& filename)
 {
     return impl->loadModelFile(filename);
@@ -215,88 +1023,396 @@ bool EditableModelItem::loadModelFile(const std::string& filename)
 
 bool EditableModelItemImpl::loadModelFile(const std::string& filename)
 {
-    BodyPtr newBody;
+    MODELEDIT_TRACE_SPAN("EditableModelItem::loadModelFile");
 
     MessageView* mv = MessageView::instance();
     mv->beginStdioRedirect();
+    ModelRootNodePtr root = loadModelTree(filename, mv->cout(true));
+    mv->endStdioRedirect();
+
+    if (!root) {
+        return false;
+    }
+    assets = root->assets;
+    if (compactMemoryMode) {
+        ModelMemoryUsage loaded = measureModelMemory(root);
+        releaseOriginalNodes(root);
+        putMemoryUsage(mv, _("Model memory after loading"), loaded);
+        putMemoryUsage(mv, _("Model memory in the compact mode"), measureModelMemory(root));
+    }
+    for (int i = 0; i < root->numChildren(); i++) {
+        EditableModelBase::createItemTree(root->child(i), self, lazyItemMode);
+    }
+    MODELEDIT_TRACE_COUNTER("Model items", countModelItems(self));
+    self->notifyUpdate();
 
-    bodyLoader.setMessageSink(mv->cout(true));
-    newBody = bodyLoader.load(filename);
+    return true;
+}
 
-    mv->endStdioRedirect();
-    
-    if(newBody){
-        newBody->initializeState();
-        newBody->calcForwardKinematics();
-        Link* link = newBody->rootLink();
-        
-        AbstractBodyLoaderPtr loader = bodyLoader.lastActualBodyLoader();
-        VRMLBodyLoader* vloader = dynamic_cast<VRMLBodyLoader*>(loader.get());
-        if (vloader) {
-            // VRMLBodyLoader supports retriveOriginalNode function
-            setLinkTree(link, vloader);
+
+void EditableModelItem::beginTransaction()
+{
+    impl->editBatchState.begin();
+}
+
+
+void EditableModelItem::commitTransaction()
+{
+    impl->editBatchState.end();
+}
+
+
+EditBatchState& EditableModelItem::editBatchState()
+{
+    return impl->editBatchState;
+}
+
+
+bool EditableModelItem::matchNamePattern(const std::string& name, const std::string& pattern)
+{
+    // iterative wildcard matching with backtracking to the last '*'
+    size_t n = 0, p = 0;
+    size_t starPos = string::npos, starMatch = 0;
+    while(n < name.size()){
+        if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])){
+            ++n;
+            ++p;
+        } else if(p < pattern.size() && pattern[p] == '*'){
+            starPos = p++;
+            starMatch = n;
+        } else if(starPos != string::npos){
+            p = starPos + 1;
+            n = ++starMatch;
         } else {
-            // Other loaders dont, so we wrap with inline node
-            VRMLProtoInstance* proto = new VRMLProtoInstance(new VRMLProto(""));
-            MFNode* children = new MFNode();
-            VRMLInlinePtr inl = new VRMLInline();
-            inl->urls.push_back(filename);
-            children->push_back(inl);
-            proto->fields["children"] = *children;
-            // first, create joint item
-            JointItemPtr item = new JointItem(link);
-            item->originalNode = proto;
-            self->addChildItem(item);
-            ItemTreeView::instance()->checkItem(item, true);
-            // next, create link item under the joint item
-            LinkItemPtr litem = new LinkItem(link);
-            litem->originalNode = proto;
-            litem->setName("link");
-            item->addChildItem(litem);
-            ItemTreeView::instance()->checkItem(litem, true);
-        }
-        for (int i = 0; i < newBody->numDevices(); i++) {
-            Device* dev = newBody->device(i);
-            SensorItemPtr sitem = new SensorItem(dev);
-            Item* parent = self->findItem<Item>(dev->link()->name());
-            if (parent) {
-                parent->addChildItem(sitem);
-                ItemTreeView::instance()->checkItem(sitem, true);
+            return false;
+        }
+    }
+    while(p < pattern.size() && pattern[p] == '*'){
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+
+bool EditableModelItemImpl::contains(Item* item) const
+{
+    for(Item* p = item; p; p = p->parentItem()){
+        if(p == self){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool EditableModelItem::moveItem(Item* item, Item* newParent)
+{
+    return impl->moveItem(item, newParent);
+}
+
+
+bool EditableModelItemImpl::moveItem(Item* item, Item* newParent)
+{
+    if(item == self || !contains(item) || !contains(newParent)){
+        return false;
+    }
+    for(Item* p = newParent; p; p = p->parentItem()){
+        if(p == item){
+            return false;
+        }
+    }
+    if(item->parentItem() == newParent){
+        return true;
+    }
+    ItemPtr holder = item;
+    item->detachFromParentItem();
+    newParent->addChildItem(item);
+    if(EditableModelBase* model = dynamic_cast<EditableModelBase*>(item)){
+        model->requestUpdate();
+    }
+    return true;
+}
+
+
+bool EditableModelItem::removeItem(Item* item)
+{
+    if(item == this || !impl->contains(item)){
+        return false;
+    }
+    item->detachFromParentItem();
+    return true;
+}
+
+
+ModelEditWorkerTaskPtr EditableModelItem::generateCollisionShapes
+(const ConvexDecompositionParams& params, const boost::function<void(int numGenerated)>& onFinished)
+{
+    return impl->generateCollisionShapes(params, onFinished);
+}
+
+
+ModelEditWorkerTaskPtr EditableModelItemImpl::generateCollisionShapes
+(const ConvexDecompositionParams& params, const boost::function<void(int numGenerated)>& onFinished)
+{
+    MODELEDIT_TRACE_SPAN("EditableModelItem::generateCollisionShapes");
+
+    CollisionHullJobPtr job = boost::make_shared<CollisionHullJob>();
+    ItemList<LinkItem> items = self->findItems<LinkItem>();
+    for(size_t i=0; i < items.size(); ++i){
+        LinkItem* item = items.get(i);
+        if(!item->isCollisionItem() && item->link()->visualShape()){
+            job->links.push_back(item);
+            job->shapes.push_back(item->link()->visualShape());
+        }
+    }
+    job->params = params;
+    job->hulls.resize(job->links.size());
+    job->onFinished = onFinished;
+
+    return ModelEditWorkerPool::instance()->submit(
+        boost::bind(runCollisionHullJob, job, _1),
+        boost::bind(onCollisionHullJobCompleted, job, _1));
+}
+
+
+ModelEditWorkerTaskPtr EditableModelItem::fitPrimitiveShapes(const boost::function<void(int numProposed)>& onFinished)
+{
+    return impl->fitPrimitiveShapes(onFinished);
+}
+
+
+ModelEditWorkerTaskPtr EditableModelItemImpl::fitPrimitiveShapes(const boost::function<void(int numProposed)>& onFinished)
+{
+    MODELEDIT_TRACE_SPAN("EditableModelItem::fitPrimitiveShapes");
+
+    PrimitiveFitJobPtr job = boost::make_shared<PrimitiveFitJob>();
+    ItemList<LinkItem> items = self->findItems<LinkItem>();
+    for(size_t i=0; i < items.size(); ++i){
+        LinkItem* item = items.get(i);
+        if(!item->isCollisionItem() && item->link()->visualShape()){
+            job->links.push_back(item);
+            job->shapes.push_back(item->link()->visualShape());
+        }
+    }
+    job->fits.resize(job->links.size());
+    job->onFinished = onFinished;
+
+    return ModelEditWorkerPool::instance()->submit(
+        boost::bind(runPrimitiveFitJob, job, _1),
+        boost::bind(onPrimitiveFitJobCompleted, job, _1));
+}
+
+
+int EditableModelItem::acceptPrimitiveProposals()
+{
+    return impl->acceptPrimitiveProposals();
+}
+
+
+int EditableModelItemImpl::acceptPrimitiveProposals()
+{
+    ItemTreeView* itemTreeView = ItemTreeView::instance();
+    ItemList<PrimitiveShapeItem> proposals = self->findItems<PrimitiveShapeItem>("collision proposal");
+    vector<Item*> links;
+    for(size_t i=0; i < proposals.size(); ++i){
+        Item* link = proposals.get(i)->parentItem();
+        if(dynamic_cast<LinkItem*>(link) && itemTreeView->isItemChecked(proposals.get(i)) &&
+           std::find(links.begin(), links.end(), link) == links.end()){
+            links.push_back(link);
+        }
+    }
+    int numAccepted = 0;
+    for(size_t i=0; i < links.size(); ++i){
+        Item* child = links[i]->childItem();
+        while(child){
+            Item* next = child->nextItem();
+            if(dynamic_cast<PrimitiveShapeItem*>(child) && child->name() == "collision proposal"){
+                if(itemTreeView->isItemChecked(child)){
+                    child->setName("collision");
+                    ++numAccepted;
+                } else {
+                    child->detachFromParentItem();
+                }
+            } else if(child->name() == "collision" &&
+                      (dynamic_cast<LinkItem*>(child) || dynamic_cast<PrimitiveShapeItem*>(child))){
+                child->detachFromParentItem();
             }
+            child = next;
         }
     }
+    return numAccepted;
+}
 
-    return (newBody);
+
+int EditableModelItem::mergeFixedJoints(ModelReductionReport* out_report)
+{
+    return impl->mergeFixedJoints(out_report);
 }
 
 
-VRMLNodePtr EditableModelItemImpl::toVRML()
+int EditableModelItemImpl::mergeFixedJoints(ModelReductionReport* out_report)
 {
-    VRMLHumanoidPtr node;
-    node = new VRMLHumanoid();
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            VRMLNodePtr childnode = item->toVRML();
-            node->humanoidBody.push_back(childnode);
+    MODELEDIT_TRACE_SPAN("EditableModelItem::mergeFixedJoints");
+
+    ModelReductionReport report;
+    countLinks(self, report.numLinksBefore, report.numTrianglesBefore);
+
+    // in the pre-order a fixed chain is collapsed from its top, so each joint
+    // is merged into the current parent which may have taken over its parent
+    ItemList<JointItem> joints = self->findItems<JointItem>();
+    int numMerged = 0;
+    self->beginTransaction();
+    for(size_t i=0; i < joints.size(); ++i){
+        JointItemPtr joint = joints.get(i);
+        JointItem* parentJoint = dynamic_cast<JointItem*>(joint->parentItem());
+        if(!parentJoint || joint->jointType() != "fixed"){
+            continue;
+        }
+        LinkItem* parentLink = findLinkItem(parentJoint);
+        LinkItem* link = findLinkItem(joint);
+        if(link){
+            if(parentLink){
+                mergeLink(parentLink, link);
+            } else {
+                moveItem(link, parentJoint);
+            }
+        }
+        Item* child = joint->childItem();
+        while(child){
+            Item* next = child->nextItem();
+            if(child != link){
+                moveItem(child, parentJoint);
+            }
+            child = next;
         }
+        joint->detachFromParentItem();
+        ++numMerged;
     }
-    return node;
+    self->commitTransaction();
+
+    countLinks(self, report.numLinksAfter, report.numTrianglesAfter);
+    if(out_report){
+        *out_report = report;
+    }
+    return numMerged;
 }
 
 
-string EditableModelItemImpl::toURDF()
+/**
+   The shapes of the link are baked into the coordinate of the parent link.
+   The shapes of the parent link are shared without being modified.
+*/
+void EditableModelItemImpl::mergeLink(LinkItem* parentLink, LinkItem* link)
 {
-    ostringstream ss;
-    ss << "<robot name=\"" << self->name() << "\">" << endl;
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
+    const Affine3 T = itemPosition(parentLink).inverse() * itemPosition(link);
+    Link* pl = parentLink->link();
+    Link* l = link->link();
+
+    SgGroup* visual = new SgGroup;
+    if(pl->visualShape()){
+        visual->addChild(pl->visualShape());
+    }
+    if(l->visualShape()){
+        visual->addChild(bakeSceneTransforms(l->visualShape(), T));
+    }
+    SgNode* collision = visual;
+    if(pl->collisionShape() != pl->visualShape() || l->collisionShape() != l->visualShape()){
+        SgGroup* group = new SgGroup;
+        if(pl->collisionShape()){
+            group->addChild(pl->collisionShape());
+        }
+        if(l->collisionShape()){
+            group->addChild(bakeSceneTransforms(l->collisionShape(), T));
+        }
+        collision = group;
+    }
+    parentLink->setShapes(visual, collision);
+
+    const double m1 = parentLink->mass();
+    const double m2 = link->mass();
+    const Vector3 c1 = parentLink->centerOfMass();
+    const Vector3 c2 = T * link->centerOfMass();
+    const double m = m1 + m2;
+    const Vector3 c = (m > 0.0) ? Vector3((m1 * c1 + m2 * c2) / m) : c1;
+    const Matrix3 I2 = T.linear() * link->inertia() * T.linear().transpose();
+    const Matrix3 I = shiftInertia(parentLink->inertia(), m1, c1 - c) + shiftInertia(I2, m2, c2 - c);
+    parentLink->setMass(m);
+    parentLink->setCenterOfMass(c);
+    parentLink->setInertia(I);
+
+    // the collision item of the link is replaced by the merged collision shape
+    Item* child = link->childItem();
+    while(child){
+        Item* next = child->nextItem();
+        if(!(dynamic_cast<LinkItem*>(child) && child->name() == "collision")){
+            moveItem(child, parentLink);
+        }
+        child = next;
+    }
+    link->detachFromParentItem();
+}
+
+
+ModelRootNodePtr EditableModelItem::createModelTree() const
+{
+    MODELEDIT_TRACE_SPAN("EditableModelItem::createModelTree");
+    ModelRootNodePtr root = new ModelRootNode;
+    root->name = name();
+    for(Item* child = childItem(); child; child = child->nextItem()){
         EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
         if (item) {
-            ss << item->toURDF();
+            ModelNodePtr node = item->createModelSubtree();
+            if (node) {
+                root->addChild(node);
+            }
         }
     }
-    ss << "</robot>" << endl;
-    return ss.str();
+    return root;
+}
+
+
+void EditableModelItem::setCompactMemoryMode(bool on)
+{
+    compactMemoryMode = on;
+}
+
+
+bool EditableModelItem::isCompactMemoryMode()
+{
+    return compactMemoryMode;
+}
+
+
+void EditableModelItem::setLazyItemMode(bool on)
+{
+    lazyItemMode = on;
+}
+
+
+bool EditableModelItem::isLazyItemMode()
+{
+    return lazyItemMode;
+}
+
+
+void EditableModelItem::materializeItems()
+{
+    EditableModelBase::materializeItems(this);
+}
+
+
+void EditableModelItem::releaseOriginalNodes()
+{
+    ItemList<EditableModelBase> items = findItems<EditableModelBase>();
+    for(size_t i=0; i < items.size(); ++i){
+        items.get(i)->originalNode = 0;
+    }
+}
+
+
+ModelMemoryUsage EditableModelItem::memoryUsage() const
+{
+    return measureModelMemory(createModelTree());
 }
 
 
@@ -308,231 +1424,8 @@ bool EditableModelItem::saveModelFile(const std::string& filename)
 
 bool EditableModelItemImpl::saveModelFile(const std::string& filename)
 {
-    std::ofstream of;
-    of.open(filename.c_str(), std::ios::out);
-    VRMLBodyWriter* writer = new VRMLBodyWriter(of);
-    writer->setOutFileName(filename);
-    writer->writeHeader();
-
-    of << endl;
-    of << "PROTO Joint [" << endl;
-    of << "  exposedField     SFVec3f      center              0 0 0" << endl;
-    of << "  exposedField     MFNode       children            []" << endl;
-    of << "  exposedField     MFFloat      llimit              []" << endl;
-    of << "  exposedField     MFFloat      lvlimit             []" << endl;
-    of << "  exposedField     SFRotation   limitOrientation    0 0 1 0" << endl;
-    of << "  exposedField     SFString     name                \"\"" << endl;
-    of << "  exposedField     SFRotation   rotation            0 0 1 0" << endl;
-    of << "  exposedField     SFVec3f      scale               1 1 1" << endl;
-    of << "  exposedField     SFRotation   scaleOrientation    0 0 1 0" << endl;
-    of << "  exposedField     MFFloat      stiffness           [ 0 0 0 ]" << endl;
-    of << "  exposedField     SFVec3f      translation         0 0 0" << endl;
-    of << "  exposedField     MFFloat      ulimit              []" << endl;
-    of << "  exposedField     MFFloat      uvlimit             []" << endl;
-    of << "  exposedField     SFString     jointType           \"\"" << endl;
-    of << "  exposedField     SFInt32      jointId             -1" << endl;
-    of << "  exposedField     SFVec3f      jointAxis           0 0 1" << endl;
-    of << endl;
-    of << "  exposedField     SFFloat      gearRatio           1" << endl;
-    of << "  exposedField     SFFloat      rotorInertia        0" << endl;
-    of << "  exposedField     SFFloat      rotorResistor       0" << endl;
-    of << "  exposedField     SFFloat      torqueConst         1" << endl;
-    of << "  exposedField     SFFloat      encoderPulse        1" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    center           IS center" << endl;
-    of << "    children         IS children" << endl;
-    of << "    rotation         IS rotation" << endl;
-    of << "    scale            IS scale" << endl;
-    of << "    scaleOrientation IS scaleOrientation" << endl;
-    of << "    translation      IS translation" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO Segment [" << endl;
-    of << "  field           SFVec3f     bboxCenter        0 0 0" << endl;
-    of << "  field           SFVec3f     bboxSize          -1 -1 -1" << endl;
-    of << "  exposedField    SFVec3f     centerOfMass      0 0 0" << endl;
-    of << "  exposedField    MFNode      children          [ ]" << endl;
-    of << "  exposedField    SFNode      coord             NULL" << endl;
-    of << "  exposedField    MFNode      displacers        [ ]" << endl;
-    of << "  exposedField    SFFloat     mass              0" << endl;
-    of << "  exposedField    MFFloat     momentsOfInertia  [ 0 0 0 0 0 0 0 0 0 ]" << endl;
-    of << "  exposedField    SFString    name              \"\"" << endl;
-    of << "  eventIn         MFNode      addChildren" << endl;
-    of << "  eventIn         MFNode      removeChildren" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Group {" << endl;
-    of << "    addChildren    IS addChildren" << endl;
-    of << "    bboxCenter     IS bboxCenter" << endl;
-    of << "    bboxSize       IS bboxSize" << endl;
-    of << "    children       IS children" << endl;
-    of << "    removeChildren IS removeChildren" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO Humanoid [" << endl;
-    of << "  field           SFVec3f    bboxCenter            0 0 0" << endl;
-    of << "  field           SFVec3f    bboxSize              -1 -1 -1" << endl;
-    of << "  exposedField    SFVec3f    center                0 0 0" << endl;
-    of << "  exposedField    MFNode     humanoidBody          [ ]" << endl;
-    of << "  exposedField    MFString   info                  [ ]" << endl;
-    of << "  exposedField    MFNode     joints                [ ]" << endl;
-    of << "  exposedField    SFString   name                  \"\"" << endl;
-    of << "  exposedField    SFRotation rotation              0 0 1 0" << endl;
-    of << "  exposedField    SFVec3f    scale                 1 1 1" << endl;
-    of << "  exposedField    SFRotation scaleOrientation      0 0 1 0" << endl;
-    of << "  exposedField    MFNode     segments              [ ]" << endl;
-    of << "  exposedField    MFNode     sites                 [ ]" << endl;
-    of << "  exposedField    SFVec3f    translation           0 0 0" << endl;
-    of << "  exposedField    SFString   version               \"1.1\"" << endl;
-    of << "  exposedField    MFNode     viewpoints            [ ]" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    bboxCenter       IS bboxCenter" << endl;
-    of << "    bboxSize         IS bboxSize" << endl;
-    of << "    center           IS center" << endl;
-    of << "    rotation         IS rotation" << endl;
-    of << "    scale            IS scale" << endl;
-    of << "    scaleOrientation IS scaleOrientation" << endl;
-    of << "    translation      IS translation" << endl;
-    of << "    children [" << endl;
-    of << "      Group {" << endl;
-    of << "        children IS viewpoints" << endl;
-    of << "      }" << endl;
-    of << "      Group {" << endl;
-    of << "        children IS humanoidBody" << endl;
-    of << "      }" << endl;
-    of << "    ]" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO ExtraJoint [" << endl;
-    of << "  exposedField SFString link1Name \"\"" << endl;
-    of << "  exposedField SFString link2Name \"\"" << endl;
-    of << "  exposedField SFVec3f  link1LocalPos 0 0 0" << endl;
-    of << "  exposedField SFVec3f  link2LocalPos 0 0 0" << endl;
-    of << "  exposedField SFString jointType \"xyz\"" << endl;
-    of << "  exposedField SFVec3f  jointAxis 1 0 0" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO VisionSensor [" << endl;
-    of << "  exposedField SFVec3f    translation       0 0 0" << endl;
-    of << "  exposedField SFRotation rotation          0 0 1 0" << endl;
-    of << "  exposedField SFFloat    fieldOfView       0.785398" << endl;
-    of << "  exposedField SFString   name              \"\"" << endl;
-    of << "  exposedField SFFloat    frontClipDistance 0.01" << endl;
-    of << "  exposedField SFFloat    backClipDistance  10.0" << endl;
-    of << "  exposedField SFString   type              \"NONE\"" << endl;
-    of << "  exposedField SFInt32    sensorId          -1" << endl;
-    of << "  exposedField SFInt32    width             320" << endl;
-    of << "  exposedField SFInt32    height            240" << endl;
-    of << "  exposedField SFFloat    frameRate         30" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    rotation         IS rotation" << endl;
-    of << "    translation      IS translation" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO ForceSensor [" << endl;
-    of << "  exposedField SFVec3f maxForce -1 -1 -1" << endl;
-    of << "  exposedField SFVec3f maxTorque -1 -1 -1" << endl;
-    of << "  exposedField SFVec3f translation 0 0 0" << endl;
-    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
-    of << "  exposedField SFInt32 sensorId -1" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    translation IS translation" << endl;
-    of << "    rotation IS rotation" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO Gyro [" << endl;
-    of << "  exposedField SFVec3f maxAngularVelocity -1 -1 -1" << endl;
-    of << "  exposedField SFVec3f translation 0 0 0" << endl;
-    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
-    of << "  exposedField SFInt32 sensorId -1" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    translation IS translation" << endl;
-    of << "    rotation IS rotation" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO AccelerationSensor [" << endl;
-    of << "  exposedField SFVec3f maxAcceleration -1 -1 -1" << endl;
-    of << "  exposedField SFVec3f translation 0 0 0" << endl;
-    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
-    of << "  exposedField SFInt32 sensorId -1" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    translation IS translation" << endl;
-    of << "    rotation IS rotation" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO PressureSensor [" << endl;
-    of << "  exposedField SFFloat maxPressure -1" << endl;
-    of << "  exposedField SFVec3f translation 0 0 0" << endl;
-    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
-    of << "  exposedField SFInt32 sensorId -1" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    translation IS translation" << endl;
-    of << "    rotation IS rotation" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO PhotoInterrupter [" << endl;
-    of << "  exposedField SFVec3f transmitter 0 0 0" << endl;
-    of << "  exposedField SFVec3f receiver 0 0 0" << endl;
-    of << "  exposedField SFInt32 sensorId -1" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform{" << endl;
-    of << "    children [" << endl;
-    of << "      Transform{" << endl;
-    of << "        translation IS transmitter" << endl;
-    of << "      }" << endl;
-    of << "      Transform{" << endl;
-    of << "        translation IS receiver" << endl;
-    of << "      }" << endl;
-    of << "    ]" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-    of << "PROTO RangeSensor [" << endl;
-    of << "  exposedField SFVec3f    translation       0 0 0" << endl;
-    of << "  exposedField SFRotation rotation          0 0 1 0" << endl;
-    of << "  exposedField MFNode     children          [ ]" << endl;
-    of << "  exposedField SFInt32    sensorId          -1" << endl;
-    of << "  exposedField SFFloat    scanAngle         3.14159 #[rad]" << endl;
-    of << "  exposedField SFFloat    scanStep          0.1     #[rad]" << endl;
-    of << "  exposedField SFFloat    scanRate          10      #[Hz]" << endl;
-    of << "  exposedField SFFloat    minDistance       0.01" << endl;
-    of << "  exposedField SFFloat    maxDistance       10" << endl;
-    of << "]" << endl;
-    of << "{" << endl;
-    of << "  Transform {" << endl;
-    of << "    rotation         IS rotation" << endl;
-    of << "    translation      IS translation" << endl;
-    of << "    children         IS children" << endl;
-    of << "  }" << endl;
-    of << "}" << endl;
-    of << endl;
-
-    writer->writeNode(toVRML());
+    MODELEDIT_TRACE_SPAN("EditableModelItem::saveModelFile");
+    return self->createModelTree()->saveVRML(filename);
 }
 
 
@@ -544,10 +1437,8 @@ bool EditableModelItem::saveModelFileURDF(const std::string& filename)
 
 bool EditableModelItemImpl::saveModelFileURDF(const std::string& filename)
 {
-    std::ofstream of;
-    of.open(filename.c_str(), std::ios::out);
-    of << toURDF();
-    of.close();
+    MODELEDIT_TRACE_SPAN("EditableModelItem::saveModelFileURDF");
+    return self->createModelTree()->saveURDF(filename, MessageView::instance()->cout());
 }
 
 
@@ -559,14 +1450,34 @@ bool EditableModelItem::saveModelFileSDF(const std::string& filename)
 
 bool EditableModelItemImpl::saveModelFileSDF(const std::string& filename)
 {
-    sdf::SDFPtr robot(new sdf::SDF());
-    sdf::init(robot);
-    sdf::readString(toURDF(), robot);
-    std::ofstream of;
-    of.open(filename.c_str(), std::ios::out);
-    of << robot->ToString();
-    cout << robot->ToString() << endl;
-    of.close();
+    MODELEDIT_TRACE_SPAN("EditableModelItem::saveModelFileSDF");
+    return self->createModelTree()->saveSDF(filename, MessageView::instance()->cout());
+}
+
+
+bool EditableModelItem::saveModelFileBody(const std::string& filename)
+{
+    return impl->saveModelFileBody(filename);
+}
+
+
+bool EditableModelItemImpl::saveModelFileBody(const std::string& filename)
+{
+    MODELEDIT_TRACE_SPAN("EditableModelItem::saveModelFileBody");
+    return writeBodyFile(self->createModelTree(), filename, MessageView::instance()->cout());
+}
+
+
+bool EditableModelItem::saveModelFileMJCF(const std::string& filename)
+{
+    return impl->saveModelFileMJCF(filename);
+}
+
+
+bool EditableModelItemImpl::saveModelFileMJCF(const std::string& filename)
+{
+    MODELEDIT_TRACE_SPAN("EditableModelItem::saveModelFileMJCF");
+    return writeMJCFFile(self->createModelTree(), filename, MessageView::instance()->cout());
 }
 
 
@@ -6,15 +6,35 @@
 #define CNOID_EDITMODEL_PLUGIN_EDITABLEMODEL_ITEM_H
 
 #include <cnoid/Item>
+#include <cnoid/ItemList>
 #include <cnoid/Body>
 #include <cnoid/Link>
 #include <cnoid/SceneProvider>
 #include <boost/optional.hpp>
+#include "ModelNode.h"
+#include "ModelMemory.h"
+#include "ConvexDecomposition.h"
+#include "WorkerPool.h"
 #include "exportdecl.h"
 
 namespace cnoid {
 
 class EditableModelItem;
+class EditBatchState;
+
+/// Sizes of a model before and after a model reduction
+struct ModelReductionReport
+{
+    ModelReductionReport()
+        : numLinksBefore(0),
+          numLinksAfter(0),
+          numTrianglesBefore(0),
+          numTrianglesAfter(0) { }
+    int numLinksBefore;
+    int numLinksAfter;
+    int numTrianglesBefore;
+    int numTrianglesAfter;
+};
 typedef ref_ptr<EditableModelItem> EditableModelItemPtr;
 class EditableModelItemImpl;
 
@@ -31,6 +51,129 @@ public:
     bool saveModelFile(const std::string& filename);
     bool saveModelFileURDF(const std::string& filename);
     bool saveModelFileSDF(const std::string& filename);
+    /// Saves the model in the YAML body format with the meshes in the VRML files next to it
+    bool saveModelFileBody(const std::string& filename);
+    bool saveModelFileMJCF(const std::string& filename);
+
+    /// Creates the model nodes of the items, which are used for exporting the model
+    ModelRootNodePtr createModelTree() const;
+
+    /**
+       In the compact memory mode, the parsed VRML nodes are released just after
+       loading and the geometry is exported from the scene meshes of the links.
+       The mode is also enabled by the --modeledit-compact-memory option.
+    */
+    static void setCompactMemoryMode(bool on);
+    static bool isCompactMemoryMode();
+
+    /**
+       In the lazy item mode, the joints below the root joints of a loaded model
+       keep their subtrees as the model nodes, which are shown as plain shapes,
+       and the items are created when the joint is selected. A dragged joint
+       moves its deferred subtree and the exports read the deferred nodes
+       without creating the items. The other operations on the whole model
+       create all the items first.
+       The mode is also enabled by the --modeledit-lazy-items option.
+    */
+    static void setLazyItemMode(bool on);
+    static bool isLazyItemMode();
+
+    /// Creates all the items deferred in the lazy item mode
+    void materializeItems();
+
+    /// Releases the original VRML nodes kept by the items of the model
+    void releaseOriginalNodes();
+    ModelMemoryUsage memoryUsage() const;
+
+    /**
+       Edit transaction for scripted changes. The update notifications of the
+       model items are deferred while a transaction is open and each modified
+       item is notified once when the outermost transaction is committed.
+    */
+    void beginTransaction();
+    void commitTransaction();
+
+    /// Edit batch shared by the items of this model, which is used by the transactions
+    EditBatchState& editBatchState();
+
+    /**
+       Drag of the selected items of the model, which the position dragger of the
+       model drives. The dragger is shared by the items of the model and shown in
+       the scene view at the selected items, and a group of the items is dragged
+       about their centroid. The items outside any model share another dragger.
+       These are also used to replay a drag without the scene view.
+       beginDrag() returns false when no item of the model is selected, and the
+       pose given to dragTo() is the pose of the dragger in the model coordinate.
+    */
+    bool beginDrag();
+    void dragTo(const Affine3& pivot);
+    void endDrag();
+    /// Pose of the dragger, which is the pivot of the drag
+    Affine3 dragPivot() const;
+
+    /**
+       Returns the items of the class in the model whose names match the pattern.
+       '*' matches any sequence of characters and '?' matches a single character.
+       The deferred items are created before the search.
+    */
+    template<class ItemType>
+    ItemList<ItemType> findItems(const std::string& namePattern = "*") {
+        materializeItems();
+        ItemList<ItemType> items;
+        findItemsSub(this, namePattern, items);
+        return items;
+    }
+
+    static bool matchNamePattern(const std::string& name, const std::string& pattern);
+
+    /**
+       Moves the item with its subtree under the new parent. Both must belong to
+       this model and the new parent must not be inside the moved subtree.
+       The poses of the items are kept because they are held in the model coordinate.
+    */
+    bool moveItem(Item* item, Item* newParent);
+    bool removeItem(Item* item);
+
+    /**
+       Replaces the collision shapes of the links with the convex decompositions
+       of their visual shapes. The decompositions are computed in parallel in the
+       background and the shapes are replaced in the completion of the returned
+       task, which then calls onFinished with the number of the links whose
+       collision shapes have been replaced.
+       The default parameters of the "Generate Collision Hulls" menu are set by
+       the options --modeledit-collision-hulls and --modeledit-collision-hull-vertices.
+    */
+    ModelEditWorkerTaskPtr generateCollisionShapes(
+        const ConvexDecompositionParams& params,
+        const boost::function<void(int numGenerated)>& onFinished = boost::function<void(int)>());
+
+    /**
+       Fits a box, a sphere and a cylinder to the visual shape of each link in
+       parallel in the background. In the completion of the returned task, every
+       candidate is added as a PrimitiveShapeItem named "collision proposal" under
+       the link, replacing the previous proposals, and only the best one is checked.
+       The fit error is shown as a property of the proposal and put in the message
+       view. onFinished is called with the number of the links given the proposals.
+    */
+    ModelEditWorkerTaskPtr fitPrimitiveShapes(
+        const boost::function<void(int numProposed)>& onFinished = boost::function<void(int)>());
+
+    /**
+       Renames the checked proposals to "collision" and removes the unchecked
+       proposals and the other collision shapes of their links, so that the
+       primitives are exported as the collision shapes.
+       Returns the number of the accepted proposals.
+    */
+    int acceptPrimitiveProposals();
+
+    /**
+       Collapses the links of the fixed joints into the links of their parent
+       joints. The shapes are merged with the relative transforms baked into the
+       meshes, the mass properties are composed by the parallel axis theorem and
+       the child joints, sensors and other items are moved to the parent, keeping
+       their poses. Returns the number of the removed joints.
+    */
+    int mergeFixedJoints(ModelReductionReport* out_report = 0);
     
 protected:
     virtual Item* doDuplicate() const;
@@ -40,6 +183,17 @@ protected:
     virtual bool restore(const Archive& archive);
             
 private:
+    template<class ItemType>
+    static void findItemsSub(Item* parent, const std::string& namePattern, ItemList<ItemType>& items) {
+        for(Item* child = parent->childItem(); child; child = child->nextItem()){
+            ItemType* item = dynamic_cast<ItemType*>(child);
+            if(item && matchNamePattern(child->name(), namePattern)){
+                items.push_back(item);
+            }
+            findItemsSub(child, namePattern, items);
+        }
+    }
+
     friend class EditableModelItemImpl;
     EditableModelItemImpl* impl;
 };
@@ -0,0 +1,395 @@
+/**
+   @file
+*/
+
+#include "GLBWriter.h"
+#include "Trace.h"
+#include <cnoid/SceneShape>
+#include <boost/cstdint.hpp>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// the constants of the glTF specification
+const boost::uint32_t GLB_MAGIC = 0x46546C67;
+const boost::uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+const boost::uint32_t GLB_CHUNK_BIN = 0x004E4942;
+const int ARRAY_BUFFER = 34962;
+const int ELEMENT_ARRAY_BUFFER = 34963;
+const int BYTE = 5120;
+const int SHORT = 5122;
+const int UNSIGNED_SHORT = 5123;
+const int UNSIGNED_INT = 5125;
+const int FLOAT = 5126;
+
+string jsonString(const string& s)
+{
+    ostringstream os;
+    os << '"';
+    for(size_t i=0; i < s.size(); ++i){
+        const unsigned char c = s[i];
+        if(c == '"' || c == '\\'){
+            os << '\\' << c;
+        } else if(c < 0x20){
+            char buf[8];
+            sprintf(buf, "\\u%04x", c);
+            os << buf;
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+    return os.str();
+}
+
+template<class VectorType>
+string jsonArray(const VectorType& v)
+{
+    ostringstream os;
+    os.precision(9);
+    os << "[";
+    for(int i=0; i < v.size(); ++i){
+        os << (i > 0 ? "," : "") << v[i];
+    }
+    os << "]";
+    return os.str();
+}
+
+/**
+   The vertices of a primitive, which are shared by the triangles only when
+   they have the same position and normal indices.
+*/
+struct PrimitiveVertices
+{
+    vector<Vector3f> positions;
+    vector<Vector3f> normals;
+    vector<boost::uint32_t> indices;
+};
+
+class GLBWriter
+{
+public:
+    GLBWriter(bool quantize);
+    bool write(const string& filename, const string& name, const vector<ShapeTransform>& shapes);
+
+private:
+    bool quantize;
+    string bin;
+    vector<string> bufferViews;
+    vector<string> accessors;
+    vector<string> materials;
+    map<string, int> materialIndices;
+    vector<string> primitives;
+    Vector3f center;
+    float scale;
+
+    int addBufferView(const void* data, size_t size, int byteStride, int target);
+    int addAccessor(int bufferView, int componentType, bool normalized, int count,
+                    const char* type, const string& minmax = string());
+    int addMaterial(const SgMaterial* material);
+    void addPrimitive(const PrimitiveVertices& v, int material);
+};
+
+void extractVertices(const SgMesh* mesh, PrimitiveVertices& out_v)
+{
+    const SgVertexArray& vertices = *mesh->vertices();
+    const SgIndexArray& triangles = mesh->triangleVertices();
+    const SgNormalArray* normals = mesh->hasNormals() ? mesh->normals() : 0;
+    const SgIndexArray& normalIndices = mesh->normalIndices();
+
+    if(normals && normalIndices.empty() && normals->size() == vertices.size()){
+        out_v.positions.assign(vertices.begin(), vertices.end());
+        out_v.normals.assign(normals->begin(), normals->end());
+        out_v.indices.assign(triangles.begin(), triangles.end());
+
+    } else if(normals && normalIndices.size() == triangles.size()){
+        map<pair<int, int>, boost::uint32_t> corners;
+        for(size_t i=0; i < triangles.size(); ++i){
+            const pair<int, int> key(triangles[i], normalIndices[i]);
+            map<pair<int, int>, boost::uint32_t>::iterator p = corners.find(key);
+            if(p == corners.end()){
+                p = corners.insert(make_pair(key, (boost::uint32_t)out_v.positions.size())).first;
+                out_v.positions.push_back(vertices[key.first]);
+                out_v.normals.push_back((*normals)[key.second]);
+            }
+            out_v.indices.push_back(p->second);
+        }
+    } else {
+        // the viewers compute the flat normals when there is no normal
+        out_v.positions.assign(vertices.begin(), vertices.end());
+        out_v.indices.assign(triangles.begin(), triangles.end());
+    }
+}
+
+}
+
+
+GLBWriter::GLBWriter(bool quantize)
+    : quantize(quantize),
+      center(Vector3f::Zero()),
+      scale(1.0f)
+{
+
+}
+
+
+int GLBWriter::addBufferView(const void* data, size_t size, int byteStride, int target)
+{
+    const size_t offset = bin.size();
+    bin.append(static_cast<const char*>(data), size);
+    // every accessor of the buffer views must be aligned to four bytes
+    bin.append((4 - bin.size() % 4) % 4, '\0');
+    ostringstream os;
+    os << "{\"buffer\":0,\"byteOffset\":" << offset << ",\"byteLength\":" << size;
+    if(byteStride > 0){
+        os << ",\"byteStride\":" << byteStride;
+    }
+    os << ",\"target\":" << target << "}";
+    bufferViews.push_back(os.str());
+    return bufferViews.size() - 1;
+}
+
+
+int GLBWriter::addAccessor(int bufferView, int componentType, bool normalized, int count,
+                           const char* type, const string& minmax)
+{
+    ostringstream os;
+    os << "{\"bufferView\":" << bufferView << ",\"componentType\":" << componentType;
+    if(normalized){
+        os << ",\"normalized\":true";
+    }
+    os << ",\"count\":" << count << ",\"type\":\"" << type << "\"" << minmax << "}";
+    accessors.push_back(os.str());
+    return accessors.size() - 1;
+}
+
+
+int GLBWriter::addMaterial(const SgMaterial* material)
+{
+    Vector3f diffuse(0.8f, 0.8f, 0.8f);
+    Vector3f emissive(Vector3f::Zero());
+    float alpha = 1.0f;
+    float roughness = 0.8f;
+    if(material){
+        diffuse = material->diffuseColor();
+        emissive = material->emissiveColor();
+        alpha = 1.0f - material->transparency();
+        roughness = 1.0f - material->shininess();
+    }
+    ostringstream os;
+    os.precision(6);
+    os << "{\"pbrMetallicRoughness\":{\"baseColorFactor\":["
+       << diffuse[0] << "," << diffuse[1] << "," << diffuse[2] << "," << alpha
+       << "],\"metallicFactor\":0,\"roughnessFactor\":" << roughness << "}";
+    if(!emissive.isZero()){
+        os << ",\"emissiveFactor\":" << jsonArray(emissive);
+    }
+    if(alpha < 1.0f){
+        os << ",\"alphaMode\":\"BLEND\"";
+    }
+    os << "}";
+
+    // the materials are shared by their values, which are often duplicated by the loaders
+    const string json = os.str();
+    map<string, int>::iterator p = materialIndices.find(json);
+    if(p != materialIndices.end()){
+        return p->second;
+    }
+    materials.push_back(json);
+    materialIndices[json] = materials.size() - 1;
+    return materials.size() - 1;
+}
+
+
+void GLBWriter::addPrimitive(const PrimitiveVertices& v, int material)
+{
+    const int n = v.positions.size();
+    ostringstream attributes;
+
+    int position;
+    if(quantize){
+        vector<boost::int16_t> q(n * 4, 0);
+        Eigen::Vector3i qmin, qmax;
+        for(int i=0; i < n; ++i){
+            const Vector3f s = (v.positions[i] - center) / scale;
+            for(int j=0; j < 3; ++j){
+                const float x = std::max(-1.0f, std::min(1.0f, s[j]));
+                q[i * 4 + j] = static_cast<boost::int16_t>(floor(x * 32767.0f + 0.5f));
+            }
+            const Eigen::Vector3i qi(q[i * 4], q[i * 4 + 1], q[i * 4 + 2]);
+            qmin = (i == 0) ? qi : Eigen::Vector3i(qmin.cwiseMin(qi));
+            qmax = (i == 0) ? qi : Eigen::Vector3i(qmax.cwiseMax(qi));
+        }
+        const int view = addBufferView(&q[0], q.size() * sizeof(boost::int16_t), 8, ARRAY_BUFFER);
+        position = addAccessor(view, SHORT, true, n, "VEC3",
+                               ",\"min\":" + jsonArray(qmin) + ",\"max\":" + jsonArray(qmax));
+    } else {
+        Vector3f pmin = v.positions.front();
+        Vector3f pmax = pmin;
+        for(int i=1; i < n; ++i){
+            pmin = pmin.cwiseMin(v.positions[i]);
+            pmax = pmax.cwiseMax(v.positions[i]);
+        }
+        const int view = addBufferView(v.positions[0].data(), n * sizeof(Vector3f), 0, ARRAY_BUFFER);
+        position = addAccessor(view, FLOAT, false, n, "VEC3",
+                               ",\"min\":" + jsonArray(pmin) + ",\"max\":" + jsonArray(pmax));
+    }
+    attributes << "\"POSITION\":" << position;
+
+    if(!v.normals.empty()){
+        int normal;
+        if(quantize){
+            vector<boost::int8_t> q(n * 4, 0);
+            for(int i=0; i < n; ++i){
+                Vector3f nv = v.normals[i];
+                if(nv.norm() > 0.0f){
+                    nv.normalize();
+                }
+                for(int j=0; j < 3; ++j){
+                    q[i * 4 + j] = static_cast<boost::int8_t>(floor(nv[j] * 127.0f + 0.5f));
+                }
+            }
+            const int view = addBufferView(&q[0], q.size(), 4, ARRAY_BUFFER);
+            normal = addAccessor(view, BYTE, true, n, "VEC3");
+        } else {
+            const int view = addBufferView(v.normals[0].data(), n * sizeof(Vector3f), 0, ARRAY_BUFFER);
+            normal = addAccessor(view, FLOAT, false, n, "VEC3");
+        }
+        attributes << ",\"NORMAL\":" << normal;
+    }
+
+    int indices;
+    // the index 65535 is the primitive restart value, which glTF does not allow
+    if(n <= 65535){
+        vector<boost::uint16_t> i16(v.indices.begin(), v.indices.end());
+        const int view = addBufferView(&i16[0], i16.size() * sizeof(boost::uint16_t), 0, ELEMENT_ARRAY_BUFFER);
+        indices = addAccessor(view, UNSIGNED_SHORT, false, i16.size(), "SCALAR");
+    } else {
+        const int view = addBufferView(&v.indices[0], v.indices.size() * sizeof(boost::uint32_t), 0, ELEMENT_ARRAY_BUFFER);
+        indices = addAccessor(view, UNSIGNED_INT, false, v.indices.size(), "SCALAR");
+    }
+
+    ostringstream os;
+    os << "{\"attributes\":{" << attributes.str() << "},\"indices\":" << indices
+       << ",\"material\":" << material << "}";
+    primitives.push_back(os.str());
+}
+
+
+bool GLBWriter::write(const string& filename, const string& name, const vector<ShapeTransform>& shapes)
+{
+    MODELEDIT_TRACE_SPAN("GLBWriter::write");
+
+    vector<PrimitiveVertices> vertices;
+    vector<const SgMaterial*> shapeMaterials;
+    for(size_t i=0; i < shapes.size(); ++i){
+        SgMeshPtr mesh = bakeShapeMesh(shapes[i]);
+        if(!mesh || !mesh->hasVertices() || mesh->triangleVertices().empty()){
+            continue;
+        }
+        vertices.push_back(PrimitiveVertices());
+        extractVertices(mesh, vertices.back());
+        shapeMaterials.push_back(shapes[i].shape->material());
+    }
+
+    if(quantize && !vertices.empty()){
+        // a uniform scale of the node keeps the normals valid
+        Vector3f pmin = vertices.front().positions.front();
+        Vector3f pmax = pmin;
+        for(size_t i=0; i < vertices.size(); ++i){
+            for(size_t j=0; j < vertices[i].positions.size(); ++j){
+                pmin = pmin.cwiseMin(vertices[i].positions[j]);
+                pmax = pmax.cwiseMax(vertices[i].positions[j]);
+            }
+        }
+        center = (pmin + pmax) / 2.0f;
+        scale = (pmax - pmin).maxCoeff() / 2.0f;
+        if(scale <= 0.0f){
+            scale = 1.0f;
+        }
+    }
+    for(size_t i=0; i < vertices.size(); ++i){
+        addPrimitive(vertices[i], addMaterial(shapeMaterials[i]));
+    }
+
+    ostringstream json;
+    json.precision(9);
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"Choreonoid model edit plugin\"}";
+    if(quantize){
+        json << ",\"extensionsUsed\":[\"KHR_mesh_quantization\"]"
+             << ",\"extensionsRequired\":[\"KHR_mesh_quantization\"]";
+    }
+    json << ",\"scene\":0,\"scenes\":[{\"nodes\":[0]}]";
+    json << ",\"nodes\":[{\"name\":" << jsonString(name);
+    if(!primitives.empty()){
+        json << ",\"mesh\":0";
+    }
+    if(quantize){
+        json << ",\"translation\":" << jsonArray(center)
+             << ",\"scale\":[" << scale << "," << scale << "," << scale << "]";
+    }
+    json << "}]";
+    if(!primitives.empty()){
+        json << ",\"meshes\":[{\"name\":" << jsonString(name) << ",\"primitives\":[";
+        for(size_t i=0; i < primitives.size(); ++i){
+            json << (i > 0 ? "," : "") << primitives[i];
+        }
+        json << "]}]";
+        json << ",\"materials\":[";
+        for(size_t i=0; i < materials.size(); ++i){
+            json << (i > 0 ? "," : "") << materials[i];
+        }
+        json << "],\"accessors\":[";
+        for(size_t i=0; i < accessors.size(); ++i){
+            json << (i > 0 ? "," : "") << accessors[i];
+        }
+        json << "],\"bufferViews\":[";
+        for(size_t i=0; i < bufferViews.size(); ++i){
+            json << (i > 0 ? "," : "") << bufferViews[i];
+        }
+        json << "],\"buffers\":[{\"byteLength\":" << bin.size() << "}]";
+    }
+    json << "}";
+
+    string jsonChunk = json.str();
+    jsonChunk.append((4 - jsonChunk.size() % 4) % 4, ' ');
+    const boost::uint32_t jsonLength = jsonChunk.size();
+    const boost::uint32_t binLength = bin.size();
+    const boost::uint32_t version = 2;
+    boost::uint32_t length = 12 + 8 + jsonLength;
+    if(binLength > 0){
+        length += 8 + binLength;
+    }
+
+    // the numbers of GLB are little endian as the hosts of Choreonoid
+    std::ofstream of(filename.c_str(), std::ios::out | std::ios::binary);
+    of.write(reinterpret_cast<const char*>(&GLB_MAGIC), 4);
+    of.write(reinterpret_cast<const char*>(&version), 4);
+    of.write(reinterpret_cast<const char*>(&length), 4);
+    of.write(reinterpret_cast<const char*>(&jsonLength), 4);
+    of.write(reinterpret_cast<const char*>(&GLB_CHUNK_JSON), 4);
+    of.write(jsonChunk.data(), jsonLength);
+    if(binLength > 0){
+        of.write(reinterpret_cast<const char*>(&binLength), 4);
+        of.write(reinterpret_cast<const char*>(&GLB_CHUNK_BIN), 4);
+        of.write(bin.data(), binLength);
+    }
+    of.close();
+    return !of.fail();
+}
+
+
+bool cnoid::writeMeshGLB
+(const std::string& filename, const std::string& name, const std::vector<ShapeTransform>& shapes, bool quantize)
+{
+    MODELEDIT_TRACE_SPAN("writeMeshGLB");
+    GLBWriter writer(quantize);
+    return writer.write(filename, name, shapes);
+}
@@ -0,0 +1,29 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_GLB_WRITER_H
+#define CNOID_EDITMODEL_PLUGIN_GLB_WRITER_H
+
+#include "MeshTransform.h"
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Writes the shapes as a binary glTF file with a node and a mesh named name.
+   Each shape becomes a primitive of the mesh with its transform baked into the
+   vertices, and the shapes of the same material values share a material.
+   When quantize is true, the positions are stored as the normalized 16-bit
+   integers scaled back by the node transform and the normals as the normalized
+   8-bit integers, which requires KHR_mesh_quantization.
+*/
+CNOID_EXPORT bool writeMeshGLB(
+    const std::string& filename, const std::string& name, const std::vector<ShapeTransform>& shapes,
+    bool quantize = false);
+
+}
+
+#endif
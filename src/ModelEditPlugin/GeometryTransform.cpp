@@ -0,0 +1,267 @@
+/**
+   @file
+*/
+
+#include "GeometryTransform.h"
+#include "EditableModelBase.h"
+#include "LinkItem.h"
+#include "JointItem.h"
+#include "PrimitiveShapeItem.h"
+#include "MeshTransform.h"
+#include "WorkerPool.h"
+#include "Trace.h"
+#include <cnoid/MessageView>
+#include <boost/format.hpp>
+#include <boost/bind.hpp>
+#include <cmath>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+struct LinkShapes
+{
+    LinkItemPtr item;
+    int visualBegin;
+    int visualEnd;
+    // the collision shape is the visual shape when the range is empty
+    int collisionBegin;
+    int collisionEnd;
+    bool isCollisionShared;
+};
+
+void bakeMesh(const vector<ShapeTransform>& shapes, vector<SgMeshPtr>& meshes, int index)
+{
+    meshes[index] = bakeShapeMesh(shapes[index]);
+}
+
+/**
+   The shapes of all the links are collected in the GUI thread, the meshes are
+   copied and transformed in the worker threads and the new shapes are set to
+   the links in the GUI thread again.
+*/
+class GeometryBaker
+{
+public:
+    void addLink(LinkItem* item, const Affine3& T) {
+        Link* link = item->link();
+        if(!link->visualShape()){
+            return;
+        }
+        LinkShapes ls;
+        ls.item = item;
+        ls.visualBegin = shapes.size();
+        collectShapeTransforms(link->visualShape(), T, shapes);
+        ls.visualEnd = shapes.size();
+        ls.isCollisionShared = (link->collisionShape() == link->visualShape());
+        ls.collisionBegin = shapes.size();
+        if(!ls.isCollisionShared){
+            collectShapeTransforms(link->collisionShape(), T, shapes);
+        }
+        ls.collisionEnd = shapes.size();
+        links.push_back(ls);
+    }
+
+    bool run() {
+        MODELEDIT_TRACE_SPAN("GeometryBaker::run");
+        meshes.resize(shapes.size());
+        try {
+            ModelEditWorkerPool::instance()->parallelFor(
+                shapes.size(), boost::bind(bakeMesh, boost::cref(shapes), boost::ref(meshes), _1));
+        } catch(const std::exception& ex){
+            MessageView::instance()->putln(format(_("Transforming the meshes failed: %1%")) % ex.what());
+            return false;
+        }
+        return true;
+    }
+
+    void apply() {
+        for(size_t i=0; i < links.size(); ++i){
+            const LinkShapes& ls = links[i];
+            SgGroup* visual = createGroup(ls.visualBegin, ls.visualEnd);
+            SgNode* collision = ls.isCollisionShared ? visual : createGroup(ls.collisionBegin, ls.collisionEnd);
+            ls.item->setShapes(visual, collision);
+        }
+    }
+
+    int numLinks() const { return links.size(); }
+
+private:
+    vector<LinkShapes> links;
+    vector<ShapeTransform> shapes;
+    vector<SgMeshPtr> meshes;
+
+    SgGroup* createGroup(int begin, int end) {
+        SgGroup* group = new SgGroup;
+        for(int i=begin; i < end; ++i){
+            group->addChild(createBakedShape(shapes[i], meshes[i]));
+        }
+        return group;
+    }
+};
+
+void collectModelItems(Item* item, vector<EditableModelBase*>& out_items)
+{
+    if(EditableModelBase* model = dynamic_cast<EditableModelBase*>(item)){
+        out_items.push_back(model);
+    }
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        collectModelItems(child, out_items);
+    }
+}
+
+bool isLinkWithShapes(EditableModelBase* item)
+{
+    LinkItem* link = dynamic_cast<LinkItem*>(item);
+    return link && !link->isCollisionItem();
+}
+
+/**
+   The inertia is converted to the second moment of the mass distribution,
+   which is transformed by the linear map L as it is.
+*/
+void scaleMassProperties(double& mass, Vector3& c, Matrix3& I, const Matrix3& L, bool preserveMass)
+{
+    const double ratio = preserveMass ? 1.0 : fabs(L.determinant());
+    const Matrix3 J = 0.5 * I.trace() * Matrix3::Identity() - I;
+    const Matrix3 J2 = ratio * L * J * L.transpose();
+    I = J2.trace() * Matrix3::Identity() - J2;
+    c = L * c;
+    mass *= ratio;
+}
+
+void scaleLink(LinkItem* item, const Matrix3& L, bool preserveMass)
+{
+    double mass = item->mass();
+    Vector3 c = item->centerOfMass();
+    Matrix3 I = item->inertia();
+    scaleMassProperties(mass, c, I, L, preserveMass);
+    item->setMass(mass);
+    item->setCenterOfMass(c);
+    item->setInertia(I);
+}
+
+void scalePrimitive(PrimitiveShapeItem* item, const Matrix3& L, bool preserveMass)
+{
+    double mass = item->mass();
+    Vector3 c = item->centerOfMass();
+    Matrix3 I = item->inertia();
+    scaleMassProperties(mass, c, I, L, preserveMass);
+    item->setMass(mass);
+    item->setCenterOfMass(c);
+    item->setInertia(I);
+
+    // the scales along the local axes, which are exact for the axis aligned scaling
+    const Vector3 k(L.col(0).norm(), L.col(1).norm(), L.col(2).norm());
+    const string type = item->primitiveType();
+    if(type == "Box"){
+        item->setBoxSize(item->boxSize().cwiseProduct(k));
+    } else if(type == "Sphere"){
+        item->setPrimitiveRadius(item->primitiveRadius() * k.sum() / 3.0);
+    } else {
+        // the axes of the cylinder and the cone are y
+        item->setPrimitiveRadius(item->primitiveRadius() * (k.x() + k.z()) / 2.0);
+        item->setPrimitiveHeight(item->primitiveHeight() * k.y());
+    }
+}
+
+void scaleJoint(JointItem* item, const Matrix3& L)
+{
+    const Vector3& axis = item->jointAxis();
+    if(item->jointType() == "slide"){
+        const Vector3 a = L * axis;
+        const double k = a.norm();
+        item->setJointAxis(a);
+        item->setJointRange(item->lowerLimit() * k, item->upperLimit() * k);
+        item->setVelocityRange(item->lowerVelocityLimit() * k, item->upperVelocityLimit() * k);
+    } else {
+        // the rotation axis is transformed as a normal of the rotation plane
+        item->setJointAxis(L.inverse().transpose() * axis);
+    }
+}
+
+}
+
+
+bool cnoid::scaleModelGeometry(Item* root, const Vector3& scale, bool preserveMass)
+{
+    MODELEDIT_TRACE_SPAN("scaleModelGeometry");
+
+    if(!root || scale.minCoeff() <= 0.0){
+        return false;
+    }
+    EditableModelBase* rootItem = dynamic_cast<EditableModelBase*>(root);
+    const Vector3 center = rootItem ? rootItem->translation : Vector3::Zero();
+    const Matrix3 S = scale.asDiagonal();
+
+    EditableModelBase::materializeItems(root);
+    vector<EditableModelBase*> items;
+    collectModelItems(root, items);
+
+    GeometryBaker baker;
+    for(size_t i=0; i < items.size(); ++i){
+        if(isLinkWithShapes(items[i])){
+            Affine3 T = Affine3::Identity();
+            T.linear() = items[i]->rotation.transpose() * S * items[i]->rotation;
+            baker.addLink(static_cast<LinkItem*>(items[i]), T);
+        }
+    }
+    if(!baker.run()){
+        return false;
+    }
+
+    EditableModelBase::EditBatch batch;
+    for(size_t i=0; i < items.size(); ++i){
+        batch.add(items[i]);
+    }
+    baker.apply();
+    for(size_t i=0; i < items.size(); ++i){
+        EditableModelBase* item = items[i];
+        // the map in the local coordinate of the item
+        const Matrix3 L = item->rotation.transpose() * S * item->rotation;
+        if(isLinkWithShapes(item)){
+            scaleLink(static_cast<LinkItem*>(item), L, preserveMass);
+        } else if(PrimitiveShapeItem* primitive = dynamic_cast<PrimitiveShapeItem*>(item)){
+            scalePrimitive(primitive, L, preserveMass);
+        } else if(JointItem* joint = dynamic_cast<JointItem*>(item)){
+            scaleJoint(joint, L);
+        }
+        item->translation = center + S * (item->translation - center);
+        item->requestUpdate();
+    }
+    return true;
+}
+
+
+int cnoid::bakeModelTransforms(Item* root)
+{
+    MODELEDIT_TRACE_SPAN("bakeModelTransforms");
+
+    if(!root){
+        return 0;
+    }
+    EditableModelBase::materializeItems(root);
+    vector<EditableModelBase*> items;
+    collectModelItems(root, items);
+
+    GeometryBaker baker;
+    for(size_t i=0; i < items.size(); ++i){
+        if(isLinkWithShapes(items[i])){
+            baker.addLink(static_cast<LinkItem*>(items[i]), Affine3::Identity());
+        }
+    }
+    if(!baker.run()){
+        return 0;
+    }
+    {
+        EditableModelBase::EditBatch batch;
+        for(size_t i=0; i < items.size(); ++i){
+            batch.add(items[i]);
+        }
+        baker.apply();
+    }
+    return baker.numLinks();
+}
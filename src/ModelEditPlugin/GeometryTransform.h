@@ -0,0 +1,38 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_GEOMETRY_TRANSFORM_H
+#define CNOID_EDITMODEL_PLUGIN_GEOMETRY_TRANSFORM_H
+
+#include <cnoid/Item>
+#include <cnoid/EigenTypes>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Scales the model items of the subtree by the per-axis scale in the model
+   coordinate about the position of the subtree root, or about the model origin
+   when the root is the model item itself.
+
+   The shapes of the links are copied with the scale and their nested transforms
+   baked into the vertices, so the shared meshes such as the ones in the asset
+   cache are not modified. The meshes are transformed in parallel.
+   The centers of mass, the inertias, the primitive sizes, the axes and the
+   limits of the slide joints and the poses of all the items including the
+   sensors are updated consistently. The masses are kept when preserveMass is
+   true, which is the case of the unit conversion, and scaled by the volume
+   otherwise.
+*/
+CNOID_EXPORT bool scaleModelGeometry(Item* root, const Vector3& scale, bool preserveMass = true);
+
+/**
+   Bakes the transform nodes of the link shapes in the subtree into the vertices
+   so that each link has a flat group of shapes. Returns the number of the links.
+*/
+CNOID_EXPORT int bakeModelTransforms(Item* root);
+
+}
+
+#endif
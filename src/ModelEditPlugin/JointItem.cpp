@@ -15,6 +15,8 @@
 #include <cnoid/ItemManager>
 #include <cnoid/OptionManager>
 #include <cnoid/MenuManager>
+#include <cnoid/ExtensionManager>
+#include <cnoid/Action>
 #include <cnoid/PutPropertyFunction>
 #include <cnoid/JointPath>
 #include <cnoid/BodyLoader>
@@ -22,7 +24,9 @@
 #include <cnoid/VRMLBody>
 #include <cnoid/SceneBody>
 #include <cnoid/SceneShape>
-#include "ModelEditDragger.h"
+#include "PropertyFormat.h"
+#include "Trace.h"
+#include "BulkEdit.h"
 #include <cnoid/FileUtil>
 #include <cnoid/MeshGenerator>
 #include <boost/bind.hpp>
@@ -31,6 +35,7 @@
 #include <deque>
 #include <iostream>
 #include <sstream>
+#include <cstring>
 #include <algorithm>
 #include "gettext.h"
 
@@ -45,6 +50,186 @@ const bool TRACE_FUNCTIONS = false;
 
 inline double radian(double deg) { return (3.14159265358979 * deg / 180.0); }
 
+bool replaceWord(string& name, const string& from, const string& to)
+{
+    string::size_type pos = name.find(from);
+    if(pos == string::npos){
+        return false;
+    }
+    name.replace(pos, from.size(), to);
+    return true;
+}
+
+// body part keywords which follow a single letter side prefix as in "LLEG" or "RARM"
+const char* sideKeywords[] = {
+    "LEG", "ARM", "HAND", "FOOT", "HIP", "KNEE", "ANKLE", "SHOULDER", "ELBOW", "WRIST",
+    "FINGER", "THUMB", "TOE", "EYE", "EAR", 0
+};
+
+bool isSidePrefixAt(const string& name, string::size_type pos)
+{
+    if(pos + 1 >= name.size() || (name[pos] != 'L' && name[pos] != 'R')){
+        return false;
+    }
+    for(int i=0; sideKeywords[i]; ++i){
+        if(name.compare(pos + 1, strlen(sideKeywords[i]), sideKeywords[i]) == 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+   Converts the name by the left/right naming rules such as
+   "LLEG_JOINT0" <-> "RLEG_JOINT0", "l_elbow" <-> "r_elbow", "wrist_L" <-> "wrist_R" and
+   "LeftHand" <-> "RightHand".
+*/
+string mirroredName(const string& name)
+{
+    static const char* words[][2] = {
+        { "Left", "Right" }, { "left", "right" }, { "LEFT", "RIGHT" }
+    };
+    for(int i=0; i < 3; ++i){
+        string mirrored(name);
+        if(replaceWord(mirrored, words[i][0], words[i][1]) ||
+           replaceWord(mirrored, words[i][1], words[i][0])){
+            return mirrored;
+        }
+    }
+
+    const string::size_type n = name.size();
+    if(n >= 2){
+        // prefix such as "L_", "r_" or "LLEG"
+        char c = name[0];
+        char next = name[1];
+        if((c == 'L' || c == 'R') && (next == '_' || isSidePrefixAt(name, 0))){
+            return string(1, c == 'L' ? 'R' : 'L') + name.substr(1);
+        }
+        if((c == 'l' || c == 'r') && next == '_'){
+            return string(1, c == 'l' ? 'r' : 'l') + name.substr(1);
+        }
+        // suffix such as "_L", ".r"
+        c = name[n - 1];
+        char prev = name[n - 2];
+        if((prev == '_' || prev == '.') && (c == 'L' || c == 'R' || c == 'l' || c == 'r')){
+            char m = (c == 'L') ? 'R' : (c == 'R') ? 'L' : (c == 'l') ? 'r' : 'l';
+            return name.substr(0, n - 1) + string(1, m);
+        }
+    }
+
+    // names such as "HRP_LLEG_JOINT0" where the side prefix follows a separator
+    for(string::size_type pos = name.find('_'); pos != string::npos; pos = name.find('_', pos + 1)){
+        if(isSidePrefixAt(name, pos + 1)){
+            string mirrored(name);
+            mirrored[pos + 1] = (name[pos + 1] == 'L') ? 'R' : 'L';
+            return mirrored;
+        }
+    }
+    return name;
+}
+
+
+void mirrorItemTree(Item* item, const Matrix3& S, const Vector3& offset)
+{
+    EditableModelBase* base = dynamic_cast<EditableModelBase*>(item);
+    if(base){
+        base->applyMirror(S, offset);
+        item->setName(mirroredName(item->name()));
+        item->notifyUpdate();
+    }
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        mirrorItemTree(child, S, offset);
+    }
+}
+
+
+SgNode* createPrimitiveShape(const PrimitiveShapeNode* primitive)
+{
+    MeshGenerator meshGenerator;
+    SgMeshPtr mesh;
+    const string& pt = primitive->primitiveType;
+    if(pt == "Box"){
+        mesh = meshGenerator.generateBox(primitive->boxSize);
+    } else if(pt == "Cone"){
+        mesh = meshGenerator.generateCone(primitive->primitiveRadius, primitive->primitiveHeight, true, true);
+    } else if(pt == "Cylinder"){
+        mesh = meshGenerator.generateCylinder(primitive->primitiveRadius, primitive->primitiveHeight);
+    } else if(pt == "Sphere"){
+        mesh = meshGenerator.generateSphere(primitive->primitiveRadius);
+    }
+    if(!mesh){
+        return 0;
+    }
+    SgShape* shape = new SgShape;
+    SgMaterial* material = new SgMaterial;
+    material->setDiffuseColor(primitive->primitiveColor);
+    shape->setMesh(mesh);
+    shape->setMaterial(material);
+    return shape;
+}
+
+
+/**
+   The shapes of the links and the primitives of a deferred subtree in the model
+   coordinate as loaded, which are shown without the items. The link shapes are shared and
+   the collision shapes under the links are omitted as in the item tree.
+*/
+void addPendingShapes(const ModelNode* node, SgGroup* group)
+{
+    for(int i=0; i < node->numChildren(); ++i){
+        const ModelNode* child = node->child(i);
+        SgNode* shape = 0;
+        if(const LinkNode* link = dynamic_cast<const LinkNode*>(child)){
+            shape = link->link ? link->link->visualShape() : 0;
+        } else if(const PrimitiveShapeNode* primitive = dynamic_cast<const PrimitiveShapeNode*>(child)){
+            shape = createPrimitiveShape(primitive);
+        } else if(dynamic_cast<const JointNode*>(child)){
+            addPendingShapes(child, group);
+        }
+        if(shape){
+            SgPosTransform* transform = new SgPosTransform;
+            transform->setTranslation(child->translation);
+            transform->setRotation(child->rotation);
+            transform->addChild(shape);
+            group->addChild(transform);
+        }
+    }
+}
+
+
+void checkItemTree(Item* item)
+{
+    ItemTreeView::instance()->checkItem(item, true);
+    for(Item* child = item->childItem(); child; child = child->nextItem()){
+        checkItemTree(child);
+    }
+}
+
+
+bool hasSelectedAncestor(Item* item, const ItemList<JointItem>& selected)
+{
+    for(Item* parent = item->parentItem(); parent; parent = parent->parentItem()){
+        for(size_t i=0; i < selected.size(); ++i){
+            if(selected.get(i) == parent){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+void onMirrorTriggered(int axis)
+{
+    ItemList<JointItem> joints = ItemTreeView::mainInstance()->selectedItems<JointItem>();
+    for(size_t i=0; i < joints.size(); ++i){
+        JointItem* joint = joints.get(i);
+        if(!hasSelectedAncestor(joint, joints)){
+            joint->mirrorSubtree(Vector3::Unit(axis));
+        }
+    }
+}
+
 }
 
 
@@ -53,8 +238,10 @@ namespace cnoid {
 class JointItemImpl
 {
 public:
+    static JointItemImpl* implOf(JointItem* item) { return item->impl; }
+
     JointItem* self;
-    Link* link;
+    LinkPtr link;
     int jointId;
     Selection jointType;
     Vector3 jointAxis;
@@ -67,39 +254,32 @@ public:
     double rotorResistor;
     double torqueConst;
     double encoderPulse;
-    bool isselected;
+    double axisRadius;
 
+    SgGroupPtr sceneRoot;
     SceneLinkPtr sceneLink;
+    SgPosTransformPtr pendingShapes;
     SgScaleTransformPtr defaultAxesScale;
     SgMaterialPtr axisMaterials[3];
     double axisCylinderNormalizedRadius;
     SgPosTransformPtr axisShape;
 
-    Vector3 prevDragTranslation;
-    //ModelEditDraggerPtr positionDragger;
-    PositionDraggerPtr positionDragger;
-    Connection conSelectUpdate;
-
-    JointItemImpl(JointItem* self);
-    JointItemImpl(JointItem* self, Link* link);
+    JointItemImpl(JointItem* self, const JointNode* node);
     JointItemImpl(JointItem* self, const JointItemImpl& org);
     ~JointItemImpl();
     
     void init();
-    void onSelectionChanged();
-    void attachPositionDragger();
-    void onDraggerStarted();
-    void onDraggerDragged();
-    void onDraggerDraggedRecur(Item *parent, Vector3 dragdiff);
+    void readNode(const JointNode* node);
+    JointNode* createNode() const;
+    void ensureScene();
     void onUpdated();
     void onPositionChanged();
+    void applyMirror(const Matrix3& S);
     double radius() const;
     void setRadius(double val);
-    VRMLNodePtr toVRML();
-    string toURDF();
     void doAssign(Item* srcItem);
     void doPutProperties(PutPropertyFunction& putProperty);
-    bool setJointAxis(const std::string& value);
+    static bool normalizeAxis(Vector3& axis);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
 };
@@ -114,6 +294,15 @@ void JointItem::initializeClass(ExtensionManager* ext)
     if(!initialized){
         ext->itemManager().registerClass<JointItem>(N_("JointItem"));
         ext->itemManager().addCreationPanel<JointItem>();
+
+        MenuManager& mm = ext->menuManager();
+        mm.setPath("/Tools").setPath(N_("Model Edit"));
+        mm.addItem(_("Mirror Joint (XZ plane)"))
+            ->sigTriggered().connect(boost::bind(onMirrorTriggered, 1));
+        mm.addItem(_("Mirror Joint (YZ plane)"))
+            ->sigTriggered().connect(boost::bind(onMirrorTriggered, 0));
+        mm.addItem(_("Mirror Joint (XY plane)"))
+            ->sigTriggered().connect(boost::bind(onMirrorTriggered, 2));
         initialized = true;
     }
 }
@@ -121,29 +310,34 @@ void JointItem::initializeClass(ExtensionManager* ext)
 
 JointItem::JointItem()
 {
-    impl = new JointItemImpl(this);
+    JointNodePtr node = new JointNode;
+    node->readLink(new Link());
+    readModelNode(node);
+    impl = new JointItemImpl(this, node);
 }
 
 
-JointItemImpl::JointItemImpl(JointItem* self)
-    : self(self)
+JointItem::JointItem(Link* link)
 {
-    link = new Link();
-    init();
+    JointNodePtr node = new JointNode;
+    node->readLink(link);
+    readModelNode(node);
+    impl = new JointItemImpl(this, node);
 }
 
 
-JointItem::JointItem(Link* link)
+JointItem::JointItem(const JointNode* node)
 {
-    impl = new JointItemImpl(this, link);
+    readModelNode(node);
+    impl = new JointItemImpl(this, node);
 }
 
 
-JointItemImpl::JointItemImpl(JointItem*self, Link* link)
+JointItemImpl::JointItemImpl(JointItem* self, const JointNode* node)
     : self(self)
 {
-    this->link = link;
     init();
+    readNode(node);
 }
 
 
@@ -159,6 +353,20 @@ JointItemImpl::JointItemImpl(JointItem* self, const JointItemImpl& org)
       link(org.link)
 {
     init();
+
+    jointId = org.jointId;
+    jointType.selectIndex(org.jointType.selectedIndex());
+    jointAxis = org.jointAxis;
+    ulimit = org.ulimit;
+    llimit = org.llimit;
+    uvlimit = org.uvlimit;
+    lvlimit = org.lvlimit;
+    gearRatio = org.gearRatio;
+    rotorInertia = org.rotorInertia;
+    rotorResistor = org.rotorResistor;
+    torqueConst = org.torqueConst;
+    encoderPulse = org.encoderPulse;
+    axisRadius = org.axisRadius;
 }
 
 
@@ -171,27 +379,63 @@ void JointItemImpl::init()
     jointType.setSymbol(Link::FIXED_JOINT, "fixed");
     jointType.setSymbol(Link::CRAWLER_JOINT, "crawler");
 
-    jointId = link->jointId();
-    jointType.selectIndex(link->jointType());
-    jointAxis = link->jointAxis();
-    ulimit = link->q_upper();
-    llimit = link->q_lower();
-    uvlimit = link->dq_upper();
-    lvlimit = link->dq_lower();
-    VRMLJointPtr node;
-    node = new VRMLJoint();  // TODO: at this moment, we use original variable but we have to read this from original VRML
+    axisRadius = 0.15;
+
+    self->sigUpdated().connect(boost::bind(&JointItemImpl::onUpdated, this));
+}
+
+
+void JointItemImpl::readNode(const JointNode* node)
+{
+    link = node->link ? node->link : new Link();
+    jointId = node->jointId;
+    jointType.select(node->jointType);
+    jointAxis = node->jointAxis;
+    ulimit = node->ulimit;
+    llimit = node->llimit;
+    uvlimit = node->uvlimit;
+    lvlimit = node->lvlimit;
     gearRatio = node->gearRatio;
     rotorInertia = node->rotorInertia;
     rotorResistor = node->rotorResistor;
     torqueConst = node->torqueConst;
     encoderPulse = node->encoderPulse;
-    
-    self->translation = link->translation();
-    self->rotation = link->rotation();
-    sceneLink = new SceneLink(new Link());
+}
 
-    if (self->name().size() == 0)
-        self->setName(link->name());
+
+JointNode* JointItemImpl::createNode() const
+{
+    JointNode* node = new JointNode;
+    node->link = link;
+    node->jointId = jointId;
+    node->jointType = jointType.selectedSymbol();
+    node->jointAxis = jointAxis;
+    node->ulimit = ulimit;
+    node->llimit = llimit;
+    node->uvlimit = uvlimit;
+    node->lvlimit = lvlimit;
+    node->gearRatio = gearRatio;
+    node->rotorInertia = rotorInertia;
+    node->rotorResistor = rotorResistor;
+    node->torqueConst = torqueConst;
+    node->encoderPulse = encoderPulse;
+    return node;
+}
+
+
+/**
+   The scene is only needed when the item is shown, so it is created on the
+   first request of the scene. The dragger is shared in the model item.
+*/
+void JointItemImpl::ensureScene()
+{
+    if (sceneLink)
+        return;
+
+    MODELEDIT_TRACE_SPAN("JointItem::ensureScene");
+    sceneRoot = new SgGroup;
+    sceneLink = new SceneLink(new Link());
+    sceneRoot->addChild(sceneLink);
 
     axisCylinderNormalizedRadius = 0.04;
     
@@ -229,100 +473,58 @@ void JointItemImpl::init()
     }
     sceneLink->addChild(defaultAxesScale);
 
-    attachPositionDragger();
-
-    setRadius(0.15);
-
-    self->sigUpdated().connect(boost::bind(&JointItemImpl::onUpdated, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&JointItemImpl::onSelectionChanged, this));
-    isselected = false;
+    setRadius(axisRadius);
 
     onUpdated();
 }
 
 
-void JointItemImpl::onSelectionChanged()
-{
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
-    }
-    if (isselected != selected) {
-        isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
-        if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
-        } else {
-            positionDragger->setDraggerAlwaysHidden(true);
-        }
-    }
-}
-
-
 double JointItemImpl::radius() const
 {
-    return defaultAxesScale->scale().x();
+    return axisRadius;
 }
 
 
 void JointItemImpl::setRadius(double r)
 {
+    axisRadius = r;
+    if (!sceneLink)
+        return;
     defaultAxesScale->setScale(r);
-    positionDragger->setRadius(r * 1.5);
-    sceneLink->notifyUpdate();
-}
-
-
-void JointItemImpl::attachPositionDragger()
-{
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&JointItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&JointItemImpl::onDraggerDragged, this));
-    positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
-    sceneLink->addChild(positionDragger);
     sceneLink->notifyUpdate();
-    self->notifyUpdate();
-}
-
-
-void JointItemImpl::onDraggerStarted()
-{
-    prevDragTranslation = positionDragger->draggedPosition().translation();
-}
-
-
-void JointItemImpl::onDraggerDraggedRecur(Item *parent, Vector3 dragdiff)
-{
-    for(Item* child = parent->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            item->translation += dragdiff;
-            item->notifyUpdate();
-            onDraggerDraggedRecur(child, dragdiff);
-        }
-    }
-}
-
-void JointItemImpl::onDraggerDragged()
-{
-    self->translation = positionDragger->draggedPosition().translation();
-    self->rotation = positionDragger->draggedPosition().rotation();
-    Vector3 dragdiff = self->translation - prevDragTranslation;
-    onDraggerDraggedRecur(self, dragdiff);
-    prevDragTranslation = self->translation;
-    self->notifyUpdate();
 }
 
 
 void JointItemImpl::onUpdated()
 {
+    MODELEDIT_TRACE_SPAN("JointItem::onUpdated");
+    if (!sceneLink)
+        return;
     sceneLink->translation() = self->translation;
     sceneLink->rotation() = self->rotation;
 
+    // the deferred subtree is shown until its items are created
+    if (self->hasPendingChildren()) {
+        // the shapes are moved with the subtree when the joint is dragged
+        const Affine3 motion = self->pendingMotion();
+        if (!pendingShapes) {
+            pendingShapes = new SgPosTransform;
+            addPendingShapes(self->pendingModelNode(), pendingShapes);
+            pendingShapes->setTranslation(motion.translation());
+            pendingShapes->setRotation(motion.linear());
+            sceneRoot->addChild(pendingShapes);
+            sceneRoot->notifyUpdate();
+        } else {
+            pendingShapes->setTranslation(motion.translation());
+            pendingShapes->setRotation(motion.linear());
+            pendingShapes->notifyUpdate();
+        }
+    } else if (pendingShapes) {
+        sceneRoot->removeChild(pendingShapes);
+        pendingShapes = NULL;
+        sceneRoot->notifyUpdate();
+    }
+
     // draw shape indicator for joint axis
     if (axisShape) {
         sceneLink->removeChild(axisShape);
@@ -365,13 +567,241 @@ JointItem::~JointItem()
 
 JointItemImpl::~JointItemImpl()
 {
-    conSelectUpdate.disconnect();
 }
 
 
 Link* JointItem::link() const
 {
-    return impl->link;
+    return impl->link.get();
+}
+
+
+int JointItem::jointId() const
+{
+    return impl->jointId;
+}
+
+
+void JointItem::setJointId(int id)
+{
+    impl->jointId = id;
+    requestUpdate();
+}
+
+
+std::string JointItem::jointType() const
+{
+    return impl->jointType.selectedSymbol();
+}
+
+
+bool JointItem::setJointType(const std::string& type)
+{
+    if(!impl->jointType.select(type)){
+        return false;
+    }
+    requestUpdate();
+    return true;
+}
+
+
+const Vector3& JointItem::jointAxis() const
+{
+    return impl->jointAxis;
+}
+
+
+bool JointItem::setJointAxis(const Vector3& axis)
+{
+    Vector3 a = axis;
+    if(!JointItemImpl::normalizeAxis(a)){
+        return false;
+    }
+    impl->jointAxis = a;
+    requestUpdate();
+    return true;
+}
+
+
+double JointItem::lowerLimit() const
+{
+    return impl->llimit;
+}
+
+
+double JointItem::upperLimit() const
+{
+    return impl->ulimit;
+}
+
+
+bool JointItem::setJointRange(double lower, double upper)
+{
+    if(lower > upper){
+        return false;
+    }
+    impl->llimit = lower;
+    impl->ulimit = upper;
+    requestUpdate();
+    return true;
+}
+
+
+double JointItem::lowerVelocityLimit() const
+{
+    return impl->lvlimit;
+}
+
+
+double JointItem::upperVelocityLimit() const
+{
+    return impl->uvlimit;
+}
+
+
+bool JointItem::setVelocityRange(double lower, double upper)
+{
+    if(lower > upper){
+        return false;
+    }
+    impl->lvlimit = lower;
+    impl->uvlimit = upper;
+    requestUpdate();
+    return true;
+}
+
+
+double JointItem::gearRatio() const
+{
+    return impl->gearRatio;
+}
+
+
+void JointItem::setGearRatio(double r)
+{
+    impl->gearRatio = r;
+    requestUpdate();
+}
+
+
+double JointItem::rotorInertia() const
+{
+    return impl->rotorInertia;
+}
+
+
+void JointItem::setRotorInertia(double I)
+{
+    impl->rotorInertia = I;
+    requestUpdate();
+}
+
+
+double JointItem::rotorResistor() const
+{
+    return impl->rotorResistor;
+}
+
+
+void JointItem::setRotorResistor(double R)
+{
+    impl->rotorResistor = R;
+    requestUpdate();
+}
+
+
+double JointItem::torqueConst() const
+{
+    return impl->torqueConst;
+}
+
+
+void JointItem::setTorqueConst(double k)
+{
+    impl->torqueConst = k;
+    requestUpdate();
+}
+
+
+double JointItem::encoderPulse() const
+{
+    return impl->encoderPulse;
+}
+
+
+void JointItem::setEncoderPulse(double n)
+{
+    impl->encoderPulse = n;
+    requestUpdate();
+}
+
+
+void JointItem::applyMirror(const Matrix3& S, const Vector3& offset)
+{
+    EditableModelBase::applyMirror(S, offset);
+    impl->applyMirror(S);
+}
+
+
+void JointItem::adjustDraggerSize(PositionDragger* dragger)
+{
+    dragger->setRadius(impl->axisRadius * 1.5);
+}
+
+
+void JointItemImpl::applyMirror(const Matrix3& S)
+{
+    string jt(jointType.selectedSymbol());
+    if(jt == "slide"){
+        jointAxis = S * jointAxis;
+    } else {
+        // the rotation axis is a pseudo vector
+        jointAxis = -(S * jointAxis);
+        if(jt == "rotate"){
+            // keep the dominant component of the axis positive by reversing the joint direction
+            int maxIndex;
+            jointAxis.cwiseAbs().maxCoeff(&maxIndex);
+            if(jointAxis[maxIndex] < 0.0){
+                jointAxis = -jointAxis;
+                double u = ulimit;
+                ulimit = -llimit;
+                llimit = -u;
+                u = uvlimit;
+                uvlimit = -lvlimit;
+                lvlimit = -u;
+            }
+        }
+    }
+    onUpdated();
+}
+
+
+JointItemPtr JointItem::mirrorSubtree(const Vector3& normal, double offset)
+{
+    double size = normal.norm();
+    if(size < 1.0e-6){
+        return 0;
+    }
+    Vector3 n = normal / size;
+    Matrix3 S = Matrix3::Identity() - 2.0 * n * n.transpose();
+
+    // the deferred nodes are not mirrored with the items
+    materializeSubtree();
+    JointItemPtr mirrored = dynamic_cast<JointItem*>(duplicateAll());
+    if(!mirrored){
+        return 0;
+    }
+    mirrorItemTree(mirrored, S, 2.0 * offset * n);
+    if(mirrored->name() == name()){
+        mirrored->setName(name() + "_MIRROR");
+    }
+
+    Item* parent = parentItem();
+    if(parent){
+        parent->addChildItem(mirrored);
+        checkItemTree(mirrored);
+    }
+    return mirrored;
 }
 
 
@@ -403,7 +833,14 @@ void JointItemImpl::doAssign(Item* srcItem)
 
 SgNode* JointItem::getScene()
 {
-    return impl->sceneLink;
+    impl->ensureScene();
+    return impl->sceneRoot;
+}
+
+
+ModelNodePtr JointItem::createModelNode() const
+{
+    return impl->createNode();
 }
 
 
@@ -416,145 +853,41 @@ void JointItem::doPutProperties(PutPropertyFunction& putProperty)
 
 void JointItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 {
-    ostringstream oss;
+    int numTargets = bulkEditTargets(self).size();
+    if(numTargets > 1){
+        putProperty(_("Edit targets"), numTargets);
+    }
     putProperty.decimals(4)(_("Joint ID"), jointId, changeProperty(jointId));
-    putProperty(_("Joint type"), jointType,
-                boost::bind(&Selection::selectIndex, &jointType, _1));
+    putBulkSelection(putProperty, _("Joint type"), self, &JointItemImpl::jointType);
     string jt(jointType.selectedSymbol());
     if (jt == "rotate" || jt == "slide") {
-        putProperty(_("Joint axis"), str(jointAxis),
-                    boost::bind(&JointItemImpl::setJointAxis, this, _1));
-        putProperty.decimals(4)(_("Upper limit"), ulimit, changeProperty(ulimit));
-        putProperty.decimals(4)(_("Lower limit"), llimit, changeProperty(llimit));
-        putProperty.decimals(4)(_("Upper velocity limit"), uvlimit, changeProperty(uvlimit));
-        putProperty.decimals(4)(_("Lower velocity limit"), lvlimit, changeProperty(lvlimit));
-        putProperty.decimals(4)(_("Gear ratio"), gearRatio, changeProperty(gearRatio));
-        putProperty.decimals(4)(_("Rotor inertia"), rotorInertia, changeProperty(rotorInertia));
-        putProperty.decimals(4)(_("Rotor resistor"), rotorResistor, changeProperty(rotorResistor));
-        putProperty.decimals(4)(_("Torque const"), torqueConst, changeProperty(torqueConst));
-        putProperty.decimals(4)(_("Encoder pulse"), encoderPulse, changeProperty(encoderPulse));
+        putBulkVectorProperty(putProperty, _("Joint axis"), self, &JointItemImpl::jointAxis,
+                              &JointItemImpl::normalizeAxis);
+        putBulkProperty(putProperty.decimals(4), _("Upper limit"), self, &JointItemImpl::ulimit);
+        putBulkProperty(putProperty.decimals(4), _("Lower limit"), self, &JointItemImpl::llimit);
+        putBulkProperty(putProperty.decimals(4), _("Upper velocity limit"), self, &JointItemImpl::uvlimit);
+        putBulkProperty(putProperty.decimals(4), _("Lower velocity limit"), self, &JointItemImpl::lvlimit);
+        putBulkProperty(putProperty.decimals(4), _("Gear ratio"), self, &JointItemImpl::gearRatio);
+        putBulkProperty(putProperty.decimals(4), _("Rotor inertia"), self, &JointItemImpl::rotorInertia);
+        putBulkProperty(putProperty.decimals(4), _("Rotor resistor"), self, &JointItemImpl::rotorResistor);
+        putBulkProperty(putProperty.decimals(4), _("Torque const"), self, &JointItemImpl::torqueConst);
+        putBulkProperty(putProperty.decimals(4), _("Encoder pulse"), self, &JointItemImpl::encoderPulse);
     }
     putProperty.decimals(4).min(0.0)(_("Axis size"), radius(),
                                      boost::bind(&JointItemImpl::setRadius, this, _1), true);
 }
 
 
-bool JointItemImpl::setJointAxis(const std::string& value)
-{
-    Vector3 p;
-    if(toVector3(value, p)){
-        jointAxis = p;
-        return true;
-    }
-    return false;
-}
-
-
-VRMLNodePtr JointItem::toVRML()
-{
-    return impl->toVRML();
-}
-
-VRMLNodePtr JointItemImpl::toVRML()
+bool JointItemImpl::normalizeAxis(Vector3& axis)
 {
-    VRMLJointPtr node;
-    node = new VRMLJoint();
-    node->defName = self->name();
-    node->jointId = jointId;
-    node->jointType = jointType.selectedSymbol();
-    node->jointAxis = jointAxis;
-    node->ulimit.clear();
-    node->ulimit.push_back(ulimit);
-    node->llimit.clear();
-    node->llimit.push_back(llimit);
-    node->uvlimit.clear();
-    node->uvlimit.push_back(uvlimit);
-    node->lvlimit.clear();
-    node->lvlimit.push_back(lvlimit);
-    node->gearRatio = gearRatio;
-    node->rotorInertia = rotorInertia;
-    node->rotorResistor = rotorResistor;
-    node->torqueConst = torqueConst;
-    node->encoderPulse = encoderPulse;
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    if (parentjoint) {
-        Affine3 parent, child, relative;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        node->translation = relative.translation();
-        node->rotation = relative.rotation();
-    } else {
-        node->translation = self->translation;
-        node->rotation = self->rotation;
-    }
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            VRMLNodePtr childnode = item->toVRML();
-            node->children.push_back(childnode);
-        }
+    double size = axis.norm();
+    if(size < 1.0e-6){
+        return false;
     }
-    return node;
+    axis /= size;
+    return true;
 }
 
-string JointItem::toURDF()
-{
-    return impl->toURDF();
-}
-
-string JointItemImpl::toURDF()
-{
-    ostringstream ss;
-    string jtype;
-    jtype = "fixed";
-    if (jointType.selectedSymbol() == "rotate") {
-        // TODO: use continuous when no limits are set
-        jtype = "revolute";
-    } else if (jointType.selectedSymbol() == "slide") {
-        jtype = "prismatic";
-    }
-    ss << "<joint name=\"" << self->name() << "\" type=\"" << jtype << "\">" << endl;
-    ss << " <axis>" << jointAxis[0] << " " << jointAxis[1] << " " << jointAxis[2] << "</axis>" << endl;
-    if (jtype == "revolute" || jtype == "prismatic") {
-        ss << " <limit>" << endl;
-        ss << "  <lower>" << llimit << "</lower>"<< endl;
-        ss << "  <upper>" << ulimit << "</upper>"<< endl;
-        ss << " </limit>" << endl;
-    }
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    bool needworld = false;
-    if (parentjoint) {
-        Affine3 parent, child, relative;
-        ss << " <parent link=\"" << parentjoint->name() << "_LINK\"/>" << endl;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        Vector3 trans = relative.translation();
-        Vector3 rpy = rpyFromRot(relative.rotation());
-        ss << " <origin xyz=\"" << trans[0] << " " << trans[1] << " " << trans[2]
-           << "\" rpy=\"" << rpy[0] << " " << rpy[1] << " " << rpy[2] << "\"/>" << endl;
-    } else {
-        ss << " <parent link=\"world\"/>" << endl;
-        needworld = true;
-    }
-    ss << " <child link=\"" << self->name() << "_LINK\"/>" << endl;
-    ss << "</joint>" << endl;
-    if (needworld) {
-        ss << "<link name=\"world\" />" << endl;
-    }
-    for(Item* child = self->childItem(); child; child = child->nextItem()){
-        EditableModelBase* item = dynamic_cast<EditableModelBase*>(child);
-        if (item) {
-            ss << item->toURDF();
-        }
-    }
-    return ss.str();
-}
 
 bool JointItem::store(Archive& archive)
 {
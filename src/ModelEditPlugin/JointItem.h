@@ -28,12 +28,48 @@ public:
     JointItem();
     JointItem(const JointItem& org);
     JointItem(Link* link);
+    JointItem(const JointNode* node);
     virtual ~JointItem();
 
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+    virtual ModelNodePtr createModelNode() const;
+    virtual void applyMirror(const Matrix3& S, const Vector3& offset);
+    virtual void adjustDraggerSize(PositionDragger* dragger);
+
+    /**
+       Creates a mirrored copy of the joint subtree reflected by the plane
+       n.x = offset and adds it next to this joint. The names of the copied
+       items are converted by the left/right naming rules.
+    */
+    JointItemPtr mirrorSubtree(const Vector3& normal, double offset = 0.0);
     
     Link* link() const;
+
+    /**
+       Typed accessors for scripting. The setters request an update of the item,
+       which is deferred while a transaction of the model is open.
+    */
+    int jointId() const;
+    void setJointId(int id);
+    std::string jointType() const;
+    bool setJointType(const std::string& type);
+    const Vector3& jointAxis() const;
+    bool setJointAxis(const Vector3& axis);
+    double lowerLimit() const;
+    double upperLimit() const;
+    bool setJointRange(double lower, double upper);
+    double lowerVelocityLimit() const;
+    double upperVelocityLimit() const;
+    bool setVelocityRange(double lower, double upper);
+    double gearRatio() const;
+    void setGearRatio(double r);
+    double rotorInertia() const;
+    void setRotorInertia(double I);
+    double rotorResistor() const;
+    void setRotorResistor(double R);
+    double torqueConst() const;
+    void setTorqueConst(double k);
+    double encoderPulse() const;
+    void setEncoderPulse(double n);
     
     virtual SgNode* getScene();
 
@@ -22,9 +22,12 @@
 #include <cnoid/SceneBody>
 #include <cnoid/VRML>
 #include <cnoid/VRMLBody>
-#include <cnoid/VRMLWriter>
 #include <cnoid/MeshGenerator>
-#include "ModelEditDragger.h"
+#include "PropertyFormat.h"
+#include "Trace.h"
+#include "BulkEdit.h"
+#include "MeshTransform.h"
+#include "MeshLOD.h"
 #include <cnoid/FileUtil>
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
@@ -33,8 +36,6 @@
 #include <iostream>
 #include <sstream>
 #include <algorithm>
-#include <assimp/Importer.hpp>
-#include <assimp/Exporter.hpp>
 #include "gettext.h"
 
 using namespace std;
@@ -55,45 +56,47 @@ namespace cnoid {
 class LinkItemImpl
 {
 public:
+    static LinkItemImpl* implOf(LinkItem* item) { return item->impl; }
+
     LinkItem* self;
-    Link* link;
+    LinkPtr link;
     double mass;
     Vector3 centerOfMass;
     Matrix3 momentsOfInertia;
-    bool isselected;
 
-    SceneLink* sceneLink;
+    SceneLinkPtr sceneLink;
+    // copy of the link whose visual shape is the LOD group, used only for the display
+    LinkPtr lodLink;
+    ModelEditWorkerTaskPtr lodTask;
     SgNode* mesh;
     SgShape* shape;
     SgPosTransformPtr massShape;
     bool visualizeMass;
 
-    Vector3 dragStartTranslation;
-    //ModelEditDraggerPtr positionDragger;
-    PositionDraggerPtr positionDragger;
-    Connection conSelectUpdate;
-
-    LinkItemImpl(LinkItem* self);
-    LinkItemImpl(LinkItem* self, Link* link);
+    LinkItemImpl(LinkItem* self, const LinkNode* node);
     LinkItemImpl(LinkItem* self, const LinkItemImpl& org);
     ~LinkItemImpl();
     void doAssign(Item* srcItem);
         
     void init();
-    void attachPositionDragger();
-    void onDraggerStarted();
-    void onDraggerDragged();
+    void readNode(const LinkNode* node);
+    LinkNode* createNode() const;
+    void ensureScene();
+    void resetSceneLink();
+    void requestMeshLOD();
+    void onMeshLODGenerated(ModelEditLODGroup* lod);
+    void clearMeshLOD();
+    void setCollisionShape(SgNode* shape);
+    void setShapes(SgNode* visualShape, SgNode* collisionShape);
+    void applyMirror(const Matrix3& S);
+    void adjustDraggerSize(PositionDragger* dragger);
     void onUpdated();
     void onPositionChanged();
-    void onSelectionChanged();
     void doPutProperties(PutPropertyFunction& putProperty);
-    bool setCenterOfMass(const std::string& v);
-    bool setInertia(const std::string& v);
+    static bool checkInertia(Matrix3& I);
     bool setPrimitiveType(const std::string& t);
     bool setBoxSize(const std::string& v);
     bool setPrimitiveColor(const std::string& v);
-    VRMLNodePtr toVRML();
-    string toURDF();
     bool store(Archive& archive);
     bool restore(const Archive& archive);
 };
@@ -115,31 +118,37 @@ void LinkItem::initializeClass(ExtensionManager* ext)
 
 LinkItem::LinkItem()
 {
-    impl = new LinkItemImpl(this);
+    LinkPtr link = new Link();
+    link->setName("Link");
+    link->setShape(new SgPosTransform());
+    LinkNodePtr node = new LinkNode;
+    node->readLink(link);
+    readModelNode(node);
+    impl = new LinkItemImpl(this, node);
 }
 
 
-LinkItemImpl::LinkItemImpl(LinkItem* self)
-    : self(self)
+LinkItem::LinkItem(Link* link)
 {
-    link = new Link();
-    link->setName("Link");
-    link->setShape(new SgPosTransform());
-    init();
+    LinkNodePtr node = new LinkNode;
+    node->readLink(link);
+    readModelNode(node);
+    impl = new LinkItemImpl(this, node);
 }
 
 
-LinkItem::LinkItem(Link* link)
+LinkItem::LinkItem(const LinkNode* node)
 {
-    impl = new LinkItemImpl(this, link);
+    readModelNode(node);
+    impl = new LinkItemImpl(this, node);
 }
     
 
-LinkItemImpl::LinkItemImpl(LinkItem* self, Link* link)
+LinkItemImpl::LinkItemImpl(LinkItem* self, const LinkNode* node)
     : self(self)
 {
-    this->link = link;
     init();
+    readNode(node);
 }
 
 
@@ -155,6 +164,11 @@ LinkItemImpl::LinkItemImpl(LinkItem* self, const LinkItemImpl& org)
 {
     link = org.link;
     init();
+
+    mass = org.mass;
+    centerOfMass = org.centerOfMass;
+    momentsOfInertia = org.momentsOfInertia;
+    visualizeMass = org.visualizeMass;
 }
 
 
@@ -186,92 +200,88 @@ void LinkItemImpl::doAssign(Item* srcItem)
 
 void LinkItemImpl::init()
 {
-    mass = link->mass();
-    centerOfMass = link->centerOfMass();
-    momentsOfInertia = link->I();
-    self->translation = link->translation();
-    self->rotation = link->rotation();
-    sceneLink = new SceneLink(link);
     massShape = NULL;
     visualizeMass = false;
 
-    if(self->name().size() == 0){
-        SgGroup* group = dynamic_cast<SgGroup*>(link->shape());
-        if(group && group->numChildObjects() > 0){
-            SgNode* node = group->child(0);
-            if(node->name().size() != 0){
-                self->setName(node->name());
-            }else{
-                self->setName(link->name() + "_LINK");
-            }
-        }
-    }
-
-    attachPositionDragger();
-
     self->sigUpdated().connect(boost::bind(&LinkItemImpl::onUpdated, this));
     self->sigPositionChanged().connect(boost::bind(&LinkItemImpl::onPositionChanged, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&LinkItemImpl::onSelectionChanged, this));
-    isselected = false;
+}
 
-    onUpdated();
+
+void LinkItemImpl::readNode(const LinkNode* node)
+{
+    link = node->link ? node->link : new Link();
+    mass = node->mass;
+    centerOfMass = node->centerOfMass;
+    momentsOfInertia = node->momentsOfInertia;
 }
 
 
-void LinkItemImpl::attachPositionDragger()
+LinkNode* LinkItemImpl::createNode() const
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&LinkItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&LinkItemImpl::onDraggerDragged, this));
-    BoundingBox bb = sceneLink->untransformedBoundingBox();
-    if (bb.empty()) {
-        positionDragger->setRadius(0.1);
-    } else {
-        positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
-    }
-    sceneLink->addChild(positionDragger);
-    sceneLink->notifyUpdate();
-    self->notifyUpdate();
+    LinkNode* node = new LinkNode;
+    node->link = link;
+    node->mass = mass;
+    node->centerOfMass = centerOfMass;
+    node->momentsOfInertia = momentsOfInertia;
+    return node;
 }
 
 
-void LinkItemImpl::onSelectionChanged()
+/**
+   The scene link shares the shapes of the link, and it is created on the
+   first request of the scene. The dragger is shared in the model item.
+   The levels of detail of a large shape are generated in the background and
+   replace the shape when ready.
+*/
+void LinkItemImpl::ensureScene()
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
-    }
-    if (isselected != selected) {
-        isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
-        if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
-        } else {
-            positionDragger->setDraggerAlwaysHidden(true);
-        }
-    }
+    if (sceneLink)
+        return;
+
+    MODELEDIT_TRACE_SPAN("LinkItem::ensureScene");
+    sceneLink = new SceneLink(lodLink ? lodLink.get() : link.get());
+    onUpdated();
+    requestMeshLOD();
+}
+
+
+void LinkItemImpl::requestMeshLOD()
+{
+    if (lodLink || lodTask)
+        return;
+    lodTask = generateMeshLOD(link->visualShape(), boost::bind(&LinkItemImpl::onMeshLODGenerated, this, _1));
 }
 
 
-void LinkItemImpl::onDraggerStarted()
+void LinkItemImpl::onMeshLODGenerated(ModelEditLODGroup* lod)
 {
-    dragStartTranslation = positionDragger->draggedPosition().translation();
+    MODELEDIT_TRACE_SPAN("LinkItem::onMeshLODGenerated");
+    // the exported link keeps the full resolution shape
+    lodLink = new Link(*link);
+    lodLink->setVisualShape(lod);
+    resetSceneLink();
 }
 
 
-void LinkItemImpl::onDraggerDragged()
+/**
+   Must be called before the shape of the link is replaced.
+*/
+void LinkItemImpl::clearMeshLOD()
 {
-    self->translation = positionDragger->draggedPosition().translation();
-    self->rotation = positionDragger->draggedPosition().rotation();
-    self->notifyUpdate();
+    if (lodTask) {
+        lodTask->cancel();
+        lodTask.reset();
+    }
+    lodLink = 0;
 }
 
+
 void LinkItemImpl::onUpdated()
 {
+    MODELEDIT_TRACE_SPAN("LinkItem::onUpdated");
+    if (!sceneLink)
+        return;
     sceneLink->translation() = self->translation;
     sceneLink->rotation() = self->rotation;
     
@@ -328,130 +338,221 @@ LinkItem::~LinkItem()
 
 LinkItemImpl::~LinkItemImpl()
 {
-    conSelectUpdate.disconnect();
+    clearMeshLOD();
 }
 
 
 Link* LinkItem::link() const
 {
-    return impl->link;
+    return impl->link.get();
 }
 
 
-void LinkItemImpl::onPositionChanged()
+double LinkItem::mass() const
 {
+    return impl->mass;
 }
 
 
-VRMLNodePtr LinkItem::toVRML()
+bool LinkItem::setMass(double m)
 {
-    return impl->toVRML();
+    if(m < 0.0){
+        return false;
+    }
+    impl->mass = m;
+    requestUpdate();
+    return true;
 }
 
-VRMLNodePtr LinkItemImpl::toVRML()
+
+const Vector3& LinkItem::centerOfMass() const
 {
-    VRMLSegmentPtr node;
-    node = new VRMLSegment();
-    node->mass = mass;
-    node->centerOfMass = centerOfMass;
-    MFFloat v(momentsOfInertia.data(), momentsOfInertia.data() + 9);
-    node->momentsOfInertia = v;
-    VRMLTransformPtr trans;
-    trans = new VRMLTransform();
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    if (parentjoint) {
-        node->defName = self->name();
-        Affine3 parent, child, relative;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        trans->translation = relative.translation();
-        trans->rotation = relative.rotation();
-    } else {
-        node->defName = self->name();
-        trans->translation = self->translation;
-        trans->rotation = self->rotation;
+    return impl->centerOfMass;
+}
+
+
+void LinkItem::setCenterOfMass(const Vector3& c)
+{
+    impl->centerOfMass = c;
+    requestUpdate();
+}
+
+
+const Matrix3& LinkItem::inertia() const
+{
+    return impl->momentsOfInertia;
+}
+
+
+bool LinkItem::setInertia(const Matrix3& I)
+{
+    Matrix3 I2 = I;
+    if(!LinkItemImpl::checkInertia(I2)){
+        return false;
     }
-    node->children.push_back(trans);
-    if (self->originalNode) {
-        VRMLProtoInstancePtr original = dynamic_pointer_cast<VRMLProtoInstance>(self->originalNode);
-        if (original) {
-            trans->children = get<MFNode>(original->fields["children"]);
+    impl->momentsOfInertia = I2;
+    requestUpdate();
+    return true;
+}
+
+
+void LinkItemImpl::resetSceneLink()
+{
+    if (!sceneLink)
+        return;
+    sceneLink = 0;
+    massShape = NULL;
+    ensureScene();
+}
+
+
+void LinkItem::setCollisionShape(SgNode* shape)
+{
+    impl->setCollisionShape(shape);
+}
+
+
+void LinkItemImpl::setCollisionShape(SgNode* shape)
+{
+    // the display copy of the LOD generation has only the visual shape, so it is kept
+    LinkPtr newLink = new Link(*link);
+    newLink->setCollisionShape(shape);
+    link = newLink;
+
+    LinkPtr collisionLink = new Link(*link);
+    collisionLink->setVisualShape(shape);
+
+    LinkItem* collisionItem = 0;
+    for(Item* child = self->childItem(); child; child = child->nextItem()){
+        LinkItem* item = dynamic_cast<LinkItem*>(child);
+        if(item && item->name() == "collision"){
+            collisionItem = item;
+            break;
         }
     }
-    return node;
+    if(collisionItem){
+        LinkItemImpl* collisionImpl = collisionItem->impl;
+        collisionImpl->clearMeshLOD();
+        collisionImpl->link = collisionLink;
+        collisionItem->originalNode = 0;
+        collisionImpl->resetSceneLink();
+    } else {
+        collisionItem = new LinkItem(collisionLink);
+        collisionItem->setName("collision");
+        collisionItem->translation = self->translation;
+        collisionItem->rotation = self->rotation;
+        self->addChildItem(collisionItem);
+    }
 }
 
 
-string LinkItem::toURDF()
+void LinkItem::setShapes(SgNode* visualShape, SgNode* collisionShape)
 {
-    return impl->toURDF();
+    impl->setShapes(visualShape, collisionShape);
 }
 
-string LinkItemImpl::toURDF()
+
+void LinkItemImpl::setShapes(SgNode* visualShape, SgNode* collisionShape)
 {
-    ostringstream ss;
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    Affine3 relative;
-    if (parentjoint) {
-        string meshfname = "";
-        Assimp::Importer* im;
-        std::stringstream vrml;
-        if (self->originalNode) {
-            VRMLProtoInstancePtr original = dynamic_pointer_cast<VRMLProtoInstance>(self->originalNode);
-            if (original) {
-                VRMLWriter* writer = new VRMLWriter(vrml);
-                writer->setOutFileName("temp");
-                writer->writeNode(original);
-            }
+    LinkPtr newLink = new Link(*link);
+    newLink->setVisualShape(visualShape);
+    newLink->setCollisionShape(collisionShape);
+    clearMeshLOD();
+    link = newLink;
+    self->originalNode = 0;
+    resetSceneLink();
+
+    if(collisionShape != visualShape){
+        setCollisionShape(collisionShape);
+        return;
+    }
+    Item* child = self->childItem();
+    while(child){
+        Item* next = child->nextItem();
+        if(dynamic_cast<LinkItem*>(child) && child->name() == "collision"){
+            child->detachFromParentItem();
         }
-        const aiScene* ashape;
-        ashape = im->ReadFileFromMemory(vrml.str().c_str(), vrml.str().length(), 0);
-        Assimp::Exporter* ex;
-        ex = new Assimp::Exporter();
-        ex->Export(ashape, "collada", meshfname + ".dae");
-        ex->Export(ashape, "stl", meshfname + ".stl");
-        Affine3 parent, child;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        ss << "<link name=\"" << parentjoint->name() << "_LINK\">" << endl;
-        ss << " <inertial>" << endl;
-        ss << "  <mass value=\"" << mass << "\"/>" << endl;
-        ss << "  <origin xyz=\"" << centerOfMass[0] << " " << centerOfMass[1] << " " << centerOfMass[1] << "\" rpy=\"0 0 0\"/>" << endl;
-        ss << "  <inertia ixx=\"" << momentsOfInertia(0, 0)
-           << "\" ixy=\"" << momentsOfInertia(0, 1)
-           << "\" ixz=\"" << momentsOfInertia(0, 2)
-           << "\" iyy=\"" << momentsOfInertia(1, 1)
-           << "\" iyz=\"" << momentsOfInertia(1, 2)
-           << "\" izz=\"" << momentsOfInertia(2, 2) << "\" />" << endl;
-        ss << " </inertial>" << endl;
-        ss << " <visual>" << endl;
-        ss << "  <geometry>" << endl;
-        ss << "   <mesh filename=\"" << meshfname << ".dae\" />" << endl;
-        ss << "  </geometry>" << endl;
-        ss << " </visual>" << endl;
-        ss << " <collision>" << endl;
-        ss << "  <geometry>" << endl;
-        ss << "   <mesh filename=\"" << meshfname << ".stl\" />" << endl;
-        ss << "  </geometry>" << endl;
-        ss << " </collision>" << endl;
-        ss << "</link>" << endl;
+        child = next;
+    }
+}
+
+
+bool LinkItem::isCollisionItem() const
+{
+    return dynamic_cast<LinkItem*>(parentItem()) != 0;
+}
+
+
+void LinkItem::applyMirror(const Matrix3& S, const Vector3& offset)
+{
+    EditableModelBase::applyMirror(S, offset);
+    impl->applyMirror(S);
+}
+
+
+void LinkItem::adjustDraggerSize(PositionDragger* dragger)
+{
+    impl->adjustDraggerSize(dragger);
+}
+
+
+void LinkItemImpl::adjustDraggerSize(PositionDragger* dragger)
+{
+    ensureScene();
+    BoundingBox bb = sceneLink->untransformedBoundingBox();
+    if (bb.empty()) {
+        dragger->setRadius(0.1);
+    } else {
+        dragger->adjustSize(bb);
     }
-    return ss.str();
+}
+
+
+void LinkItemImpl::applyMirror(const Matrix3& S)
+{
+    centerOfMass = S * centerOfMass;
+    momentsOfInertia = S * momentsOfInertia * S;
+
+    LinkPtr mirrored = new Link(*link);
+    SgNode* visual = cloneSceneWithMeshes(link->visualShape());
+    mirrorScene(visual, S);
+    mirrored->setVisualShape(visual);
+    if(link->collisionShape() == link->visualShape()){
+        mirrored->setCollisionShape(visual);
+    } else {
+        SgNode* collision = cloneSceneWithMeshes(link->collisionShape());
+        mirrorScene(collision, S);
+        mirrored->setCollisionShape(collision);
+    }
+    clearMeshLOD();
+    link = mirrored;
+
+    // the original VRML node does not correspond to the mirrored geometry any more,
+    // so the geometry is regenerated from the scene graph on export
+    self->originalNode = 0;
+
+    resetSceneLink();
+}
+
+
+void LinkItemImpl::onPositionChanged()
+{
 }
 
 
 SgNode* LinkItem::getScene()
 {
+    impl->ensureScene();
     return impl->sceneLink;
 }
 
 
+ModelNodePtr LinkItem::createModelNode() const
+{
+    return impl->createNode();
+}
+
+
 void LinkItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     EditableModelBase::doPutProperties(putProperty);
@@ -461,34 +562,23 @@ void LinkItem::doPutProperties(PutPropertyFunction& putProperty)
 
 void LinkItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 {
-    ostringstream oss;
+    int numTargets = bulkEditTargets(self).size();
+    if(numTargets > 1){
+        putProperty(_("Edit targets"), numTargets);
+    }
     //putProperty(_("Model name"), link->name());
     //putProperty(_("Model file"), getFilename(boost::filesystem::path(self->filePath())));
-    putProperty.decimals(4)(_("Mass"), mass, changeProperty(mass));
-    putProperty(_("Center of mass"), str(Vector3(centerOfMass)),
-                boost::bind(&LinkItemImpl::setCenterOfMass, this, _1));
-    oss.str("");
-    oss << momentsOfInertia;
-    putProperty(_("Inertia"), oss.str(),
-                boost::bind(&LinkItemImpl::setInertia, this, _1));
-    putProperty.decimals(4)(_("Visualize mass"), visualizeMass, changeProperty(visualizeMass));
-}
-
-
-bool LinkItemImpl::setCenterOfMass(const std::string& value)
-{
-    Vector3 p;
-    if(toVector3(value, p)){
-        centerOfMass = p;
-        return true;
-    }
-    return false;
+    putBulkProperty(putProperty.decimals(4), _("Mass"), self, &LinkItemImpl::mass);
+    putBulkVectorProperty(putProperty, _("Center of mass"), self, &LinkItemImpl::centerOfMass);
+    putBulkVectorProperty(putProperty, _("Inertia"), self, &LinkItemImpl::momentsOfInertia,
+                          &LinkItemImpl::checkInertia);
+    putBulkProperty(putProperty, _("Visualize mass"), self, &LinkItemImpl::visualizeMass);
 }
 
 
-bool LinkItemImpl::setInertia(const std::string& value)
+bool LinkItemImpl::checkInertia(Matrix3& I)
 {
-    return false;
+    return (I - I.transpose()).cwiseAbs().maxCoeff() <= 1.0e-6 * std::max(1.0, I.cwiseAbs().maxCoeff());
 }
 
 
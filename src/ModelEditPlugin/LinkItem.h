@@ -27,14 +27,40 @@ public:
         
     LinkItem();
     LinkItem(Link* link);
+    LinkItem(const LinkNode* node);
     LinkItem(const LinkItem& org);
     virtual ~LinkItem();
 
     bool loadModelFile(const std::string& filename);
     
     Link* link() const;
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+
+    double mass() const;
+    bool setMass(double m);
+    const Vector3& centerOfMass() const;
+    void setCenterOfMass(const Vector3& c);
+    const Matrix3& inertia() const;
+    bool setInertia(const Matrix3& I);
+    virtual ModelNodePtr createModelNode() const;
+
+    /**
+       Replaces the collision shape of the link. The shape is shown by the
+       "collision" link item under this item, which is created if necessary.
+    */
+    void setCollisionShape(SgNode* shape);
+
+    /**
+       Replaces both shapes of the link. The geometry is regenerated from the
+       shapes on export. The "collision" link item is removed when the collision
+       shape is the visual shape.
+    */
+    void setShapes(SgNode* visualShape, SgNode* collisionShape);
+
+    /// True for the item which shows the collision shape of its parent link item
+    bool isCollisionItem() const;
+
+    virtual void applyMirror(const Matrix3& S, const Vector3& offset);
+    virtual void adjustDraggerSize(PositionDragger* dragger);
 
     virtual SgNode* getScene();
 
@@ -0,0 +1,400 @@
+/**
+   @file
+*/
+
+#include "MJCFWriter.h"
+#include "MeshTransform.h"
+#include "Trace.h"
+#include <cnoid/SceneShape>
+#include <cnoid/EigenUtil>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+string escape(const string& s)
+{
+    string escaped;
+    for(size_t i=0; i < s.size(); ++i){
+        switch(s[i]){
+        case '&': escaped += "&amp;"; break;
+        case '<': escaped += "&lt;"; break;
+        case '>': escaped += "&gt;"; break;
+        case '"': escaped += "&quot;"; break;
+        default: escaped += s[i]; break;
+        }
+    }
+    return escaped;
+}
+
+struct Values
+{
+    vector<double> values;
+    Values(const Vector3& v) : values(v.data(), v.data() + 3) { }
+};
+
+ostream& operator<<(ostream& os, const Values& v)
+{
+    for(size_t i=0; i < v.values.size(); ++i){
+        os << (i > 0 ? " " : "") << v.values[i];
+    }
+    return os;
+}
+
+struct Pose
+{
+    const Affine3& T;
+    Pose(const Affine3& T) : T(T) { }
+};
+
+ostream& operator<<(ostream& os, const Pose& pose)
+{
+    os << " pos=\"" << Values(pose.T.translation()) << "\"";
+    const Eigen::Quaterniond q(pose.T.linear());
+    if(q.vec().norm() > 1.0e-12){
+        os << " quat=\"" << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\"";
+    }
+    return os;
+}
+
+bool isFinite(double x)
+{
+    return fabs(x) <= numeric_limits<double>::max();
+}
+
+Affine3 modelPosition(const ModelNode* node)
+{
+    Affine3 T;
+    T.translation() = node->translation;
+    T.linear() = node->rotation;
+    return T;
+}
+
+/// Mesh asset, which is shared by the geoms of the same mesh and scale
+struct MeshAsset
+{
+    string name;
+    string filename;
+    Vector3 scale;
+};
+
+class MJCFWriter
+{
+public:
+    MJCFWriter(const ModelRootNode* root, const string& filename, ostream& messages);
+    bool write();
+
+private:
+    const ModelRootNode* root;
+    string filename;
+    ostream& messages;
+    ostringstream bodies;
+    ostringstream actuators;
+    ostringstream sensors;
+    map<pair<const SgMesh*, string>, int> meshIndices;
+    vector<MeshAsset> meshes;
+    bool isMeshWritingFailed;
+
+    void writeJoint(const JointNode* joint, const string& indent);
+    void writeLink(const JointNode* joint, const LinkNode* link, const string& indent);
+    void writeMeshGeom(const ShapeTransform& st, bool isVisual, bool isColliding, const string& indent);
+    const MeshAsset* findMeshAsset(const ShapeTransform& st, Affine3& out_T);
+    void writePrimitive(const PrimitiveShapeNode* primitive, const Affine3& T, bool isCollision, const string& indent);
+    void writeSensor(const SensorNode* sensor, const Affine3& T, const string& indent);
+};
+
+}
+
+
+MJCFWriter::MJCFWriter(const ModelRootNode* root, const string& filename, ostream& messages)
+    : root(root),
+      filename(filename),
+      messages(messages),
+      isMeshWritingFailed(false)
+{
+    bodies.precision(10);
+    actuators.precision(10);
+}
+
+
+bool MJCFWriter::write()
+{
+    for(int i=0; i < root->numChildren(); ++i){
+        if(const JointNode* joint = dynamic_cast<const JointNode*>(root->child(i))){
+            writeJoint(joint, "    ");
+        }
+    }
+    if(bodies.str().empty()){
+        messages << "[MJCF] the model has no joint" << endl;
+        return false;
+    }
+
+    std::ofstream of(filename.c_str(), std::ios::out);
+    of.precision(10);
+    of << "<mujoco model=\"" << escape(root->name) << "\">" << endl;
+    of << "  <compiler angle=\"radian\" inertiafromgeom=\"auto\"/>" << endl;
+    if(!meshes.empty()){
+        of << "  <asset>" << endl;
+        for(size_t i=0; i < meshes.size(); ++i){
+            const MeshAsset& mesh = meshes[i];
+            of << "    <mesh name=\"" << mesh.name << "\" file=\"" << escape(mesh.filename) << "\"";
+            if(!mesh.scale.isOnes()){
+                of << " scale=\"" << Values(mesh.scale) << "\"";
+            }
+            of << "/>" << endl;
+        }
+        of << "  </asset>" << endl;
+    }
+    of << "  <worldbody>" << endl;
+    of << bodies.str();
+    of << "  </worldbody>" << endl;
+    if(!actuators.str().empty()){
+        of << "  <actuator>" << endl << actuators.str() << "  </actuator>" << endl;
+    }
+    if(!sensors.str().empty()){
+        of << "  <sensor>" << endl << sensors.str() << "  </sensor>" << endl;
+    }
+    of << "</mujoco>" << endl;
+    of.close();
+    return !of.fail() && !isMeshWritingFailed;
+}
+
+
+void MJCFWriter::writeJoint(const JointNode* joint, const string& indent)
+{
+    MODELEDIT_TRACE_SPAN("MJCFWriter::writeJoint");
+
+    const string name = escape(joint->name);
+    bodies << indent << "<body name=\"" << name << "\"" << Pose(joint->relativePosition()) << ">" << endl;
+
+    const string sub = indent + "  ";
+    const string& type = joint->jointType;
+    if(type == "rotate" || type == "slide"){
+        bodies << sub << "<joint name=\"" << name << "\" type=\"" << (type == "rotate" ? "hinge" : "slide")
+               << "\" axis=\"" << Values(joint->jointAxis) << "\"";
+        if(joint->llimit < joint->ulimit && isFinite(joint->llimit) && isFinite(joint->ulimit)){
+            bodies << " limited=\"true\" range=\"" << joint->llimit << " " << joint->ulimit << "\"";
+        }
+        // the rotor inertia reflected to the joint side
+        const double armature = joint->rotorInertia * joint->gearRatio * joint->gearRatio;
+        if(armature > 0.0){
+            bodies << " armature=\"" << armature << "\"";
+        }
+        bodies << "/>" << endl;
+        actuators << "    <motor name=\"" << name << "\" joint=\"" << name << "\" gear=\"" << joint->gearRatio << "\"/>" << endl;
+    } else if(type == "free"){
+        bodies << sub << "<freejoint name=\"" << name << "\"/>" << endl;
+    }
+
+    double mass;
+    Vector3 c;
+    Matrix3 I;
+    joint->getMassProperties(mass, c, I);
+    if(mass > 0.0){
+        bodies << sub << "<inertial pos=\"" << Values(c) << "\" mass=\"" << mass << "\" fullinertia=\""
+               << I(0,0) << " " << I(1,1) << " " << I(2,2) << " "
+               << I(0,1) << " " << I(0,2) << " " << I(1,2) << "\"/>" << endl;
+    }
+
+    const Affine3 Tinv = modelPosition(joint).inverse();
+    vector<const JointNode*> childJoints;
+    for(int i=0; i < joint->numChildren(); ++i){
+        const ModelNode* child = joint->child(i);
+        if(const LinkNode* link = dynamic_cast<const LinkNode*>(child)){
+            writeLink(joint, link, sub);
+        } else if(const PrimitiveShapeNode* primitive = dynamic_cast<const PrimitiveShapeNode*>(child)){
+            writePrimitive(primitive, Tinv * modelPosition(primitive), false, sub);
+        } else if(const SensorNode* sensor = dynamic_cast<const SensorNode*>(child)){
+            writeSensor(sensor, Tinv * modelPosition(sensor), sub);
+        } else if(const JointNode* childJoint = dynamic_cast<const JointNode*>(child)){
+            childJoints.push_back(childJoint);
+        }
+    }
+    for(size_t i=0; i < childJoints.size(); ++i){
+        writeJoint(childJoints[i], sub);
+    }
+    bodies << indent << "</body>" << endl;
+}
+
+
+/**
+   The accepted primitive fits take priority over the collision shape of the
+   link as in the URDF export, and the visual meshes collide only when the link
+   has neither of them.
+*/
+void MJCFWriter::writeLink(const JointNode* joint, const LinkNode* link, const string& indent)
+{
+    MODELEDIT_TRACE_SPAN("MJCFWriter::writeLink");
+
+    const Affine3 Tinv = modelPosition(joint).inverse();
+    vector<const PrimitiveShapeNode*> collisionPrimitives;
+    for(int i=0; i < link->numChildren(); ++i){
+        const PrimitiveShapeNode* primitive = dynamic_cast<const PrimitiveShapeNode*>(link->child(i));
+        if(primitive && primitive->name == "collision"){
+            collisionPrimitives.push_back(primitive);
+        }
+    }
+    Link* l = link->link.get();
+    if(!l){
+        return;
+    }
+    const Affine3 T = link->relativePosition();
+    vector<ShapeTransform> visuals;
+    collectShapeTransforms(l->visualShape(), T, visuals);
+    vector<ShapeTransform> collisions;
+    if(collisionPrimitives.empty() && l->collisionShape() && l->collisionShape() != l->visualShape()){
+        collectShapeTransforms(l->collisionShape(), T, collisions);
+    }
+    const bool isVisualColliding = collisionPrimitives.empty() && collisions.empty();
+    for(size_t i=0; i < visuals.size(); ++i){
+        writeMeshGeom(visuals[i], true, isVisualColliding, indent);
+    }
+    for(size_t i=0; i < collisions.size(); ++i){
+        writeMeshGeom(collisions[i], false, true, indent);
+    }
+    for(size_t i=0; i < collisionPrimitives.size(); ++i){
+        writePrimitive(collisionPrimitives[i], Tinv * modelPosition(collisionPrimitives[i]), true, indent);
+    }
+}
+
+
+/**
+   The linear part of the shape transform is decomposed into the rotation of
+   the geom and the scale of the asset, so the geoms of a mesh instanced with
+   the same scale share one STL file.
+*/
+const MeshAsset* MJCFWriter::findMeshAsset(const ShapeTransform& st, Affine3& out_T)
+{
+    const SgMesh* mesh = st.shape->mesh();
+    if(!mesh || !mesh->hasVertices()){
+        return 0;
+    }
+    Vector3 scale(st.linear.col(0).norm(), st.linear.col(1).norm(), st.linear.col(2).norm());
+    if(scale.minCoeff() <= 0.0){
+        return 0;
+    }
+    Matrix3 R = st.linear * scale.cwiseInverse().asDiagonal();
+    if(R.determinant() < 0.0){
+        scale.x() = -scale.x();
+        R.col(0) = -R.col(0);
+    }
+    out_T.linear() = R;
+    out_T.translation() = st.translation;
+
+    ostringstream key;
+    key.precision(6);
+    key << Values(scale);
+    const pair<const SgMesh*, string> id(mesh, key.str());
+    map<pair<const SgMesh*, string>, int>::iterator p = meshIndices.find(id);
+    if(p != meshIndices.end()){
+        return &meshes[p->second];
+    }
+
+    const filesystem::path path(filename);
+    MeshAsset asset;
+    ostringstream name;
+    name << "mesh" << meshes.size();
+    asset.name = name.str();
+    asset.filename = path.stem().string() + "_" + asset.name + ".stl";
+    asset.scale = scale;
+    ShapeTransform local;
+    local.shape = st.shape;
+    local.linear.setIdentity();
+    local.translation.setZero();
+    const filesystem::path meshPath = path.parent_path() / asset.filename;
+    if(!writeMeshSTL(meshPath.string(), local)){
+        messages << "[MJCF] cannot write " << meshPath.string() << endl;
+        isMeshWritingFailed = true;
+    }
+    meshIndices[id] = meshes.size();
+    meshes.push_back(asset);
+    return &meshes.back();
+}
+
+
+void MJCFWriter::writeMeshGeom(const ShapeTransform& st, bool isVisual, bool isColliding, const string& indent)
+{
+    Affine3 T;
+    const MeshAsset* asset = findMeshAsset(st, T);
+    if(!asset){
+        return;
+    }
+    bodies << indent << "<geom type=\"mesh\" mesh=\"" << asset->name << "\"" << Pose(T);
+    if(!isColliding){
+        bodies << " contype=\"0\" conaffinity=\"0\" group=\"1\"";
+    } else if(!isVisual){
+        bodies << " group=\"3\"";
+    }
+    if(SgMaterial* material = st.shape->material()){
+        bodies << " rgba=\"" << Values(material->diffuseColor().cast<double>())
+               << " " << (1.0 - material->transparency()) << "\"";
+    }
+    bodies << "/>" << endl;
+}
+
+
+void MJCFWriter::writePrimitive(const PrimitiveShapeNode* primitive, const Affine3& T, bool isCollision, const string& indent)
+{
+    const string& pt = primitive->primitiveType;
+    if(pt != "Box" && pt != "Cylinder" && pt != "Sphere"){
+        messages << "[MJCF] unsupported primitive type " << pt << " of " << primitive->name << endl;
+        return;
+    }
+    Affine3 G = T;
+    bodies << indent << "<geom type=\"";
+    if(pt == "Box"){
+        bodies << "box\" size=\"" << Values(0.5 * primitive->boxSize) << "\"";
+    } else if(pt == "Sphere"){
+        bodies << "sphere\" size=\"" << primitive->primitiveRadius << "\"";
+    } else {
+        // the cylinder axis is y in Choreonoid and z in MuJoCo
+        G.linear() = T.linear() * AngleAxis(-PI / 2.0, Vector3::UnitX()).toRotationMatrix();
+        bodies << "cylinder\" size=\"" << primitive->primitiveRadius << " " << 0.5 * primitive->primitiveHeight << "\"";
+    }
+    bodies << Pose(G);
+    if(isCollision){
+        bodies << " group=\"3\"";
+    }
+    bodies << " rgba=\"" << Values(primitive->primitiveColor.cast<double>()) << " 1\"/>" << endl;
+}
+
+
+void MJCFWriter::writeSensor(const SensorNode* sensor, const Affine3& T, const string& indent)
+{
+    const string& st = sensor->sensorType;
+    const string name = escape(sensor->name);
+    if(st == "force"){
+        sensors << "    <force name=\"" << name << "_force\" site=\"" << name << "\"/>" << endl;
+        sensors << "    <torque name=\"" << name << "_torque\" site=\"" << name << "\"/>" << endl;
+    } else if(st == "gyro"){
+        sensors << "    <gyro name=\"" << name << "\" site=\"" << name << "\"/>" << endl;
+    } else if(st == "acceleration"){
+        sensors << "    <accelerometer name=\"" << name << "\" site=\"" << name << "\"/>" << endl;
+    } else if(st == "camera"){
+        // both of the cameras look along -z with y up
+        bodies << indent << "<camera name=\"" << name << "\"" << Pose(T)
+               << " fovy=\"" << degree(sensor->fieldOfView) << "\"/>" << endl;
+        return;
+    } else {
+        messages << "[MJCF] unsupported sensor type " << st << " of " << sensor->name << endl;
+        return;
+    }
+    bodies << indent << "<site name=\"" << name << "\"" << Pose(T) << "/>" << endl;
+}
+
+
+bool cnoid::writeMJCFFile(const ModelRootNode* root, const std::string& filename, std::ostream& os)
+{
+    MODELEDIT_TRACE_SPAN("writeMJCFFile");
+    MJCFWriter writer(root, filename, os);
+    return writer.write();
+}
@@ -0,0 +1,30 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MJCF_WRITER_H
+#define CNOID_EDITMODEL_PLUGIN_MJCF_WRITER_H
+
+#include "ModelNode.h"
+#include <string>
+#include <ostream>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Writes a model tree in the MJCF format of MuJoCo. Each joint node becomes a
+   body with a hinge, slide or free joint, and the rotor inertia and the gear
+   ratio become the armature of the joint and the gear of its motor.
+   The primitive nodes are written as native geoms. The meshes of the link nodes
+   are written to the STL files next to the model file once per mesh and scale,
+   and referred by the mesh assets. When a link has the collision primitives or
+   the collision shape of its own, the visual meshes do not collide.
+   The force, gyro and acceleration sensors become the sensors at their sites.
+   The messages of the unsupported nodes are put to os.
+*/
+CNOID_EXPORT bool writeMJCFFile(const ModelRootNode* root, const std::string& filename, std::ostream& os);
+
+}
+
+#endif
@@ -0,0 +1,263 @@
+/**
+   @file
+*/
+
+#include "MeshLOD.h"
+#include "MeshSimplifier.h"
+#include "ModelEditDragger.h"
+#include "Trace.h"
+#include <cnoid/SceneShape>
+#include <cnoid/GLSceneRenderer>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <map>
+#include <set>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// scenes with fewer triangles are drawn as they are
+const int minTrianglesForLOD = 20000;
+
+// meshes with fewer triangles are shared by all the levels
+const int minTrianglesToSimplify = 200;
+
+struct LevelSpec
+{
+    double ratio;
+    double minProjectedSize;
+};
+
+// the full resolution is drawn above 0.3 of the view height
+const double fullResolutionSize = 0.3;
+
+// the last one is also the proxy drawn while dragging
+const LevelSpec reducedLevels[] = {
+    { 0.25, 0.08 },
+    { 0.03, 0.0 }
+};
+const int numReducedLevels = sizeof(reducedLevels) / sizeof(reducedLevels[0]);
+
+struct LODJob
+{
+    SgNodePtr scene;
+    vector<SgMeshPtr> sources;
+    vector<SgMeshPtr> reduced[numReducedLevels];
+    boost::function<void(ModelEditLODGroup* lod)> onGenerated;
+};
+typedef boost::shared_ptr<LODJob> LODJobPtr;
+
+void collectMeshes(SgNode* node, set<SgMesh*>& visited, vector<SgMeshPtr>& meshes, int& numTriangles)
+{
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        SgMesh* mesh = shape->mesh();
+        if(mesh && visited.insert(mesh).second){
+            meshes.push_back(mesh);
+        }
+        if(mesh){
+            numTriangles += mesh->numTriangles();
+        }
+    } else if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            collectMeshes(group->child(i), visited, meshes, numTriangles);
+        }
+    }
+}
+
+/**
+   Runs in a worker thread. The source meshes are only read and the references
+   of them are not changed here.
+*/
+void simplifyMeshes(LODJob* job, ModelEditWorkerTask* task)
+{
+    MODELEDIT_TRACE_SPAN("generateMeshLOD::simplifyMeshes");
+
+    for(int level=0; level < numReducedLevels; ++level){
+        job->reduced[level].resize(job->sources.size());
+    }
+    for(size_t i=0; i < job->sources.size(); ++i){
+        if(task->isCanceled()){
+            return;
+        }
+        const SgMesh* source = job->sources[i].get();
+        const int n = source->numTriangles();
+        if(n < minTrianglesToSimplify){
+            continue;
+        }
+        for(int level=0; level < numReducedLevels; ++level){
+            job->reduced[level][i] = simplifyMesh(source, n * reducedLevels[level].ratio);
+        }
+    }
+}
+
+void runLODJob(LODJobPtr job, ModelEditWorkerTask* task)
+{
+    simplifyMeshes(job.get(), task);
+}
+
+/**
+   Copies the groups and the shapes of the scene with the meshes replaced.
+   The subtrees without the replaced meshes are shared.
+*/
+SgNode* cloneSceneWithMeshMap(SgNode* node, const map<SgMesh*, SgMesh*>& meshMap)
+{
+    if(SgShape* orgShape = dynamic_cast<SgShape*>(node)){
+        map<SgMesh*, SgMesh*>::const_iterator p = meshMap.find(orgShape->mesh());
+        if(p == meshMap.end()){
+            return node;
+        }
+        SgShape* shape = new SgShape;
+        shape->setName(orgShape->name());
+        shape->setMesh(p->second);
+        shape->setMaterial(orgShape->material());
+        return shape;
+    }
+
+    SgGroup* orgGroup = dynamic_cast<SgGroup*>(node);
+    if(!orgGroup){
+        return node;
+    }
+    vector<SgNode*> children(orgGroup->numChildren());
+    bool isChanged = false;
+    for(int i=0; i < orgGroup->numChildren(); ++i){
+        children[i] = cloneSceneWithMeshMap(orgGroup->child(i), meshMap);
+        if(children[i] != orgGroup->child(i)){
+            isChanged = true;
+        }
+    }
+    if(!isChanged){
+        return node;
+    }
+
+    SgGroup* group;
+    if(SgPosTransform* orgPos = dynamic_cast<SgPosTransform*>(node)){
+        SgPosTransform* pos = new SgPosTransform;
+        pos->setTranslation(orgPos->translation());
+        pos->setRotation(orgPos->rotation());
+        group = pos;
+    } else if(SgScaleTransform* orgScale = dynamic_cast<SgScaleTransform*>(node)){
+        SgScaleTransform* scale = new SgScaleTransform;
+        scale->setScale(orgScale->scale());
+        group = scale;
+    } else {
+        group = new SgGroup;
+    }
+    group->setName(orgGroup->name());
+    for(size_t i=0; i < children.size(); ++i){
+        group->addChild(children[i]);
+    }
+    return group;
+}
+
+void onLODJobCompleted(LODJobPtr job, bool canceled)
+{
+    if(!canceled){
+        MODELEDIT_TRACE_SPAN("generateMeshLOD::onCompleted");
+        ModelEditLODGroupPtr lod = new ModelEditLODGroup(job->scene);
+        for(int level=0; level < numReducedLevels; ++level){
+            map<SgMesh*, SgMesh*> meshMap;
+            for(size_t i=0; i < job->sources.size(); ++i){
+                if(job->reduced[level][i]){
+                    meshMap[job->sources[i].get()] = job->reduced[level][i].get();
+                }
+            }
+            lod->addLevel(cloneSceneWithMeshMap(job->scene, meshMap), reducedLevels[level].minProjectedSize);
+        }
+        job->onGenerated(lod);
+    }
+    // the scene objects are released in the GUI thread
+    job->scene = 0;
+    job->sources.clear();
+    for(int level=0; level < numReducedLevels; ++level){
+        job->reduced[level].clear();
+    }
+}
+
+}
+
+
+ModelEditLODGroup::ModelEditLODGroup(SgNode* fullShape)
+{
+    addChild(fullShape);
+    levels.push_back(fullShape);
+    minProjectedSizes.push_back(fullResolutionSize);
+}
+
+
+void ModelEditLODGroup::addLevel(SgNode* node, double minProjectedSize)
+{
+    levels.push_back(node);
+    minProjectedSizes.push_back(minProjectedSize);
+}
+
+
+/**
+   Only the renderer sees the reduced levels. The other visitors such as the
+   bounding box calculation see the full resolution child.
+*/
+void ModelEditLODGroup::accept(SceneVisitor& visitor)
+{
+    GLSceneRenderer* renderer = dynamic_cast<GLSceneRenderer*>(&visitor);
+    if(!renderer || levels.size() < 2){
+        SgGroup::accept(visitor);
+        return;
+    }
+
+    int selected = levels.size() - 1;
+    if(!ModelEditDragger::isAnyDragged()){
+        const BoundingBox& bb = boundingBox();
+        if(!bb.empty()){
+            const Vector3 center = renderer->currentModelTransform() * bb.center();
+            const Vector3 local = renderer->currentCameraPosition().inverse() * center;
+            const double radius = (bb.max() - bb.min()).norm() / 2.0;
+            const Matrix4& P = renderer->projectionMatrix();
+            double size;
+            if(P(3, 3) == 1.0){
+                // orthographic
+                size = radius * P(1, 1);
+            } else {
+                const double depth = std::max(-local.z(), 1.0e-6);
+                size = radius * P(1, 1) / depth;
+            }
+            for(size_t i=0; i < levels.size() - 1; ++i){
+                if(size >= minProjectedSizes[i]){
+                    selected = i;
+                    break;
+                }
+            }
+        } else {
+            selected = 0;
+        }
+    }
+    if(selected == 0){
+        SgGroup::accept(visitor);
+    } else {
+        levels[selected]->accept(visitor);
+    }
+}
+
+
+ModelEditWorkerTaskPtr cnoid::generateMeshLOD
+(SgNode* scene, const boost::function<void(ModelEditLODGroup* lod)>& onGenerated)
+{
+    if(!scene){
+        return ModelEditWorkerTaskPtr();
+    }
+    LODJobPtr job = boost::make_shared<LODJob>();
+    set<SgMesh*> visited;
+    int numTriangles = 0;
+    collectMeshes(scene, visited, job->sources, numTriangles);
+    if(numTriangles < minTrianglesForLOD){
+        return ModelEditWorkerTaskPtr();
+    }
+    MODELEDIT_TRACE_COUNTER("Triangles of LOD source", numTriangles);
+    job->scene = scene;
+    job->onGenerated = onGenerated;
+
+    return ModelEditWorkerPool::instance()->submit(
+        boost::bind(runLODJob, job, _1),
+        boost::bind(onLODJobCompleted, job, _1),
+        ModelEditWorkerPool::LOW_PRIORITY);
+}
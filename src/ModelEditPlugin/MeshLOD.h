@@ -0,0 +1,57 @@
+/**
+   \file
+   Levels of detail of the link shapes for the interactive display.
+   The levels are used only in the scene views and never exported.
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MESH_LOD_H
+#define CNOID_EDITMODEL_PLUGIN_MESH_LOD_H
+
+#include <cnoid/SceneGraph>
+#include <boost/function.hpp>
+#include <vector>
+#include "WorkerPool.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Group which has the full resolution shape as its child and draws one of the
+   levels by the size of its bounding sphere projected to the view.
+   The coarsest level is drawn while a dragger of the plugin is being dragged.
+*/
+class CNOID_EXPORT ModelEditLODGroup : public SgGroup
+{
+public:
+    ModelEditLODGroup(SgNode* fullShape);
+
+    /**
+       Adds the next coarser level, which is drawn when the projected size
+       is smaller than the minimum size of the previous level.
+       The size is the ratio of the diameter to the height of the view.
+    */
+    void addLevel(SgNode* node, double minProjectedSize);
+
+    int numLevels() const { return levels.size(); }
+    SgNode* level(int index) const { return levels[index]; }
+
+    virtual void accept(SceneVisitor& visitor);
+
+private:
+    std::vector<SgNodePtr> levels;
+    std::vector<double> minProjectedSizes;
+};
+typedef ref_ptr<ModelEditLODGroup> ModelEditLODGroupPtr;
+
+/**
+   Simplifies the meshes of the scene in a worker thread and calls onGenerated
+   with the LOD group in the GUI thread. The scene must not be modified until
+   the task is completed. A null task is returned and nothing is called when
+   the scene is small enough to be drawn as it is.
+*/
+CNOID_EXPORT ModelEditWorkerTaskPtr generateMeshLOD(
+    SgNode* scene, const boost::function<void(ModelEditLODGroup* lod)>& onGenerated);
+
+}
+
+#endif
@@ -0,0 +1,456 @@
+/**
+   @file
+*/
+
+#include "MeshSimplifier.h"
+#include "Trace.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/**
+   Symmetric 4x4 matrix of the squared distance to a set of planes,
+   stored as the upper triangle.
+*/
+struct Quadric
+{
+    double m[10];
+
+    Quadric() {
+        std::fill(m, m + 10, 0.0);
+    }
+
+    Quadric(double a, double b, double c, double d) {
+        m[0] = a * a; m[1] = a * b; m[2] = a * c; m[3] = a * d;
+        m[4] = b * b; m[5] = b * c; m[6] = b * d;
+        m[7] = c * c; m[8] = c * d;
+        m[9] = d * d;
+    }
+
+    Quadric operator+(const Quadric& q) const {
+        Quadric r;
+        for(int i=0; i < 10; ++i){
+            r.m[i] = m[i] + q.m[i];
+        }
+        return r;
+    }
+
+    Quadric& operator+=(const Quadric& q) {
+        for(int i=0; i < 10; ++i){
+            m[i] += q.m[i];
+        }
+        return *this;
+    }
+
+    double det(int a11, int a12, int a13, int a21, int a22, int a23, int a31, int a32, int a33) const {
+        return m[a11] * m[a22] * m[a33] + m[a13] * m[a21] * m[a32] + m[a12] * m[a23] * m[a31]
+            - m[a13] * m[a22] * m[a31] - m[a11] * m[a23] * m[a32] - m[a12] * m[a21] * m[a33];
+    }
+
+    double error(const Vector3& p) const {
+        const double x = p.x(), y = p.y(), z = p.z();
+        return m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+            + m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+            + m[7] * z * z + 2.0 * m[8] * z + m[9];
+    }
+};
+
+struct Triangle
+{
+    int v[3];
+    double error[4];
+    bool isDeleted;
+    bool isDirty;
+    Vector3 normal;
+};
+
+struct Vertex
+{
+    Vector3 p;
+    int refStart;
+    int numRefs;
+    Quadric q;
+    bool isBorder;
+};
+
+// a triangle and the corner of the vertex in it
+struct Ref
+{
+    int triangle;
+    int corner;
+};
+
+/**
+   The edge collapse which visits the triangles in the order of the array and
+   collapses the edges whose errors are under a threshold growing with the
+   iterations instead of keeping a priority queue of the edges.
+*/
+class Simplifier
+{
+public:
+    vector<Vertex> vertices;
+    vector<Triangle> triangles;
+    vector<Ref> refs;
+
+    Simplifier(const SgMesh* mesh);
+    void simplify(int numTriangles);
+    SgMesh* createMesh() const;
+
+private:
+    double calcError(int v1, int v2, Vector3& p) const;
+    bool isFlipped(const Vector3& p, int i1, const Vertex& v0, vector<char>& deleted) const;
+    void updateTriangles(int i0, const Vertex& v, const vector<char>& deleted, int& numDeleted);
+    void updateMesh(int iteration);
+};
+
+}
+
+
+Simplifier::Simplifier(const SgMesh* mesh)
+{
+    const SgVertexArray& orgVertices = *mesh->vertices();
+    vertices.resize(orgVertices.size());
+    for(size_t i=0; i < orgVertices.size(); ++i){
+        vertices[i].p = orgVertices[i].cast<double>();
+        vertices[i].isBorder = false;
+    }
+    const SgIndexArray& indices = mesh->triangleVertices();
+    const int n = indices.size() / 3;
+    triangles.reserve(n);
+    for(int i=0; i < n; ++i){
+        Triangle t;
+        for(int j=0; j < 3; ++j){
+            t.v[j] = indices[i * 3 + j];
+        }
+        if(t.v[0] == t.v[1] || t.v[1] == t.v[2] || t.v[2] == t.v[0]){
+            continue;
+        }
+        t.isDeleted = false;
+        t.isDirty = false;
+        triangles.push_back(t);
+    }
+}
+
+
+double Simplifier::calcError(int id1, int id2, Vector3& p) const
+{
+    const Vertex& v1 = vertices[id1];
+    const Vertex& v2 = vertices[id2];
+    Quadric q = v1.q + v2.q;
+    const bool isBorder = v1.isBorder && v2.isBorder;
+    const double det = q.det(0, 1, 2, 1, 4, 5, 2, 5, 7);
+
+    if(det != 0.0 && !isBorder){
+        // the position which minimizes the error
+        p.x() = -1.0 / det * q.det(1, 2, 3, 4, 5, 6, 5, 7, 8);
+        p.y() =  1.0 / det * q.det(0, 2, 3, 1, 5, 6, 2, 7, 8);
+        p.z() = -1.0 / det * q.det(0, 1, 3, 1, 4, 6, 2, 5, 8);
+        return q.error(p);
+    }
+
+    const Vector3 p3 = (v1.p + v2.p) / 2.0;
+    const double error1 = q.error(v1.p);
+    const double error2 = q.error(v2.p);
+    const double error3 = q.error(p3);
+    const double error = std::min(error1, std::min(error2, error3));
+    if(error == error1){
+        p = v1.p;
+    } else if(error == error2){
+        p = v2.p;
+    } else {
+        p = p3;
+    }
+    return error;
+}
+
+
+/**
+   Checks whether moving v0 to p flips one of its triangles. The triangles which
+   have the collapsed edge are marked to be deleted.
+*/
+bool Simplifier::isFlipped(const Vector3& p, int i1, const Vertex& v0, vector<char>& deleted) const
+{
+    for(int k=0; k < v0.numRefs; ++k){
+        const Ref& r = refs[v0.refStart + k];
+        const Triangle& t = triangles[r.triangle];
+        if(t.isDeleted){
+            continue;
+        }
+        const int id1 = t.v[(r.corner + 1) % 3];
+        const int id2 = t.v[(r.corner + 2) % 3];
+        if(id1 == i1 || id2 == i1){
+            deleted[k] = 1;
+            continue;
+        }
+        Vector3 d1 = vertices[id1].p - p;
+        Vector3 d2 = vertices[id2].p - p;
+        const double n1 = d1.norm();
+        const double n2 = d2.norm();
+        if(n1 == 0.0 || n2 == 0.0){
+            return true;
+        }
+        d1 /= n1;
+        d2 /= n2;
+        if(fabs(d1.dot(d2)) > 0.999){
+            return true;
+        }
+        deleted[k] = 0;
+        if(d1.cross(d2).normalized().dot(t.normal) < 0.2){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void Simplifier::updateTriangles(int i0, const Vertex& v, const vector<char>& deleted, int& numDeleted)
+{
+    Vector3 p;
+    for(int k=0; k < v.numRefs; ++k){
+        // copied because refs grows in this loop
+        const Ref r = refs[v.refStart + k];
+        Triangle& t = triangles[r.triangle];
+        if(t.isDeleted){
+            continue;
+        }
+        if(deleted[k]){
+            t.isDeleted = true;
+            ++numDeleted;
+            continue;
+        }
+        t.v[r.corner] = i0;
+        t.isDirty = true;
+        t.error[0] = calcError(t.v[0], t.v[1], p);
+        t.error[1] = calcError(t.v[1], t.v[2], p);
+        t.error[2] = calcError(t.v[2], t.v[0], p);
+        t.error[3] = std::min(t.error[0], std::min(t.error[1], t.error[2]));
+        refs.push_back(r);
+    }
+}
+
+
+void Simplifier::updateMesh(int iteration)
+{
+    if(iteration > 0){
+        size_t n = 0;
+        for(size_t i=0; i < triangles.size(); ++i){
+            if(!triangles[i].isDeleted){
+                triangles[n++] = triangles[i];
+            }
+        }
+        triangles.resize(n);
+    }
+
+    if(iteration == 0){
+        for(size_t i=0; i < triangles.size(); ++i){
+            Triangle& t = triangles[i];
+            const Vector3& p0 = vertices[t.v[0]].p;
+            Vector3 n = (vertices[t.v[1]].p - p0).cross(vertices[t.v[2]].p - p0);
+            const double norm = n.norm();
+            if(norm > 0.0){
+                n /= norm;
+            }
+            t.normal = n;
+            const Quadric q(n.x(), n.y(), n.z(), -n.dot(p0));
+            for(int j=0; j < 3; ++j){
+                vertices[t.v[j]].q += q;
+            }
+        }
+        Vector3 p;
+        for(size_t i=0; i < triangles.size(); ++i){
+            Triangle& t = triangles[i];
+            for(int j=0; j < 3; ++j){
+                t.error[j] = calcError(t.v[j], t.v[(j + 1) % 3], p);
+            }
+            t.error[3] = std::min(t.error[0], std::min(t.error[1], t.error[2]));
+        }
+    }
+
+    for(size_t i=0; i < vertices.size(); ++i){
+        vertices[i].refStart = 0;
+        vertices[i].numRefs = 0;
+    }
+    for(size_t i=0; i < triangles.size(); ++i){
+        for(int j=0; j < 3; ++j){
+            vertices[triangles[i].v[j]].numRefs++;
+        }
+    }
+    int start = 0;
+    for(size_t i=0; i < vertices.size(); ++i){
+        vertices[i].refStart = start;
+        start += vertices[i].numRefs;
+        vertices[i].numRefs = 0;
+    }
+    refs.resize(triangles.size() * 3);
+    for(size_t i=0; i < triangles.size(); ++i){
+        for(int j=0; j < 3; ++j){
+            Vertex& v = vertices[triangles[i].v[j]];
+            Ref& r = refs[v.refStart + v.numRefs++];
+            r.triangle = i;
+            r.corner = j;
+        }
+    }
+
+    if(iteration == 0){
+        // the vertices of the edges which have only one triangle are on the border
+        vector<int> counts;
+        vector<int> ids;
+        for(size_t i=0; i < vertices.size(); ++i){
+            const Vertex& v = vertices[i];
+            counts.clear();
+            ids.clear();
+            for(int k=0; k < v.numRefs; ++k){
+                const Triangle& t = triangles[refs[v.refStart + k].triangle];
+                for(int j=0; j < 3; ++j){
+                    const int id = t.v[j];
+                    size_t m = 0;
+                    while(m < ids.size() && ids[m] != id){
+                        ++m;
+                    }
+                    if(m == ids.size()){
+                        ids.push_back(id);
+                        counts.push_back(1);
+                    } else {
+                        counts[m]++;
+                    }
+                }
+            }
+            for(size_t m=0; m < ids.size(); ++m){
+                if(counts[m] == 1){
+                    vertices[ids[m]].isBorder = true;
+                }
+            }
+        }
+    }
+}
+
+
+void Simplifier::simplify(int numTriangles)
+{
+    int numDeleted = 0;
+    const int numOrgTriangles = triangles.size();
+    vector<char> deleted0;
+    vector<char> deleted1;
+
+    for(int iteration=0; iteration < 100; ++iteration){
+        if(numOrgTriangles - numDeleted <= numTriangles){
+            break;
+        }
+        if(iteration % 5 == 0){
+            updateMesh(iteration);
+        }
+        for(size_t i=0; i < triangles.size(); ++i){
+            triangles[i].isDirty = false;
+        }
+        const double threshold = 1.0e-9 * pow(iteration + 3.0, 7.0);
+
+        for(size_t i=0; i < triangles.size(); ++i){
+            Triangle& t = triangles[i];
+            if(t.error[3] > threshold || t.isDeleted || t.isDirty){
+                continue;
+            }
+            for(int j=0; j < 3; ++j){
+                if(t.error[j] >= threshold){
+                    continue;
+                }
+                const int i0 = t.v[j];
+                const int i1 = t.v[(j + 1) % 3];
+                Vertex& v0 = vertices[i0];
+                const Vertex& v1 = vertices[i1];
+                if(v0.isBorder != v1.isBorder){
+                    continue;
+                }
+                Vector3 p;
+                calcError(i0, i1, p);
+                deleted0.resize(v0.numRefs);
+                deleted1.resize(v1.numRefs);
+                if(isFlipped(p, i1, v0, deleted0) || isFlipped(p, i0, v1, deleted1)){
+                    continue;
+                }
+
+                v0.p = p;
+                v0.q += v1.q;
+                const int refStart = refs.size();
+                updateTriangles(i0, v0, deleted0, numDeleted);
+                updateTriangles(i0, v1, deleted1, numDeleted);
+                const int numRefs = refs.size() - refStart;
+                if(numRefs <= v0.numRefs){
+                    // reuse the old range of the references
+                    if(numRefs > 0){
+                        std::copy(refs.begin() + refStart, refs.end(), refs.begin() + v0.refStart);
+                    }
+                } else {
+                    v0.refStart = refStart;
+                }
+                v0.numRefs = numRefs;
+                break;
+            }
+            if(numOrgTriangles - numDeleted <= numTriangles){
+                break;
+            }
+        }
+    }
+}
+
+
+SgMesh* Simplifier::createMesh() const
+{
+    vector<int> newIndices(vertices.size(), -1);
+    SgMesh* mesh = new SgMesh;
+    SgVertexArray* newVertices = new SgVertexArray;
+    SgIndexArray& indices = mesh->triangleVertices();
+
+    for(size_t i=0; i < triangles.size(); ++i){
+        const Triangle& t = triangles[i];
+        if(t.isDeleted){
+            continue;
+        }
+        for(int j=0; j < 3; ++j){
+            int& index = newIndices[t.v[j]];
+            if(index < 0){
+                index = newVertices->size();
+                newVertices->push_back(vertices[t.v[j]].p.cast<float>());
+            }
+            indices.push_back(index);
+        }
+    }
+    mesh->setVertices(newVertices);
+
+    SgNormalArray* normals = new SgNormalArray(newVertices->size(), Vector3f::Zero());
+    for(size_t i=0; i + 2 < indices.size(); i += 3){
+        const Vector3f& p0 = (*newVertices)[indices[i]];
+        // weighted by the area
+        const Vector3f n = ((*newVertices)[indices[i + 1]] - p0).cross((*newVertices)[indices[i + 2]] - p0);
+        for(int j=0; j < 3; ++j){
+            (*normals)[indices[i + j]] += n;
+        }
+    }
+    for(size_t i=0; i < normals->size(); ++i){
+        Vector3f& n = (*normals)[i];
+        const float norm = n.norm();
+        if(norm > 1.0e-12f){
+            n /= norm;
+        }
+    }
+    mesh->setNormals(normals);
+    mesh->updateBoundingBox();
+    return mesh;
+}
+
+
+SgMesh* cnoid::simplifyMesh(const SgMesh* mesh, int numTriangles)
+{
+    MODELEDIT_TRACE_SPAN("simplifyMesh");
+
+    if(!mesh->hasVertices()){
+        return new SgMesh;
+    }
+    Simplifier simplifier(mesh);
+    simplifier.simplify(std::max(numTriangles, 1));
+    return simplifier.createMesh();
+}
@@ -0,0 +1,26 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MESH_SIMPLIFIER_H
+#define CNOID_EDITMODEL_PLUGIN_MESH_SIMPLIFIER_H
+
+#include <cnoid/SceneShape>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Reduces a triangle mesh to about numTriangles triangles by the quadric error
+   edge collapse. The result has the vertices, the triangles and the normals
+   averaged over the adjacent triangles. The colors and the texture coordinates
+   are not kept because the result is used only for the display.
+
+   The original mesh is only read, so this can be called in a worker thread as
+   long as the mesh is not modified at the same time.
+*/
+CNOID_EXPORT SgMesh* simplifyMesh(const SgMesh* mesh, int numTriangles);
+
+}
+
+#endif
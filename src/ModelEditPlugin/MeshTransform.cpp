@@ -0,0 +1,327 @@
+/**
+   @file
+*/
+
+#include "MeshTransform.h"
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <fstream>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const bool TRACE_FUNCTIONS = false;
+
+typedef Eigen::Map<Eigen::Matrix<float, 3, Eigen::Dynamic> > VectorArrayMap;
+typedef Eigen::Map<Eigen::Matrix<int, 3, Eigen::Dynamic> > TriangleIndexMap;
+
+void collectSceneTrianglesSub
+(SgNode* node, const Affine3& T, vector<Vector3>& vertices, vector<Eigen::Vector3i>& triangles)
+{
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        const SgMesh* mesh = shape->mesh();
+        if(!mesh || !mesh->hasVertices()){
+            return;
+        }
+        const SgVertexArray& orgVertices = *mesh->vertices();
+        const int offset = vertices.size();
+        for(size_t i=0; i < orgVertices.size(); ++i){
+            vertices.push_back(T * orgVertices[i].cast<double>());
+        }
+        const SgIndexArray& indices = mesh->triangleVertices();
+        for(size_t i=0; i + 2 < indices.size(); i += 3){
+            triangles.push_back(
+                Eigen::Vector3i(indices[i] + offset, indices[i + 1] + offset, indices[i + 2] + offset));
+        }
+        return;
+    }
+
+    SgGroup* group = dynamic_cast<SgGroup*>(node);
+    if(!group){
+        return;
+    }
+    Affine3 T2 = T;
+    if(SgPosTransform* pos = dynamic_cast<SgPosTransform*>(node)){
+        Affine3 P;
+        P.translation() = pos->translation();
+        P.linear() = pos->rotation();
+        T2 = T * P;
+    } else if(SgScaleTransform* scale = dynamic_cast<SgScaleTransform*>(node)){
+        Affine3 S = Affine3::Identity();
+        S.linear() = scale->scale().asDiagonal();
+        T2 = T * S;
+    }
+    for(int i=0; i < group->numChildren(); ++i){
+        collectSceneTrianglesSub(group->child(i), T2, vertices, triangles);
+    }
+}
+
+void collectShapeTransformsSub(SgNode* node, const Affine3& T, vector<ShapeTransform>& out_shapes)
+{
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        if(shape->mesh()){
+            ShapeTransform st;
+            st.shape = shape;
+            st.linear = T.linear();
+            st.translation = T.translation();
+            out_shapes.push_back(st);
+        }
+        return;
+    }
+
+    SgGroup* group = dynamic_cast<SgGroup*>(node);
+    if(!group){
+        return;
+    }
+    Affine3 T2 = T;
+    if(SgPosTransform* pos = dynamic_cast<SgPosTransform*>(node)){
+        Affine3 P;
+        P.translation() = pos->translation();
+        P.linear() = pos->rotation();
+        T2 = T * P;
+    } else if(SgScaleTransform* scale = dynamic_cast<SgScaleTransform*>(node)){
+        Affine3 S = Affine3::Identity();
+        S.linear() = scale->scale().asDiagonal();
+        T2 = T * S;
+    }
+    for(int i=0; i < group->numChildren(); ++i){
+        collectShapeTransformsSub(group->child(i), T2, out_shapes);
+    }
+}
+
+void reverseWinding(SgIndexArray& indices)
+{
+    if(indices.empty() || indices.size() % 3 != 0){
+        return;
+    }
+    TriangleIndexMap m(&indices[0], 3, indices.size() / 3);
+    m.row(1).swap(m.row(2));
+}
+
+}
+
+
+SgMesh* cnoid::cloneMesh(SgMesh* org)
+{
+    SgMesh* mesh = new SgMesh;
+    mesh->setName(org->name());
+    if(org->hasVertices()){
+        mesh->setVertices(new SgVertexArray(*org->vertices()));
+    }
+    if(org->hasNormals()){
+        mesh->setNormals(new SgNormalArray(*org->normals()));
+        mesh->normalIndices() = org->normalIndices();
+    }
+    if(org->hasColors()){
+        mesh->setColors(new SgColorArray(*org->colors()));
+        mesh->colorIndices() = org->colorIndices();
+    }
+    if(org->hasTexCoords()){
+        mesh->setTexCoords(new SgTexCoordArray(*org->texCoords()));
+        mesh->texCoordIndices() = org->texCoordIndices();
+    }
+    mesh->triangleVertices() = org->triangleVertices();
+    mesh->setSolid(org->isSolid());
+    mesh->updateBoundingBox();
+    return mesh;
+}
+
+
+SgNode* cnoid::cloneSceneWithMeshes(SgNode* node)
+{
+    if(!node){
+        return 0;
+    }
+
+    if(SgShape* orgShape = dynamic_cast<SgShape*>(node)){
+        SgShape* shape = new SgShape;
+        shape->setName(orgShape->name());
+        if(orgShape->mesh()){
+            shape->setMesh(cloneMesh(orgShape->mesh()));
+        }
+        shape->setMaterial(orgShape->material());
+        shape->setTexture(orgShape->texture());
+        return shape;
+    }
+
+    SgGroup* orgGroup = dynamic_cast<SgGroup*>(node);
+    if(!orgGroup){
+        // unknown leaf nodes are shared
+        return node;
+    }
+
+    SgGroup* group;
+    if(SgPosTransform* orgPos = dynamic_cast<SgPosTransform*>(node)){
+        SgPosTransform* pos = new SgPosTransform;
+        pos->setTranslation(orgPos->translation());
+        pos->setRotation(orgPos->rotation());
+        group = pos;
+    } else if(SgScaleTransform* orgScale = dynamic_cast<SgScaleTransform*>(node)){
+        SgScaleTransform* scale = new SgScaleTransform;
+        scale->setScale(orgScale->scale());
+        group = scale;
+    } else {
+        group = new SgGroup;
+    }
+    group->setName(orgGroup->name());
+    for(int i=0; i < orgGroup->numChildren(); ++i){
+        group->addChild(cloneSceneWithMeshes(orgGroup->child(i)));
+    }
+    return group;
+}
+
+
+void cnoid::transformMesh(SgMesh* mesh, const Matrix3f& M, const Vector3f& t)
+{
+    if(mesh->hasVertices() && !mesh->vertices()->empty()){
+        SgVertexArray& vertices = *mesh->vertices();
+        VectorArrayMap V(vertices[0].data(), 3, vertices.size());
+        V = (M * V).colwise() + t;
+        vertices.notifyUpdate();
+    }
+
+    if(mesh->hasNormals() && !mesh->normals()->empty()){
+        SgNormalArray& normals = *mesh->normals();
+        VectorArrayMap N(normals[0].data(), 3, normals.size());
+        const Matrix3f MinvT = M.inverse().transpose();
+        N = MinvT * N;
+        for(int i=0; i < N.cols(); ++i){
+            const float norm = N.col(i).norm();
+            if(norm > 1.0e-12f){
+                N.col(i) /= norm;
+            }
+        }
+        normals.notifyUpdate();
+    }
+
+    if(M.determinant() < 0.0f){
+        reverseWinding(mesh->triangleVertices());
+        if(mesh->normalIndices().size() == mesh->triangleVertices().size()){
+            reverseWinding(mesh->normalIndices());
+        }
+        if(mesh->colorIndices().size() == mesh->triangleVertices().size()){
+            reverseWinding(mesh->colorIndices());
+        }
+        if(mesh->texCoordIndices().size() == mesh->triangleVertices().size()){
+            reverseWinding(mesh->texCoordIndices());
+        }
+    }
+
+    mesh->updateBoundingBox();
+}
+
+
+void cnoid::mirrorScene(SgNode* node, const Matrix3& S)
+{
+    if(!node){
+        return;
+    }
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        if(shape->mesh()){
+            transformMesh(shape->mesh(), S.cast<float>(), Vector3f::Zero());
+        }
+        return;
+    }
+    if(SgPosTransform* pos = dynamic_cast<SgPosTransform*>(node)){
+        Matrix3 R = S * pos->rotation() * S;
+        pos->setTranslation(Vector3(S * pos->translation()));
+        pos->setRotation(R);
+    }
+    if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            mirrorScene(group->child(i), S);
+        }
+    }
+    node->notifyUpdate();
+}
+
+
+void cnoid::collectSceneTriangles
+(SgNode* node, std::vector<Vector3>& out_vertices, std::vector<Eigen::Vector3i>& out_triangles)
+{
+    if(node){
+        collectSceneTrianglesSub(node, Affine3::Identity(), out_vertices, out_triangles);
+    }
+}
+
+
+void cnoid::collectShapeTransforms(SgNode* node, const Affine3& T, std::vector<ShapeTransform>& out_shapes)
+{
+    if(node){
+        collectShapeTransformsSub(node, T, out_shapes);
+    }
+}
+
+
+SgMesh* cnoid::bakeShapeMesh(const ShapeTransform& st)
+{
+    SgMesh* mesh = cloneMesh(st.shape->mesh());
+    transformMesh(mesh, st.linear.cast<float>(), st.translation.cast<float>());
+    return mesh;
+}
+
+
+SgShape* cnoid::createBakedShape(const ShapeTransform& st, SgMesh* mesh)
+{
+    SgShape* shape = new SgShape;
+    shape->setName(st.shape->name());
+    shape->setMesh(mesh);
+    shape->setMaterial(st.shape->material());
+    shape->setTexture(st.shape->texture());
+    return shape;
+}
+
+
+SgGroup* cnoid::bakeSceneTransforms(SgNode* node, const Affine3& T)
+{
+    vector<ShapeTransform> shapes;
+    collectShapeTransforms(node, T, shapes);
+    SgGroup* group = new SgGroup;
+    for(size_t i=0; i < shapes.size(); ++i){
+        group->addChild(createBakedShape(shapes[i], bakeShapeMesh(shapes[i])));
+    }
+    return group;
+}
+
+
+// little endian binary STL
+bool cnoid::writeMeshSTL(const std::string& filename, const ShapeTransform& st)
+{
+    std::ofstream of(filename.c_str(), std::ios::out | std::ios::binary);
+    char header[80];
+    std::fill(header, header + 80, 0);
+    const char title[] = "Choreonoid model edit plugin";
+    std::copy(title, title + sizeof(title) - 1, header);
+    of.write(header, 80);
+
+    const SgMesh* mesh = st.shape->mesh();
+    boost::uint32_t numTriangles = 0;
+    if(mesh && mesh->hasVertices()){
+        numTriangles = mesh->triangleVertices().size() / 3;
+    }
+    of.write(reinterpret_cast<const char*>(&numTriangles), 4);
+    if(numTriangles == 0){
+        return of.good();
+    }
+    const SgVertexArray& vertices = *mesh->vertices();
+    const SgIndexArray& indices = mesh->triangleVertices();
+    for(size_t i=0; i < numTriangles; ++i){
+        Vector3f p[3];
+        for(int j=0; j < 3; ++j){
+            p[j] = (st.linear * vertices[indices[i * 3 + j]].cast<double>() + st.translation).cast<float>();
+        }
+        Vector3f n = (p[1] - p[0]).cross(p[2] - p[0]);
+        if(n.norm() > 0.0f){
+            n.normalize();
+        }
+        of.write(reinterpret_cast<const char*>(n.data()), 12);
+        for(int j=0; j < 3; ++j){
+            of.write(reinterpret_cast<const char*>(p[j].data()), 12);
+        }
+        const boost::uint16_t attributes = 0;
+        of.write(reinterpret_cast<const char*>(&attributes), 2);
+    }
+    return of.good();
+}
@@ -0,0 +1,82 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MESH_TRANSFORM_H
+#define CNOID_EDITMODEL_PLUGIN_MESH_TRANSFORM_H
+
+#include <cnoid/SceneGraph>
+#include <cnoid/SceneShape>
+#include <cnoid/EigenTypes>
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Deep copy of a scene subtree. Group nodes and meshes are duplicated so that the
+   result can be modified without affecting the original scene. Materials and
+   textures are shared.
+*/
+CNOID_EXPORT SgNode* cloneSceneWithMeshes(SgNode* node);
+
+CNOID_EXPORT SgMesh* cloneMesh(SgMesh* mesh);
+
+/**
+   Applies v' = M * v + t to all the vertices of the mesh at once.
+   Normals are transformed by the inverse transpose of M and the triangle
+   winding order is reversed when M flips the handedness.
+*/
+CNOID_EXPORT void transformMesh(SgMesh* mesh, const Matrix3f& M, const Vector3f& t);
+
+/**
+   Reflects a scene subtree by the reflection matrix S (S * S = I).
+   Transform nodes are conjugated (R' = S R S, p' = S p) and the mesh vertices
+   are reflected in place, so the subtree keeps its structure.
+*/
+CNOID_EXPORT void mirrorScene(SgNode* node, const Matrix3& S);
+
+/**
+   Collects the triangles of the shapes in a scene subtree with the vertices
+   transformed to the coordinate of the subtree root. The scene is only read,
+   so this can be called in a worker thread.
+*/
+CNOID_EXPORT void collectSceneTriangles(
+    SgNode* node, std::vector<Vector3>& out_vertices, std::vector<Eigen::Vector3i>& out_triangles);
+
+/// Shape in a scene subtree with its transform from the subtree root
+class ShapeTransform
+{
+public:
+    SgShapePtr shape;
+    Matrix3 linear;
+    Vector3 translation;
+};
+
+CNOID_EXPORT void collectShapeTransforms(
+    SgNode* node, const Affine3& T, std::vector<ShapeTransform>& out_shapes);
+
+/**
+   Copy of the mesh of the shape with the transform applied to its vertices.
+   The original mesh is only read and no reference count of the scene is
+   changed, so this can be called in a worker thread.
+*/
+CNOID_EXPORT SgMesh* bakeShapeMesh(const ShapeTransform& st);
+
+/// Shape with the baked mesh and the material and the texture of the original shape
+CNOID_EXPORT SgShape* createBakedShape(const ShapeTransform& st, SgMesh* mesh);
+
+/// Writes the mesh of the shape transformed by its transform as a binary STL file
+CNOID_EXPORT bool writeMeshSTL(const std::string& filename, const ShapeTransform& st);
+
+/**
+   Copies the shapes of a scene subtree into a flat group. The transforms of the
+   subtree and T are baked into the vertices of the copied meshes, so a mesh
+   shared by several shapes gets a copy for each of them.
+*/
+CNOID_EXPORT SgGroup* bakeSceneTransforms(SgNode* node, const Affine3& T);
+
+}
+
+#endif
@@ -0,0 +1,346 @@
+/**
+   @file
+*/
+
+#include "ModelAssetCache.h"
+#include "Trace.h"
+#include <cnoid/SceneShape>
+#include <cnoid/Image>
+#include <boost/thread/mutex.hpp>
+#include <boost/cstdint.hpp>
+#include <map>
+#include <set>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/// 64-bit FNV-1a hash
+class ContentHash
+{
+public:
+    ContentHash() : value(14695981039346656037ULL) { }
+    void add(const void* data, size_t size) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for(size_t i=0; i < size; ++i){
+            value ^= p[i];
+            value *= 1099511628211ULL;
+        }
+    }
+    template<class Array> void addArray(const Array& a) {
+        size_t n = a.size();
+        add(&n, sizeof(n));
+        if(n > 0){
+            add(&a[0], n * sizeof(a[0]));
+        }
+    }
+    boost::uint64_t value;
+};
+
+
+template<class Array>
+bool equalArrays(const Array& a, const Array& b)
+{
+    return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(a[0])) == 0);
+}
+
+
+template<class Array>
+bool equalArrayPtrs(const Array* a, const Array* b)
+{
+    if(!a || !b){
+        return (!a || a->empty()) && (!b || b->empty());
+    }
+    return equalArrays(*a, *b);
+}
+
+
+boost::uint64_t hashMesh(SgMesh* mesh)
+{
+    ContentHash hash;
+    if(mesh->hasVertices()){
+        hash.addArray(*mesh->vertices());
+    }
+    if(mesh->hasNormals()){
+        hash.addArray(*mesh->normals());
+    }
+    if(mesh->hasColors()){
+        hash.addArray(*mesh->colors());
+    }
+    if(mesh->hasTexCoords()){
+        hash.addArray(*mesh->texCoords());
+    }
+    hash.addArray(mesh->triangleVertices());
+    hash.addArray(mesh->normalIndices());
+    hash.addArray(mesh->colorIndices());
+    hash.addArray(mesh->texCoordIndices());
+    return hash.value;
+}
+
+
+bool equalMeshes(SgMesh* a, SgMesh* b)
+{
+    return equalArrayPtrs(a->vertices(), b->vertices()) &&
+        equalArrayPtrs(a->normals(), b->normals()) &&
+        equalArrayPtrs(a->colors(), b->colors()) &&
+        equalArrayPtrs(a->texCoords(), b->texCoords()) &&
+        equalArrays(a->triangleVertices(), b->triangleVertices()) &&
+        equalArrays(a->normalIndices(), b->normalIndices()) &&
+        equalArrays(a->colorIndices(), b->colorIndices()) &&
+        equalArrays(a->texCoordIndices(), b->texCoordIndices());
+}
+
+
+size_t imageSize(const Image& image)
+{
+    return image.width() * image.height() * image.numComponents();
+}
+
+
+boost::uint64_t hashImage(SgImage* image)
+{
+    const Image& img = image->constImage();
+    ContentHash hash;
+    int header[3] = { img.width(), img.height(), img.numComponents() };
+    hash.add(header, sizeof(header));
+    if(!img.empty()){
+        hash.add(img.pixels(), imageSize(img));
+    }
+    return hash.value;
+}
+
+
+bool equalImages(SgImage* a, SgImage* b)
+{
+    const Image& ia = a->constImage();
+    const Image& ib = b->constImage();
+    if(ia.width() != ib.width() || ia.height() != ib.height() || ia.numComponents() != ib.numComponents()){
+        return false;
+    }
+    return ia.empty() || memcmp(ia.pixels(), ib.pixels(), imageSize(ia)) == 0;
+}
+
+}
+
+
+namespace cnoid {
+
+class ModelAssetCacheEntry
+{
+public:
+    boost::uint64_t hash;
+    SgMeshPtr mesh;
+    SgImagePtr image;
+    int numUsers;
+};
+
+
+class ModelAssetCacheImpl
+{
+public:
+    typedef multimap<boost::uint64_t, ModelAssetCacheEntry*> EntryMap;
+
+    boost::mutex mutex;
+    EntryMap meshes;
+    EntryMap images;
+    int numSharedAssets;
+
+    ModelAssetCacheImpl();
+    ModelAssetLease* createLease(const std::string& path);
+    void shareScene(SgNode* node, ModelAssetLease* lease, set<SgNode*>& visited);
+    SgMesh* shareMesh(SgMesh* mesh, ModelAssetLease* lease);
+    SgImage* shareImage(SgImage* image, ModelAssetLease* lease);
+    void release(ModelAssetLease* lease);
+};
+
+}
+
+
+ModelAssetLease::ModelAssetLease(const std::string& path)
+    : path_(path)
+{
+
+}
+
+
+ModelAssetLease::~ModelAssetLease()
+{
+    ModelAssetCache::instance()->impl->release(this);
+}
+
+
+ModelAssetCache* ModelAssetCache::instance()
+{
+    // never deleted so that the leases can be released at the exit
+    static ModelAssetCache* cache = new ModelAssetCache;
+    return cache;
+}
+
+
+ModelAssetCache::ModelAssetCache()
+{
+    impl = new ModelAssetCacheImpl;
+}
+
+
+ModelAssetCacheImpl::ModelAssetCacheImpl()
+    : numSharedAssets(0)
+{
+
+}
+
+
+ModelAssetCache::~ModelAssetCache()
+{
+    delete impl;
+}
+
+
+ModelAssetLeasePtr ModelAssetCache::share(const std::string& path, const std::vector<SgNode*>& scenes)
+{
+    MODELEDIT_TRACE_SPAN("ModelAssetCache::share");
+    ModelAssetLeasePtr lease = impl->createLease(path);
+    boost::mutex::scoped_lock lock(impl->mutex);
+    set<SgNode*> visited;
+    for(size_t i=0; i < scenes.size(); ++i){
+        impl->shareScene(scenes[i], lease, visited);
+    }
+    MODELEDIT_TRACE_COUNTER("Cached meshes", impl->meshes.size());
+    MODELEDIT_TRACE_COUNTER("Shared assets", impl->numSharedAssets);
+    return lease;
+}
+
+
+ModelAssetLease* ModelAssetCacheImpl::createLease(const std::string& path)
+{
+    return new ModelAssetLease(path);
+}
+
+
+void ModelAssetCacheImpl::shareScene(SgNode* node, ModelAssetLease* lease, set<SgNode*>& visited)
+{
+    if(!node || !visited.insert(node).second){
+        return;
+    }
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        if(SgMesh* mesh = shape->mesh()){
+            SgMesh* cached = shareMesh(mesh, lease);
+            if(cached != mesh){
+                shape->setMesh(cached);
+            }
+        }
+        SgTexture* texture = shape->texture();
+        if(texture && texture->image()){
+            SgImage* image = texture->image();
+            SgImage* cached = shareImage(image, lease);
+            if(cached != image){
+                texture->setImage(cached);
+            }
+        }
+    } else if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            shareScene(group->child(i), lease, visited);
+        }
+    }
+}
+
+
+SgMesh* ModelAssetCacheImpl::shareMesh(SgMesh* mesh, ModelAssetLease* lease)
+{
+    boost::uint64_t hash = hashMesh(mesh);
+    ModelAssetCacheEntry* entry = 0;
+    pair<EntryMap::iterator, EntryMap::iterator> range = meshes.equal_range(hash);
+    for(EntryMap::iterator p = range.first; p != range.second; ++p){
+        if(p->second->mesh == mesh || equalMeshes(p->second->mesh, mesh)){
+            entry = p->second;
+            break;
+        }
+    }
+    if(entry){
+        if(entry->mesh != mesh){
+            numSharedAssets++;
+        }
+    } else {
+        entry = new ModelAssetCacheEntry;
+        entry->hash = hash;
+        entry->mesh = mesh;
+        entry->numUsers = 0;
+        meshes.insert(make_pair(hash, entry));
+    }
+    entry->numUsers++;
+    lease->entries.push_back(entry);
+    return entry->mesh;
+}
+
+
+SgImage* ModelAssetCacheImpl::shareImage(SgImage* image, ModelAssetLease* lease)
+{
+    boost::uint64_t hash = hashImage(image);
+    ModelAssetCacheEntry* entry = 0;
+    pair<EntryMap::iterator, EntryMap::iterator> range = images.equal_range(hash);
+    for(EntryMap::iterator p = range.first; p != range.second; ++p){
+        if(p->second->image == image || equalImages(p->second->image, image)){
+            entry = p->second;
+            break;
+        }
+    }
+    if(entry){
+        if(entry->image != image){
+            numSharedAssets++;
+        }
+    } else {
+        entry = new ModelAssetCacheEntry;
+        entry->hash = hash;
+        entry->image = image;
+        entry->numUsers = 0;
+        images.insert(make_pair(hash, entry));
+    }
+    entry->numUsers++;
+    lease->entries.push_back(entry);
+    return entry->image;
+}
+
+
+void ModelAssetCacheImpl::release(ModelAssetLease* lease)
+{
+    boost::mutex::scoped_lock lock(mutex);
+    for(size_t i=0; i < lease->entries.size(); ++i){
+        ModelAssetCacheEntry* entry = lease->entries[i];
+        if(--entry->numUsers > 0){
+            continue;
+        }
+        EntryMap& entries = entry->mesh ? meshes : images;
+        pair<EntryMap::iterator, EntryMap::iterator> range = entries.equal_range(entry->hash);
+        for(EntryMap::iterator p = range.first; p != range.second; ++p){
+            if(p->second == entry){
+                entries.erase(p);
+                break;
+            }
+        }
+        delete entry;
+    }
+    lease->entries.clear();
+}
+
+
+int ModelAssetCache::numMeshes() const
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    return impl->meshes.size();
+}
+
+
+int ModelAssetCache::numImages() const
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    return impl->images.size();
+}
+
+
+int ModelAssetCache::numSharedAssets() const
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    return impl->numSharedAssets;
+}
@@ -0,0 +1,83 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_ASSET_CACHE_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_ASSET_CACHE_H
+
+#include <cnoid/Referenced>
+#include <cnoid/SceneGraph>
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ModelAssetCache;
+class ModelAssetCacheImpl;
+class ModelAssetCacheEntry;
+
+/**
+   The assets used by a loaded model. The model is a user of the cached assets
+   while this object is alive, and the assets are evicted from the cache when
+   their last user is released.
+*/
+class CNOID_EXPORT ModelAssetLease : public Referenced
+{
+public:
+    ~ModelAssetLease();
+
+    const std::string& path() const { return path_; }
+    int numAssets() const { return entries.size(); }
+
+private:
+    ModelAssetLease(const std::string& path);
+
+    std::string path_;
+    std::vector<ModelAssetCacheEntry*> entries;
+
+    friend class ModelAssetCacheImpl;
+};
+typedef ref_ptr<ModelAssetLease> ModelAssetLeasePtr;
+
+
+/**
+   Process-wide cache of the meshes and the texture images of the loaded models.
+   The assets are identified by the hash of their content and compared by the
+   content, so the instances of a model and the variants which contain the same
+   meshes share one copy of the data.
+   The cached meshes are shared by the scene graphs, so they must be cloned
+   before being modified.
+*/
+class CNOID_EXPORT ModelAssetCache
+{
+public:
+    static ModelAssetCache* instance();
+
+    /**
+       Replaces the meshes and the images in the scene with the cached ones and
+       registers the new ones in the cache. The returned lease keeps the assets
+       in the cache. The path is the model file, which is used for the statistics.
+       The scenes are shared after the body loader has built them, so the
+       duplicates are released at this point and the peak memory of the loading
+       itself is not reduced.
+    */
+    ModelAssetLeasePtr share(const std::string& path, const std::vector<SgNode*>& scenes);
+
+    int numMeshes() const;
+    int numImages() const;
+    /// Number of the assets which have been replaced with cached ones
+    int numSharedAssets() const;
+
+private:
+    ModelAssetCache();
+    ~ModelAssetCache();
+
+    ModelAssetCacheImpl* impl;
+
+    friend class ModelAssetLease;
+};
+
+}
+
+#endif
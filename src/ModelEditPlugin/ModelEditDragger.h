@@ -7,6 +7,8 @@
 
 #include <cnoid/PositionDragger>
 #include <cnoid/SceneDrawables>
+#include <boost/bind.hpp>
+#include <algorithm>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -14,8 +16,25 @@ namespace cnoid {
 class CNOID_EXPORT ModelEditDragger : public PositionDragger
 {
 public:
+    ModelEditDragger() {
+        sigDragStarted().connect(boost::bind(&ModelEditDragger::onDragStateChanged, 1));
+        sigDragFinished().connect(boost::bind(&ModelEditDragger::onDragStateChanged, -1));
+    }
+
     // override scene mode change event to show always
     virtual void onSceneModeChanged(const SceneWidgetEvent& event) {};
+
+    // true while one of the draggers is being dragged, when the coarse shapes are drawn
+    static bool isAnyDragged() { return numDraggedRef() > 0; }
+
+private:
+    static int& numDraggedRef() {
+        static int numDragged = 0;
+        return numDragged;
+    }
+    static void onDragStateChanged(int d) {
+        numDraggedRef() = std::max(numDraggedRef() + d, 0);
+    }
 };
 
 typedef ref_ptr<ModelEditDragger> ModelEditDraggerPtr;
@@ -3,6 +3,8 @@
 #include "PrimitiveShapeItem.h"
 #include "JointItem.h"
 #include "SensorItem.h"
+#include "Trace.h"
+#include "WorkerPool.h"
 #include <cnoid/Plugin>
 
 using namespace cnoid;
@@ -14,15 +16,24 @@ public:
     ModelEditPlugin() : Plugin("ModelEdit") { }
     
     virtual bool initialize() {
+
+        ModelEditTrace::initializeFromEnvironment();
         
         EditableModelItem::initializeClass(this);
         LinkItem::initializeClass(this);
         PrimitiveShapeItem::initializeClass(this);
         JointItem::initializeClass(this);
         SensorItem::initializeClass(this);
+        ModelEditWorkerPool::initializeClass(this);
         
         return true;
     }
+
+    virtual bool finalize() {
+        ModelEditWorkerPool::finalize();
+        ModelEditTrace::writeToDefaultFile();
+        return true;
+    }
 };
 
 CNOID_IMPLEMENT_PLUGIN_ENTRY(ModelEditPlugin);
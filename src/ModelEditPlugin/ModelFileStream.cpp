@@ -0,0 +1,308 @@
+/**
+   @file
+*/
+
+#include "ModelFileStream.h"
+#include "Trace.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/file.hpp>
+#include <boost/iostreams/device/null.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/operations.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/shared_ptr.hpp>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+#ifdef MODELEDIT_USE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+using namespace cnoid;
+namespace io = boost::iostreams;
+
+namespace {
+
+int compressionLevel = -1;
+
+#ifdef MODELEDIT_USE_ZSTD
+
+const int ZSTD_DEFAULT_LEVEL = 3;
+
+/**
+   Output filter of the zstd compression. The filters are copied when they are
+   pushed to a chain, so the stream of libzstd is shared by the copies.
+*/
+class ZstdCompressor
+{
+public:
+    typedef char char_type;
+    struct category : io::multichar_output_filter_tag, io::closable_tag { };
+
+    ZstdCompressor(int level) : state(new State(level)) { }
+
+    template<typename Sink>
+    std::streamsize write(Sink& sink, const char* s, std::streamsize n) {
+        ZSTD_inBuffer in = { s, static_cast<size_t>(n), 0 };
+        while(in.pos < in.size){
+            ZSTD_outBuffer out = { &state->buffer[0], state->buffer.size(), 0 };
+            check(ZSTD_compressStream(state->stream, &out, &in));
+            io::write(sink, &state->buffer[0], out.pos);
+        }
+        return n;
+    }
+
+    template<typename Sink>
+    void close(Sink& sink) {
+        size_t remaining;
+        do {
+            ZSTD_outBuffer out = { &state->buffer[0], state->buffer.size(), 0 };
+            remaining = check(ZSTD_endStream(state->stream, &out));
+            io::write(sink, &state->buffer[0], out.pos);
+        } while(remaining > 0);
+        ZSTD_initCStream(state->stream, state->level);
+    }
+
+private:
+    struct State
+    {
+        ZSTD_CStream* stream;
+        vector<char> buffer;
+        int level;
+        State(int level) : stream(ZSTD_createCStream()), buffer(ZSTD_CStreamOutSize()), level(level) {
+            ZSTD_initCStream(stream, level);
+        }
+        ~State() { ZSTD_freeCStream(stream); }
+    };
+    boost::shared_ptr<State> state;
+
+    static size_t check(size_t result) {
+        if(ZSTD_isError(result)){
+            throw std::ios_base::failure(ZSTD_getErrorName(result));
+        }
+        return result;
+    }
+};
+
+/// Input filter of the zstd decompression, which reads the source block by block
+class ZstdDecompressor
+{
+public:
+    typedef char char_type;
+    struct category : io::multichar_input_filter_tag { };
+
+    ZstdDecompressor() : state(new State) { }
+
+    template<typename Source>
+    std::streamsize read(Source& source, char* s, std::streamsize n) {
+        ZSTD_outBuffer out = { s, static_cast<size_t>(n), 0 };
+        while(out.pos == 0){
+            if(state->in.pos == state->in.size){
+                if(state->isEnd){
+                    break;
+                }
+                const std::streamsize m = io::read(source, &state->buffer[0], state->buffer.size());
+                if(m <= 0){
+                    state->isEnd = true;
+                    break;
+                }
+                state->in.src = &state->buffer[0];
+                state->in.size = m;
+                state->in.pos = 0;
+            }
+            const size_t result = ZSTD_decompressStream(state->stream, &out, &state->in);
+            if(ZSTD_isError(result)){
+                throw std::ios_base::failure(ZSTD_getErrorName(result));
+            }
+        }
+        return (out.pos > 0) ? static_cast<std::streamsize>(out.pos) : -1;
+    }
+
+private:
+    struct State
+    {
+        ZSTD_DStream* stream;
+        vector<char> buffer;
+        ZSTD_inBuffer in;
+        bool isEnd;
+        State() : stream(ZSTD_createDStream()), buffer(ZSTD_DStreamInSize()), isEnd(false) {
+            ZSTD_initDStream(stream);
+            in.src = 0;
+            in.size = 0;
+            in.pos = 0;
+        }
+        ~State() { ZSTD_freeDStream(stream); }
+    };
+    boost::shared_ptr<State> state;
+};
+
+#endif
+
+}
+
+namespace cnoid {
+
+class ModelFileOutputImpl
+{
+public:
+    io::filtering_ostream out;
+    bool isFailed;
+    bool isClosed;
+};
+
+}
+
+
+ModelFileCompression cnoid::modelFileCompression(const std::string& filename)
+{
+    const string name = boost::algorithm::to_lower_copy(filename);
+    if(boost::algorithm::ends_with(name, ".gz") || boost::algorithm::ends_with(name, ".wrz")){
+        return GZIP_COMPRESSION;
+    } else if(boost::algorithm::ends_with(name, ".zst")){
+        return ZSTD_COMPRESSION;
+    }
+    return NO_COMPRESSION;
+}
+
+
+std::string cnoid::uncompressedFileName(const std::string& filename)
+{
+    const string name = boost::algorithm::to_lower_copy(filename);
+    if(boost::algorithm::ends_with(name, ".wrz")){
+        return filename.substr(0, filename.size() - 4) + ".wrl";
+    } else if(boost::algorithm::ends_with(name, ".gz")){
+        return filename.substr(0, filename.size() - 3);
+    } else if(boost::algorithm::ends_with(name, ".zst")){
+        return filename.substr(0, filename.size() - 4);
+    }
+    return filename;
+}
+
+
+bool cnoid::isZstdSupported()
+{
+#ifdef MODELEDIT_USE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void cnoid::setModelFileCompressionLevel(int level)
+{
+    compressionLevel = level;
+}
+
+
+int cnoid::modelFileCompressionLevel()
+{
+    return compressionLevel;
+}
+
+
+ModelFileOutput::ModelFileOutput(const std::string& filename)
+{
+    impl = new ModelFileOutputImpl;
+    impl->isFailed = false;
+    impl->isClosed = false;
+
+    switch(modelFileCompression(filename)){
+    case GZIP_COMPRESSION:
+        impl->out.push(io::gzip_compressor(
+                           io::gzip_params(compressionLevel < 0 ? io::zlib::default_compression
+                                           : std::min(compressionLevel, 9))));
+        break;
+    case ZSTD_COMPRESSION:
+#ifdef MODELEDIT_USE_ZSTD
+        impl->out.push(ZstdCompressor(compressionLevel < 0 ? ZSTD_DEFAULT_LEVEL
+                                      : std::min(compressionLevel, ZSTD_maxCLevel())));
+        break;
+#else
+        // the file is not created instead of writing the text with the zstd extension
+        impl->isFailed = true;
+        impl->out.push(io::null_sink());
+        return;
+#endif
+    default:
+        break;
+    }
+    io::file_sink sink(filename, std::ios::out | std::ios::binary);
+    impl->isFailed = !sink.is_open();
+    impl->out.push(sink);
+}
+
+
+ModelFileOutput::~ModelFileOutput()
+{
+    close();
+    delete impl;
+}
+
+
+std::ostream& ModelFileOutput::stream()
+{
+    return impl->out;
+}
+
+
+bool ModelFileOutput::close()
+{
+    if(!impl->isClosed){
+        impl->isClosed = true;
+        try {
+            impl->out.flush();
+            impl->isFailed |= !impl->out.good();
+            // closing the chain writes the rest of the compressed data
+            impl->out.reset();
+        } catch(const std::exception&){
+            impl->isFailed = true;
+        }
+    }
+    return !impl->isFailed;
+}
+
+
+bool cnoid::decompressModelFile(const std::string& filename, const std::string& out_filename, std::ostream& os)
+{
+    MODELEDIT_TRACE_SPAN("decompressModelFile");
+
+    io::filtering_istream in;
+    switch(modelFileCompression(filename)){
+    case GZIP_COMPRESSION:
+        in.push(io::gzip_decompressor());
+        break;
+    case ZSTD_COMPRESSION:
+#ifdef MODELEDIT_USE_ZSTD
+        in.push(ZstdDecompressor());
+        break;
+#else
+        os << filename << " cannot be read because the plugin is built without libzstd" << endl;
+        return false;
+#endif
+    default:
+        break;
+    }
+    io::file_source source(filename, std::ios::in | std::ios::binary);
+    if(!source.is_open()){
+        os << filename << " cannot be opened" << endl;
+        return false;
+    }
+    in.push(source);
+
+    std::ofstream of(out_filename.c_str(), std::ios::out | std::ios::binary);
+    if(!of.is_open()){
+        return false;
+    }
+    try {
+        // the streams are closed by copy
+        io::copy(in, of);
+    } catch(const std::exception& ex){
+        os << filename << " cannot be decompressed: " << ex.what() << endl;
+        return false;
+    }
+    return !of.bad();
+}
@@ -0,0 +1,61 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_FILE_STREAM_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_FILE_STREAM_H
+
+#include <string>
+#include <ostream>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+enum ModelFileCompression { NO_COMPRESSION, GZIP_COMPRESSION, ZSTD_COMPRESSION };
+
+/// Compression of a model file by its extension, which is .gz or .wrz for gzip and .zst for zstd
+CNOID_EXPORT ModelFileCompression modelFileCompression(const std::string& filename);
+
+/// File name without the compression extension, where .wrz becomes .wrl
+CNOID_EXPORT std::string uncompressedFileName(const std::string& filename);
+
+/// True when the plugin is built with libzstd
+CNOID_EXPORT bool isZstdSupported();
+
+/**
+   Level of the compression of the written model files. The default level of
+   each compression is used when the level is negative.
+*/
+CNOID_EXPORT void setModelFileCompressionLevel(int level);
+CNOID_EXPORT int modelFileCompressionLevel();
+
+class ModelFileOutputImpl;
+
+/**
+   Output stream of a model file, which compresses the data while it is written
+   when the file name has a compression extension.
+*/
+class CNOID_EXPORT ModelFileOutput
+{
+public:
+    ModelFileOutput(const std::string& filename);
+    ~ModelFileOutput();
+
+    std::ostream& stream();
+
+    /// Flushes the compressor and closes the file. Returns false when writing failed.
+    bool close();
+
+private:
+    ModelFileOutputImpl* impl;
+};
+
+/**
+   Decompresses a model file into out_filename block by block, so neither the
+   compressed data nor the text is held in memory as a whole.
+*/
+CNOID_EXPORT bool decompressModelFile(const std::string& filename, const std::string& out_filename, std::ostream& os);
+
+}
+
+#endif
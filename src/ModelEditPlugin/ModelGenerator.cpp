@@ -0,0 +1,303 @@
+/**
+   @file
+*/
+
+#include "ModelGenerator.h"
+#include "ModelNode.h"
+#include <cnoid/EigenTypes>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const double sphereRadius = 0.04;
+
+const char* sensorTypes[] = { "ForceSensor", "Gyro", "AccelerationSensor", "VisionSensor", "RangeSensor" };
+const int numSensorTypes = 5;
+
+class SyntheticModelWriter
+{
+public:
+    SyntheticModelWriter(ostream& os, const SyntheticModelSpec& spec)
+        : os(os), spec(spec) {
+        sensorCounts.resize(numSensorTypes, 0);
+    }
+    void write();
+
+private:
+    ostream& os;
+    const SyntheticModelSpec& spec;
+    vector<int> sensorCounts;
+
+    void writeJoint(int index, const string& indent);
+    void writeSegment(int index, const string& indent);
+    void writeSphere(double radius, const string& indent);
+    void writeSensor(int sensorIndex, const string& indent);
+};
+
+
+Vector3 spherePoint(double radius, int stack, int slice, int stacks, int slices)
+{
+    double phi = PI * stack / stacks;
+    double theta = 2.0 * PI * slice / slices;
+    return Vector3(radius * sin(phi) * cos(theta), radius * sin(phi) * sin(theta), radius * cos(phi));
+}
+
+
+double jointOffsetY(int index, int branchingFactor)
+{
+    const int b = branchingFactor;
+    int siblingIndex = (index - 1) % b;
+    return (b > 1) ? (0.1 * siblingIndex - 0.05 * (b - 1)) : 0.0;
+}
+
+
+const char* jointAxisText(int index)
+{
+    return (index % 3 == 0) ? "1 0 0" : (index % 3 == 1) ? "0 1 0" : "0 0 1";
+}
+
+
+bool writeSphereSTL(const string& filename, double radius, const SyntheticModelSpec& spec)
+{
+    const int stacks = spec.meshDensity;
+    const int slices = spec.meshDensity * 2;
+
+    ofstream os(filename.c_str());
+    if(!os){
+        return false;
+    }
+    os << "solid sphere\n";
+    for(int i=0; i < stacks; ++i){
+        for(int j=0; j < slices; ++j){
+            const Vector3 a = spherePoint(radius, i, j, stacks, slices);
+            const Vector3 b = spherePoint(radius, i, j + 1, stacks, slices);
+            const Vector3 c = spherePoint(radius, i + 1, j, stacks, slices);
+            const Vector3 d = spherePoint(radius, i + 1, j + 1, stacks, slices);
+            const Vector3* triangles[2][3] = { { &a, &c, &d }, { &a, &d, &b } };
+            for(int k=0; k < 2; ++k){
+                os << "facet normal 0 0 0\n outer loop\n";
+                for(int l=0; l < 3; ++l){
+                    const Vector3& v = *triangles[k][l];
+                    os << "  vertex " << v.x() << " " << v.y() << " " << v.z() << "\n";
+                }
+                os << " endloop\nendfacet\n";
+            }
+        }
+    }
+    os << "endsolid sphere\n";
+    os.close();
+    return !os.fail();
+}
+
+}
+
+
+bool SyntheticModelSpec::parse(const std::string& text)
+{
+    int* values[] = { &numJoints, &branchingFactor, &meshDensity, &numSensors };
+    const char* p = text.c_str();
+    for(int i=0; i < 4 && *p; ++i){
+        char* next;
+        long value = strtol(p, &next, 10);
+        if(next != p){
+            if(value < 0){
+                return false;
+            }
+            *values[i] = value;
+        }
+        p = next;
+        if(*p == ','){
+            ++p;
+        } else if(*p){
+            return false;
+        }
+    }
+    numJoints = std::max(numJoints, 1);
+    branchingFactor = std::max(branchingFactor, 1);
+    meshDensity = std::max(meshDensity, 2);
+    return true;
+}
+
+
+bool cnoid::writeSyntheticModel(const std::string& filename, const SyntheticModelSpec& spec)
+{
+    ofstream of(filename.c_str());
+    if(!of){
+        return false;
+    }
+    SyntheticModelWriter writer(of, spec);
+    writer.write();
+    of.close();
+    return !of.fail();
+}
+
+
+bool cnoid::writeSyntheticModelURDF(const std::string& filename, const SyntheticModelSpec& spec)
+{
+    ofstream os(filename.c_str());
+    if(!os){
+        return false;
+    }
+    const filesystem::path directory = filesystem::path(filename).parent_path();
+    const int n = spec.numJoints;
+    const int b = spec.branchingFactor;
+
+    os << "<?xml version=\"1.0\"?>\n";
+    os << "<robot name=\"synthetic\">\n";
+    for(int i=0; i < n; ++i){
+        ostringstream meshName;
+        meshName << "L" << i << ".stl";
+        if(!writeSphereSTL((directory / meshName.str()).string(), sphereRadius, spec)){
+            return false;
+        }
+        os << " <link name=\"L" << i << "\">\n";
+        os << "  <inertial>\n";
+        os << "   <mass value=\"1.0\"/>\n";
+        os << "   <origin xyz=\"0 0 -0.05\" rpy=\"0 0 0\"/>\n";
+        os << "   <inertia ixx=\"0.01\" ixy=\"0\" ixz=\"0\" iyy=\"0.01\" iyz=\"0\" izz=\"0.01\"/>\n";
+        os << "  </inertial>\n";
+        os << "  <visual>\n";
+        os << "   <origin xyz=\"0 0 -0.05\" rpy=\"0 0 0\"/>\n";
+        os << "   <geometry><mesh filename=\"" << meshName.str() << "\"/></geometry>\n";
+        os << "  </visual>\n";
+        os << " </link>\n";
+        if(i > 0){
+            os << " <joint name=\"J" << i << "\" type=\"revolute\">\n";
+            os << "  <parent link=\"L" << ((i - 1) / b) << "\"/>\n";
+            os << "  <child link=\"L" << i << "\"/>\n";
+            os << "  <origin xyz=\"0 " << jointOffsetY(i, b) << " -0.1\" rpy=\"0 0 0\"/>\n";
+            os << "  <axis xyz=\"" << jointAxisText(i) << "\"/>\n";
+            os << "  <limit lower=\"-1.57\" upper=\"1.57\" velocity=\"6.28\" effort=\"100\"/>\n";
+            os << " </joint>\n";
+        }
+    }
+    os << "</robot>\n";
+    os.close();
+    return !os.fail();
+}
+
+
+void SyntheticModelWriter::write()
+{
+    os << "#VRML V2.0 utf8\n\n";
+    writeOpenHRPProtoDeclarations(os);
+    os << "DEF synthetic Humanoid {\n";
+    os << "  name \"synthetic\"\n";
+    os << "  humanoidBody [\n";
+    writeJoint(0, "    ");
+    os << "  ]\n";
+    os << "}\n";
+}
+
+
+void SyntheticModelWriter::writeJoint(int index, const string& indent)
+{
+    const int b = spec.branchingFactor;
+    const int n = spec.numJoints;
+
+    os << indent << "DEF J" << index << " Joint {\n";
+    if(index == 0){
+        os << indent << "  jointType \"free\"\n";
+    } else {
+        os << indent << "  translation 0 " << jointOffsetY(index, b) << " -0.1\n";
+        os << indent << "  jointType \"rotate\"\n";
+        os << indent << "  jointAxis " << jointAxisText(index) << "\n";
+        os << indent << "  jointId " << (index - 1) << "\n";
+        os << indent << "  ulimit [ 1.57 ]\n";
+        os << indent << "  llimit [ -1.57 ]\n";
+        os << indent << "  uvlimit [ 6.28 ]\n";
+        os << indent << "  lvlimit [ -6.28 ]\n";
+    }
+    os << indent << "  children [\n";
+    string childIndent = indent + "    ";
+    writeSegment(index, childIndent);
+
+    for(int i = index; i < spec.numSensors; i += n){
+        writeSensor(i, childIndent);
+    }
+    for(int i=0; i < b; ++i){
+        int child = index * b + 1 + i;
+        if(child >= n){
+            break;
+        }
+        writeJoint(child, childIndent);
+    }
+    os << indent << "  ]\n";
+    os << indent << "}\n";
+}
+
+
+void SyntheticModelWriter::writeSegment(int index, const string& indent)
+{
+    os << indent << "DEF L" << index << " Segment {\n";
+    os << indent << "  mass 1.0\n";
+    os << indent << "  centerOfMass 0 0 -0.05\n";
+    os << indent << "  momentsOfInertia [ 0.01 0 0 0 0.01 0 0 0 0.01 ]\n";
+    os << indent << "  children [\n";
+    writeSphere(sphereRadius, indent + "    ");
+    os << indent << "  ]\n";
+    os << indent << "}\n";
+}
+
+
+void SyntheticModelWriter::writeSphere(double radius, const string& indent)
+{
+    const int stacks = spec.meshDensity;
+    const int slices = spec.meshDensity * 2;
+
+    os << indent << "Transform {\n";
+    os << indent << "  translation 0 0 -0.05\n";
+    os << indent << "  children Shape {\n";
+    os << indent << "    appearance Appearance { material Material { diffuseColor 0.6 0.6 0.7 } }\n";
+    os << indent << "    geometry IndexedFaceSet {\n";
+    os << indent << "      coord Coordinate {\n";
+    os << indent << "        point [\n";
+    for(int i=0; i <= stacks; ++i){
+        for(int j=0; j < slices; ++j){
+            const Vector3 p = spherePoint(radius, i, j, stacks, slices);
+            os << indent << "          " << p.x() << " " << p.y() << " " << p.z() << ",\n";
+        }
+    }
+    os << indent << "        ]\n";
+    os << indent << "      }\n";
+    os << indent << "      coordIndex [\n";
+    for(int i=0; i < stacks; ++i){
+        for(int j=0; j < slices; ++j){
+            int a = i * slices + j;
+            int b = i * slices + (j + 1) % slices;
+            int c = a + slices;
+            int d = b + slices;
+            os << indent << "        " << a << " " << c << " " << d << " -1 " << a << " " << d << " " << b << " -1\n";
+        }
+    }
+    os << indent << "      ]\n";
+    os << indent << "    }\n";
+    os << indent << "  }\n";
+    os << indent << "}\n";
+}
+
+
+void SyntheticModelWriter::writeSensor(int sensorIndex, const string& indent)
+{
+    int type = sensorIndex % numSensorTypes;
+    int id = sensorCounts[type]++;
+    os << indent << "DEF S" << sensorIndex << " " << sensorTypes[type] << " {\n";
+    os << indent << "  translation 0 0 -0.02\n";
+    os << indent << "  sensorId " << id << "\n";
+    if(type == 3){
+        os << indent << "  type \"COLOR\"\n";
+        os << indent << "  width 320\n";
+        os << indent << "  height 240\n";
+    }
+    os << indent << "}\n";
+}
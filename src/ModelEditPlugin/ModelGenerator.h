@@ -0,0 +1,49 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_GENERATOR_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_GENERATOR_H
+
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Parameters of a synthetic robot model.
+   The joints form a tree in which each joint has up to branchingFactor child
+   joints. Each link has a sphere mesh with meshDensity stacks and
+   2 * meshDensity slices, and the sensors are attached to the joints in turn.
+*/
+struct SyntheticModelSpec
+{
+    SyntheticModelSpec()
+        : numJoints(30),
+          branchingFactor(2),
+          meshDensity(8),
+          numSensors(4) { }
+    int numJoints;
+    int branchingFactor;
+    int meshDensity;
+    int numSensors;
+
+    /// Reads "joints,branching,density,sensors". Omitted values are kept.
+    bool parse(const std::string& text);
+};
+
+/**
+   Writes a synthetic model in the OpenHRP VRML format.
+*/
+CNOID_EXPORT bool writeSyntheticModel(const std::string& filename, const SyntheticModelSpec& spec);
+
+/**
+   Writes the same joint tree in URDF. The sphere of each link is written to its
+   own ASCII STL file next to the URDF file, so that every mesh is parsed as in
+   the VRML model. URDF has no sensors, so they are omitted.
+*/
+CNOID_EXPORT bool writeSyntheticModelURDF(const std::string& filename, const SyntheticModelSpec& spec);
+
+}
+
+#endif
@@ -0,0 +1,305 @@
+/**
+   @file
+*/
+
+#include "ModelImporter.h"
+#include "WorkerPool.h"
+#include "Trace.h"
+#include <cnoid/MeshGenerator>
+#include <boost/bind.hpp>
+#include <boost/format.hpp>
+#include <boost/algorithm/string.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+void addSearchPaths(vector<filesystem::path>& paths, const char* variable, const string& name)
+{
+    if(const char* value = getenv(variable)){
+        vector<string> dirs;
+        boost::algorithm::split(dirs, value, boost::algorithm::is_any_of(":;"));
+        for(size_t i=0; i < dirs.size(); ++i){
+            if(!dirs[i].empty()){
+                paths.push_back(filesystem::path(dirs[i]) / name);
+            }
+        }
+    }
+}
+
+}
+
+
+ModelImporter::ModelImporter(const std::string& filename, std::ostream& os)
+    : filename(filename),
+      os(os)
+{
+    directory = filesystem::absolute(filesystem::path(filename)).parent_path();
+}
+
+
+ModelImporter::~ModelImporter()
+{
+
+}
+
+
+std::string ModelImporter::resolveFilename(const std::string& uri) const
+{
+    if(boost::algorithm::starts_with(uri, "file://")){
+        return uri.substr(7);
+    }
+    const char* variable;
+    size_t schemeLength;
+    if(boost::algorithm::starts_with(uri, "package://")){
+        variable = "ROS_PACKAGE_PATH";
+        schemeLength = 10;
+    } else if(boost::algorithm::starts_with(uri, "model://")){
+        variable = "GAZEBO_MODEL_PATH";
+        schemeLength = 8;
+    } else {
+        filesystem::path path(uri);
+        if(path.is_absolute()){
+            return uri;
+        }
+        return (directory / path).string();
+    }
+
+    string rest = uri.substr(schemeLength);
+    size_t slash = rest.find('/');
+    string name = rest.substr(0, slash);
+    string relative = (slash == string::npos) ? string() : rest.substr(slash + 1);
+
+    vector<filesystem::path> candidates;
+    addSearchPaths(candidates, variable, name);
+    // the model file is usually in the package or the model directory
+    for(filesystem::path dir = directory; !dir.empty(); dir = dir.parent_path()){
+        if(dir.filename() == name){
+            candidates.push_back(dir);
+        }
+        candidates.push_back(dir / name);
+        if(dir == dir.root_path()){
+            break;
+        }
+    }
+    for(size_t i=0; i < candidates.size(); ++i){
+        filesystem::path path = candidates[i] / relative;
+        if(filesystem::exists(path)){
+            return path.string();
+        }
+    }
+    return (directory / relative).string();
+}
+
+
+int ModelImporter::addMeshFile(const std::string& uri)
+{
+    string path = resolveFilename(uri);
+    map<string, int>::iterator p = meshIndices.find(path);
+    if(p != meshIndices.end()){
+        return p->second;
+    }
+    int index = meshFiles.size();
+    meshFiles.push_back(path);
+    meshIndices[path] = index;
+    return index;
+}
+
+
+void ModelImporter::loadMeshes()
+{
+    MODELEDIT_TRACE_SPAN("ModelImporter::loadMeshes");
+    MODELEDIT_TRACE_COUNTER("Imported mesh files", meshFiles.size());
+
+    meshes.resize(meshFiles.size());
+    meshErrors.resize(meshFiles.size());
+    ModelEditWorkerPool::instance()->parallelFor(
+        meshFiles.size(), boost::bind(&ModelImporter::loadMesh, this, _1));
+
+    for(size_t i=0; i < meshErrors.size(); ++i){
+        if(!meshErrors[i].empty()){
+            os << meshErrors[i] << endl;
+        }
+    }
+}
+
+
+/**
+   Runs in a worker thread. Only the new scene objects of the mesh are created here.
+*/
+void ModelImporter::loadMesh(int index)
+{
+    MODELEDIT_TRACE_SPAN("ModelImporter::loadMesh");
+
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(
+        meshFiles[index],
+        aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_JoinIdenticalVertices | aiProcess_PreTransformVertices);
+    if(!scene){
+        meshErrors[index] = str(format("Cannot load the mesh \"%1%\": %2%") % meshFiles[index] % importer.GetErrorString());
+        return;
+    }
+
+    SgGroupPtr group = new SgGroup;
+    for(unsigned int i=0; i < scene->mNumMeshes; ++i){
+        const aiMesh* src = scene->mMeshes[i];
+        SgMeshPtr mesh = new SgMesh;
+
+        SgVertexArray* vertices = new SgVertexArray;
+        vertices->reserve(src->mNumVertices);
+        for(unsigned int j=0; j < src->mNumVertices; ++j){
+            const aiVector3D& v = src->mVertices[j];
+            vertices->push_back(Vector3f(v.x, v.y, v.z));
+        }
+        mesh->setVertices(vertices);
+
+        if(src->HasNormals()){
+            SgNormalArray* normals = new SgNormalArray;
+            normals->reserve(src->mNumVertices);
+            for(unsigned int j=0; j < src->mNumVertices; ++j){
+                const aiVector3D& n = src->mNormals[j];
+                normals->push_back(Vector3f(n.x, n.y, n.z));
+            }
+            mesh->setNormals(normals);
+        }
+
+        SgIndexArray& triangles = mesh->triangleVertices();
+        triangles.reserve(src->mNumFaces * 3);
+        for(unsigned int j=0; j < src->mNumFaces; ++j){
+            const aiFace& face = src->mFaces[j];
+            if(face.mNumIndices == 3){
+                triangles.push_back(face.mIndices[0]);
+                triangles.push_back(face.mIndices[1]);
+                triangles.push_back(face.mIndices[2]);
+            }
+        }
+        mesh->updateBoundingBox();
+
+        SgShapePtr shape = new SgShape;
+        shape->setMesh(mesh);
+        SgMaterialPtr material = new SgMaterial;
+        aiColor4D diffuse;
+        if(aiGetMaterialColor(scene->mMaterials[src->mMaterialIndex], AI_MATKEY_COLOR_DIFFUSE, &diffuse) == AI_SUCCESS){
+            material->setDiffuseColor(Vector3f(diffuse.r, diffuse.g, diffuse.b));
+        }
+        shape->setMaterial(material);
+        group->addChild(shape);
+    }
+    meshes[index] = group;
+}
+
+
+SgNode* ModelImporter::createShape(const std::vector<ImportedShape>& shapes, const std::string& name)
+{
+    if(shapes.empty()){
+        return 0;
+    }
+    SgGroup* top = new SgGroup;
+    SgGroup* group = new SgGroup;
+    group->setName(name);
+    top->addChild(group);
+    for(size_t i=0; i < shapes.size(); ++i){
+        SgNode* geometry = createGeometry(shapes[i]);
+        if(geometry){
+            SgPosTransform* pos = new SgPosTransform;
+            pos->setTranslation(shapes[i].origin.translation());
+            pos->setRotation(shapes[i].origin.linear());
+            pos->addChild(geometry);
+            group->addChild(pos);
+        }
+    }
+    return top;
+}
+
+
+SgNode* ModelImporter::createGeometry(const ImportedShape& shape)
+{
+    const ImportedGeometry& geometry = shape.geometry;
+    MeshGenerator meshGenerator;
+    SgMeshPtr mesh;
+
+    switch(geometry.type){
+
+    case ImportedGeometry::BOX:
+        mesh = meshGenerator.generateBox(geometry.size);
+        break;
+
+    case ImportedGeometry::SPHERE:
+        mesh = meshGenerator.generateSphere(geometry.radius);
+        break;
+
+    case ImportedGeometry::CYLINDER:
+    {
+        // the axis of the cylinder is y in Choreonoid
+        SgShape* cylinder = new SgShape;
+        cylinder->setMesh(meshGenerator.generateCylinder(geometry.radius, geometry.length));
+        cylinder->setMaterial(createMaterial(shape));
+        SgPosTransform* pos = new SgPosTransform;
+        pos->setRotation(AngleAxis(PI / 2.0, Vector3::UnitX()));
+        pos->addChild(cylinder);
+        return pos;
+    }
+
+    case ImportedGeometry::MESH:
+    {
+        SgGroup* loaded = dynamic_cast<SgGroup*>(meshes[geometry.meshIndex].get());
+        if(!loaded){
+            return 0;
+        }
+        SgGroup* group;
+        if(geometry.scale != Vector3::Ones()){
+            SgScaleTransform* scale = new SgScaleTransform;
+            scale->setScale(geometry.scale);
+            group = scale;
+        } else {
+            group = new SgGroup;
+        }
+        SgMaterial* material = shape.hasColor ? createMaterial(shape) : 0;
+        for(int i=0; i < loaded->numChildren(); ++i){
+            SgShape* loadedShape = dynamic_cast<SgShape*>(loaded->child(i));
+            if(material && loadedShape){
+                // the mesh is shared by the uses of the file
+                SgShape* colored = new SgShape;
+                colored->setMesh(loadedShape->mesh());
+                colored->setMaterial(material);
+                group->addChild(colored);
+            } else {
+                group->addChild(loaded->child(i));
+            }
+        }
+        return group;
+    }
+
+    default:
+        return 0;
+    }
+
+    if(!mesh){
+        return 0;
+    }
+    SgShape* primitive = new SgShape;
+    primitive->setMesh(mesh);
+    primitive->setMaterial(createMaterial(shape));
+    return primitive;
+}
+
+
+SgMaterial* ModelImporter::createMaterial(const ImportedShape& shape)
+{
+    Vector4f color(0.7f, 0.7f, 0.7f, 1.0f);
+    if(shape.hasColor){
+        color = shape.color;
+    }
+    SgMaterial* material = new SgMaterial;
+    material->setDiffuseColor(Vector3f(color[0], color[1], color[2]));
+    material->setTransparency(1.0f - color[3]);
+    return material;
+}
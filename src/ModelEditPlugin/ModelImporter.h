@@ -0,0 +1,100 @@
+/**
+   \file
+   Common part of the importers of the model formats other than VRML.
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_IMPORTER_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_IMPORTER_H
+
+#include <cnoid/EigenTypes>
+#include <cnoid/SceneShape>
+#include <boost/filesystem.hpp>
+#include <string>
+#include <vector>
+#include <map>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+struct ImportedGeometry
+{
+    enum Type { NONE, BOX, CYLINDER, SPHERE, MESH };
+
+    ImportedGeometry()
+        : type(NONE), size(Vector3::Zero()), radius(0.0), length(0.0),
+          meshIndex(-1), scale(Vector3::Ones()) { }
+
+    Type type;
+    Vector3 size;
+    double radius;
+    // the axis of the cylinder is z
+    double length;
+    // index given by ModelImporter::addMeshFile()
+    int meshIndex;
+    Vector3 scale;
+};
+
+
+/// Visual or collision geometry of a link
+struct ImportedShape
+{
+    ImportedShape() : origin(Affine3::Identity()), hasColor(false) { }
+
+    // position in the link frame
+    Affine3 origin;
+    ImportedGeometry geometry;
+    // material defined elsewhere in the file
+    std::string materialName;
+    bool hasColor;
+    Vector4f color;
+};
+
+
+/**
+   The importers register the mesh files while parsing the model and load them
+   at once by loadMeshes(), which runs in the worker threads. The link shapes
+   are then created from the parsed shapes.
+*/
+class CNOID_EXPORT ModelImporter
+{
+public:
+    ModelImporter(const std::string& filename, std::ostream& os);
+    virtual ~ModelImporter();
+
+protected:
+    std::string filename;
+    boost::filesystem::path directory;
+    std::ostream& os;
+
+    /**
+       Resolves a file name written in the model file. The paths relative to the model
+       file and the file://, package:// and model:// URIs are supported. The packages
+       and the models are searched in ROS_PACKAGE_PATH, GAZEBO_MODEL_PATH and the
+       ancestor directories of the model file.
+    */
+    std::string resolveFilename(const std::string& uri) const;
+
+    int addMeshFile(const std::string& uri);
+    void loadMeshes();
+
+    /**
+       Creates the shape of a link. The shape is a group whose first child is named
+       after the link, which is used as the name of the link item.
+    */
+    SgNode* createShape(const std::vector<ImportedShape>& shapes, const std::string& name);
+
+private:
+    std::vector<std::string> meshFiles;
+    std::map<std::string, int> meshIndices;
+    std::vector<SgNodePtr> meshes;
+    std::vector<std::string> meshErrors;
+
+    void loadMesh(int index);
+    SgNode* createGeometry(const ImportedShape& shape);
+    SgMaterial* createMaterial(const ImportedShape& shape);
+};
+
+}
+
+#endif
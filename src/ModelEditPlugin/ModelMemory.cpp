@@ -0,0 +1,186 @@
+/**
+   @file
+*/
+
+#include "ModelMemory.h"
+#include <cnoid/SceneGraph>
+#include <cnoid/SceneShape>
+#include <set>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+template<class Container>
+size_t arrayBytes(const Container& c)
+{
+    return c.size() * sizeof(typename Container::value_type);
+}
+
+
+class ModelMemoryCounter
+{
+public:
+    ModelMemoryUsage usage;
+
+    void countModelNode(const ModelNode* node);
+
+private:
+    set<const VRMLNode*> visitedVRMLNodes;
+    set<const SgObject*> visitedSceneObjects;
+
+    void countVRMLNode(const VRMLNode* node);
+    void countVRMLField(const VRMLVariantField& field);
+    void countSceneNode(SgNode* node);
+    void countMesh(SgMesh* mesh);
+};
+
+
+void ModelMemoryCounter::countModelNode(const ModelNode* node)
+{
+    countVRMLNode(node->originalNode.get());
+
+    Link* link = 0;
+    if(const LinkNode* linkNode = dynamic_cast<const LinkNode*>(node)){
+        link = linkNode->link;
+    } else if(const JointNode* jointNode = dynamic_cast<const JointNode*>(node)){
+        link = jointNode->link;
+    }
+    if(link){
+        countSceneNode(link->visualShape());
+        countSceneNode(link->collisionShape());
+    }
+    for(int i=0; i < node->numChildren(); ++i){
+        countModelNode(node->child(i));
+    }
+}
+
+
+void ModelMemoryCounter::countVRMLNode(const VRMLNode* node)
+{
+    if(!node || !visitedVRMLNodes.insert(node).second){
+        return;
+    }
+    usage.numVRMLNodes++;
+    usage.vrmlBytes += sizeof(VRMLNode) + node->defName.capacity();
+
+    if(const VRMLProtoInstance* proto = dynamic_cast<const VRMLProtoInstance*>(node)){
+        for(VRMLProtoFieldMap::const_iterator p = proto->fields.begin(); p != proto->fields.end(); ++p){
+            usage.vrmlBytes += sizeof(*p) + p->first.capacity();
+            countVRMLField(p->second);
+        }
+        countVRMLNode(proto->actualNode.get());
+    } else if(const VRMLGroup* group = dynamic_cast<const VRMLGroup*>(node)){
+        usage.vrmlBytes += sizeof(VRMLGroup) + arrayBytes(group->children);
+        for(size_t i=0; i < group->children.size(); ++i){
+            countVRMLNode(group->children[i].get());
+        }
+    } else if(const VRMLShape* shape = dynamic_cast<const VRMLShape*>(node)){
+        usage.vrmlBytes += sizeof(VRMLShape);
+        countVRMLNode(shape->appearance.get());
+        countVRMLNode(shape->geometry.get());
+    } else if(const VRMLAppearance* appearance = dynamic_cast<const VRMLAppearance*>(node)){
+        usage.vrmlBytes += sizeof(VRMLAppearance);
+        countVRMLNode(appearance->material.get());
+        countVRMLNode(appearance->texture.get());
+        countVRMLNode(appearance->textureTransform.get());
+    } else if(const VRMLIndexedFaceSet* faceSet = dynamic_cast<const VRMLIndexedFaceSet*>(node)){
+        usage.vrmlBytes += sizeof(VRMLIndexedFaceSet)
+            + arrayBytes(faceSet->coordIndex) + arrayBytes(faceSet->normalIndex)
+            + arrayBytes(faceSet->colorIndex) + arrayBytes(faceSet->texCoordIndex);
+        countVRMLNode(faceSet->coord.get());
+        countVRMLNode(faceSet->normal.get());
+        countVRMLNode(faceSet->color.get());
+        countVRMLNode(faceSet->texCoord.get());
+    } else if(const VRMLCoordinate* coord = dynamic_cast<const VRMLCoordinate*>(node)){
+        usage.vrmlBytes += arrayBytes(coord->point);
+    } else if(const VRMLNormal* normal = dynamic_cast<const VRMLNormal*>(node)){
+        usage.vrmlBytes += arrayBytes(normal->vector);
+    } else if(const VRMLColor* color = dynamic_cast<const VRMLColor*>(node)){
+        usage.vrmlBytes += arrayBytes(color->color);
+    } else if(const VRMLTextureCoordinate* texCoord = dynamic_cast<const VRMLTextureCoordinate*>(node)){
+        usage.vrmlBytes += arrayBytes(texCoord->point);
+    }
+}
+
+
+void ModelMemoryCounter::countVRMLField(const VRMLVariantField& field)
+{
+    if(const SFNode* node = boost::get<SFNode>(&field)){
+        countVRMLNode(node->get());
+    } else if(const MFNode* nodes = boost::get<MFNode>(&field)){
+        usage.vrmlBytes += arrayBytes(*nodes);
+        for(size_t i=0; i < nodes->size(); ++i){
+            countVRMLNode((*nodes)[i].get());
+        }
+    } else if(const MFVec3f* v = boost::get<MFVec3f>(&field)){
+        usage.vrmlBytes += arrayBytes(*v);
+    } else if(const MFInt32* v = boost::get<MFInt32>(&field)){
+        usage.vrmlBytes += arrayBytes(*v);
+    } else if(const MFFloat* v = boost::get<MFFloat>(&field)){
+        usage.vrmlBytes += arrayBytes(*v);
+    }
+}
+
+
+void ModelMemoryCounter::countSceneNode(SgNode* node)
+{
+    if(!node || !visitedSceneObjects.insert(node).second){
+        return;
+    }
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        countMesh(shape->mesh());
+    } else if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            countSceneNode(group->child(i));
+        }
+    }
+}
+
+
+void ModelMemoryCounter::countMesh(SgMesh* mesh)
+{
+    if(!mesh || !visitedSceneObjects.insert(mesh).second){
+        return;
+    }
+    usage.numMeshes++;
+    usage.meshBytes += sizeof(SgMesh);
+    if(mesh->hasVertices()){
+        usage.meshBytes += arrayBytes(*mesh->vertices());
+    }
+    if(mesh->hasNormals()){
+        usage.meshBytes += arrayBytes(*mesh->normals());
+    }
+    if(mesh->hasColors()){
+        usage.meshBytes += arrayBytes(*mesh->colors());
+    }
+    if(mesh->hasTexCoords()){
+        usage.meshBytes += arrayBytes(*mesh->texCoords());
+    }
+    usage.meshBytes += arrayBytes(mesh->triangleVertices())
+        + arrayBytes(mesh->normalIndices())
+        + arrayBytes(mesh->colorIndices())
+        + arrayBytes(mesh->texCoordIndices());
+}
+
+}
+
+
+ModelMemoryUsage cnoid::measureModelMemory(const ModelNode* root)
+{
+    ModelMemoryCounter counter;
+    if(root){
+        counter.countModelNode(root);
+    }
+    return counter.usage;
+}
+
+
+void cnoid::releaseOriginalNodes(ModelNode* root)
+{
+    root->originalNode = 0;
+    for(int i=0; i < root->numChildren(); ++i){
+        releaseOriginalNodes(root->child(i));
+    }
+}
@@ -0,0 +1,44 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_MEMORY_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_MEMORY_H
+
+#include "ModelNode.h"
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Approximate memory footprint of the data referred by a model tree.
+   Nodes and meshes shared in the tree are counted once.
+*/
+struct ModelMemoryUsage
+{
+    ModelMemoryUsage()
+        : numVRMLNodes(0),
+          vrmlBytes(0),
+          numMeshes(0),
+          meshBytes(0) { }
+    size_t numVRMLNodes;
+    size_t vrmlBytes;
+    size_t numMeshes;
+    size_t meshBytes;
+
+    size_t totalBytes() const { return vrmlBytes + meshBytes; }
+};
+
+CNOID_EXPORT ModelMemoryUsage measureModelMemory(const ModelNode* root);
+
+/**
+   Drops the original VRML nodes in the tree so that the parsed VRML is freed.
+   The geometry is kept in the scene meshes of the links and the exporters
+   regenerate the VRML geometry from them.
+*/
+CNOID_EXPORT void releaseOriginalNodes(ModelNode* root);
+
+}
+
+#endif
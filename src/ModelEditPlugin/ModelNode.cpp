@@ -0,0 +1,1830 @@
+/**
+   @file
+*/
+
+#include "ModelNode.h"
+#include "SgToVRMLConverter.h"
+#include "MeshTransform.h"
+#include "GLBWriter.h"
+#include "ModelFileStream.h"
+#include "Trace.h"
+#include "WorkerPool.h"
+#include "URDFLoader.h"
+#include "SDFLoader.h"
+#include <cnoid/BodyLoader>
+#include <cnoid/VRMLBodyLoader>
+#include <cnoid/VRMLBody>
+#include <cnoid/VRMLBodyWriter>
+#include <cnoid/VRMLWriter>
+#include <cnoid/EigenUtil>
+#include <cnoid/Sensor>
+#include <cnoid/Camera>
+#include <cnoid/RangeCamera>
+#include <cnoid/RangeSensor>
+#include <boost/bind.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <sdf/sdf.hh>
+#include <assimp/Importer.hpp>
+#include <assimp/Exporter.hpp>
+#include <assimp/scene.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <typeinfo>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+LinkNode::VisualMeshFormat urdfVisualMeshFormat = LinkNode::COLLADA;
+
+const char* jointTypeSymbol(Link::JointType type)
+{
+    switch(type){
+    case Link::ROTATIONAL_JOINT: return "rotate";
+    case Link::SLIDE_JOINT:      return "slide";
+    case Link::FREE_JOINT:       return "free";
+    case Link::FIXED_JOINT:      return "fixed";
+    case Link::CRAWLER_JOINT:    return "crawler";
+    default:                     return "fixed";
+    }
+}
+
+struct VectorText
+{
+    const Vector3& v;
+    VectorText(const Vector3& v) : v(v) { }
+};
+
+ostream& operator<<(ostream& os, const VectorText& t)
+{
+    return os << t.v[0] << " " << t.v[1] << " " << t.v[2];
+}
+
+void writeInertial(ostream& os, double mass, const Vector3& c, const Matrix3& I)
+{
+    os << " <inertial>" << endl;
+    os << "  <mass value=\"" << mass << "\"/>" << endl;
+    os << "  <origin xyz=\"" << VectorText(c) << "\" rpy=\"0 0 0\"/>" << endl;
+    os << "  <inertia ixx=\"" << I(0, 0)
+       << "\" ixy=\"" << I(0, 1)
+       << "\" ixz=\"" << I(0, 2)
+       << "\" iyy=\"" << I(1, 1)
+       << "\" iyz=\"" << I(1, 2)
+       << "\" izz=\"" << I(2, 2) << "\" />" << endl;
+    os << " </inertial>" << endl;
+}
+
+ModelRootNodePtr createRootNode(Body* body, const string& filename)
+{
+    body->initializeState();
+    body->calcForwardKinematics();
+
+    ModelRootNodePtr root = new ModelRootNode;
+    root->body = body;
+    root->name = body->modelName();
+
+    vector<SgNode*> scenes;
+    for (int i = 0; i < body->numLinks(); i++) {
+        scenes.push_back(body->link(i)->visualShape());
+        scenes.push_back(body->link(i)->collisionShape());
+    }
+    root->assets = ModelAssetCache::instance()->share(filename, scenes);
+    return root;
+}
+
+
+// The vloader is null for the bodies which have no original VRML nodes
+void addLinkTree(ModelNode* parent, Link* link, VRMLBodyLoader* vloader)
+{
+    // first, create joint node
+    JointNodePtr joint = new JointNode;
+    joint->readLink(link);
+    if (vloader) {
+        joint->originalNode = vloader->getOriginalNode(link);
+    }
+    parent->addChild(joint);
+    // next, create link node under the joint node
+    LinkNodePtr linkNode = new LinkNode;
+    linkNode->readLink(link);
+    linkNode->originalNode = joint->originalNode;
+    joint->addChild(linkNode);
+    if(link->collisionShape() != link->visualShape()){
+        // the collision node shows the collision shape
+        LinkPtr collisionLink = new Link(*link);
+        collisionLink->setVisualShape(link->collisionShape());
+        LinkNodePtr collision = new LinkNode;
+        collision->readLink(collisionLink);
+        collision->originalNode = joint->originalNode;
+        collision->name = "collision";
+        linkNode->addChild(collision);
+    }
+    for(Link* child = link->child(); child; child = child->sibling()){
+        addLinkTree(joint, child, vloader);
+    }
+}
+
+
+void addSensorNodes(ModelRootNode* root)
+{
+    Body* body = root->body;
+    for (int i = 0; i < body->numDevices(); i++) {
+        Device* dev = body->device(i);
+        ModelNode* parent = root->findNode(dev->link()->name());
+        if (parent) {
+            SensorNodePtr sensor = new SensorNode;
+            sensor->readDevice(dev);
+            parent->addChild(sensor);
+        }
+    }
+}
+
+}
+
+
+ModelNode::ModelNode()
+    : translation(Vector3::Zero()),
+      rotation(Matrix3::Identity()),
+      parent_(0)
+{
+
+}
+
+
+ModelNode::ModelNode(const ModelNode& org)
+    : Referenced(),
+      name(org.name),
+      translation(org.translation),
+      rotation(org.rotation),
+      originalNode(org.originalNode),
+      parent_(0)
+{
+
+}
+
+
+ModelNode::~ModelNode()
+{
+    for(size_t i=0; i < children_.size(); ++i){
+        children_[i]->parent_ = 0;
+    }
+}
+
+
+void ModelNode::addChild(ModelNode* node)
+{
+    ModelNodePtr holder = node;
+    if(node->parent_){
+        node->parent_->removeChild(node);
+    }
+    node->parent_ = this;
+    children_.push_back(node);
+}
+
+
+void ModelNode::removeChild(ModelNode* node)
+{
+    for(vector<ModelNodePtr>::iterator p = children_.begin(); p != children_.end(); ++p){
+        if(p->get() == node){
+            node->parent_ = 0;
+            children_.erase(p);
+            return;
+        }
+    }
+}
+
+
+ModelNode* ModelNode::findNode(const std::string& name)
+{
+    if(this->name == name){
+        return this;
+    }
+    for(size_t i=0; i < children_.size(); ++i){
+        if(ModelNode* found = children_[i]->findNode(name)){
+            return found;
+        }
+    }
+    return 0;
+}
+
+
+JointNode* ModelNode::parentJoint() const
+{
+    return dynamic_cast<JointNode*>(parent_);
+}
+
+
+Affine3 ModelNode::relativePosition() const
+{
+    Affine3 child;
+    child.translation() = translation;
+    child.linear() = rotation;
+    if(JointNode* joint = parentJoint()){
+        Affine3 parent;
+        parent.translation() = joint->translation;
+        parent.linear() = joint->rotation;
+        return parent.inverse() * child;
+    }
+    return child;
+}
+
+
+ModelNodePtr ModelNode::cloneSubtree() const
+{
+    ModelNodePtr node = clone();
+    for(size_t i=0; i < children_.size(); ++i){
+        node->addChild(children_[i]->cloneSubtree().get());
+    }
+    return node;
+}
+
+
+std::string ModelNode::toURDF(std::ostream& os) const
+{
+    ostringstream ss;
+    writeURDF(ss, os);
+    return ss.str();
+}
+
+
+namespace cnoid {
+
+/**
+   Splits a model tree into the independent subtrees and generates their VRML
+   nodes in the worker threads. The nodes above the subtrees are generated by
+   the calling thread, which takes the generated subtrees in the order of the
+   children, so the result does not depend on the scheduling.
+   The original VRML nodes may be shared by the links and the subtrees, and the
+   counter of Referenced is not atomic, so the workers only collect the raw
+   pointers of the original shapes and their references are taken by the
+   calling thread after the workers have finished.
+*/
+class ParallelVRMLGenerator
+{
+public:
+    ParallelVRMLGenerator(const ModelNode* root) : root(root) { }
+    VRMLNodePtr generate();
+
+    /**
+       Keeps the original shapes of the link to be added to the group after the
+       join when this is called in a subtree generated by a worker.
+       Returns false otherwise, and then the caller adds the shapes itself.
+    */
+    static bool deferOriginalShapes(const LinkNode* link, VRMLGroup* group);
+
+private:
+    struct DeferredShapes
+    {
+        VRMLGroup* group;
+        vector<VRMLNode*> shapes;
+    };
+    typedef vector<DeferredShapes> DeferredShapesList;
+
+    const ModelNode* root;
+    vector<const ModelNode*> subtrees;
+    map<const ModelNode*, int> sizes;
+    vector<DeferredShapesList> deferredShapes;
+
+    // the list of the subtree being generated in the current thread
+    static boost::thread_specific_ptr<DeferredShapesList> currentDeferredShapes;
+
+    int countNodes(const ModelNode* node);
+    void split(int numSubtrees);
+    void generateSubtree(int index);
+    void addDeferredShapes();
+    static void keepDeferredShapesList(DeferredShapesList*) { }
+};
+
+}
+
+
+int ParallelVRMLGenerator::countNodes(const ModelNode* node)
+{
+    int n = 1;
+    for(int i=0; i < node->numChildren(); ++i){
+        n += countNodes(node->child(i));
+    }
+    sizes[node] = n;
+    return n;
+}
+
+
+/**
+   The largest subtree is replaced with its children until there are enough
+   subtrees to balance the load of the workers.
+*/
+void ParallelVRMLGenerator::split(int numSubtrees)
+{
+    for(int i=0; i < root->numChildren(); ++i){
+        subtrees.push_back(root->child(i));
+    }
+    while((int)subtrees.size() < numSubtrees){
+        int largest = -1;
+        for(size_t i=0; i < subtrees.size(); ++i){
+            if(subtrees[i]->numChildren() > 0 &&
+               (largest < 0 || sizes[subtrees[i]] > sizes[subtrees[largest]])){
+                largest = i;
+            }
+        }
+        if(largest < 0){
+            break;
+        }
+        const ModelNode* node = subtrees[largest];
+        subtrees.erase(subtrees.begin() + largest);
+        for(int i=0; i < node->numChildren(); ++i){
+            subtrees.push_back(node->child(i));
+        }
+    }
+}
+
+
+boost::thread_specific_ptr<ParallelVRMLGenerator::DeferredShapesList>
+ParallelVRMLGenerator::currentDeferredShapes(&ParallelVRMLGenerator::keepDeferredShapesList);
+
+
+void ParallelVRMLGenerator::generateSubtree(int index)
+{
+    const ModelNode* node = subtrees[index];
+    currentDeferredShapes.reset(&deferredShapes[index]);
+    try {
+        node->generatedVRML = node->toVRML();
+    } catch(...){
+        currentDeferredShapes.reset();
+        throw;
+    }
+    currentDeferredShapes.reset();
+}
+
+
+bool ParallelVRMLGenerator::deferOriginalShapes(const LinkNode* link, VRMLGroup* group)
+{
+    DeferredShapesList* list = currentDeferredShapes.get();
+    if(!list || !link->originalNode){
+        return false;
+    }
+    list->push_back(DeferredShapes());
+    list->back().group = group;
+    link->collectOriginalShapes(list->back().shapes);
+    return true;
+}
+
+
+void ParallelVRMLGenerator::addDeferredShapes()
+{
+    for(size_t i=0; i < deferredShapes.size(); ++i){
+        const DeferredShapesList& list = deferredShapes[i];
+        for(size_t j=0; j < list.size(); ++j){
+            MFNode& children = list[j].group->children;
+            children.insert(children.end(), list[j].shapes.begin(), list[j].shapes.end());
+        }
+    }
+}
+
+
+VRMLNodePtr ParallelVRMLGenerator::generate()
+{
+    ModelEditWorkerPool* pool = ModelEditWorkerPool::instance();
+    countNodes(root);
+    split((pool->numThreads() + 1) * 4);
+    MODELEDIT_TRACE_COUNTER("Parallel VRML subtrees", subtrees.size());
+    deferredShapes.resize(subtrees.size());
+
+    VRMLNodePtr node;
+    try {
+        pool->parallelFor(subtrees.size(), boost::bind(&ParallelVRMLGenerator::generateSubtree, this, _1));
+        addDeferredShapes();
+        node = root->toVRML();
+    } catch(...){
+        for(size_t i=0; i < subtrees.size(); ++i){
+            subtrees[i]->generatedVRML = 0;
+        }
+        throw;
+    }
+    for(size_t i=0; i < subtrees.size(); ++i){
+        subtrees[i]->generatedVRML = 0;
+    }
+    return node;
+}
+
+
+VRMLNodePtr ModelNode::toVRMLInParallel() const
+{
+    MODELEDIT_TRACE_SPAN("ModelNode::toVRMLInParallel");
+    ParallelVRMLGenerator generator(this);
+    return generator.generate();
+}
+
+
+void ModelNode::addChildrenToVRML(MFNode& nodes) const
+{
+    for(size_t i=0; i < children_.size(); ++i){
+        const ModelNode* child = children_[i];
+        VRMLNodePtr node = child->generatedVRML ? child->generatedVRML : child->toVRML();
+        if(node){
+            nodes.push_back(node);
+        }
+    }
+}
+
+
+void ModelNode::writeChildrenURDF(std::ostream& ss, std::ostream& os) const
+{
+    for(size_t i=0; i < children_.size(); ++i){
+        children_[i]->writeURDF(ss, os);
+    }
+}
+
+
+JointNode::JointNode()
+{
+    VRMLJointPtr defaults = new VRMLJoint();
+    jointId = -1;
+    jointType = "fixed";
+    jointAxis = Vector3::UnitZ();
+    ulimit = 0.0;
+    llimit = 0.0;
+    uvlimit = 0.0;
+    lvlimit = 0.0;
+    gearRatio = defaults->gearRatio;
+    rotorInertia = defaults->rotorInertia;
+    rotorResistor = defaults->rotorResistor;
+    torqueConst = defaults->torqueConst;
+    encoderPulse = defaults->encoderPulse;
+}
+
+
+ModelNode* JointNode::clone() const
+{
+    return new JointNode(*this);
+}
+
+
+void JointNode::readLink(Link* link)
+{
+    this->link = link;
+    name = link->name();
+    jointId = link->jointId();
+    jointType = jointTypeSymbol(link->jointType());
+    jointAxis = link->jointAxis();
+    ulimit = link->q_upper();
+    llimit = link->q_lower();
+    uvlimit = link->dq_upper();
+    lvlimit = link->dq_lower();
+    // TODO: at this moment, we use the default values but we have to read them from the original VRML
+    translation = link->translation();
+    rotation = link->rotation();
+}
+
+
+VRMLNodePtr JointNode::toVRML() const
+{
+    MODELEDIT_TRACE_SPAN("JointNode::toVRML");
+    VRMLJointPtr node;
+    node = new VRMLJoint();
+    node->defName = name;
+    node->jointId = jointId;
+    node->jointType = jointType;
+    node->jointAxis = jointAxis;
+    node->ulimit.clear();
+    node->ulimit.push_back(ulimit);
+    node->llimit.clear();
+    node->llimit.push_back(llimit);
+    node->uvlimit.clear();
+    node->uvlimit.push_back(uvlimit);
+    node->lvlimit.clear();
+    node->lvlimit.push_back(lvlimit);
+    node->gearRatio = gearRatio;
+    node->rotorInertia = rotorInertia;
+    node->rotorResistor = rotorResistor;
+    node->torqueConst = torqueConst;
+    node->encoderPulse = encoderPulse;
+    Affine3 relative = relativePosition();
+    node->translation = relative.translation();
+    node->rotation = relative.rotation();
+    addChildrenToVRML(node->children);
+    return node;
+}
+
+
+void JointNode::getMassProperties(double& out_mass, Vector3& out_c, Matrix3& out_I) const
+{
+    out_mass = 0.0;
+    out_c.setZero();
+    out_I.setZero();
+    for (size_t i=0; i < children_.size(); ++i) {
+        double m;
+        Vector3 c;
+        Matrix3 I;
+        if (LinkNode* link = dynamic_cast<LinkNode*>(children_[i].get())) {
+            m = link->mass;
+            c = link->centerOfMass;
+            I = link->momentsOfInertia;
+        } else if (PrimitiveShapeNode* primitive = dynamic_cast<PrimitiveShapeNode*>(children_[i].get())) {
+            m = primitive->mass;
+            c = primitive->centerOfMass;
+            I = primitive->momentsOfInertia;
+        } else {
+            continue;
+        }
+        const double total = out_mass + m;
+        const Vector3 newc = (total > 0.0) ? Vector3((out_mass * out_c + m * c) / total) : out_c;
+        const Vector3 d1 = out_c - newc;
+        const Vector3 d2 = c - newc;
+        out_I += out_mass * (d1.squaredNorm() * Matrix3::Identity() - d1 * d1.transpose());
+        out_I += I + m * (d2.squaredNorm() * Matrix3::Identity() - d2 * d2.transpose());
+        out_c = newc;
+        out_mass = total;
+    }
+}
+
+
+void JointNode::writeURDF(std::ostream& ss, std::ostream& os) const
+{
+    MODELEDIT_TRACE_SPAN("JointNode::toURDF");
+    string jtype;
+    jtype = "fixed";
+    if (jointType == "rotate") {
+        // TODO: use continuous when no limits are set
+        jtype = "revolute";
+    } else if (jointType == "slide") {
+        jtype = "prismatic";
+    }
+    ss << "<joint name=\"" << name << "\" type=\"" << jtype << "\">" << endl;
+    ss << " <axis>" << jointAxis[0] << " " << jointAxis[1] << " " << jointAxis[2] << "</axis>" << endl;
+    if (jtype == "revolute" || jtype == "prismatic") {
+        ss << " <limit>" << endl;
+        ss << "  <lower>" << llimit << "</lower>"<< endl;
+        ss << "  <upper>" << ulimit << "</upper>"<< endl;
+        ss << " </limit>" << endl;
+    }
+    JointNode* parentjoint = parentJoint();
+    bool needworld = false;
+    if (parentjoint) {
+        ss << " <parent link=\"" << parentjoint->name << "_LINK\"/>" << endl;
+        Affine3 relative = relativePosition();
+        Vector3 trans = relative.translation();
+        Vector3 rpy = rpyFromRot(relative.rotation());
+        ss << " <origin xyz=\"" << trans[0] << " " << trans[1] << " " << trans[2]
+           << "\" rpy=\"" << rpy[0] << " " << rpy[1] << " " << rpy[2] << "\"/>" << endl;
+    } else {
+        ss << " <parent link=\"world\"/>" << endl;
+        needworld = true;
+    }
+    ss << " <child link=\"" << name << "_LINK\"/>" << endl;
+    ss << "</joint>" << endl;
+    if (needworld) {
+        ss << "<link name=\"world\" />" << endl;
+    }
+    writeChildrenURDF(ss, os);
+}
+
+
+LinkNode::LinkNode()
+    : mass(0.0),
+      centerOfMass(Vector3::Zero()),
+      momentsOfInertia(Matrix3::Identity())
+{
+
+}
+
+
+ModelNode* LinkNode::clone() const
+{
+    return new LinkNode(*this);
+}
+
+
+void LinkNode::setVisualMeshFormat(VisualMeshFormat format)
+{
+    urdfVisualMeshFormat = format;
+}
+
+
+LinkNode::VisualMeshFormat LinkNode::visualMeshFormat()
+{
+    return urdfVisualMeshFormat;
+}
+
+
+void LinkNode::readLink(Link* link)
+{
+    this->link = link;
+    mass = link->mass();
+    centerOfMass = link->centerOfMass();
+    momentsOfInertia = link->I();
+    translation = link->translation();
+    rotation = link->rotation();
+
+    SgGroup* group = dynamic_cast<SgGroup*>(link->shape());
+    if(group && group->numChildObjects() > 0){
+        SgNode* node = group->child(0);
+        if(node->name().size() != 0){
+            name = node->name();
+        }else{
+            name = link->name() + "_LINK";
+        }
+    }
+}
+
+
+void LinkNode::collectOriginalShapes(std::vector<VRMLNode*>& out_nodes) const
+{
+    VRMLProtoInstance* original = dynamic_cast<VRMLProtoInstance*>(originalNode.get());
+    if (original) {
+        VRMLProtoFieldMap::iterator p = original->fields.find("children");
+        if (p != original->fields.end()) {
+            MFNode& children = boost::get<MFNode>(p->second);
+            for (size_t i=0; i < children.size(); ++i) {
+                out_nodes.push_back(children[i].get());
+            }
+        }
+    }
+}
+
+
+void LinkNode::getShapeVRML(MFNode& out_nodes) const
+{
+    if (originalNode) {
+        vector<VRMLNode*> shapes;
+        collectOriginalShapes(shapes);
+        out_nodes.insert(out_nodes.end(), shapes.begin(), shapes.end());
+    } else if (link && link->visualShape()) {
+        SgToVRMLConverter converter;
+        VRMLNodePtr shape = converter.convert(link->visualShape());
+        if (shape) {
+            out_nodes.push_back(shape);
+        }
+    }
+}
+
+
+VRMLNodePtr LinkNode::toVRML() const
+{
+    MODELEDIT_TRACE_SPAN("LinkNode::toVRML");
+    VRMLSegmentPtr node;
+    node = new VRMLSegment();
+    node->defName = name;
+    node->mass = mass;
+    node->centerOfMass = centerOfMass;
+    MFFloat v(momentsOfInertia.data(), momentsOfInertia.data() + 9);
+    node->momentsOfInertia = v;
+    VRMLTransformPtr trans;
+    trans = new VRMLTransform();
+    Affine3 relative = relativePosition();
+    trans->translation = relative.translation();
+    trans->rotation = relative.rotation();
+    node->children.push_back(trans);
+    if (!ParallelVRMLGenerator::deferOriginalShapes(this, trans.get())) {
+        getShapeVRML(trans->children);
+    }
+    return node;
+}
+
+
+void LinkNode::writeURDF(std::ostream& ss, std::ostream& os) const
+{
+    MODELEDIT_TRACE_SPAN("LinkNode::toURDF");
+    JointNode* parentjoint = parentJoint();
+    if (!parentjoint) {
+        return;
+    }
+    string linkName = parentjoint->name + "_LINK";
+    string meshfname = linkName;
+    // the accepted primitive fits take priority over the other collision shapes
+    vector<const PrimitiveShapeNode*> collisionPrimitives;
+    for (int i=0; i < numChildren(); ++i) {
+        const PrimitiveShapeNode* primitive = dynamic_cast<const PrimitiveShapeNode*>(child(i));
+        if (primitive && primitive->name == "collision") {
+            collisionPrimitives.push_back(primitive);
+        }
+    }
+    // a separate collision shape such as the convex hulls is exported as it is
+    vector<ShapeTransform> collisionMeshes;
+    if (collisionPrimitives.empty() &&
+        link && link->collisionShape() && link->collisionShape() != link->visualShape()) {
+        collectShapeTransforms(link->collisionShape(), Affine3::Identity(), collisionMeshes);
+    }
+    bool hasCollisionMesh = collisionPrimitives.empty() && collisionMeshes.empty();
+    string visualfname;
+    if (urdfVisualMeshFormat == COLLADA) {
+        visualfname = meshfname + ".dae";
+        std::stringstream vrml;
+        MFNode shapes;
+        getShapeVRML(shapes);
+        if (!shapes.empty()) {
+            VRMLWriter writer(vrml);
+            writer.setOutFileName("temp");
+            for (size_t i=0; i < shapes.size(); ++i) {
+                writer.writeNode(shapes[i]);
+            }
+        }
+        Assimp::Importer importer;
+        const aiScene* ashape;
+        {
+            MODELEDIT_TRACE_SPAN("Assimp::ReadFileFromMemory");
+            MODELEDIT_TRACE_COUNTER("URDF mesh source bytes", vrml.str().length());
+            ashape = importer.ReadFileFromMemory(vrml.str().c_str(), vrml.str().length(), 0);
+        }
+        if (ashape) {
+            MODELEDIT_TRACE_SPAN("Assimp::Export");
+            Assimp::Exporter exporter;
+            exporter.Export(ashape, "collada", visualfname);
+            if (hasCollisionMesh) {
+                exporter.Export(ashape, "stl", meshfname + ".stl");
+            }
+        }
+    } else {
+        // the GLB file is written from the scene directly without the VRML text and Assimp
+        visualfname = meshfname + ".glb";
+        vector<ShapeTransform> visualMeshes;
+        if (link && link->visualShape()) {
+            collectShapeTransforms(link->visualShape(), Affine3::Identity(), visualMeshes);
+        }
+        if (!writeMeshGLB(visualfname, linkName, visualMeshes, urdfVisualMeshFormat == QUANTIZED_GLB)) {
+            os << "[URDF] cannot write " << visualfname << endl;
+        }
+        if (hasCollisionMesh) {
+            collisionMeshes = visualMeshes;
+            hasCollisionMesh = false;
+        }
+    }
+    ss << "<link name=\"" << linkName << "\">" << endl;
+    writeInertial(ss, mass, centerOfMass, momentsOfInertia);
+    ss << " <visual>" << endl;
+    ss << "  <geometry>" << endl;
+    ss << "   <mesh filename=\"" << visualfname << "\" />" << endl;
+    ss << "  </geometry>" << endl;
+    ss << " </visual>" << endl;
+    if (hasCollisionMesh) {
+        ss << " <collision>" << endl;
+        ss << "  <geometry>" << endl;
+        ss << "   <mesh filename=\"" << meshfname << ".stl\" />" << endl;
+        ss << "  </geometry>" << endl;
+        ss << " </collision>" << endl;
+    }
+    for (size_t i=0; i < collisionMeshes.size(); ++i) {
+        ostringstream collisionfname;
+        collisionfname << meshfname << "_collision" << i << ".stl";
+        if (!writeMeshSTL(collisionfname.str(), collisionMeshes[i])) {
+            os << "[URDF] cannot write " << collisionfname.str() << endl;
+        }
+        ss << " <collision>" << endl;
+        ss << "  <geometry>" << endl;
+        ss << "   <mesh filename=\"" << collisionfname.str() << "\" />" << endl;
+        ss << "  </geometry>" << endl;
+        ss << " </collision>" << endl;
+    }
+    for (size_t i=0; i < collisionPrimitives.size(); ++i) {
+        writePrimitiveCollisionURDF(ss, os, collisionPrimitives[i]);
+    }
+    ss << "</link>" << endl;
+}
+
+
+/**
+   The pose of the primitive is written relative to the link. The cylinder
+   axis is y in Choreonoid and z in URDF.
+*/
+void LinkNode::writePrimitiveCollisionURDF(std::ostream& ss, std::ostream& os, const PrimitiveShapeNode* primitive) const
+{
+    const string& pt = primitive->primitiveType;
+    if (pt != "Box" && pt != "Cylinder" && pt != "Sphere") {
+        os << "[URDF] unsupported primitive type " << pt << endl;
+        return;
+    }
+    const Vector3 p = rotation.transpose() * (primitive->translation - translation);
+    Matrix3 R = rotation.transpose() * primitive->rotation;
+    if (pt == "Cylinder") {
+        R = R * AngleAxis(-PI / 2.0, Vector3::UnitX()).toRotationMatrix();
+    }
+    ss << " <collision>" << endl;
+    ss << "  <origin xyz=\"" << VectorText(p) << "\" rpy=\"" << VectorText(rpyFromRot(R)) << "\"/>" << endl;
+    ss << "  <geometry>" << endl;
+    if (pt == "Box") {
+        ss << "   <box size=\"" << VectorText(primitive->boxSize) << "\" />" << endl;
+    } else if (pt == "Cylinder") {
+        ss << "   <cylinder radius=\"" << primitive->primitiveRadius
+           << "\" length=\"" << primitive->primitiveHeight << "\" />" << endl;
+    } else {
+        ss << "   <sphere radius=\"" << primitive->primitiveRadius << "\" />" << endl;
+    }
+    ss << "  </geometry>" << endl;
+    ss << " </collision>" << endl;
+}
+
+
+SensorNode::SensorNode()
+    : sensorType("camera"),
+      cameraType("COLOR"),
+      resolutionX(0),
+      resolutionY(0),
+      nearDistance(0.0),
+      farDistance(0.0),
+      fieldOfView(0.0),
+      frameRate(0.0),
+      maxForce(Vector3::Zero()),
+      maxTorque(Vector3::Zero()),
+      maxAngularVelocity(Vector3::Zero()),
+      maxAcceleration(Vector3::Zero()),
+      scanAngle(0.0),
+      scanStep(0.0),
+      scanRate(0.0),
+      minDistance(0.0),
+      maxDistance(0.0)
+{
+
+}
+
+
+ModelNode* SensorNode::clone() const
+{
+    return new SensorNode(*this);
+}
+
+
+void SensorNode::readDevice(Device* device)
+{
+    this->device = device;
+    name = device->name();
+    Affine3 position = device->link()->position() * device->T_local();
+    translation = position.translation();
+    rotation = position.rotation();
+
+    ForceSensor* fsensor = dynamic_cast<ForceSensor*>(device);
+    if (fsensor) {
+        sensorType = "force";
+        maxForce = fsensor->F_max().head<3>();
+        maxTorque = fsensor->F_max().tail<3>();
+    }
+    RateGyroSensor* gyro = dynamic_cast<RateGyroSensor*>(device);
+    if (gyro) {
+        sensorType = "gyro";
+        maxAngularVelocity = gyro->w_max();
+    }
+    AccelerationSensor* asensor = dynamic_cast<AccelerationSensor*>(device);
+    if (asensor) {
+        sensorType = "acceleration";
+        maxAcceleration = asensor->dv_max();
+    }
+    RangeSensor* rsensor = dynamic_cast<RangeSensor*>(device);
+    if (rsensor) {
+        sensorType = "range";
+        if (rsensor->yawRange() > 0)
+            scanAngle = rsensor->yawRange();
+        else
+            scanAngle = rsensor->pitchRange();
+        scanStep = rsensor->pitchStep();
+        scanRate = rsensor->frameRate();
+        minDistance = rsensor->minDistance();
+        maxDistance = rsensor->maxDistance();
+    }
+    Camera* camera = dynamic_cast<Camera*>(device);
+    if (camera) {
+        sensorType = "camera";
+        RangeCamera* range = dynamic_cast<RangeCamera*>(device);
+        if (range) {
+            if (range->isOrganized()) {
+                if (range->imageType() == Camera::NO_IMAGE) {
+                    cameraType = "DEPTH";
+                } else {
+                    cameraType = "COLOR_DEPTH";
+                }
+            } else {
+                if (range->imageType() == Camera::NO_IMAGE) {
+                    cameraType = "POINT_CLOUD";
+                } else {
+                    cameraType = "COLOR_POINT_CLOUD";
+                }
+            }
+        } else {
+            if (camera->imageType() == Camera::COLOR_IMAGE) {
+                cameraType = "COLOR";
+            } else {
+                cameraType = "NONE";
+            }
+        }
+        resolutionX = camera->resolutionX();
+        resolutionY = camera->resolutionY();
+        frameRate = camera->frameRate();
+        fieldOfView = camera->fieldOfView();
+        nearDistance = camera->nearDistance();
+        farDistance = camera->farDistance();
+    }
+}
+
+
+VRMLNodePtr SensorNode::toVRML() const
+{
+    MODELEDIT_TRACE_SPAN("SensorNode::toVRML");
+    VRMLTransformPtr node = NULL;
+    const string& st = sensorType;
+    if (st == "force") {
+        VRMLForceSensorPtr fnode = new VRMLForceSensor();
+        fnode->maxForce = maxForce;
+        fnode->maxTorque = maxTorque;
+        node = fnode;
+    } else if (st == "gyro") {
+        VRMLGyroPtr gnode = new VRMLGyro();
+        gnode->maxAngularVelocity = maxAngularVelocity;
+        node = gnode;
+    } else if (st == "acceleration") {
+        VRMLAccelerationSensorPtr anode = new VRMLAccelerationSensor();
+        anode->maxAcceleration = maxAcceleration;
+        node = anode;
+    } else if (st == "range") {
+        VRMLRangeSensorPtr rnode = new VRMLRangeSensor();
+        rnode->scanAngle = scanAngle;
+        rnode->scanStep = scanStep;
+        rnode->scanRate = scanRate;
+        rnode->minDistance = minDistance;
+        rnode->maxDistance = maxDistance;
+        node = rnode;
+    } else if (st == "camera") {
+        VRMLVisionSensorPtr cnode = new VRMLVisionSensor();
+        cnode->type = cameraType;
+        cnode->width = resolutionX;
+        cnode->height = resolutionY;
+        cnode->frameRate = frameRate;
+        cnode->fieldOfView = fieldOfView;
+        cnode->frontClipDistance = nearDistance;
+        cnode->backClipDistance = farDistance;
+        node = cnode;
+    }
+    if (node) {
+        node->defName = name;
+        Affine3 relative = relativePosition();
+        node->translation = relative.translation();
+        node->rotation = relative.rotation();
+    }
+    return node;
+}
+
+
+void SensorNode::writeURDF(std::ostream& ss, std::ostream& os) const
+{
+    // URDF does not describe sensors
+}
+
+
+PrimitiveShapeNode::PrimitiveShapeNode()
+    : mass(0.0),
+      centerOfMass(Vector3::Zero()),
+      momentsOfInertia(Matrix3::Identity()),
+      primitiveType("Box"),
+      primitiveColor(0.5f, 0.5f, 0.5f),
+      boxSize(0.1, 0.1, 0.1),
+      primitiveRadius(0.1),
+      primitiveHeight(0.1)
+{
+
+}
+
+
+ModelNode* PrimitiveShapeNode::clone() const
+{
+    return new PrimitiveShapeNode(*this);
+}
+
+
+void PrimitiveShapeNode::readLink(Link* link)
+{
+    name = link->name();
+    mass = link->mass();
+    centerOfMass = link->centerOfMass();
+    momentsOfInertia = link->I();
+    translation = link->translation();
+    rotation = link->rotation();
+}
+
+
+VRMLNodePtr PrimitiveShapeNode::toVRML() const
+{
+    MODELEDIT_TRACE_SPAN("PrimitiveShapeNode::toVRML");
+    VRMLSegmentPtr node;
+    node = new VRMLSegment();
+    node->mass = mass;
+    node->centerOfMass = centerOfMass;
+    MFFloat v(momentsOfInertia.data(), momentsOfInertia.data() + 9);
+    node->momentsOfInertia = v;
+    VRMLTransformPtr trans;
+    trans = new VRMLTransform();
+    JointNode* parentjoint = parentJoint();
+    if (parentjoint) {
+        node->defName = parentjoint->name + "_LINK";
+    } else {
+        node->defName = name;
+    }
+    Affine3 relative = relativePosition();
+    trans->translation = relative.translation();
+    trans->rotation = relative.rotation();
+    node->children.push_back(trans);
+    VRMLShapePtr shape;
+    shape = new VRMLShape();
+    trans->children.push_back(shape);
+    const string& pt = primitiveType;
+    if (pt == "Box") {
+        VRMLBoxPtr box = new VRMLBox();
+        box->size = boxSize;
+        shape->geometry = box;
+    }
+    if (pt == "Cone") {
+        VRMLConePtr cone = new VRMLCone();
+        cone->bottomRadius = primitiveRadius;
+        cone->height = primitiveHeight;
+        cone->bottom = true;
+        cone->side = true;
+        shape->geometry = cone;
+    }
+    if (pt == "Cylinder") {
+        VRMLCylinderPtr cylinder = new VRMLCylinder();
+        cylinder->radius = primitiveRadius;
+        cylinder->height = primitiveHeight;
+        cylinder->top = true;
+        cylinder->bottom = true;
+        cylinder->side = true;
+        shape->geometry = cylinder;
+    }
+    if (pt == "Sphere") {
+        VRMLSpherePtr sphere = new VRMLSphere();
+        sphere->radius = primitiveRadius;
+        shape->geometry = sphere;
+    }
+    return node;
+}
+
+
+void PrimitiveShapeNode::writeURDF(std::ostream& ss, std::ostream& os) const
+{
+    MODELEDIT_TRACE_SPAN("PrimitiveShapeNode::toURDF");
+    ss << "<link name=\"" << name << "\">" << endl;
+    writeInertial(ss, mass, centerOfMass, momentsOfInertia);
+    const string& pt = primitiveType;
+    for (int i=0; i < 2; i++) {
+        if (i == 0) {
+            ss << " <visual>" << endl;
+        } else {
+            ss << " <collision>" << endl;
+        }
+        if (pt == "Box") {
+            ss << "  <geometry>" << endl;
+            ss << "   <box size=\"" << VectorText(boxSize) << "\" />" << endl;
+            ss << "  </geometry>" << endl;
+        } else if (pt == "Cylinder") {
+            ss << "  <geometry>" << endl;
+            ss << "   <cylinder radius=\"" << primitiveRadius
+               << "\" length=\"" << primitiveHeight << "\" />" << endl;
+            ss << "  </geometry>" << endl;
+        } else if (pt == "Sphere") {
+            ss << "  <geometry>" << endl;
+            ss << "   <sphere radius=\"" << primitiveRadius << "\" />" << endl;
+            ss << "  </geometry>" << endl;
+        } else {
+            os << "[URDF] unsupported primitive type " << pt << endl;
+        }
+        if (i == 0) {
+            ss << " </visual>" << endl;
+        } else {
+            ss << " </collision>" << endl;
+        }
+    }
+    ss << "</link>" << endl;
+}
+
+
+ModelRootNode::ModelRootNode()
+{
+
+}
+
+
+ModelNode* ModelRootNode::clone() const
+{
+    return new ModelRootNode(*this);
+}
+
+
+VRMLNodePtr ModelRootNode::toVRML() const
+{
+    MODELEDIT_TRACE_SPAN("ModelRootNode::toVRML");
+    VRMLHumanoidPtr node;
+    node = new VRMLHumanoid();
+    addChildrenToVRML(node->humanoidBody);
+    return node;
+}
+
+
+void ModelRootNode::writeURDF(std::ostream& ss, std::ostream& os) const
+{
+    MODELEDIT_TRACE_SPAN("ModelRootNode::toURDF");
+    ss << "<robot name=\"" << name << "\">" << endl;
+    writeChildrenURDF(ss, os);
+    ss << "</robot>" << endl;
+}
+
+
+namespace {
+
+const char* SHARED_GEOMETRY_PREFIX = "SHARED_GEOMETRY_";
+
+void hashGeometryValue(size_t& seed, const Vector2& v)
+{
+    boost::hash_range(seed, v.data(), v.data() + 2);
+}
+
+void hashGeometryValue(size_t& seed, const Vector2f& v)
+{
+    boost::hash_range(seed, v.data(), v.data() + 2);
+}
+
+void hashGeometryValue(size_t& seed, const Vector3& v)
+{
+    boost::hash_range(seed, v.data(), v.data() + 3);
+}
+
+void hashGeometryValue(size_t& seed, const Vector3f& v)
+{
+    boost::hash_range(seed, v.data(), v.data() + 3);
+}
+
+void hashGeometryValue(size_t& seed, const AngleAxis& r)
+{
+    boost::hash_combine(seed, r.angle());
+    hashGeometryValue(seed, r.axis());
+}
+
+template<class ValueType>
+void hashGeometryValue(size_t& seed, const ValueType& value)
+{
+    boost::hash_combine(seed, value);
+}
+
+template<class ValueType, class Allocator>
+void hashGeometryValue(size_t& seed, const std::vector<ValueType, Allocator>& values)
+{
+    boost::hash_combine(seed, values.size());
+    for(size_t i=0; i < values.size(); ++i){
+        hashGeometryValue(seed, values[i]);
+    }
+}
+
+bool isSameGeometryValue(const AngleAxis& r1, const AngleAxis& r2)
+{
+    return r1.angle() == r2.angle() && r1.axis() == r2.axis();
+}
+
+template<class ValueType>
+bool isSameGeometryValue(const ValueType& value1, const ValueType& value2)
+{
+    return value1 == value2;
+}
+
+/// Takes the pairs of the fields of the same node for the hash
+struct GeometryHasher
+{
+    size_t hash;
+    GeometryHasher() : hash(0) { }
+    template<class ValueType>
+    bool operator()(const ValueType& value, const ValueType&) {
+        hashGeometryValue(hash, value);
+        return true;
+    }
+};
+
+struct GeometryComparator
+{
+    template<class ValueType>
+    bool operator()(const ValueType& value1, const ValueType& value2) const {
+        return isSameGeometryValue(value1, value2);
+    }
+};
+
+/**
+   Visits the fields of two geometry subtrees in parallel, which are written by
+   VRMLWriter, with the hasher or the comparator. Returns false when the visitor
+   finds a difference or a node which is not supported, whose subtree is not shared.
+*/
+template<class Visitor>
+bool visitGeometry(Visitor& v, VRMLNode* node1, VRMLNode* node2)
+{
+    if(!v(node1 != 0, node2 != 0)){
+        return false;
+    }
+    if(!node1){
+        return true;
+    }
+    if(!v(string(typeid(*node1).name()), string(typeid(*node2).name())) || !v(node1->defName, node2->defName)){
+        return false;
+    }
+    if(VRMLTransform* t1 = dynamic_cast<VRMLTransform*>(node1)){
+        VRMLTransform* t2 = static_cast<VRMLTransform*>(node2);
+        if(!v(t1->center, t2->center) || !v(t1->rotation, t2->rotation) || !v(t1->scale, t2->scale) ||
+           !v(t1->scaleOrientation, t2->scaleOrientation) || !v(t1->translation, t2->translation)){
+            return false;
+        }
+    }
+    if(VRMLGroup* g1 = dynamic_cast<VRMLGroup*>(node1)){
+        VRMLGroup* g2 = static_cast<VRMLGroup*>(node2);
+        if(!v(g1->children.size(), g2->children.size())){
+            return false;
+        }
+        for(size_t i=0; i < g1->children.size(); ++i){
+            if(!visitGeometry(v, g1->children[i].get(), g2->children[i].get())){
+                return false;
+            }
+        }
+        return true;
+
+    } else if(VRMLShape* s1 = dynamic_cast<VRMLShape*>(node1)){
+        VRMLShape* s2 = static_cast<VRMLShape*>(node2);
+        return visitGeometry(v, s1->appearance.get(), s2->appearance.get()) &&
+            visitGeometry(v, s1->geometry.get(), s2->geometry.get());
+
+    } else if(VRMLAppearance* a1 = dynamic_cast<VRMLAppearance*>(node1)){
+        VRMLAppearance* a2 = static_cast<VRMLAppearance*>(node2);
+        return visitGeometry(v, a1->material.get(), a2->material.get()) &&
+            visitGeometry(v, a1->texture.get(), a2->texture.get()) &&
+            visitGeometry(v, a1->textureTransform.get(), a2->textureTransform.get());
+
+    } else if(VRMLMaterial* m1 = dynamic_cast<VRMLMaterial*>(node1)){
+        VRMLMaterial* m2 = static_cast<VRMLMaterial*>(node2);
+        return v(m1->ambientIntensity, m2->ambientIntensity) && v(m1->diffuseColor, m2->diffuseColor) &&
+            v(m1->emissiveColor, m2->emissiveColor) && v(m1->shininess, m2->shininess) &&
+            v(m1->specularColor, m2->specularColor) && v(m1->transparency, m2->transparency);
+
+    } else if(VRMLImageTexture* i1 = dynamic_cast<VRMLImageTexture*>(node1)){
+        VRMLImageTexture* i2 = static_cast<VRMLImageTexture*>(node2);
+        return v(i1->url, i2->url) && v(i1->repeatS, i2->repeatS) && v(i1->repeatT, i2->repeatT);
+
+    } else if(VRMLTextureTransform* tt1 = dynamic_cast<VRMLTextureTransform*>(node1)){
+        VRMLTextureTransform* tt2 = static_cast<VRMLTextureTransform*>(node2);
+        return v(tt1->center, tt2->center) && v(tt1->rotation, tt2->rotation) &&
+            v(tt1->scale, tt2->scale) && v(tt1->translation, tt2->translation);
+
+    } else if(VRMLIndexedFaceSet* f1 = dynamic_cast<VRMLIndexedFaceSet*>(node1)){
+        VRMLIndexedFaceSet* f2 = static_cast<VRMLIndexedFaceSet*>(node2);
+        return v(f1->ccw, f2->ccw) && v(f1->convex, f2->convex) && v(f1->creaseAngle, f2->creaseAngle) &&
+            v(f1->solid, f2->solid) && v(f1->colorPerVertex, f2->colorPerVertex) &&
+            v(f1->normalPerVertex, f2->normalPerVertex) &&
+            v(f1->coordIndex, f2->coordIndex) && v(f1->normalIndex, f2->normalIndex) &&
+            v(f1->colorIndex, f2->colorIndex) && v(f1->texCoordIndex, f2->texCoordIndex) &&
+            visitGeometry(v, f1->coord.get(), f2->coord.get()) &&
+            visitGeometry(v, f1->normal.get(), f2->normal.get()) &&
+            visitGeometry(v, f1->color.get(), f2->color.get()) &&
+            visitGeometry(v, f1->texCoord.get(), f2->texCoord.get());
+
+    } else if(VRMLCoordinate* c1 = dynamic_cast<VRMLCoordinate*>(node1)){
+        return v(c1->point, static_cast<VRMLCoordinate*>(node2)->point);
+
+    } else if(VRMLNormal* n1 = dynamic_cast<VRMLNormal*>(node1)){
+        return v(n1->vector, static_cast<VRMLNormal*>(node2)->vector);
+
+    } else if(VRMLColor* col1 = dynamic_cast<VRMLColor*>(node1)){
+        return v(col1->color, static_cast<VRMLColor*>(node2)->color);
+
+    } else if(VRMLTextureCoordinate* tc1 = dynamic_cast<VRMLTextureCoordinate*>(node1)){
+        return v(tc1->point, static_cast<VRMLTextureCoordinate*>(node2)->point);
+
+    } else if(VRMLBox* b1 = dynamic_cast<VRMLBox*>(node1)){
+        return v(b1->size, static_cast<VRMLBox*>(node2)->size);
+
+    } else if(VRMLSphere* sp1 = dynamic_cast<VRMLSphere*>(node1)){
+        return v(sp1->radius, static_cast<VRMLSphere*>(node2)->radius);
+
+    } else if(VRMLCylinder* cy1 = dynamic_cast<VRMLCylinder*>(node1)){
+        VRMLCylinder* cy2 = static_cast<VRMLCylinder*>(node2);
+        return v(cy1->radius, cy2->radius) && v(cy1->height, cy2->height) &&
+            v(cy1->top, cy2->top) && v(cy1->bottom, cy2->bottom) && v(cy1->side, cy2->side);
+
+    } else if(VRMLCone* co1 = dynamic_cast<VRMLCone*>(node1)){
+        VRMLCone* co2 = static_cast<VRMLCone*>(node2);
+        return v(co1->bottomRadius, co2->bottomRadius) && v(co1->height, co2->height) &&
+            v(co1->bottom, co2->bottom) && v(co1->side, co2->side);
+    }
+    return false;
+}
+
+
+/// Placeholder of a shared geometry, which is written as its USE statement
+class VRMLSharedGeometryUse : public VRMLNode
+{
+public:
+    VRMLSharedGeometryUse(const string& name) { defName = name; }
+};
+
+
+/**
+   VRMLBodyWriter which writes the placeholders of the shared geometries.
+   The other nodes are written inline as VRMLBodyWriter does.
+*/
+class SharedGeometryWriter : public VRMLBodyWriter
+{
+public:
+    SharedGeometryWriter(std::ostream& out) : VRMLBodyWriter(out) {
+        registerNodeMethod(typeid(VRMLSharedGeometryUse), &SharedGeometryWriter::writeSharedGeometryUse);
+    }
+
+private:
+    void writeSharedGeometryUse(VRMLNodePtr node) {
+        out << indent << "USE " << node->defName << "\n";
+    }
+};
+
+
+/**
+   Shares the identical geometry of the segments by DEF and USE. The geometry
+   subtrees, which are the children of the transforms of the segments, are
+   grouped by the structural hash of their meshes, materials and transforms and
+   compared field by field. The first subtree of a group is wrapped by a group
+   with a DEF name and the others are replaced by the placeholders written by
+   SharedGeometryWriter. Only the generated transforms are modified, so the
+   original nodes shared with the items are kept as they are.
+*/
+class GeometryInstancer
+{
+public:
+    GeometryInstancer() : numShared(0) { }
+    void share(VRMLNode* root);
+
+private:
+    struct Instance
+    {
+        MFNode* nodes;
+        int index;
+    };
+    struct Geometry
+    {
+        VRMLNode* node;
+        vector<Instance> instances;
+    };
+    vector<Geometry> geometries;
+    map<size_t, vector<int> > buckets;
+    map<VRMLNode*, int> nodeGeometries;
+    int numShared;
+
+    void collect(VRMLNode* node);
+    void addInstance(MFNode& nodes, int index);
+};
+
+}
+
+
+void GeometryInstancer::share(VRMLNode* root)
+{
+    MODELEDIT_TRACE_SPAN("GeometryInstancer::share");
+
+    collect(root);
+    for(size_t i=0; i < geometries.size(); ++i){
+        const vector<Instance>& instances = geometries[i].instances;
+        if(instances.size() < 2){
+            continue;
+        }
+        ostringstream name;
+        name << SHARED_GEOMETRY_PREFIX << numShared++;
+        VRMLGroupPtr definition = new VRMLGroup();
+        definition->defName = name.str();
+        definition->children.push_back((*instances[0].nodes)[instances[0].index]);
+        (*instances[0].nodes)[instances[0].index] = definition;
+        for(size_t j=1; j < instances.size(); ++j){
+            (*instances[j].nodes)[instances[j].index] = new VRMLSharedGeometryUse(name.str());
+        }
+    }
+    MODELEDIT_TRACE_COUNTER("VRML shared geometries", numShared);
+}
+
+
+void GeometryInstancer::collect(VRMLNode* node)
+{
+    if(VRMLHumanoid* humanoid = dynamic_cast<VRMLHumanoid*>(node)){
+        for(size_t i=0; i < humanoid->humanoidBody.size(); ++i){
+            collect(humanoid->humanoidBody[i].get());
+        }
+    } else if(VRMLSegment* segment = dynamic_cast<VRMLSegment*>(node)){
+        for(size_t i=0; i < segment->children.size(); ++i){
+            if(VRMLTransform* trans = dynamic_cast<VRMLTransform*>(segment->children[i].get())){
+                for(size_t j=0; j < trans->children.size(); ++j){
+                    addInstance(trans->children, j);
+                }
+            }
+        }
+    } else if(VRMLGroup* group = dynamic_cast<VRMLGroup*>(node)){
+        for(size_t i=0; i < group->children.size(); ++i){
+            collect(group->children[i].get());
+        }
+    }
+}
+
+
+void GeometryInstancer::addInstance(MFNode& nodes, int index)
+{
+    Instance instance;
+    instance.nodes = &nodes;
+    instance.index = index;
+
+    // a node shared by the original model is not hashed again
+    VRMLNode* node = nodes[index].get();
+    map<VRMLNode*, int>::iterator p = nodeGeometries.find(node);
+    if(p != nodeGeometries.end()){
+        geometries[p->second].instances.push_back(instance);
+        return;
+    }
+    GeometryHasher hasher;
+    if(!visitGeometry(hasher, node, node)){
+        return;
+    }
+    vector<int>& bucket = buckets[hasher.hash];
+    int geometry = -1;
+    GeometryComparator comparator;
+    for(size_t i=0; i < bucket.size(); ++i){
+        if(visitGeometry(comparator, geometries[bucket[i]].node, node)){
+            geometry = bucket[i];
+            break;
+        }
+    }
+    if(geometry < 0){
+        geometry = geometries.size();
+        geometries.push_back(Geometry());
+        geometries.back().node = node;
+        bucket.push_back(geometry);
+    }
+    geometries[geometry].instances.push_back(instance);
+    nodeGeometries[node] = geometry;
+}
+
+
+bool ModelRootNode::saveVRML(const std::string& filename) const
+{
+    MODELEDIT_TRACE_SPAN("ModelRootNode::saveVRML");
+    VRMLNodePtr node = toVRMLInParallel();
+    GeometryInstancer instancer;
+    instancer.share(node.get());
+
+    ModelFileOutput out(filename);
+    SharedGeometryWriter writer(out.stream());
+    writer.setOutFileName(filename);
+    writer.writeHeader();
+
+    out.stream() << endl;
+    writeOpenHRPProtoDeclarations(out.stream());
+
+    writer.writeNode(node);
+    return out.close();
+}
+
+
+bool ModelRootNode::saveURDF(const std::string& filename, std::ostream& os) const
+{
+    MODELEDIT_TRACE_SPAN("ModelRootNode::saveURDF");
+    ModelFileOutput out(filename);
+    writeURDF(out.stream(), os);
+    return out.close();
+}
+
+
+bool ModelRootNode::saveSDF(const std::string& filename, std::ostream& os) const
+{
+    MODELEDIT_TRACE_SPAN("ModelRootNode::saveSDF");
+    sdf::SDFPtr robot(new sdf::SDF());
+    sdf::init(robot);
+    sdf::readString(toURDF(os), robot);
+    ModelFileOutput out(filename);
+    out.stream() << robot->ToString();
+    return out.close();
+}
+
+
+namespace {
+
+/**
+   The model is loaded from sourceFilename, and filename is the name of the
+   model file which is different when the source is decompressed.
+*/
+ModelRootNodePtr loadModelTreeFile(const string& filename, const string& sourceFilename, std::ostream& os)
+{
+    string extension = boost::algorithm::to_lower_copy(filesystem::path(sourceFilename).extension().string());
+    if (extension == ".urdf") {
+        return loadURDFModelTree(sourceFilename, os);
+    } else if (extension == ".sdf") {
+        return loadSDFModelTree(sourceFilename, os);
+    }
+
+    BodyLoader bodyLoader;
+    bodyLoader.setMessageSink(os);
+    BodyPtr body = bodyLoader.load(sourceFilename);
+    if(!body){
+        return 0;
+    }
+    ModelRootNodePtr root = createRootNode(body, filename);
+    Link* link = body->rootLink();
+
+    AbstractBodyLoaderPtr loader = bodyLoader.lastActualBodyLoader();
+    VRMLBodyLoader* vloader = dynamic_cast<VRMLBodyLoader*>(loader.get());
+    if (vloader) {
+        // VRMLBodyLoader supports retriveOriginalNode function
+        addLinkTree(root, link, vloader);
+    } else if (sourceFilename != filename) {
+        // the inline node cannot refer to the decompressed file, which is removed after loading
+        os << "The compressed model file " << filename << " is not a VRML file" << endl;
+        return 0;
+    } else {
+        // Other loaders dont, so we wrap with inline node
+        VRMLProtoInstance* proto = new VRMLProtoInstance(new VRMLProto(""));
+        MFNode* children = new MFNode();
+        VRMLInlinePtr inl = new VRMLInline();
+        inl->urls.push_back(filename);
+        children->push_back(inl);
+        proto->fields["children"] = *children;
+        // first, create joint node
+        JointNodePtr joint = new JointNode;
+        joint->readLink(link);
+        joint->originalNode = proto;
+        root->addChild(joint);
+        // next, create link node under the joint node
+        LinkNodePtr linkNode = new LinkNode;
+        linkNode->readLink(link);
+        linkNode->originalNode = proto;
+        linkNode->name = "link";
+        joint->addChild(linkNode);
+    }
+    addSensorNodes(root);
+    return root;
+}
+
+}
+
+
+/**
+   A compressed file is decompressed block by block into a hidden file next to
+   it, where the relative URLs of the model are valid, because the loaders only
+   read the files. The system temporary directory is used when the directory
+   of the model is not writable, which is warned to os because the relative
+   URLs cannot be resolved there.
+*/
+ModelRootNodePtr cnoid::loadModelTree(const std::string& filename, std::ostream& os)
+{
+    MODELEDIT_TRACE_SPAN("loadModelTree");
+
+    if (modelFileCompression(filename) == NO_COMPRESSION) {
+        return loadModelTreeFile(filename, filename, os);
+    }
+    filesystem::path uncompressed(uncompressedFileName(filename));
+    if (uncompressed.extension().empty()) {
+        uncompressed.replace_extension(".wrl");
+    }
+    const string tempName =
+        "." + uncompressed.stem().string() + "-" + filesystem::unique_path("%%%%%%%%").string() +
+        uncompressed.extension().string();
+    filesystem::path source = uncompressed.parent_path() / tempName;
+    bool decompressed = decompressModelFile(filename, source.string(), os);
+    if (!decompressed && !filesystem::exists(source)) {
+        source = filesystem::temp_directory_path() / tempName;
+        decompressed = decompressModelFile(filename, source.string(), os);
+        if (decompressed) {
+            os << filename << " is decompressed into " << source.parent_path().string()
+               << " because its directory is not writable. The relative URLs of the model may not be resolved." << endl;
+        }
+    }
+    ModelRootNodePtr root;
+    if (decompressed) {
+        root = loadModelTreeFile(filename, source.string(), os);
+    }
+    boost::system::error_code error;
+    filesystem::remove(source, error);
+    return root;
+}
+
+
+ModelRootNodePtr cnoid::createModelTree(Body* body, const std::string& filename)
+{
+    ModelRootNodePtr root = createRootNode(body, filename);
+    addLinkTree(root, body->rootLink(), 0);
+    addSensorNodes(root);
+    return root;
+}
+
+
+void cnoid::writeOpenHRPProtoDeclarations(std::ostream& of)
+{
+    of << "PROTO Joint [" << endl;
+    of << "  exposedField     SFVec3f      center              0 0 0" << endl;
+    of << "  exposedField     MFNode       children            []" << endl;
+    of << "  exposedField     MFFloat      llimit              []" << endl;
+    of << "  exposedField     MFFloat      lvlimit             []" << endl;
+    of << "  exposedField     SFRotation   limitOrientation    0 0 1 0" << endl;
+    of << "  exposedField     SFString     name                \"\"" << endl;
+    of << "  exposedField     SFRotation   rotation            0 0 1 0" << endl;
+    of << "  exposedField     SFVec3f      scale               1 1 1" << endl;
+    of << "  exposedField     SFRotation   scaleOrientation    0 0 1 0" << endl;
+    of << "  exposedField     MFFloat      stiffness           [ 0 0 0 ]" << endl;
+    of << "  exposedField     SFVec3f      translation         0 0 0" << endl;
+    of << "  exposedField     MFFloat      ulimit              []" << endl;
+    of << "  exposedField     MFFloat      uvlimit             []" << endl;
+    of << "  exposedField     SFString     jointType           \"\"" << endl;
+    of << "  exposedField     SFInt32      jointId             -1" << endl;
+    of << "  exposedField     SFVec3f      jointAxis           0 0 1" << endl;
+    of << endl;
+    of << "  exposedField     SFFloat      gearRatio           1" << endl;
+    of << "  exposedField     SFFloat      rotorInertia        0" << endl;
+    of << "  exposedField     SFFloat      rotorResistor       0" << endl;
+    of << "  exposedField     SFFloat      torqueConst         1" << endl;
+    of << "  exposedField     SFFloat      encoderPulse        1" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    center           IS center" << endl;
+    of << "    children         IS children" << endl;
+    of << "    rotation         IS rotation" << endl;
+    of << "    scale            IS scale" << endl;
+    of << "    scaleOrientation IS scaleOrientation" << endl;
+    of << "    translation      IS translation" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO Segment [" << endl;
+    of << "  field           SFVec3f     bboxCenter        0 0 0" << endl;
+    of << "  field           SFVec3f     bboxSize          -1 -1 -1" << endl;
+    of << "  exposedField    SFVec3f     centerOfMass      0 0 0" << endl;
+    of << "  exposedField    MFNode      children          [ ]" << endl;
+    of << "  exposedField    SFNode      coord             NULL" << endl;
+    of << "  exposedField    MFNode      displacers        [ ]" << endl;
+    of << "  exposedField    SFFloat     mass              0" << endl;
+    of << "  exposedField    MFFloat     momentsOfInertia  [ 0 0 0 0 0 0 0 0 0 ]" << endl;
+    of << "  exposedField    SFString    name              \"\"" << endl;
+    of << "  eventIn         MFNode      addChildren" << endl;
+    of << "  eventIn         MFNode      removeChildren" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Group {" << endl;
+    of << "    addChildren    IS addChildren" << endl;
+    of << "    bboxCenter     IS bboxCenter" << endl;
+    of << "    bboxSize       IS bboxSize" << endl;
+    of << "    children       IS children" << endl;
+    of << "    removeChildren IS removeChildren" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO Humanoid [" << endl;
+    of << "  field           SFVec3f    bboxCenter            0 0 0" << endl;
+    of << "  field           SFVec3f    bboxSize              -1 -1 -1" << endl;
+    of << "  exposedField    SFVec3f    center                0 0 0" << endl;
+    of << "  exposedField    MFNode     humanoidBody          [ ]" << endl;
+    of << "  exposedField    MFString   info                  [ ]" << endl;
+    of << "  exposedField    MFNode     joints                [ ]" << endl;
+    of << "  exposedField    SFString   name                  \"\"" << endl;
+    of << "  exposedField    SFRotation rotation              0 0 1 0" << endl;
+    of << "  exposedField    SFVec3f    scale                 1 1 1" << endl;
+    of << "  exposedField    SFRotation scaleOrientation      0 0 1 0" << endl;
+    of << "  exposedField    MFNode     segments              [ ]" << endl;
+    of << "  exposedField    MFNode     sites                 [ ]" << endl;
+    of << "  exposedField    SFVec3f    translation           0 0 0" << endl;
+    of << "  exposedField    SFString   version               \"1.1\"" << endl;
+    of << "  exposedField    MFNode     viewpoints            [ ]" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    bboxCenter       IS bboxCenter" << endl;
+    of << "    bboxSize         IS bboxSize" << endl;
+    of << "    center           IS center" << endl;
+    of << "    rotation         IS rotation" << endl;
+    of << "    scale            IS scale" << endl;
+    of << "    scaleOrientation IS scaleOrientation" << endl;
+    of << "    translation      IS translation" << endl;
+    of << "    children [" << endl;
+    of << "      Group {" << endl;
+    of << "        children IS viewpoints" << endl;
+    of << "      }" << endl;
+    of << "      Group {" << endl;
+    of << "        children IS humanoidBody" << endl;
+    of << "      }" << endl;
+    of << "    ]" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO ExtraJoint [" << endl;
+    of << "  exposedField SFString link1Name \"\"" << endl;
+    of << "  exposedField SFString link2Name \"\"" << endl;
+    of << "  exposedField SFVec3f  link1LocalPos 0 0 0" << endl;
+    of << "  exposedField SFVec3f  link2LocalPos 0 0 0" << endl;
+    of << "  exposedField SFString jointType \"xyz\"" << endl;
+    of << "  exposedField SFVec3f  jointAxis 1 0 0" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO VisionSensor [" << endl;
+    of << "  exposedField SFVec3f    translation       0 0 0" << endl;
+    of << "  exposedField SFRotation rotation          0 0 1 0" << endl;
+    of << "  exposedField SFFloat    fieldOfView       0.785398" << endl;
+    of << "  exposedField SFString   name              \"\"" << endl;
+    of << "  exposedField SFFloat    frontClipDistance 0.01" << endl;
+    of << "  exposedField SFFloat    backClipDistance  10.0" << endl;
+    of << "  exposedField SFString   type              \"NONE\"" << endl;
+    of << "  exposedField SFInt32    sensorId          -1" << endl;
+    of << "  exposedField SFInt32    width             320" << endl;
+    of << "  exposedField SFInt32    height            240" << endl;
+    of << "  exposedField SFFloat    frameRate         30" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    rotation         IS rotation" << endl;
+    of << "    translation      IS translation" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO ForceSensor [" << endl;
+    of << "  exposedField SFVec3f maxForce -1 -1 -1" << endl;
+    of << "  exposedField SFVec3f maxTorque -1 -1 -1" << endl;
+    of << "  exposedField SFVec3f translation 0 0 0" << endl;
+    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
+    of << "  exposedField SFInt32 sensorId -1" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    translation IS translation" << endl;
+    of << "    rotation IS rotation" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO Gyro [" << endl;
+    of << "  exposedField SFVec3f maxAngularVelocity -1 -1 -1" << endl;
+    of << "  exposedField SFVec3f translation 0 0 0" << endl;
+    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
+    of << "  exposedField SFInt32 sensorId -1" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    translation IS translation" << endl;
+    of << "    rotation IS rotation" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO AccelerationSensor [" << endl;
+    of << "  exposedField SFVec3f maxAcceleration -1 -1 -1" << endl;
+    of << "  exposedField SFVec3f translation 0 0 0" << endl;
+    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
+    of << "  exposedField SFInt32 sensorId -1" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    translation IS translation" << endl;
+    of << "    rotation IS rotation" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO PressureSensor [" << endl;
+    of << "  exposedField SFFloat maxPressure -1" << endl;
+    of << "  exposedField SFVec3f translation 0 0 0" << endl;
+    of << "  exposedField SFRotation rotation 0 0 1 0" << endl;
+    of << "  exposedField SFInt32 sensorId -1" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    translation IS translation" << endl;
+    of << "    rotation IS rotation" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO PhotoInterrupter [" << endl;
+    of << "  exposedField SFVec3f transmitter 0 0 0" << endl;
+    of << "  exposedField SFVec3f receiver 0 0 0" << endl;
+    of << "  exposedField SFInt32 sensorId -1" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform{" << endl;
+    of << "    children [" << endl;
+    of << "      Transform{" << endl;
+    of << "        translation IS transmitter" << endl;
+    of << "      }" << endl;
+    of << "      Transform{" << endl;
+    of << "        translation IS receiver" << endl;
+    of << "      }" << endl;
+    of << "    ]" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+    of << "PROTO RangeSensor [" << endl;
+    of << "  exposedField SFVec3f    translation       0 0 0" << endl;
+    of << "  exposedField SFRotation rotation          0 0 1 0" << endl;
+    of << "  exposedField MFNode     children          [ ]" << endl;
+    of << "  exposedField SFInt32    sensorId          -1" << endl;
+    of << "  exposedField SFFloat    scanAngle         3.14159 #[rad]" << endl;
+    of << "  exposedField SFFloat    scanStep          0.1     #[rad]" << endl;
+    of << "  exposedField SFFloat    scanRate          10      #[Hz]" << endl;
+    of << "  exposedField SFFloat    minDistance       0.01" << endl;
+    of << "  exposedField SFFloat    maxDistance       10" << endl;
+    of << "]" << endl;
+    of << "{" << endl;
+    of << "  Transform {" << endl;
+    of << "    rotation         IS rotation" << endl;
+    of << "    translation      IS translation" << endl;
+    of << "    children         IS children" << endl;
+    of << "  }" << endl;
+    of << "}" << endl;
+    of << endl;
+}
@@ -0,0 +1,265 @@
+/**
+   \file
+   Model data of the editor which does not depend on the GUI.
+   The items of the plugin are views of these nodes and the exporters work on the
+   node tree, so that a model can be loaded and exported without the item tree.
+   The parallel work uses only ModelEditWorkerPool::parallelFor, which runs
+   without the event loop.
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_MODEL_NODE_H
+#define CNOID_EDITMODEL_PLUGIN_MODEL_NODE_H
+
+#include <cnoid/Referenced>
+#include <cnoid/EigenTypes>
+#include <cnoid/Body>
+#include <cnoid/Link>
+#include <cnoid/Device>
+#include <cnoid/VRML>
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include "ModelAssetCache.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ModelNode;
+typedef ref_ptr<ModelNode> ModelNodePtr;
+class JointNode;
+class PrimitiveShapeNode;
+
+class CNOID_EXPORT ModelNode : public Referenced
+{
+public:
+    virtual ~ModelNode();
+
+    std::string name;
+    // position in the model coordinate
+    Vector3 translation;
+    Matrix3 rotation;
+    // parsed VRML node of the source model if available
+    VRMLNodePtr originalNode;
+
+    ModelNode* parent() const { return parent_; }
+    int numChildren() const { return children_.size(); }
+    ModelNode* child(int index) const { return children_[index]; }
+    void addChild(ModelNode* node);
+    void removeChild(ModelNode* node);
+    ModelNode* findNode(const std::string& name);
+
+    /// Joint node to which this node is attached, or null for the root nodes
+    JointNode* parentJoint() const;
+
+    /// Position relative to the parent joint
+    Affine3 relativePosition() const;
+
+    virtual VRMLNodePtr toVRML() const = 0;
+    /// Writes the URDF text to ss. The messages of the unsupported nodes are put to os.
+    virtual void writeURDF(std::ostream& ss, std::ostream& os) const = 0;
+    std::string toURDF(std::ostream& os) const;
+
+    /**
+       Same as toVRML() but the independent subtrees are generated in the worker
+       threads. The result is identical to the one of toVRML().
+       The tree must not be modified until this returns.
+    */
+    VRMLNodePtr toVRMLInParallel() const;
+
+    /// Copies this node and its descendants. The copy has no parent.
+    ModelNodePtr cloneSubtree() const;
+
+protected:
+    ModelNode();
+    /// Copies the data of the node but not the parent and the children
+    ModelNode(const ModelNode& org);
+    virtual ModelNode* clone() const = 0;
+    void addChildrenToVRML(MFNode& nodes) const;
+    void writeChildrenURDF(std::ostream& ss, std::ostream& os) const;
+
+private:
+    ModelNode* parent_;
+    std::vector<ModelNodePtr> children_;
+    // subtree generated in a worker thread by toVRMLInParallel()
+    mutable VRMLNodePtr generatedVRML;
+
+    friend class ParallelVRMLGenerator;
+};
+
+
+class CNOID_EXPORT JointNode : public ModelNode
+{
+public:
+    JointNode();
+    void readLink(Link* link);
+
+    LinkPtr link;
+    int jointId;
+    std::string jointType;
+    Vector3 jointAxis;
+    double ulimit;
+    double llimit;
+    double uvlimit;
+    double lvlimit;
+    double gearRatio;
+    double rotorInertia;
+    double rotorResistor;
+    double torqueConst;
+    double encoderPulse;
+
+    virtual VRMLNodePtr toVRML() const;
+    virtual void writeURDF(std::ostream& ss, std::ostream& os) const;
+
+    /**
+       Composes the mass properties of the link and primitive nodes under the joint
+       by the parallel axis theorem. They are in the joint frame as in the VRML export.
+    */
+    void getMassProperties(double& out_mass, Vector3& out_c, Matrix3& out_I) const;
+
+protected:
+    virtual ModelNode* clone() const;
+};
+typedef ref_ptr<JointNode> JointNodePtr;
+
+
+class CNOID_EXPORT LinkNode : public ModelNode
+{
+public:
+    LinkNode();
+    void readLink(Link* link);
+
+    // the link keeps the visual and collision shapes
+    LinkPtr link;
+    double mass;
+    Vector3 centerOfMass;
+    Matrix3 momentsOfInertia;
+
+    virtual VRMLNodePtr toVRML() const;
+    virtual void writeURDF(std::ostream& ss, std::ostream& os) const;
+
+    enum VisualMeshFormat { COLLADA, GLB, QUANTIZED_GLB };
+
+    /// Format of the visual mesh files written by writeURDF, which is COLLADA by default
+    static void setVisualMeshFormat(VisualMeshFormat format);
+    static VisualMeshFormat visualMeshFormat();
+
+    /// VRML nodes of the geometry, regenerated from the scene when there is no original node
+    void getShapeVRML(MFNode& out_nodes) const;
+
+    /**
+       Shape nodes of the original node, whose references are not taken so that
+       this can be called from the worker threads
+    */
+    void collectOriginalShapes(std::vector<VRMLNode*>& out_nodes) const;
+
+protected:
+    virtual ModelNode* clone() const;
+
+private:
+    void writePrimitiveCollisionURDF(std::ostream& ss, std::ostream& os, const PrimitiveShapeNode* primitive) const;
+};
+typedef ref_ptr<LinkNode> LinkNodePtr;
+
+
+class CNOID_EXPORT SensorNode : public ModelNode
+{
+public:
+    SensorNode();
+    void readDevice(Device* device);
+
+    DevicePtr device;
+    std::string sensorType;
+    std::string cameraType;
+    int resolutionX;
+    int resolutionY;
+    double nearDistance;
+    double farDistance;
+    double fieldOfView;
+    double frameRate;
+    Vector3 maxForce;
+    Vector3 maxTorque;
+    Vector3 maxAngularVelocity;
+    Vector3 maxAcceleration;
+    double scanAngle;
+    double scanStep;
+    double scanRate;
+    double minDistance;
+    double maxDistance;
+
+    virtual VRMLNodePtr toVRML() const;
+    virtual void writeURDF(std::ostream& ss, std::ostream& os) const;
+
+protected:
+    virtual ModelNode* clone() const;
+};
+typedef ref_ptr<SensorNode> SensorNodePtr;
+
+
+class CNOID_EXPORT PrimitiveShapeNode : public ModelNode
+{
+public:
+    PrimitiveShapeNode();
+    void readLink(Link* link);
+
+    double mass;
+    Vector3 centerOfMass;
+    Matrix3 momentsOfInertia;
+    std::string primitiveType;
+    Vector3f primitiveColor;
+    Vector3 boxSize;
+    double primitiveRadius;
+    double primitiveHeight;
+
+    virtual VRMLNodePtr toVRML() const;
+    virtual void writeURDF(std::ostream& ss, std::ostream& os) const;
+
+protected:
+    virtual ModelNode* clone() const;
+};
+typedef ref_ptr<PrimitiveShapeNode> PrimitiveShapeNodePtr;
+
+
+/**
+   Root of a model. The children are the root joints of the model.
+*/
+class CNOID_EXPORT ModelRootNode : public ModelNode
+{
+public:
+    ModelRootNode();
+
+    // the loaded body which owns the links and devices
+    BodyPtr body;
+    // keeps the meshes and the images of the body in the shared asset cache
+    ModelAssetLeasePtr assets;
+
+    virtual VRMLNodePtr toVRML() const;
+    virtual void writeURDF(std::ostream& ss, std::ostream& os) const;
+
+    bool saveVRML(const std::string& filename) const;
+    bool saveURDF(const std::string& filename, std::ostream& os) const;
+    bool saveSDF(const std::string& filename, std::ostream& os) const;
+
+protected:
+    virtual ModelNode* clone() const;
+};
+typedef ref_ptr<ModelRootNode> ModelRootNodePtr;
+
+
+/**
+   Loads a model file supported by BodyLoader, a URDF file or an SDF file and creates the joint,
+   link and sensor nodes in the same structure as the item tree of EditableModelItem.
+*/
+CNOID_EXPORT ModelRootNodePtr loadModelTree(const std::string& filename, std::ostream& os);
+
+/**
+   Creates the model tree of a body built without the original VRML nodes, such
+   as the bodies of the importers. The geometry is exported from the link shapes.
+*/
+CNOID_EXPORT ModelRootNodePtr createModelTree(Body* body, const std::string& filename);
+
+/// Writes the PROTO declarations of the OpenHRP model format
+CNOID_EXPORT void writeOpenHRPProtoDeclarations(std::ostream& os);
+
+}
+
+#endif
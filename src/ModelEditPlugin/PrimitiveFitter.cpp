@@ -0,0 +1,385 @@
+/**
+   @file
+*/
+
+#include "PrimitiveFitter.h"
+#include "MeshTransform.h"
+#include "Trace.h"
+#include <cnoid/EigenUtil>
+#include <Eigen/Eigenvalues>
+#include <Eigen/LU>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// unaligned so that the points can be held by std::vector
+typedef Eigen::Matrix<double, 2, 1, Eigen::DontAlign> Vector2;
+
+/// Shuffles the points by a fixed sequence so that the fitting is reproducible
+template<class T> void shuffle(vector<T>& points)
+{
+    unsigned long state = 12345;
+    for(size_t i = points.size(); i > 1; --i){
+        state = state * 1103515245 + 12345;
+        std::swap(points[i - 1], points[(state >> 16) % i]);
+    }
+}
+
+/**
+   Ball of the Welzl's algorithm in 2D or 3D. The ball through the support
+   points is computed by solving the equations on their affine hull.
+*/
+template<int Dim>
+struct Ball
+{
+    typedef Eigen::Matrix<double, Dim, 1, Eigen::DontAlign> Point;
+    Point center;
+    double radius;
+
+    bool contains(const Point& p, double eps) const {
+        return (p - center).norm() <= radius + eps;
+    }
+
+    static Ball through(const Point* points, int n) {
+        Ball ball;
+        if(n == 1){
+            ball.center = points[0];
+            ball.radius = 0.0;
+            return ball;
+        }
+        // center = p0 + sum(a_i * (p_i - p0)) which is equidistant from the points
+        Eigen::MatrixXd A(n - 1, n - 1);
+        Eigen::VectorXd b(n - 1);
+        for(int i=1; i < n; ++i){
+            const Point vi = points[i] - points[0];
+            for(int j=1; j < n; ++j){
+                A(i - 1, j - 1) = 2.0 * vi.dot(points[j] - points[0]);
+            }
+            b(i - 1) = vi.squaredNorm();
+        }
+        Eigen::FullPivLU<Eigen::MatrixXd> lu(A);
+        if(!lu.isInvertible()){
+            // degenerate support, use the farthest pair
+            ball.radius = -1.0;
+            for(int i=0; i < n; ++i){
+                for(int j=i+1; j < n; ++j){
+                    const double r = (points[i] - points[j]).norm() / 2.0;
+                    if(r > ball.radius){
+                        ball.radius = r;
+                        ball.center = (points[i] + points[j]) / 2.0;
+                    }
+                }
+            }
+            return ball;
+        }
+        const Eigen::VectorXd a = lu.solve(b);
+        ball.center = points[0];
+        for(int i=1; i < n; ++i){
+            ball.center += a(i - 1) * (points[i] - points[0]);
+        }
+        ball.radius = (points[0] - ball.center).norm();
+        return ball;
+    }
+};
+
+/**
+   Move-to-front free iterative form of the Welzl's algorithm,
+   which has the expected linear time for the shuffled points.
+*/
+template<int Dim>
+class MinimalBall
+{
+public:
+    typedef typename Ball<Dim>::Point Point;
+
+    MinimalBall(const vector<Point>& points, double eps) : points(points), eps(eps) { }
+
+    Ball<Dim> compute() {
+        if(points.empty()){
+            Ball<Dim> ball;
+            ball.center.setZero();
+            ball.radius = 0.0;
+            return ball;
+        }
+        return computeSub(points.size(), 0);
+    }
+
+private:
+    const vector<Point>& points;
+    double eps;
+    Point support[Dim + 1];
+
+    Ball<Dim> computeSub(int n, int numSupports) {
+        Ball<Dim> ball;
+        int first = 0;
+        if(numSupports > 0){
+            ball = Ball<Dim>::through(support, numSupports);
+        } else {
+            ball.center = points[0];
+            ball.radius = 0.0;
+            first = 1;
+        }
+        if(numSupports == Dim + 1){
+            return ball;
+        }
+        for(int i=first; i < n; ++i){
+            if(!ball.contains(points[i], eps)){
+                support[numSupports] = points[i];
+                ball = computeSub(i, numSupports + 1);
+            }
+        }
+        return ball;
+    }
+};
+
+double distanceToBox(const Vector3& q, const Vector3& h)
+{
+    const Vector3 d = q.cwiseAbs() - h;
+    if(d.maxCoeff() <= 0.0){
+        return -d.maxCoeff();
+    }
+    return d.cwiseMax(Vector3::Zero()).norm();
+}
+
+double distanceToCylinder(const Vector3& q, double radius, double halfHeight)
+{
+    const double dr = sqrt(q.x() * q.x() + q.z() * q.z()) - radius;
+    const double dy = fabs(q.y()) - halfHeight;
+    if(dr <= 0.0 && dy <= 0.0){
+        return std::min(-dr, -dy);
+    }
+    return Vector2(std::max(dr, 0.0), std::max(dy, 0.0)).norm();
+}
+
+double distanceToSurface(const PrimitiveFit& fit, const Vector3& p)
+{
+    const Vector3 q = fit.rotation.transpose() * (p - fit.translation);
+    switch(fit.type){
+    case PrimitiveFit::BOX:
+        return distanceToBox(q, fit.boxSize / 2.0);
+    case PrimitiveFit::SPHERE:
+        return fabs(q.norm() - fit.radius);
+    default:
+        return distanceToCylinder(q, fit.radius, fit.height / 2.0);
+    }
+}
+
+/**
+   The surface is sampled at the centroid and the edge midpoints of each
+   triangle weighted by its area so that the vertices on the primitive surface
+   do not hide the faces between them.
+*/
+double calcError
+(const PrimitiveFit& fit, const vector<Vector3>& vertices, const vector<Eigen::Vector3i>& triangles, double size)
+{
+    double sum = 0.0;
+    double totalArea = 0.0;
+    for(size_t i=0; i < triangles.size(); ++i){
+        const Vector3& a = vertices[triangles[i][0]];
+        const Vector3& b = vertices[triangles[i][1]];
+        const Vector3& c = vertices[triangles[i][2]];
+        const double area = (b - a).cross(c - a).norm() / 2.0;
+        if(area <= 0.0){
+            continue;
+        }
+        const Vector3 samples[] = { (a + b + c) / 3.0, (a + b) / 2.0, (b + c) / 2.0, (c + a) / 2.0 };
+        double d2 = 0.0;
+        for(int k=0; k < 4; ++k){
+            const double d = distanceToSurface(fit, samples[k]);
+            d2 += d * d;
+        }
+        sum += area * d2 / 4.0;
+        totalArea += area;
+    }
+    if(totalArea <= 0.0){
+        return 0.0;
+    }
+    return sqrt(sum / totalArea) / size;
+}
+
+/// Principal axes of the surface, where the vertices are weighted by the areas of their triangles
+Matrix3 calcPrincipalAxes(const vector<Vector3>& vertices, const vector<Eigen::Vector3i>& triangles)
+{
+    vector<double> weights(vertices.size(), 0.0);
+    for(size_t i=0; i < triangles.size(); ++i){
+        const Eigen::Vector3i& t = triangles[i];
+        const double area = (vertices[t[1]] - vertices[t[0]]).cross(vertices[t[2]] - vertices[t[0]]).norm() / 2.0;
+        for(int k=0; k < 3; ++k){
+            weights[t[k]] += area / 3.0;
+        }
+    }
+    double total = 0.0;
+    Vector3 mean = Vector3::Zero();
+    for(size_t i=0; i < vertices.size(); ++i){
+        total += weights[i];
+        mean += weights[i] * vertices[i];
+    }
+    if(total <= 0.0){
+        return Matrix3::Identity();
+    }
+    mean /= total;
+    Matrix3 C = Matrix3::Zero();
+    for(size_t i=0; i < vertices.size(); ++i){
+        const Vector3 d = vertices[i] - mean;
+        C += weights[i] * d * d.transpose();
+    }
+    Eigen::SelfAdjointEigenSolver<Matrix3> solver(C);
+    Matrix3 R = solver.eigenvectors();
+    R.col(2) = R.col(0).cross(R.col(1));
+    return R;
+}
+
+PrimitiveFit fitBox(const vector<Vector3>& points, const Matrix3& R)
+{
+    PrimitiveFit fit;
+    fit.type = PrimitiveFit::BOX;
+    Vector3 min = R.transpose() * points.front();
+    Vector3 max = min;
+    for(size_t i=1; i < points.size(); ++i){
+        const Vector3 q = R.transpose() * points[i];
+        min = min.cwiseMin(q);
+        max = max.cwiseMax(q);
+    }
+    fit.rotation = R;
+    fit.translation = R * ((min + max) / 2.0);
+    fit.boxSize = max - min;
+    fit.volume = fit.boxSize.prod();
+    return fit;
+}
+
+PrimitiveFit fitSphere(const vector<Vector3>& vertices, double eps)
+{
+    vector<Ball<3>::Point> points(vertices.begin(), vertices.end());
+    shuffle(points);
+    Ball<3> ball = MinimalBall<3>(points, eps).compute();
+    PrimitiveFit fit;
+    fit.type = PrimitiveFit::SPHERE;
+    fit.translation = ball.center;
+    fit.rotation.setIdentity();
+    fit.radius = ball.radius;
+    fit.volume = 4.0 / 3.0 * PI * pow(fit.radius, 3.0);
+    return fit;
+}
+
+/// Cylinder along the principal axis of the index, whose cross section is the minimal enclosing circle
+PrimitiveFit fitCylinder(const vector<Vector3>& points, const Matrix3& axes, int axis, double eps)
+{
+    // the y axis of the cylinder is the principal axis and the frame is right handed
+    Matrix3 R;
+    R.col(0) = axes.col((axis + 2) % 3);
+    R.col(1) = axes.col(axis);
+    R.col(2) = axes.col((axis + 1) % 3);
+
+    vector<Vector2> projected(points.size());
+    double ymin = numeric_limits<double>::max();
+    double ymax = -numeric_limits<double>::max();
+    for(size_t i=0; i < points.size(); ++i){
+        const Vector3 q = R.transpose() * points[i];
+        projected[i] = Vector2(q.x(), q.z());
+        ymin = std::min(ymin, q.y());
+        ymax = std::max(ymax, q.y());
+    }
+    shuffle(projected);
+    Ball<2> circle = MinimalBall<2>(projected, eps).compute();
+
+    PrimitiveFit fit;
+    fit.type = PrimitiveFit::CYLINDER;
+    fit.rotation = R;
+    fit.translation = R * Vector3(circle.center.x(), (ymin + ymax) / 2.0, circle.center.y());
+    fit.radius = circle.radius;
+    fit.height = ymax - ymin;
+    fit.volume = PI * fit.radius * fit.radius * fit.height;
+    return fit;
+}
+
+bool compareErrors(const PrimitiveFit& fit1, const PrimitiveFit& fit2)
+{
+    return fit1.error < fit2.error;
+}
+
+}
+
+
+PrimitiveFit::PrimitiveFit()
+    : type(BOX),
+      translation(Vector3::Zero()),
+      rotation(Matrix3::Identity()),
+      boxSize(Vector3::Zero()),
+      radius(0.0),
+      height(0.0),
+      error(0.0),
+      volume(0.0)
+{
+
+}
+
+
+const char* PrimitiveFit::typeName() const
+{
+    switch(type){
+    case BOX: return "Box";
+    case SPHERE: return "Sphere";
+    default: return "Cylinder";
+    }
+}
+
+
+void cnoid::fitPrimitives(SgNode* scene, std::vector<PrimitiveFit>& out_fits)
+{
+    MODELEDIT_TRACE_SPAN("fitPrimitives");
+
+    out_fits.clear();
+    vector<Vector3> vertices;
+    vector<Eigen::Vector3i> triangles;
+    collectSceneTriangles(scene, vertices, triangles);
+    if(triangles.empty()){
+        return;
+    }
+
+    // only the vertices used by the triangles
+    vector<char> used(vertices.size(), 0);
+    vector<Vector3> points;
+    for(size_t i=0; i < triangles.size(); ++i){
+        for(int k=0; k < 3; ++k){
+            if(!used[triangles[i][k]]){
+                used[triangles[i][k]] = 1;
+                points.push_back(vertices[triangles[i][k]]);
+            }
+        }
+    }
+    Vector3 min = points.front();
+    Vector3 max = min;
+    for(size_t i=1; i < points.size(); ++i){
+        min = min.cwiseMin(points[i]);
+        max = max.cwiseMax(points[i]);
+    }
+    const double size = (max - min).norm();
+    if(size <= 0.0){
+        return;
+    }
+    const double eps = 1.0e-9 * size;
+
+    const Matrix3 axes = calcPrincipalAxes(vertices, triangles);
+    out_fits.push_back(fitBox(points, axes));
+    out_fits.push_back(fitSphere(points, eps));
+
+    // the cylinder along the axis with the smallest volume
+    PrimitiveFit cylinder;
+    for(int axis=0; axis < 3; ++axis){
+        PrimitiveFit fit = fitCylinder(points, axes, axis, eps);
+        if(axis == 0 || fit.volume < cylinder.volume){
+            cylinder = fit;
+        }
+    }
+    out_fits.push_back(cylinder);
+
+    for(size_t i=0; i < out_fits.size(); ++i){
+        out_fits[i].error = calcError(out_fits[i], vertices, triangles, size);
+    }
+    std::sort(out_fits.begin(), out_fits.end(), compareErrors);
+}
@@ -0,0 +1,54 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_PRIMITIVE_FITTER_H
+#define CNOID_EDITMODEL_PLUGIN_PRIMITIVE_FITTER_H
+
+#include <cnoid/SceneGraph>
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Primitive enclosing the triangles of a scene. The type names and the
+   parameters are the same as the ones of PrimitiveShapeItem.
+*/
+class CNOID_EXPORT PrimitiveFit
+{
+public:
+    enum Type { BOX, SPHERE, CYLINDER };
+
+    PrimitiveFit();
+
+    Type type;
+    /// Pose in the coordinate of the fitted scene. The axis of the cylinder is y.
+    Vector3 translation;
+    Matrix3 rotation;
+    Vector3 boxSize;
+    double radius;
+    double height;
+
+    /**
+       Area weighted root mean square distance from the triangles to the surface
+       of the primitive divided by the diagonal of the bounding box of the vertices
+    */
+    double error;
+    double volume;
+
+    const char* typeName() const;
+};
+
+/**
+   Fits an oriented bounding box by the principal axes of the surface, the
+   minimal enclosing sphere and the cylinder along the best of the principal
+   axes to the triangles of a scene. The fits are sorted by the error.
+   The scene is only read, so this can be called in a worker thread.
+*/
+CNOID_EXPORT void fitPrimitives(SgNode* scene, std::vector<PrimitiveFit>& out_fits);
+
+}
+
+#endif
@@ -23,7 +23,9 @@
 #include <cnoid/VRML>
 #include <cnoid/VRMLBody>
 #include <cnoid/MeshGenerator>
-#include "ModelEditDragger.h"
+#include "PropertyFormat.h"
+#include "Trace.h"
+#include "BulkEdit.h"
 #include <cnoid/FileUtil>
 #include <boost/bind.hpp>
 #include <boost/make_shared.hpp>
@@ -51,8 +53,10 @@ namespace cnoid {
 class PrimitiveShapeItemImpl
 {
 public:
+    static PrimitiveShapeItemImpl* implOf(PrimitiveShapeItem* item) { return item->impl; }
+
     PrimitiveShapeItem* self;
-    Link* link;
+    LinkPtr link;
     double mass;
     Vector3 centerOfMass;
     Matrix3 momentsOfInertia;
@@ -61,36 +65,29 @@ public:
     Vector3 boxSize;
     double primitiveRadius;
     double primitiveHeight;
-    bool isselected;
-
-    SgPosTransform* sceneLink;
-    SgShape* shape;
+    double fitError;
 
-    //ModelEditDraggerPtr positionDragger;
-    PositionDraggerPtr positionDragger;
-    Connection conSelectUpdate;
+    SgPosTransformPtr sceneLink;
+    SgShapePtr shape;
 
-    PrimitiveShapeItemImpl(PrimitiveShapeItem* self);
-    PrimitiveShapeItemImpl(PrimitiveShapeItem* self, Link* link);
+    PrimitiveShapeItemImpl(PrimitiveShapeItem* self, Link* link, const PrimitiveShapeNode* node);
     PrimitiveShapeItemImpl(PrimitiveShapeItem* self, const PrimitiveShapeItemImpl& org);
     ~PrimitiveShapeItemImpl();
     void doAssign(Item* srcItem);
         
     void init();
-    void attachPositionDragger();
-    void onDraggerStarted();
-    void onDraggerDragged();
+    void readNode(const PrimitiveShapeNode* node);
+    PrimitiveShapeNode* createNode() const;
+    void ensureScene();
+    void adjustDraggerSize(PositionDragger* dragger);
     void onUpdated();
     void onPositionChanged();
-    void onSelectionChanged();
+    void applyMirror(const Matrix3& S);
     void doPutProperties(PutPropertyFunction& putProperty);
-    bool setCenterOfMass(const std::string& v);
-    bool setInertia(const std::string& v);
+    static bool checkInertia(Matrix3& I);
+    static bool checkBoxSize(Vector3& size);
+    static bool checkColor(Vector3f& color);
     bool setPrimitiveType(const std::string& t);
-    bool setBoxSize(const std::string& v);
-    bool setPrimitiveColor(const std::string& v);
-    VRMLNodePtr toVRML();
-    string toURDF();
     bool store(Archive& archive);
     bool restore(const Archive& archive);
 };
@@ -112,29 +109,37 @@ void PrimitiveShapeItem::initializeClass(ExtensionManager* ext)
 
 PrimitiveShapeItem::PrimitiveShapeItem()
 {
-    impl = new PrimitiveShapeItemImpl(this);
+    LinkPtr link = new Link();
+    link->setShape(new SgPosTransform());
+    PrimitiveShapeNodePtr node = new PrimitiveShapeNode;
+    node->readLink(link);
+    readModelNode(node);
+    impl = new PrimitiveShapeItemImpl(this, link, node);
 }
 
 
-PrimitiveShapeItemImpl::PrimitiveShapeItemImpl(PrimitiveShapeItem* self)
-    : self(self)
+PrimitiveShapeItem::PrimitiveShapeItem(Link* link)
 {
-    link = new Link();
-    link->setShape(new SgPosTransform());
-    init();
+    PrimitiveShapeNodePtr node = new PrimitiveShapeNode;
+    node->readLink(link);
+    readModelNode(node);
+    impl = new PrimitiveShapeItemImpl(this, link, node);
 }
 
 
-PrimitiveShapeItem::PrimitiveShapeItem(Link* link)
+PrimitiveShapeItem::PrimitiveShapeItem(const PrimitiveShapeNode* node)
 {
-    impl = new PrimitiveShapeItemImpl(this, link);
+    readModelNode(node);
+    impl = new PrimitiveShapeItemImpl(this, new Link(), node);
 }
     
 
-PrimitiveShapeItemImpl::PrimitiveShapeItemImpl(PrimitiveShapeItem* self, Link* link)
+PrimitiveShapeItemImpl::PrimitiveShapeItemImpl(PrimitiveShapeItem* self, Link* link, const PrimitiveShapeNode* node)
+    : self(self),
+      link(link)
 {
-    this->link = link;
     init();
+    readNode(node);
 }
     
 
@@ -150,6 +155,16 @@ PrimitiveShapeItemImpl::PrimitiveShapeItemImpl(PrimitiveShapeItem* self, const P
 {
     link = org.link;
     init();
+
+    mass = org.mass;
+    centerOfMass = org.centerOfMass;
+    momentsOfInertia = org.momentsOfInertia;
+    primitiveType.selectIndex(org.primitiveType.selectedIndex());
+    primitiveColor = org.primitiveColor;
+    boxSize = org.boxSize;
+    primitiveRadius = org.primitiveRadius;
+    primitiveHeight = org.primitiveHeight;
+    fitError = org.fitError;
 }
 
 
@@ -187,107 +202,260 @@ void PrimitiveShapeItemImpl::init()
     primitiveType.setSymbol(2, "Cylinder");
     primitiveType.setSymbol(3, "Cone");
     primitiveType.select("Box");
-    primitiveColor[0] = 0.5f;
-    primitiveColor[1] = 0.5f;
-    primitiveColor[2] = 0.5f;
-    boxSize[0] = 0.1;
-    boxSize[1] = 0.1;
-    boxSize[2] = 0.1;
-    primitiveRadius = 0.1;
-    primitiveHeight = 0.1;
-
-    mass = link->mass();
-    centerOfMass = link->centerOfMass();
-    momentsOfInertia = link->I();
-    self->translation = link->translation();
-    self->rotation = link->rotation();
-    sceneLink = new SgPosTransform();
-    shape = NULL;
-    if (self->name().size() == 0)
-        self->setName(link->name());
-
-    attachPositionDragger();
+    fitError = -1.0;
 
     self->sigUpdated().connect(boost::bind(&PrimitiveShapeItemImpl::onUpdated, this));
     self->sigPositionChanged().connect(boost::bind(&PrimitiveShapeItemImpl::onPositionChanged, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&PrimitiveShapeItemImpl::onSelectionChanged, this));
-    isselected = false;
+}
+
+
+void PrimitiveShapeItemImpl::readNode(const PrimitiveShapeNode* node)
+{
+    mass = node->mass;
+    centerOfMass = node->centerOfMass;
+    momentsOfInertia = node->momentsOfInertia;
+    primitiveType.select(node->primitiveType);
+    primitiveColor = node->primitiveColor;
+    boxSize = node->boxSize;
+    primitiveRadius = node->primitiveRadius;
+    primitiveHeight = node->primitiveHeight;
+}
+
 
+PrimitiveShapeNode* PrimitiveShapeItemImpl::createNode() const
+{
+    PrimitiveShapeNode* node = new PrimitiveShapeNode;
+    node->mass = mass;
+    node->centerOfMass = centerOfMass;
+    node->momentsOfInertia = momentsOfInertia;
+    node->primitiveType = primitiveType.selectedSymbol();
+    node->primitiveColor = primitiveColor;
+    node->boxSize = boxSize;
+    node->primitiveRadius = primitiveRadius;
+    node->primitiveHeight = primitiveHeight;
+    return node;
+}
+
+
+/**
+   The scene is only needed when the item is shown, so it is created on the
+   first request of the scene. The dragger is shared in the model item.
+*/
+void PrimitiveShapeItemImpl::ensureScene()
+{
+    if (sceneLink)
+        return;
+
+    MODELEDIT_TRACE_SPAN("PrimitiveShapeItem::ensureScene");
+    sceneLink = new SgPosTransform();
     onUpdated();
 }
 
 
-void PrimitiveShapeItemImpl::attachPositionDragger()
+void PrimitiveShapeItemImpl::adjustDraggerSize(PositionDragger* dragger)
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&PrimitiveShapeItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&PrimitiveShapeItemImpl::onDraggerDragged, this));
+    ensureScene();
     BoundingBox bb = sceneLink->untransformedBoundingBox();
     if (bb.empty()) {
-        positionDragger->setRadius(0.1);
+        dragger->setRadius(0.1);
     } else {
-        positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
+        dragger->adjustSize(bb);
     }
-    sceneLink->addChild(positionDragger);
-    sceneLink->notifyUpdate();
-    self->notifyUpdate();
 }
 
 
-void PrimitiveShapeItemImpl::onSelectionChanged()
+PrimitiveShapeItem::~PrimitiveShapeItem()
+{
+    delete impl;
+}
+
+
+PrimitiveShapeItemImpl::~PrimitiveShapeItemImpl()
+{
+}
+
+
+Link* PrimitiveShapeItem::link() const
+{
+    return impl->link.get();
+}
+
+
+double PrimitiveShapeItem::mass() const
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
+    return impl->mass;
+}
+
+
+bool PrimitiveShapeItem::setMass(double m)
+{
+    if(m < 0.0){
+        return false;
     }
-    if (isselected != selected) {
-        isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
-        if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
-        } else {
-            positionDragger->setDraggerAlwaysHidden(true);
-        }
+    impl->mass = m;
+    requestUpdate();
+    return true;
+}
+
+
+const Vector3& PrimitiveShapeItem::centerOfMass() const
+{
+    return impl->centerOfMass;
+}
+
+
+void PrimitiveShapeItem::setCenterOfMass(const Vector3& c)
+{
+    impl->centerOfMass = c;
+    requestUpdate();
+}
+
+
+const Matrix3& PrimitiveShapeItem::inertia() const
+{
+    return impl->momentsOfInertia;
+}
+
+
+bool PrimitiveShapeItem::setInertia(const Matrix3& I)
+{
+    Matrix3 I2 = I;
+    if(!PrimitiveShapeItemImpl::checkInertia(I2)){
+        return false;
     }
+    impl->momentsOfInertia = I2;
+    requestUpdate();
+    return true;
 }
 
 
-void PrimitiveShapeItemImpl::onDraggerStarted()
+std::string PrimitiveShapeItem::primitiveType() const
 {
+    return impl->primitiveType.selectedSymbol();
 }
 
 
-void PrimitiveShapeItemImpl::onDraggerDragged()
+bool PrimitiveShapeItem::setPrimitiveType(const std::string& type)
 {
-    self->translation = positionDragger->draggedPosition().translation();
-    self->rotation = positionDragger->draggedPosition().rotation();
-    self->notifyUpdate();
+    if(!impl->primitiveType.select(type)){
+        return false;
+    }
+    requestUpdate();
+    return true;
 }
 
-PrimitiveShapeItem::~PrimitiveShapeItem()
+
+const Vector3& PrimitiveShapeItem::boxSize() const
 {
-    delete impl;
+    return impl->boxSize;
 }
 
 
-PrimitiveShapeItemImpl::~PrimitiveShapeItemImpl()
+bool PrimitiveShapeItem::setBoxSize(const Vector3& size)
 {
-    conSelectUpdate.disconnect();
+    Vector3 s = size;
+    if(!PrimitiveShapeItemImpl::checkBoxSize(s)){
+        return false;
+    }
+    impl->boxSize = s;
+    requestUpdate();
+    return true;
 }
 
 
-Link* PrimitiveShapeItem::link() const
+double PrimitiveShapeItem::primitiveRadius() const
+{
+    return impl->primitiveRadius;
+}
+
+
+bool PrimitiveShapeItem::setPrimitiveRadius(double r)
+{
+    if(r <= 0.0){
+        return false;
+    }
+    impl->primitiveRadius = r;
+    requestUpdate();
+    return true;
+}
+
+
+double PrimitiveShapeItem::primitiveHeight() const
+{
+    return impl->primitiveHeight;
+}
+
+
+bool PrimitiveShapeItem::setPrimitiveHeight(double h)
+{
+    if(h <= 0.0){
+        return false;
+    }
+    impl->primitiveHeight = h;
+    requestUpdate();
+    return true;
+}
+
+
+const Vector3f& PrimitiveShapeItem::primitiveColor() const
 {
-    return impl->link;
+    return impl->primitiveColor;
+}
+
+
+bool PrimitiveShapeItem::setPrimitiveColor(const Vector3f& color)
+{
+    Vector3f c = color;
+    if(!PrimitiveShapeItemImpl::checkColor(c)){
+        return false;
+    }
+    impl->primitiveColor = c;
+    requestUpdate();
+    return true;
+}
+
+
+double PrimitiveShapeItem::fitError() const
+{
+    return impl->fitError;
+}
+
+
+void PrimitiveShapeItem::setFitError(double error)
+{
+    impl->fitError = error;
+}
+
+
+void PrimitiveShapeItem::applyMirror(const Matrix3& S, const Vector3& offset)
+{
+    EditableModelBase::applyMirror(S, offset);
+    impl->applyMirror(S);
+}
+
+
+void PrimitiveShapeItem::adjustDraggerSize(PositionDragger* dragger)
+{
+    impl->adjustDraggerSize(dragger);
+}
+
+
+/**
+   The primitives are symmetric with regard to the planes of their local axes,
+   so only the mass properties have to be reflected.
+*/
+void PrimitiveShapeItemImpl::applyMirror(const Matrix3& S)
+{
+    centerOfMass = S * centerOfMass;
+    momentsOfInertia = S * momentsOfInertia * S;
 }
 
 
 void PrimitiveShapeItemImpl::onUpdated()
 {
+    MODELEDIT_TRACE_SPAN("PrimitiveShapeItem::onUpdated");
+    if (!sceneLink)
+        return;
     sceneLink->translation() = self->translation;
     sceneLink->rotation() = self->rotation;
     string pt(primitiveType.selectedSymbol());
@@ -332,138 +500,6 @@ void PrimitiveShapeItemImpl::onPositionChanged()
 }
 
 
-VRMLNodePtr PrimitiveShapeItem::toVRML()
-{
-    return impl->toVRML();
-}
-
-VRMLNodePtr PrimitiveShapeItemImpl::toVRML()
-{
-    VRMLSegmentPtr node;
-    node = new VRMLSegment();
-    node->mass = mass;
-    node->centerOfMass = centerOfMass;
-    MFFloat v(momentsOfInertia.data(), momentsOfInertia.data() + 9);
-    node->momentsOfInertia = v;
-    VRMLTransformPtr trans;
-    trans = new VRMLTransform();
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    if (parentjoint) {
-        node->defName = parentjoint->name() + "_LINK";
-        Affine3 parent, child, relative;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        trans->translation = relative.translation();
-        trans->rotation = relative.rotation();
-    } else {
-        node->defName = self->name();
-        trans->translation = self->translation;
-        trans->rotation = self->rotation;
-    }
-    node->children.push_back(trans);
-    VRMLShapePtr shape;
-    shape = new VRMLShape();
-    trans->children.push_back(shape);
-    string pt(primitiveType.selectedSymbol());
-    if (pt == "Box") {
-        VRMLBoxPtr box = new VRMLBox();
-        box->size = boxSize;
-        shape->geometry = box;
-    }
-    if (pt == "Cone") {
-        VRMLConePtr cone = new VRMLCone();
-        cone->bottomRadius = primitiveRadius;
-        cone->height = primitiveHeight;
-        cone->bottom = true;
-        cone->side = true;
-        shape->geometry = cone;
-    }
-    if (pt == "Cylinder") {
-        VRMLCylinderPtr cylinder = new VRMLCylinder();
-        cylinder->radius = primitiveRadius;
-        cylinder->height = primitiveHeight;
-        cylinder->top = true;
-        cylinder->bottom = true;
-        cylinder->side = true;
-        shape->geometry = cylinder;
-    }
-    if (pt == "Sphere") {
-        VRMLSpherePtr sphere = new VRMLSphere();
-        sphere->radius = primitiveRadius;
-        shape->geometry = sphere;
-    }
-    return node;
-}
-
-
-string PrimitiveShapeItem::toURDF()
-{
-    return impl->toURDF();
-}
-
-string PrimitiveShapeItemImpl::toURDF()
-{
-    ostringstream ss;
-    ss << "<link name=\"" << self->name() << "\">" << endl;
-    ss << " <inertial>" << endl;
-    ss << "  <mass value=\"" << mass << "\"/>" << endl;
-    ss << "  <origin xyz=\"" << centerOfMass << "\" rpy=\"0 0 0\"/>" << endl;
-    ss << "  <inertia ixx=\"" << momentsOfInertia(0, 0)
-       << "\" ixy=" << momentsOfInertia(0, 1)
-       << "\" ixz=" << momentsOfInertia(0, 2)
-       << "\" iyy=" << momentsOfInertia(1, 1)
-       << "\" iyz=" << momentsOfInertia(1, 2)
-       << "\" izz=" << momentsOfInertia(2, 2) << "\" />" << endl;
-    ss << " </inertial>" << endl;
-    Affine3 relative;
-    JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-    if (parentjoint) {
-        Affine3 parent, child;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-    } else {
-        relative.translation() = self->translation;
-        relative.linear() = self->rotation;
-    }
-    string pt(primitiveType.selectedSymbol());
-    for (int i=0; i < 2; i++) {
-        if (i == 0) {
-            ss << " <visual>" << endl;
-        } else {
-            ss << " <collision>" << endl;
-        }
-        if (pt == "Box") {
-            ss << "  <geometry>" << endl;
-            ss << "   <box size=\"" << boxSize << "\" />" << endl;
-            ss << "  </geometry>" << endl;
-        } else if (pt == "Cylinder") {
-            ss << "  <geometry>" << endl;
-            ss << "   <cylinder radius=\"" << primitiveRadius
-               << " length=\"" << primitiveHeight << "\" />" << endl;
-            ss << "  </geometry>" << endl;
-        } else if (pt == "Sphere") {
-            ss << "  <geometry>" << endl;
-            ss << "   <sphere radius=\"" << primitiveRadius << "\" />" << endl;
-            ss << "  </geometry>" << endl;
-        } else {
-            cout << "[URDF] unsupported primitive type " << pt << endl;
-        }
-        if (i == 0) {
-            ss << " </visual>" << endl;
-        } else {
-            ss << " </collision>" << endl;
-        }
-    }
-    return ss.str();
-}
-
-
 bool PrimitiveShapeItemImpl::setPrimitiveType(const std::string& t)
 {
     return primitiveType.select(t);
@@ -472,10 +508,17 @@ bool PrimitiveShapeItemImpl::setPrimitiveType(const std::string& t)
 
 SgNode* PrimitiveShapeItem::getScene()
 {
+    impl->ensureScene();
     return impl->sceneLink;
 }
 
 
+ModelNodePtr PrimitiveShapeItem::createModelNode() const
+{
+    return impl->createNode();
+}
+
+
 void PrimitiveShapeItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     EditableModelBase::doPutProperties(putProperty);
@@ -485,76 +528,54 @@ void PrimitiveShapeItem::doPutProperties(PutPropertyFunction& putProperty)
 
 void PrimitiveShapeItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 {
-    ostringstream oss;
-    putProperty.decimals(4)(_("Mass"), mass, changeProperty(mass));
-    putProperty(_("Center of mass"), str(Vector3(centerOfMass)),
-                boost::bind(&PrimitiveShapeItemImpl::setCenterOfMass, this, _1));
-    oss.str("");
-    oss << momentsOfInertia;
-    putProperty(_("Inertia"), oss.str(),
-                boost::bind(&PrimitiveShapeItemImpl::setInertia, this, _1));
-    putProperty(_("Primitive type"), primitiveType,
-                boost::bind(&Selection::selectIndex, &primitiveType, _1));
+    int numTargets = bulkEditTargets(self).size();
+    if(numTargets > 1){
+        putProperty(_("Edit targets"), numTargets);
+    }
+    putBulkProperty(putProperty.decimals(4), _("Mass"), self, &PrimitiveShapeItemImpl::mass);
+    putBulkVectorProperty(putProperty, _("Center of mass"), self, &PrimitiveShapeItemImpl::centerOfMass);
+    putBulkVectorProperty(putProperty, _("Inertia"), self, &PrimitiveShapeItemImpl::momentsOfInertia,
+                          &PrimitiveShapeItemImpl::checkInertia);
+    putBulkSelection(putProperty, _("Primitive type"), self, &PrimitiveShapeItemImpl::primitiveType);
     string pt(primitiveType.selectedSymbol());
     if (pt == "Box") {
-        putProperty(_("Box size"), str(boxSize),
-                    boost::bind(&PrimitiveShapeItemImpl::setBoxSize, this, _1));
+        putBulkVectorProperty(putProperty, _("Box size"), self, &PrimitiveShapeItemImpl::boxSize,
+                              &PrimitiveShapeItemImpl::checkBoxSize);
     }
     if (pt == "Cone") {
-        putProperty.decimals(4)(_("Cone radius"), primitiveRadius, changeProperty(primitiveRadius));
-        putProperty.decimals(4)(_("Cone height"), primitiveHeight, changeProperty(primitiveHeight));
+        putBulkProperty(putProperty.decimals(4), _("Cone radius"), self, &PrimitiveShapeItemImpl::primitiveRadius);
+        putBulkProperty(putProperty.decimals(4), _("Cone height"), self, &PrimitiveShapeItemImpl::primitiveHeight);
     }
     if (pt == "Cylinder") {
-        putProperty.decimals(4)(_("Cylinder radius"), primitiveRadius, changeProperty(primitiveRadius));
-        putProperty.decimals(4)(_("Cylinder height"), primitiveHeight, changeProperty(primitiveHeight));
+        putBulkProperty(putProperty.decimals(4), _("Cylinder radius"), self, &PrimitiveShapeItemImpl::primitiveRadius);
+        putBulkProperty(putProperty.decimals(4), _("Cylinder height"), self, &PrimitiveShapeItemImpl::primitiveHeight);
     }
     if (pt == "Sphere") {
-        putProperty.decimals(4)(_("Sphere radius"), primitiveRadius, changeProperty(primitiveRadius));
+        putBulkProperty(putProperty.decimals(4), _("Sphere radius"), self, &PrimitiveShapeItemImpl::primitiveRadius);
     }
-    oss.str("");
-    oss << primitiveColor;
-    putProperty(_("Color"), oss.str(),
-                boost::bind(&PrimitiveShapeItemImpl::setPrimitiveColor, this, _1));
-}
-
-
-bool PrimitiveShapeItemImpl::setCenterOfMass(const std::string& value)
-{
-    Vector3 p;
-    if(toVector3(value, p)){
-        centerOfMass = p;
-        return true;
+    putBulkVectorProperty(putProperty, _("Color"), self, &PrimitiveShapeItemImpl::primitiveColor,
+                          &PrimitiveShapeItemImpl::checkColor);
+    if(fitError >= 0.0){
+        putProperty.decimals(4)(_("Fit error"), fitError);
     }
-    return false;
 }
 
 
-bool PrimitiveShapeItemImpl::setInertia(const std::string& value)
+bool PrimitiveShapeItemImpl::checkInertia(Matrix3& I)
 {
-    return false;
+    return (I - I.transpose()).cwiseAbs().maxCoeff() <= 1.0e-6 * std::max(1.0, I.cwiseAbs().maxCoeff());
 }
 
-bool PrimitiveShapeItemImpl::setBoxSize(const std::string& value)
+
+bool PrimitiveShapeItemImpl::checkBoxSize(Vector3& size)
 {
-    Vector3 p;
-    if(toVector3(value, p)){
-        boxSize = p;
-        return true;
-    }
-    return false;
+    return size.minCoeff() > 0.0;
 }
 
 
-bool PrimitiveShapeItemImpl::setPrimitiveColor(const std::string& value)
+bool PrimitiveShapeItemImpl::checkColor(Vector3f& color)
 {
-    Vector3 p;
-    if(toVector3(value, p)){
-        primitiveColor[0] = p[0];
-        primitiveColor[1] = p[1];
-        primitiveColor[2] = p[2];
-        return true;
-    }
-    return false;
+    return color.minCoeff() >= 0.0f && color.maxCoeff() <= 1.0f;
 }
 
 
@@ -28,12 +28,34 @@ public:
         
     PrimitiveShapeItem();
     PrimitiveShapeItem(Link* link);
+    PrimitiveShapeItem(const PrimitiveShapeNode* node);
     PrimitiveShapeItem(const PrimitiveShapeItem& org);
     virtual ~PrimitiveShapeItem();
 
     Link* link() const;
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+
+    double mass() const;
+    bool setMass(double m);
+    const Vector3& centerOfMass() const;
+    void setCenterOfMass(const Vector3& c);
+    const Matrix3& inertia() const;
+    bool setInertia(const Matrix3& I);
+    std::string primitiveType() const;
+    bool setPrimitiveType(const std::string& type);
+    const Vector3& boxSize() const;
+    bool setBoxSize(const Vector3& size);
+    double primitiveRadius() const;
+    bool setPrimitiveRadius(double r);
+    double primitiveHeight() const;
+    bool setPrimitiveHeight(double h);
+    const Vector3f& primitiveColor() const;
+    bool setPrimitiveColor(const Vector3f& color);
+    /// Relative error of the fitting which proposed this shape, or a negative value
+    double fitError() const;
+    void setFitError(double error);
+    virtual ModelNodePtr createModelNode() const;
+    virtual void applyMirror(const Matrix3& S, const Vector3& offset);
+    virtual void adjustDraggerSize(PositionDragger* dragger);
 
     virtual SgNode* getScene();
 
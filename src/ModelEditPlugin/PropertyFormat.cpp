@@ -0,0 +1,156 @@
+/**
+   @file
+*/
+
+#include "PropertyFormat.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const bool TRACE_FUNCTIONS = false;
+
+inline bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',';
+}
+
+const char* skipSeparators(const char* p, const char* end)
+{
+    while(p != end && isSeparator(*p)){
+        ++p;
+    }
+    return p;
+}
+
+/**
+   Reads one number from [p, end). The locale independent std::from_chars is used
+   when the standard library provides it.
+*/
+const char* readNumber(const char* p, const char* end, double& out_value)
+{
+#if defined(__cpp_lib_to_chars)
+    if(p != end && *p == '+'){
+        ++p;
+    }
+    std::from_chars_result result = std::from_chars(p, end, out_value);
+    if(result.ec != std::errc()){
+        return 0;
+    }
+    return result.ptr;
+#else
+    char* next;
+    out_value = strtod(p, &next);
+    if(next == p || next > end){
+        return 0;
+    }
+    return next;
+#endif
+}
+
+}
+
+
+void PropertyText::append(const char* text)
+{
+    int n = strlen(text);
+    if(length_ + n >= CAPACITY){
+        n = CAPACITY - length_ - 1;
+    }
+    memcpy(buf + length_, text, n);
+    length_ += n;
+    buf[length_] = '\0';
+}
+
+
+void PropertyText::append(double value, int precision)
+{
+    if(value == 0.0){
+        // avoid showing "-0"
+        value = 0.0;
+    }
+    char* p = buf + length_;
+    int room = CAPACITY - length_ - 1;
+    if(room <= 0){
+        return;
+    }
+#if defined(__cpp_lib_to_chars)
+    std::to_chars_result result = std::to_chars(p, p + room, value, std::chars_format::general, precision);
+    if(result.ec != std::errc()){
+        return;
+    }
+    length_ = result.ptr - buf;
+#else
+    int n = snprintf(p, room + 1, "%.*g", precision, value);
+    if(n < 0){
+        return;
+    }
+    length_ += (n < room) ? n : room;
+#endif
+    buf[length_] = '\0';
+}
+
+
+bool cnoid::parseNumbers(const char* text, double* out_values, int n)
+{
+    const char* end = text + strlen(text);
+    const char* p = skipSeparators(text, end);
+    for(int i=0; i < n; ++i){
+        if(p == end){
+            return false;
+        }
+        double value;
+        const char* next = readNumber(p, end, value);
+        if(!next || !std::isfinite(value)){
+            return false;
+        }
+        if(next != end && !isSeparator(*next)){
+            return false;
+        }
+        out_values[i] = value;
+        p = skipSeparators(next, end);
+    }
+    return p == end;
+}
+
+
+bool cnoid::parseProperty(const std::string& text, double& out_value)
+{
+    return parseNumbers(text.c_str(), &out_value, 1);
+}
+
+
+bool cnoid::parseProperty(const std::string& text, int& out_value)
+{
+    double value;
+    if(!parseNumbers(text.c_str(), &value, 1) || value != std::floor(value) ||
+       value < INT_MIN || value > INT_MAX){
+        return false;
+    }
+    out_value = static_cast<int>(value);
+    return true;
+}
+
+
+bool cnoid::parseProperty(const std::string& text, bool& out_value)
+{
+    if(text == "true" || text == "1"){
+        out_value = true;
+    } else if(text == "false" || text == "0"){
+        out_value = false;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_PROPERTY_FORMAT_H
+#define CNOID_EDITMODEL_PLUGIN_PROPERTY_FORMAT_H
+
+#include <Eigen/Core>
+#include <boost/function.hpp>
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Fixed size text buffer used to format the property values without heap allocation.
+*/
+class CNOID_EXPORT PropertyText
+{
+public:
+    PropertyText() : length_(0) { buf[0] = '\0'; }
+
+    const char* c_str() const { return buf; }
+    int size() const { return length_; }
+    std::string str() const { return std::string(buf, length_); }
+
+    void append(double value, int precision = 6);
+    void append(const char* text);
+
+private:
+    enum { CAPACITY = 384 };
+    char buf[CAPACITY];
+    int length_;
+};
+
+/**
+   Parses exactly n numbers separated by white spaces or commas.
+   This fails when the number of values does not match or when the text
+   contains anything which is not a number.
+*/
+CNOID_EXPORT bool parseNumbers(const char* text, double* out_values, int n);
+
+/**
+   Scalar counterparts of the following template, used when a value is edited as text
+*/
+CNOID_EXPORT bool parseProperty(const std::string& text, double& out_value);
+CNOID_EXPORT bool parseProperty(const std::string& text, int& out_value);
+CNOID_EXPORT bool parseProperty(const std::string& text, bool& out_value);
+
+template<class Derived>
+bool parseProperty(const std::string& text, Eigen::MatrixBase<Derived>& out_value)
+{
+    enum {
+        Rows = Derived::RowsAtCompileTime,
+        Cols = Derived::ColsAtCompileTime
+    };
+    EIGEN_STATIC_ASSERT_FIXED_SIZE(Derived);
+    double values[Rows * Cols];
+    if(!parseNumbers(text.c_str(), values, Rows * Cols)){
+        return false;
+    }
+    // the text is written row by row
+    for(int i=0; i < Rows; ++i){
+        for(int j=0; j < Cols; ++j){
+            out_value(i, j) = values[i * Cols + j];
+        }
+    }
+    return true;
+}
+
+template<class Derived>
+PropertyText formatProperty(const Eigen::MatrixBase<Derived>& value, int precision = 6)
+{
+    PropertyText text;
+    for(int i=0; i < value.rows(); ++i){
+        for(int j=0; j < value.cols(); ++j){
+            if(i > 0 || j > 0){
+                text.append(" ");
+            }
+            text.append(value(i, j), precision);
+        }
+    }
+    return text;
+}
+
+template<class ValueType>
+class VectorPropertySetter
+{
+public:
+    VectorPropertySetter(ValueType& target) : target(&target) { }
+    bool operator()(const std::string& text) const {
+        ValueType value;
+        if(parseProperty(text, value)){
+            *target = value;
+            return true;
+        }
+        return false;
+    }
+private:
+    ValueType* target;
+};
+
+/**
+   Counterpart of changeProperty() for the fixed size Eigen types
+*/
+template<class ValueType>
+boost::function<bool(const std::string&)> changeVectorProperty(ValueType& target)
+{
+    return VectorPropertySetter<ValueType>(target);
+}
+
+}
+
+#endif
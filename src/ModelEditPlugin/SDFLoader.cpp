@@ -0,0 +1,514 @@
+/**
+   @file
+*/
+
+#include "SDFLoader.h"
+#include "ModelImporter.h"
+#include "Trace.h"
+#include <cnoid/EigenUtil>
+#include <cnoid/Sensor>
+#include <cnoid/Camera>
+#include <cnoid/RangeCamera>
+#include <cnoid/RangeSensor>
+#include <boost/format.hpp>
+#include <sdf/sdf.hh>
+#include <sstream>
+#include <map>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+// sdformat fills the omitted limits with these values
+const double unlimited = 1.0e16;
+
+struct SDFLink
+{
+    SDFLink() : pose(Affine3::Identity()), mass(0.0), inertial(Affine3::Identity()),
+                inertia(Matrix3::Identity()) { }
+    string name;
+    // in the model frame
+    Affine3 pose;
+    double mass;
+    // in the link frame
+    Affine3 inertial;
+    Matrix3 inertia;
+    vector<ImportedShape> visuals;
+    vector<ImportedShape> collisions;
+    vector<sdf::ElementPtr> sensors;
+};
+
+struct SDFJoint
+{
+    SDFJoint() : pose(Affine3::Identity()), axis(Vector3::UnitZ()), useParentModelFrame(false),
+                 lower(-unlimited), upper(unlimited), velocity(-1.0) { }
+    string name;
+    string type;
+    string parent;
+    string child;
+    // in the child link frame
+    Affine3 pose;
+    Vector3 axis;
+    bool useParentModelFrame;
+    double lower;
+    double upper;
+    double velocity;
+};
+
+class SDFLoader : public ModelImporter
+{
+public:
+    SDFLoader(const string& filename, ostream& os);
+    ModelRootNodePtr load();
+
+private:
+    sdf::SDFPtr document;
+    string modelName;
+    vector<SDFLink> links;
+    vector<SDFJoint> joints;
+    map<string, int> deviceCounts;
+
+    bool parse();
+    void readLink(sdf::ElementPtr element);
+    void readShape(sdf::ElementPtr element, vector<ImportedShape>& shapes, bool isVisual);
+    void readJoint(sdf::ElementPtr element);
+    BodyPtr createBody();
+    void addSensor(Body* body, Link* link, const Affine3& T, sdf::ElementPtr element);
+};
+
+
+bool readNumbers(const string& text, double* values, int n)
+{
+    istringstream is(text);
+    for(int i=0; i < n; ++i){
+        if(!(is >> values[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+sdf::ElementPtr firstElement(sdf::ElementPtr element, const char* name)
+{
+    if(element && element->HasElement(name)){
+        return element->GetElement(name);
+    }
+    return sdf::ElementPtr();
+}
+
+
+string elementText(sdf::ElementPtr element, const char* name)
+{
+    sdf::ElementPtr child = firstElement(element, name);
+    if(child && child->GetValue()){
+        return child->GetValue()->GetAsString();
+    }
+    return string();
+}
+
+
+string attributeText(sdf::ElementPtr element, const char* name)
+{
+    sdf::ParamPtr attribute = element->GetAttribute(name);
+    return attribute ? attribute->GetAsString() : string();
+}
+
+
+double elementDouble(sdf::ElementPtr element, const char* name, double defaultValue)
+{
+    double value;
+    return readNumbers(elementText(element, name), &value, 1) ? value : defaultValue;
+}
+
+
+Vector3 elementVector(sdf::ElementPtr element, const char* name, const Vector3& defaultValue)
+{
+    double v[3];
+    return readNumbers(elementText(element, name), v, 3) ? Vector3(v[0], v[1], v[2]) : defaultValue;
+}
+
+
+Affine3 elementPose(sdf::ElementPtr element)
+{
+    Affine3 T = Affine3::Identity();
+    double v[6];
+    if(readNumbers(elementText(element, "pose"), v, 6)){
+        T.translation() << v[0], v[1], v[2];
+        T.linear() = rotFromRpy(v[3], v[4], v[5]);
+    }
+    return T;
+}
+
+}
+
+
+ModelRootNodePtr cnoid::loadSDFModelTree(const std::string& filename, std::ostream& os)
+{
+    MODELEDIT_TRACE_SPAN("loadSDFModelTree");
+    SDFLoader loader(filename, os);
+    return loader.load();
+}
+
+
+SDFLoader::SDFLoader(const string& filename, ostream& os)
+    : ModelImporter(filename, os)
+{
+
+}
+
+
+ModelRootNodePtr SDFLoader::load()
+{
+    if(!parse()){
+        return 0;
+    }
+    loadMeshes();
+    BodyPtr body = createBody();
+    if(!body){
+        return 0;
+    }
+    return createModelTree(body, filename);
+}
+
+
+bool SDFLoader::parse()
+{
+    MODELEDIT_TRACE_SPAN("SDFLoader::parse");
+
+    document.reset(new sdf::SDF());
+    sdf::init(document);
+    if(!sdf::readFile(filename, document)){
+        os << format("Cannot read \"%1%\" as an SDF file.") % filename << endl;
+        return false;
+    }
+    sdf::ElementPtr model = firstElement(document->root, "model");
+    if(!model){
+        model = firstElement(firstElement(document->root, "world"), "model");
+    }
+    if(!model){
+        os << format("\"%1%\" has no model.") % filename << endl;
+        return false;
+    }
+    modelName = attributeText(model, "name");
+
+    for(sdf::ElementPtr e = firstElement(model, "link"); e; e = e->GetNextElement("link")){
+        readLink(e);
+    }
+    for(sdf::ElementPtr e = firstElement(model, "joint"); e; e = e->GetNextElement("joint")){
+        readJoint(e);
+    }
+    MODELEDIT_TRACE_COUNTER("SDF links", links.size());
+    return true;
+}
+
+
+void SDFLoader::readLink(sdf::ElementPtr element)
+{
+    SDFLink link;
+    link.name = attributeText(element, "name");
+    link.pose = elementPose(element);
+
+    if(sdf::ElementPtr inertial = firstElement(element, "inertial")){
+        link.mass = elementDouble(inertial, "mass", 0.0);
+        link.inertial = elementPose(inertial);
+        if(sdf::ElementPtr inertia = firstElement(inertial, "inertia")){
+            Matrix3& I = link.inertia;
+            I(0, 0) = elementDouble(inertia, "ixx", 0.0);
+            I(1, 1) = elementDouble(inertia, "iyy", 0.0);
+            I(2, 2) = elementDouble(inertia, "izz", 0.0);
+            I(0, 1) = I(1, 0) = elementDouble(inertia, "ixy", 0.0);
+            I(0, 2) = I(2, 0) = elementDouble(inertia, "ixz", 0.0);
+            I(1, 2) = I(2, 1) = elementDouble(inertia, "iyz", 0.0);
+        }
+    }
+    for(sdf::ElementPtr e = firstElement(element, "visual"); e; e = e->GetNextElement("visual")){
+        readShape(e, link.visuals, true);
+    }
+    for(sdf::ElementPtr e = firstElement(element, "collision"); e; e = e->GetNextElement("collision")){
+        readShape(e, link.collisions, false);
+    }
+    for(sdf::ElementPtr e = firstElement(element, "sensor"); e; e = e->GetNextElement("sensor")){
+        link.sensors.push_back(e);
+    }
+    links.push_back(link);
+}
+
+
+void SDFLoader::readShape(sdf::ElementPtr element, vector<ImportedShape>& shapes, bool isVisual)
+{
+    ImportedShape shape;
+    shape.origin = elementPose(element);
+
+    sdf::ElementPtr geometry = firstElement(element, "geometry");
+    ImportedGeometry& g = shape.geometry;
+    if(sdf::ElementPtr box = firstElement(geometry, "box")){
+        g.type = ImportedGeometry::BOX;
+        g.size = elementVector(box, "size", Vector3::Zero());
+    } else if(sdf::ElementPtr cylinder = firstElement(geometry, "cylinder")){
+        g.type = ImportedGeometry::CYLINDER;
+        g.radius = elementDouble(cylinder, "radius", 0.0);
+        g.length = elementDouble(cylinder, "length", 0.0);
+    } else if(sdf::ElementPtr sphere = firstElement(geometry, "sphere")){
+        g.type = ImportedGeometry::SPHERE;
+        g.radius = elementDouble(sphere, "radius", 0.0);
+    } else if(sdf::ElementPtr mesh = firstElement(geometry, "mesh")){
+        g.type = ImportedGeometry::MESH;
+        g.meshIndex = addMeshFile(elementText(mesh, "uri"));
+        g.scale = elementVector(mesh, "scale", Vector3::Ones());
+    } else {
+        // planes and heightmaps are not models of robots
+        return;
+    }
+
+    if(isVisual){
+        double rgba[4];
+        sdf::ElementPtr material = firstElement(element, "material");
+        if(readNumbers(elementText(material, "diffuse"), rgba, 4) ||
+           readNumbers(elementText(material, "ambient"), rgba, 4)){
+            shape.color << rgba[0], rgba[1], rgba[2], rgba[3];
+            shape.hasColor = true;
+        }
+    }
+    shapes.push_back(shape);
+}
+
+
+void SDFLoader::readJoint(sdf::ElementPtr element)
+{
+    SDFJoint joint;
+    joint.name = attributeText(element, "name");
+    joint.type = attributeText(element, "type");
+    joint.parent = elementText(element, "parent");
+    joint.child = elementText(element, "child");
+    joint.pose = elementPose(element);
+    if(sdf::ElementPtr axis = firstElement(element, "axis")){
+        joint.axis = elementVector(axis, "xyz", Vector3::UnitZ());
+        joint.useParentModelFrame = (elementText(axis, "use_parent_model_frame") == "true" ||
+                                     elementText(axis, "use_parent_model_frame") == "1");
+        if(sdf::ElementPtr limit = firstElement(axis, "limit")){
+            joint.lower = elementDouble(limit, "lower", -unlimited);
+            joint.upper = elementDouble(limit, "upper", unlimited);
+            joint.velocity = elementDouble(limit, "velocity", -1.0);
+        }
+    }
+    joints.push_back(joint);
+}
+
+
+/**
+   The frame of a Choreonoid link is the joint frame, which is the SDF link frame
+   moved by the pose of the joint. The shapes, the inertia and the sensors given
+   in the SDF link frame are moved into the joint frame.
+*/
+BodyPtr SDFLoader::createBody()
+{
+    MODELEDIT_TRACE_SPAN("SDFLoader::createBody");
+
+    map<string, const SDFJoint*> parentJoints;
+    for(size_t i=0; i < joints.size(); ++i){
+        if(joints[i].parent != "world"){
+            parentJoints[joints[i].child] = &joints[i];
+        }
+    }
+
+    BodyPtr body = new Body;
+    body->setName(modelName);
+    body->setModelName(modelName);
+
+    map<string, Link*> linkMap;
+    map<string, Affine3> jointFrames;
+    Link* rootLink = 0;
+    for(size_t i=0; i < links.size(); ++i){
+        SDFLink& src = links[i];
+        Link* link = new Link;
+        Affine3 jointPose = Affine3::Identity();
+        map<string, const SDFJoint*>::iterator p = parentJoints.find(src.name);
+        if(p != parentJoints.end()){
+            link->setName(p->second->name);
+            jointPose = p->second->pose;
+        } else if(!rootLink){
+            link->setName(src.name);
+            link->setJointType(Link::FIXED_JOINT);
+            rootLink = link;
+        } else {
+            os << format("The link \"%1%\" of \"%2%\" has no parent joint.") % src.name % filename << endl;
+            delete link;
+            continue;
+        }
+        jointFrames[src.name] = src.pose * jointPose;
+
+        const Affine3 Tinv = jointPose.inverse();
+        Affine3 inertial = Tinv * src.inertial;
+        link->setMass(src.mass);
+        link->setCenterOfMass(inertial.translation());
+        link->setInertia(inertial.linear() * src.inertia * inertial.linear().transpose());
+
+        for(size_t j=0; j < src.visuals.size(); ++j){
+            src.visuals[j].origin = Tinv * src.visuals[j].origin;
+        }
+        for(size_t j=0; j < src.collisions.size(); ++j){
+            src.collisions[j].origin = Tinv * src.collisions[j].origin;
+        }
+        SgNode* visual = createShape(src.visuals, src.name);
+        SgNode* collision = src.collisions.empty() ? visual : createShape(src.collisions, src.name);
+        link->setVisualShape(visual);
+        link->setCollisionShape(collision);
+        linkMap[src.name] = link;
+    }
+    if(!rootLink){
+        os << format("\"%1%\" has no root link.") % filename << endl;
+        return 0;
+    }
+    body->setRootLink(rootLink);
+
+    int jointId = 0;
+    for(size_t i=0; i < joints.size(); ++i){
+        const SDFJoint& joint = joints[i];
+        if(joint.parent == "world"){
+            continue;
+        }
+        map<string, Link*>::iterator parent = linkMap.find(joint.parent);
+        map<string, Link*>::iterator child = linkMap.find(joint.child);
+        if(parent == linkMap.end() || child == linkMap.end()){
+            os << format("The links of the joint \"%1%\" are not defined.") % joint.name << endl;
+            continue;
+        }
+        Link* link = child->second;
+        const Affine3& T = jointFrames[joint.child];
+        Affine3 offset = jointFrames[joint.parent].inverse() * T;
+        link->setOffsetTranslation(offset.translation());
+        link->setOffsetRotation(offset.linear());
+
+        Vector3 axis = joint.useParentModelFrame ? Vector3(T.linear().transpose() * joint.axis) : joint.axis;
+        if(axis.norm() > 0.0){
+            axis.normalize();
+        }
+        link->setJointAxis(axis);
+
+        if(joint.type == "revolute"){
+            link->setJointType(Link::ROTATIONAL_JOINT);
+        } else if(joint.type == "prismatic"){
+            link->setJointType(Link::SLIDE_JOINT);
+        } else {
+            if(joint.type != "fixed"){
+                os << format("The %1% joint \"%2%\" is loaded as a fixed joint.") % joint.type % joint.name << endl;
+            }
+            link->setJointType(Link::FIXED_JOINT);
+        }
+        if(link->isRotationalJoint() || link->isSlideJoint()){
+            link->setJointId(jointId++);
+            if(joint.lower > -unlimited && joint.upper < unlimited){
+                link->setJointRange(joint.lower, joint.upper);
+            }
+            if(joint.velocity > 0.0){
+                link->setJointVelocityRange(-joint.velocity, joint.velocity);
+            }
+        }
+        parent->second->appendChild(link);
+    }
+    body->updateLinkTree();
+
+    for(size_t i=0; i < links.size(); ++i){
+        map<string, Link*>::iterator p = linkMap.find(links[i].name);
+        if(p == linkMap.end()){
+            continue;
+        }
+        const map<string, const SDFJoint*>::iterator joint = parentJoints.find(links[i].name);
+        Affine3 Tinv = (joint != parentJoints.end()) ? joint->second->pose.inverse() : Affine3::Identity();
+        for(size_t j=0; j < links[i].sensors.size(); ++j){
+            addSensor(body, p->second, Tinv, links[i].sensors[j]);
+        }
+    }
+    return body;
+}
+
+
+void SDFLoader::addSensor(Body* body, Link* link, const Affine3& Tinv, sdf::ElementPtr element)
+{
+    string type = attributeText(element, "type");
+    double updateRate = elementDouble(element, "update_rate", 0.0);
+
+    vector<DevicePtr> devices;
+    // the cameras and the range sensors look along +X with +Z up in SDF
+    bool isOpticalFrame = false;
+    if(type == "camera" || type == "depth"){
+        CameraPtr camera;
+        if(type == "depth"){
+            RangeCamera* range = new RangeCamera;
+            range->setOrganized(true);
+            range->setImageType(Camera::NO_IMAGE);
+            camera = range;
+        } else {
+            camera = new Camera;
+            camera->setImageType(Camera::COLOR_IMAGE);
+        }
+        sdf::ElementPtr src = firstElement(element, "camera");
+        sdf::ElementPtr image = firstElement(src, "image");
+        camera->setResolution(elementDouble(image, "width", 320), elementDouble(image, "height", 240));
+        camera->setFieldOfView(elementDouble(src, "horizontal_fov", camera->fieldOfView()));
+        sdf::ElementPtr clip = firstElement(src, "clip");
+        camera->setNearDistance(elementDouble(clip, "near", camera->nearDistance()));
+        camera->setFarDistance(elementDouble(clip, "far", camera->farDistance()));
+        if(updateRate > 0.0){
+            camera->setFrameRate(updateRate);
+        }
+        devices.push_back(camera);
+        isOpticalFrame = true;
+
+    } else if(type == "ray" || type == "gpu_ray"){
+        RangeSensor* sensor = new RangeSensor;
+        sdf::ElementPtr ray = firstElement(element, "ray");
+        sdf::ElementPtr horizontal = firstElement(firstElement(ray, "scan"), "horizontal");
+        double minAngle = elementDouble(horizontal, "min_angle", 0.0);
+        double maxAngle = elementDouble(horizontal, "max_angle", 0.0);
+        int samples = elementDouble(horizontal, "samples", 1);
+        sensor->setYawRange(maxAngle - minAngle);
+        if(samples > 1){
+            sensor->setYawStep((maxAngle - minAngle) / (samples - 1));
+        }
+        sdf::ElementPtr range = firstElement(ray, "range");
+        sensor->setMinDistance(elementDouble(range, "min", sensor->minDistance()));
+        sensor->setMaxDistance(elementDouble(range, "max", sensor->maxDistance()));
+        if(updateRate > 0.0){
+            sensor->setFrameRate(updateRate);
+        }
+        devices.push_back(sensor);
+        isOpticalFrame = true;
+
+    } else if(type == "imu"){
+        devices.push_back(new RateGyroSensor);
+        devices.push_back(new AccelerationSensor);
+
+    } else if(type == "force_torque"){
+        devices.push_back(new ForceSensor);
+
+    } else {
+        os << format("The %1% sensor \"%2%\" is not supported.") % type % attributeText(element, "name") << endl;
+        return;
+    }
+
+    string name = attributeText(element, "name");
+    Affine3 T = Tinv * elementPose(element);
+    if(isOpticalFrame){
+        // Choreonoid looks along -Z with +Y up
+        Matrix3 R;
+        R << 0.0,  0.0, -1.0,
+            -1.0,  0.0,  0.0,
+             0.0,  1.0,  0.0;
+        T.linear() = T.linear() * R;
+    }
+    for(size_t i=0; i < devices.size(); ++i){
+        Device* device = devices[i];
+        // the sensors of the same type are numbered in the order of the file
+        int& count = deviceCounts[device->typeName()];
+        device->setId(count++);
+        device->setName((i == 0) ? name : name + "_" + device->typeName());
+        device->setLink(link);
+        device->setLocalTranslation(T.translation());
+        device->setLocalRotation(T.linear());
+        body->addDevice(device);
+    }
+}
@@ -0,0 +1,23 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_SDF_LOADER_H
+#define CNOID_EDITMODEL_PLUGIN_SDF_LOADER_H
+
+#include "ModelNode.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Loads the first model of an SDF file into a model tree. The links, joints and
+   sensors of the model become the joint, link and sensor nodes, and the collision
+   geometry becomes the "collision" link node under the link node. The mesh files
+   are loaded in the worker threads.
+*/
+CNOID_EXPORT ModelRootNodePtr loadSDFModelTree(const std::string& filename, std::ostream& os);
+
+}
+
+#endif
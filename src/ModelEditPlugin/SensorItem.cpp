@@ -24,7 +24,9 @@
 #include <cnoid/Camera>
 #include <cnoid/RangeSensor>
 #include <cnoid/VRMLBody>
-#include "ModelEditDragger.h"
+#include "PropertyFormat.h"
+#include "Trace.h"
+#include "BulkEdit.h"
 #include "JointItem.h"
 #include <cnoid/FileUtil>
 #include <cnoid/MeshNormalGenerator>
@@ -57,8 +59,10 @@ namespace cnoid {
 class SensorItemImpl
 {
 public:
+    static SensorItemImpl* implOf(SensorItem* item) { return item->impl; }
+
     SensorItem* self;
-    Device* device;
+    DevicePtr device;
     Selection sensorType;
     Selection cameraType;
     int resolutionX;
@@ -76,7 +80,7 @@ public:
     double scanRate;
     double minDistance;
     double maxDistance;
-    bool isselected;
+    double axisRadius;
 
     SceneLinkPtr sceneLink;
     SgScaleTransformPtr defaultAxesScale;
@@ -84,29 +88,17 @@ public:
     double axisCylinderNormalizedRadius;
     SgPosTransformPtr sensorShape;
 
-    ModelEditDraggerPtr positionDragger;
-    Connection conSelectUpdate;
-
-    SensorItemImpl(SensorItem* self);
-    SensorItemImpl(SensorItem* self, Device* dev);
+    SensorItemImpl(SensorItem* self, const SensorNode* node);
     SensorItemImpl(SensorItem* self, const SensorItemImpl& org);
     ~SensorItemImpl();
     
     void init();
-    void syncDevice();
-    void onSelectionChanged();
-    void attachPositionDragger();
-    void onDraggerStarted();
-    void onDraggerDragged();
+    void readNode(const SensorNode* node);
+    SensorNode* createNode() const;
+    void ensureScene();
     void onUpdated();
     double radius() const;
     void setRadius(double val);
-    bool onMaxForceChanged(const std::string& value);
-    bool onMaxTorqueChanged(const std::string& value);
-    bool onMaxAngularVelocityChanged(const std::string& value);
-    bool onMaxAccelerationChanged(const std::string& value);
-    VRMLNodePtr toVRML();
-    string toURDF();
     void doAssign(Item* srcItem);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool store(Archive& archive);
@@ -130,34 +122,34 @@ void SensorItem::initializeClass(ExtensionManager* ext)
 
 SensorItem::SensorItem()
 {
-    impl = new SensorItemImpl(this);
+    SensorNodePtr node = new SensorNode;
+    node->device = new Camera();
+    readModelNode(node);
+    impl = new SensorItemImpl(this, node);
 }
 
 
-SensorItemImpl::SensorItemImpl(SensorItem* self)
-    : self(self)
+SensorItem::SensorItem(Device *dev)
 {
-    device = new Camera();
-    init();
+    SensorNodePtr node = new SensorNode;
+    node->readDevice(dev);
+    readModelNode(node);
+    impl = new SensorItemImpl(this, node);
 }
 
 
-SensorItem::SensorItem(Device *dev)
+SensorItem::SensorItem(const SensorNode* node)
 {
-    impl = new SensorItemImpl(this, dev);
+    readModelNode(node);
+    impl = new SensorItemImpl(this, node);
 }
 
 
-SensorItemImpl::SensorItemImpl(SensorItem* self, Device* dev)
+SensorItemImpl::SensorItemImpl(SensorItem* self, const SensorNode* node)
     : self(self)
 {
-    this->device = dev;
-    self->setName(dev->name());
-    Affine3 position = dev->link()->position() * dev->T_local();
-    self->translation = position.translation();
-    self->rotation = position.rotation();
     init();
-    syncDevice();
+    readNode(node);
 }
 
 
@@ -173,7 +165,25 @@ SensorItemImpl::SensorItemImpl(SensorItem* self, const SensorItemImpl& org)
       device(org.device)
 {
     init();
-    syncDevice();
+
+    sensorType.selectIndex(org.sensorType.selectedIndex());
+    cameraType.selectIndex(org.cameraType.selectedIndex());
+    resolutionX = org.resolutionX;
+    resolutionY = org.resolutionY;
+    nearDistance = org.nearDistance;
+    farDistance = org.farDistance;
+    fieldOfView = org.fieldOfView;
+    frameRate = org.frameRate;
+    maxForce = org.maxForce;
+    maxTorque = org.maxTorque;
+    maxAngularVelocity = org.maxAngularVelocity;
+    maxAcceleration = org.maxAcceleration;
+    scanAngle = org.scanAngle;
+    scanStep = org.scanStep;
+    scanRate = org.scanRate;
+    minDistance = org.minDistance;
+    maxDistance = org.maxDistance;
+    axisRadius = org.axisRadius;
 }
 
 
@@ -196,8 +206,72 @@ void SensorItemImpl::init()
     cameraType.setSymbol(5, "COLOR_POINT_CLOUD");
     cameraType.select("COLOR");
 
-    sceneLink = new SceneLink(new Link());
     sensorShape = NULL;
+    axisRadius = 0.15;
+
+    self->sigUpdated().connect(boost::bind(&SensorItemImpl::onUpdated, this));
+}
+
+
+void SensorItemImpl::readNode(const SensorNode* node)
+{
+    device = node->device;
+    sensorType.select(node->sensorType);
+    cameraType.select(node->cameraType);
+    resolutionX = node->resolutionX;
+    resolutionY = node->resolutionY;
+    nearDistance = node->nearDistance;
+    farDistance = node->farDistance;
+    fieldOfView = node->fieldOfView;
+    frameRate = node->frameRate;
+    maxForce = node->maxForce;
+    maxTorque = node->maxTorque;
+    maxAngularVelocity = node->maxAngularVelocity;
+    maxAcceleration = node->maxAcceleration;
+    scanAngle = node->scanAngle;
+    scanStep = node->scanStep;
+    scanRate = node->scanRate;
+    minDistance = node->minDistance;
+    maxDistance = node->maxDistance;
+}
+
+
+SensorNode* SensorItemImpl::createNode() const
+{
+    SensorNode* node = new SensorNode;
+    node->device = device;
+    node->sensorType = sensorType.selectedSymbol();
+    node->cameraType = cameraType.selectedSymbol();
+    node->resolutionX = resolutionX;
+    node->resolutionY = resolutionY;
+    node->nearDistance = nearDistance;
+    node->farDistance = farDistance;
+    node->fieldOfView = fieldOfView;
+    node->frameRate = frameRate;
+    node->maxForce = maxForce;
+    node->maxTorque = maxTorque;
+    node->maxAngularVelocity = maxAngularVelocity;
+    node->maxAcceleration = maxAcceleration;
+    node->scanAngle = scanAngle;
+    node->scanStep = scanStep;
+    node->scanRate = scanRate;
+    node->minDistance = minDistance;
+    node->maxDistance = maxDistance;
+    return node;
+}
+
+
+/**
+   The scene is only needed when the item is shown, so it is created on the
+   first request of the scene. The dragger is shared in the model item.
+*/
+void SensorItemImpl::ensureScene()
+{
+    if (sceneLink)
+        return;
+
+    MODELEDIT_TRACE_SPAN("SensorItem::ensureScene");
+    sceneLink = new SceneLink(new Link());
 
     axisCylinderNormalizedRadius = 0.04;
     
@@ -235,163 +309,232 @@ void SensorItemImpl::init()
     }
     sceneLink->addChild(defaultAxesScale);
 
-    attachPositionDragger();
-    
-    setRadius(0.15);
-
-    self->sigUpdated().connect(boost::bind(&SensorItemImpl::onUpdated, this));
-    conSelectUpdate = ItemTreeView::mainInstance()->sigSelectionChanged().connect(boost::bind(&SensorItemImpl::onSelectionChanged, this));
-    isselected = false;
+    setRadius(axisRadius);
 
     onUpdated();
 }
 
-void SensorItemImpl::syncDevice()
+
+double SensorItemImpl::radius() const
 {
-    ForceSensor* fsensor = dynamic_cast<ForceSensor*>(device);
-    if (fsensor) {
-        sensorType.select("force");
-        maxForce = fsensor->F_max().head<3>();
-        maxTorque = fsensor->F_max().tail<3>();
-    }
-    RateGyroSensor* gyro = dynamic_cast<RateGyroSensor*>(device);
-    if (gyro) {
-        sensorType.select("gyro");
-        maxAngularVelocity = gyro->w_max();
-    }
-    AccelerationSensor* asensor = dynamic_cast<AccelerationSensor*>(device);
-    if (asensor) {
-        sensorType.select("acceleration");
-        maxAcceleration = asensor->dv_max();
+    return axisRadius;
+}
+
+
+void SensorItemImpl::setRadius(double r)
+{
+    axisRadius = r;
+    if (!sceneLink)
+        return;
+    defaultAxesScale->setScale(r);
+    sceneLink->notifyUpdate();
+}
+
+
+SensorItem::~SensorItem()
+{
+    delete impl;
+}
+
+
+SensorItemImpl::~SensorItemImpl()
+{
+}
+
+
+Device* SensorItem::device() const
+{
+    return impl->device.get();
+}
+
+
+std::string SensorItem::sensorType() const
+{
+    return impl->sensorType.selectedSymbol();
+}
+
+
+bool SensorItem::setSensorType(const std::string& type)
+{
+    if(!impl->sensorType.select(type)){
+        return false;
     }
-    RangeSensor* rsensor = dynamic_cast<RangeSensor*>(device);
-    if (rsensor) {
-        sensorType.select("range");
-        if (rsensor->yawRange() > 0)
-            scanAngle = rsensor->yawRange();
-        else
-            scanAngle = rsensor->pitchRange();
-        scanStep = rsensor->pitchStep();
-        scanRate = rsensor->frameRate();
-        minDistance = rsensor->minDistance();
-        maxDistance = rsensor->maxDistance();
+    requestUpdate();
+    return true;
+}
+
+
+std::string SensorItem::cameraType() const
+{
+    return impl->cameraType.selectedSymbol();
+}
+
+
+bool SensorItem::setCameraType(const std::string& type)
+{
+    if(!impl->cameraType.select(type)){
+        return false;
     }
-    Camera* camera = dynamic_cast<Camera*>(device);
-    if (camera) {
-        sensorType.select("camera");
-        RangeCamera* range = dynamic_cast<RangeCamera*>(device);
-        if (range) {
-            if (range->isOrganized()) {
-                if (range->imageType() == Camera::NO_IMAGE) {
-                    cameraType.select("DEPTH");
-                } else {
-                    cameraType.select("COLOR_DEPTH");
-                }
-            } else {
-                if (range->imageType() == Camera::NO_IMAGE) {
-                    cameraType.select("POINT_CLOUD");
-                } else {
-                    cameraType.select("COLOR_POINT_CLOUD");
-                }
-            }
-        } else {
-            if (camera->imageType() == Camera::COLOR_IMAGE) {
-                cameraType.select("COLOR");
-            } else {
-                cameraType.select("NONE");
-            }
-        }
-        resolutionX = camera->resolutionX();
-        resolutionY = camera->resolutionY();
-        frameRate = camera->frameRate();
-        fieldOfView = camera->fieldOfView();
-        nearDistance = camera->nearDistance();
-        farDistance = camera->farDistance();
+    requestUpdate();
+    return true;
+}
+
+
+int SensorItem::resolutionX() const
+{
+    return impl->resolutionX;
+}
+
+
+int SensorItem::resolutionY() const
+{
+    return impl->resolutionY;
+}
+
+
+bool SensorItem::setResolution(int x, int y)
+{
+    if(x < 0 || y < 0){
+        return false;
     }
-    onUpdated();
+    impl->resolutionX = x;
+    impl->resolutionY = y;
+    requestUpdate();
+    return true;
 }
 
 
-void SensorItemImpl::onSelectionChanged()
+double SensorItem::frameRate() const
 {
-    ItemList<Item> items = ItemTreeView::mainInstance()->selectedItems();
-    bool selected = false;
-    for(size_t i=0; i < items.size(); ++i){
-        Item* item = items.get(i);
-        if (item == self) {
-            selected = true;
-        }
+    return impl->frameRate;
+}
+
+
+void SensorItem::setFrameRate(double r)
+{
+    impl->frameRate = r;
+    requestUpdate();
+}
+
+
+double SensorItem::fieldOfView() const
+{
+    return impl->fieldOfView;
+}
+
+
+void SensorItem::setFieldOfView(double fov)
+{
+    impl->fieldOfView = fov;
+    requestUpdate();
+}
+
+
+double SensorItem::nearDistance() const
+{
+    return impl->nearDistance;
+}
+
+
+double SensorItem::farDistance() const
+{
+    return impl->farDistance;
+}
+
+
+bool SensorItem::setClipDistance(double nearDistance, double farDistance)
+{
+    if(nearDistance > farDistance){
+        return false;
     }
-    if (isselected != selected) {
-        isselected = selected;
-        //positionDragger->setDraggerAlwaysShown(selected);
-        if (isselected) {
-            positionDragger->setDraggerAlwaysShown(true);
-        } else {
-            positionDragger->setDraggerAlwaysHidden(true);
-        }
+    impl->nearDistance = nearDistance;
+    impl->farDistance = farDistance;
+    requestUpdate();
+    return true;
+}
+
+
+double SensorItem::minDistance() const
+{
+    return impl->minDistance;
+}
+
+
+double SensorItem::maxDistance() const
+{
+    return impl->maxDistance;
+}
+
+
+bool SensorItem::setRangeDistance(double minDistance, double maxDistance)
+{
+    if(minDistance > maxDistance){
+        return false;
     }
+    impl->minDistance = minDistance;
+    impl->maxDistance = maxDistance;
+    requestUpdate();
+    return true;
 }
 
 
-double SensorItemImpl::radius() const
+const Vector3& SensorItem::maxForce() const
 {
-    return defaultAxesScale->scale().x();
+    return impl->maxForce;
 }
 
 
-void SensorItemImpl::setRadius(double r)
+void SensorItem::setMaxForce(const Vector3& f)
 {
-    defaultAxesScale->setScale(r);
-    positionDragger->setRadius(r * 1.5);
-    sceneLink->notifyUpdate();
+    impl->maxForce = f;
+    requestUpdate();
 }
 
 
-void SensorItemImpl::attachPositionDragger()
+const Vector3& SensorItem::maxTorque() const
 {
-    positionDragger = new ModelEditDragger;
-    positionDragger->sigDragStarted().connect(boost::bind(&SensorItemImpl::onDraggerStarted, this));
-    positionDragger->sigPositionDragged().connect(boost::bind(&SensorItemImpl::onDraggerDragged, this));
-    positionDragger->adjustSize(sceneLink->untransformedBoundingBox());
-    sceneLink->addChild(positionDragger);
-    sceneLink->notifyUpdate();
-    self->notifyUpdate();
+    return impl->maxTorque;
 }
 
 
-void SensorItemImpl::onDraggerStarted()
+void SensorItem::setMaxTorque(const Vector3& tau)
 {
+    impl->maxTorque = tau;
+    requestUpdate();
 }
 
 
-void SensorItemImpl::onDraggerDragged()
+const Vector3& SensorItem::maxAngularVelocity() const
 {
-    self->translation = positionDragger->draggedPosition().translation();
-    self->rotation = positionDragger->draggedPosition().rotation();
-    self->notifyUpdate();
- }
+    return impl->maxAngularVelocity;
+}
 
-SensorItem::~SensorItem()
+
+void SensorItem::setMaxAngularVelocity(const Vector3& w)
 {
-    delete impl;
+    impl->maxAngularVelocity = w;
+    requestUpdate();
 }
 
 
-SensorItemImpl::~SensorItemImpl()
+const Vector3& SensorItem::maxAcceleration() const
 {
-    conSelectUpdate.disconnect();
+    return impl->maxAcceleration;
 }
 
 
-Device* SensorItem::device() const
+void SensorItem::setMaxAcceleration(const Vector3& dv)
 {
-    return impl->device;
+    impl->maxAcceleration = dv;
+    requestUpdate();
 }
 
 
 void SensorItemImpl::onUpdated()
 {
+    MODELEDIT_TRACE_SPAN("SensorItem::onUpdated");
+    if (!sceneLink)
+        return;
     sceneLink->translation() = self->translation;
     sceneLink->rotation() = self->rotation;
 
@@ -508,168 +651,60 @@ void SensorItemImpl::doAssign(Item* srcItem)
 
 SgNode* SensorItem::getScene()
 {
+    impl->ensureScene();
     return impl->sceneLink;
 }
 
 
-void SensorItem::doPutProperties(PutPropertyFunction& putProperty)
+ModelNodePtr SensorItem::createModelNode() const
 {
-    impl->doPutProperties(putProperty);
+    return impl->createNode();
 }
 
 
-void SensorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
+void SensorItem::adjustDraggerSize(PositionDragger* dragger)
 {
-    ostringstream oss;
-    putProperty(_("Translation"), str(Vector3(sceneLink->translation())),
-                boost::bind(&SensorItem::onTranslationChanged, self, _1));
-    SFRotation rotation;
-    rotation = sceneLink->rotation();
-    oss.str("");
-    oss << rotation.angle() << " " << str(rotation.axis());
-    putProperty(_("Rotation (Axis)"), oss.str(),
-                boost::bind(&SensorItem::onRotationAxisChanged, self, _1));
-    Vector3 rpy(rpyFromRot(sceneLink->rotation()));
-    putProperty("Rotation (RPY)", str(TO_DEGREE * rpy), boost::bind(&SensorItem::onRotationRPYChanged, self, _1));
-    oss.str("");
-    oss << sceneLink->rotation();
-    putProperty(_("Rotation (Matrix)"), oss.str(),
-                boost::bind(&SensorItem::onRotationChanged, self, _1));
-    putProperty(_("Sensor type"), sensorType,
-                boost::bind(&Selection::selectIndex, &sensorType, _1));
-    string st(sensorType.selectedSymbol());
-    if (st == "camera") {
-        putProperty(_("Camera type"), cameraType,
-                    boost::bind(&Selection::selectIndex, &cameraType, _1));
-        putProperty.decimals(4).min(0)(_("Resolution X"), resolutionX, changeProperty(resolutionX));
-        putProperty.decimals(4).min(0)(_("Resolution Y"), resolutionY, changeProperty(resolutionY));
-        putProperty.decimals(4).min(0)(_("Frame rate"), frameRate, changeProperty(frameRate));
-        putProperty.decimals(4)(_("Field of view"), fieldOfView, changeProperty(fieldOfView));
-        putProperty.decimals(4)(_("Near distance"), nearDistance, changeProperty(nearDistance));
-        putProperty.decimals(4)(_("Far distance"), farDistance, changeProperty(farDistance));
-    } else if (st == "force") {
-        putProperty("Max force", str(maxForce), boost::bind(&SensorItemImpl::onMaxForceChanged, this, _1));
-        putProperty("Max torque", str(maxTorque), boost::bind(&SensorItemImpl::onMaxTorqueChanged, this, _1));
-    } else if (st == "gyro") {
-        putProperty("Max angular velocity", str(maxAngularVelocity), boost::bind(&SensorItemImpl::onMaxAngularVelocityChanged, this, _1));
-    } else if (st == "acceleration") {
-        putProperty("Max acceleration", str(maxAcceleration), boost::bind(&SensorItemImpl::onMaxAccelerationChanged, this, _1));
-    } else if (st == "range") {
-        putProperty("Scan angle", scanAngle, changeProperty(scanAngle));
-        putProperty("Scan step", scanStep, changeProperty(scanStep));
-        putProperty("Scan rate", scanRate, changeProperty(scanRate));
-        putProperty("Min distance", minDistance, changeProperty(minDistance));
-        putProperty("Max distance", maxDistance, changeProperty(maxDistance));
-    }
+    dragger->setRadius(impl->axisRadius * 1.5);
 }
 
-bool SensorItemImpl::onMaxForceChanged(const std::string& value)
-{
-    Vector3 p;
-    if(toVector3(value, p)){
-        maxForce = p;
-        return true;
-    }
-    return false;
-}
 
-bool SensorItemImpl::onMaxTorqueChanged(const std::string& value)
+void SensorItem::doPutProperties(PutPropertyFunction& putProperty)
 {
-    Vector3 p;
-    if(toVector3(value, p)){
-        maxTorque = p;
-        return true;
-    }
-    return false;
+    EditableModelBase::doPutProperties(putProperty);
+    impl->doPutProperties(putProperty);
 }
 
-bool SensorItemImpl::onMaxAngularVelocityChanged(const std::string& value)
-{
-    Vector3 p;
-    if(toVector3(value, p)){
-        maxAngularVelocity = p;
-        return true;
-    }
-    return false;
-}
 
-bool SensorItemImpl::onMaxAccelerationChanged(const std::string& value)
+void SensorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
 {
-    Vector3 p;
-    if(toVector3(value, p)){
-        maxAcceleration = p;
-        return true;
+    int numTargets = bulkEditTargets(self).size();
+    if(numTargets > 1){
+        putProperty(_("Edit targets"), numTargets);
     }
-    return false;
-}
-
-VRMLNodePtr SensorItem::toVRML()
-{
-    return impl->toVRML();
-}
-
-
-VRMLNodePtr SensorItemImpl::toVRML()
-{
-    VRMLTransformPtr node = NULL;
+    putBulkSelection(putProperty, _("Sensor type"), self, &SensorItemImpl::sensorType);
     string st(sensorType.selectedSymbol());
-    if (st == "force") {
-        VRMLForceSensorPtr fnode = new VRMLForceSensor();
-        fnode->maxForce = maxForce;
-        fnode->maxTorque = maxTorque;
-        node = fnode;
+    if (st == "camera") {
+        putBulkSelection(putProperty, _("Camera type"), self, &SensorItemImpl::cameraType);
+        putBulkProperty(putProperty.decimals(4).min(0), _("Resolution X"), self, &SensorItemImpl::resolutionX);
+        putBulkProperty(putProperty.decimals(4).min(0), _("Resolution Y"), self, &SensorItemImpl::resolutionY);
+        putBulkProperty(putProperty.decimals(4).min(0), _("Frame rate"), self, &SensorItemImpl::frameRate);
+        putBulkProperty(putProperty.decimals(4), _("Field of view"), self, &SensorItemImpl::fieldOfView);
+        putBulkProperty(putProperty.decimals(4), _("Near distance"), self, &SensorItemImpl::nearDistance);
+        putBulkProperty(putProperty.decimals(4), _("Far distance"), self, &SensorItemImpl::farDistance);
+    } else if (st == "force") {
+        putBulkVectorProperty(putProperty, "Max force", self, &SensorItemImpl::maxForce);
+        putBulkVectorProperty(putProperty, "Max torque", self, &SensorItemImpl::maxTorque);
     } else if (st == "gyro") {
-        VRMLGyroPtr gnode = new VRMLGyro();
-        gnode->maxAngularVelocity = maxAngularVelocity;
-        node = gnode;
+        putBulkVectorProperty(putProperty, "Max angular velocity", self, &SensorItemImpl::maxAngularVelocity);
     } else if (st == "acceleration") {
-        VRMLAccelerationSensorPtr anode = new VRMLAccelerationSensor();
-        anode->maxAcceleration = maxAcceleration;
-        node = anode;
+        putBulkVectorProperty(putProperty, "Max acceleration", self, &SensorItemImpl::maxAcceleration);
     } else if (st == "range") {
-        VRMLRangeSensorPtr rnode = new VRMLRangeSensor();
-        rnode->scanAngle = scanAngle;
-        rnode->scanStep = scanStep;
-        rnode->scanRate = scanRate;
-        rnode->minDistance = minDistance;
-        rnode->maxDistance = maxDistance;
-        node = rnode;
-    } else if (st == "camera") {
-        VRMLVisionSensorPtr cnode = new VRMLVisionSensor();
-        cnode->type = cameraType.selectedSymbol();
-        cnode->width = resolutionX;
-        cnode->height = resolutionY;
-        cnode->frameRate = frameRate;
-        cnode->fieldOfView = fieldOfView;
-        cnode->frontClipDistance = nearDistance;
-        cnode->backClipDistance = farDistance;
-        node = cnode;
-    }
-    if (node) {
-        node->defName = self->name();
-        JointItem* parentjoint = dynamic_cast<JointItem*>(self->parentItem());
-        Affine3 parent, child, relative;
-        parent.translation() = parentjoint->translation;
-        parent.linear() = parentjoint->rotation;
-        child.translation() = self->translation;
-        child.linear() = self->rotation;
-        relative = parent.inverse() * child;
-        node->translation = relative.translation();
-        node->rotation = relative.rotation();
+        putBulkProperty(putProperty, "Scan angle", self, &SensorItemImpl::scanAngle);
+        putBulkProperty(putProperty, "Scan step", self, &SensorItemImpl::scanStep);
+        putBulkProperty(putProperty, "Scan rate", self, &SensorItemImpl::scanRate);
+        putBulkProperty(putProperty, "Min distance", self, &SensorItemImpl::minDistance);
+        putBulkProperty(putProperty, "Max distance", self, &SensorItemImpl::maxDistance);
     }
-    return node;
-}
-
-
-string SensorItem::toURDF()
-{
-    return impl->toURDF();
-}
-
-
-string SensorItemImpl::toURDF()
-{
-    return NULL;
 }
 
 
@@ -683,8 +718,8 @@ bool SensorItemImpl::store(Archive& archive)
 {
     archive.setDoubleFormat("% .6f");
 
-    write(archive, "position", sceneLink->translation());
-    write(archive, "attitude", Matrix3(sceneLink->rotation()));
+    write(archive, "position", self->translation);
+    write(archive, "attitude", Matrix3(self->rotation));
 
     return true;
 }
@@ -700,11 +735,11 @@ bool SensorItemImpl::restore(const Archive& archive)
 {
     Vector3 p;
     if(read(archive, "position", p)){
-        sceneLink->translation() = p;
+        self->translation = p;
     }
     Matrix3 R;
     if(read(archive, "attitude", R)){
-        sceneLink->rotation() = R;
+        self->rotation = R;
     }
 
     return true;
@@ -29,12 +29,39 @@ public:
     SensorItem();
     SensorItem(const SensorItem& org);
     SensorItem(Device* dev);
+    SensorItem(const SensorNode* node);
     virtual ~SensorItem();
 
-    VRMLNodePtr toVRML();
-    std::string toURDF();
+    virtual ModelNodePtr createModelNode() const;
+    virtual void adjustDraggerSize(PositionDragger* dragger);
     
     Device* device() const;
+
+    std::string sensorType() const;
+    bool setSensorType(const std::string& type);
+    std::string cameraType() const;
+    bool setCameraType(const std::string& type);
+    int resolutionX() const;
+    int resolutionY() const;
+    bool setResolution(int x, int y);
+    double frameRate() const;
+    void setFrameRate(double r);
+    double fieldOfView() const;
+    void setFieldOfView(double fov);
+    double nearDistance() const;
+    double farDistance() const;
+    bool setClipDistance(double nearDistance, double farDistance);
+    double minDistance() const;
+    double maxDistance() const;
+    bool setRangeDistance(double minDistance, double maxDistance);
+    const Vector3& maxForce() const;
+    void setMaxForce(const Vector3& f);
+    const Vector3& maxTorque() const;
+    void setMaxTorque(const Vector3& tau);
+    const Vector3& maxAngularVelocity() const;
+    void setMaxAngularVelocity(const Vector3& w);
+    const Vector3& maxAcceleration() const;
+    void setMaxAcceleration(const Vector3& dv);
     
     virtual SgNode* getScene();
 
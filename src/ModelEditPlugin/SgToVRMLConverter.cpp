@@ -0,0 +1,177 @@
+/**
+   @file
+*/
+
+#include "SgToVRMLConverter.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/// Separates the triangles of the indices by -1 as in IndexedFaceSet
+void copyTriangleIndices(const SgIndexArray& indices, MFInt32& out_indices)
+{
+    const int numTriangles = indices.size() / 3;
+    out_indices.resize(numTriangles * 4);
+    for(int i=0; i < numTriangles; ++i){
+        out_indices[i * 4 + 0] = indices[i * 3 + 0];
+        out_indices[i * 4 + 1] = indices[i * 3 + 1];
+        out_indices[i * 4 + 2] = indices[i * 3 + 2];
+        out_indices[i * 4 + 3] = -1;
+    }
+}
+
+}
+
+
+SgToVRMLConverter::SgToVRMLConverter()
+{
+
+}
+
+
+VRMLNodePtr SgToVRMLConverter::convert(SgNode* node)
+{
+    if(!node){
+        return 0;
+    }
+
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        return convertShape(shape);
+    }
+
+    SgGroup* group = dynamic_cast<SgGroup*>(node);
+    if(!group){
+        return 0;
+    }
+
+    VRMLGroupPtr vgroup;
+    if(SgPosTransform* pos = dynamic_cast<SgPosTransform*>(node)){
+        VRMLTransformPtr trans = new VRMLTransform();
+        trans->translation = pos->translation();
+        trans->rotation = Matrix3(pos->rotation());
+        vgroup = trans;
+    } else if(SgScaleTransform* scale = dynamic_cast<SgScaleTransform*>(node)){
+        VRMLTransformPtr trans = new VRMLTransform();
+        trans->scale = scale->scale();
+        vgroup = trans;
+    } else {
+        vgroup = new VRMLGroup();
+    }
+    for(int i=0; i < group->numChildren(); ++i){
+        VRMLNodePtr child = convert(group->child(i));
+        if(child){
+            vgroup->children.push_back(child);
+        }
+    }
+    return vgroup;
+}
+
+
+VRMLNodePtr SgToVRMLConverter::convertShape(SgShape* shape)
+{
+    if(!shape->mesh()){
+        return 0;
+    }
+    VRMLShapePtr vshape = new VRMLShape();
+    vshape->geometry = convertMesh(shape->mesh());
+    if(shape->material()){
+        VRMLAppearancePtr appearance = new VRMLAppearance();
+        appearance->material = convertMaterial(shape->material());
+        vshape->appearance = appearance;
+    }
+    return vshape;
+}
+
+
+VRMLNodePtr SgToVRMLConverter::convertMesh(SgMesh* mesh)
+{
+    map<SgMesh*, VRMLNodePtr>::iterator p = geometryMap.find(mesh);
+    if(p != geometryMap.end()){
+        return p->second;
+    }
+
+    VRMLIndexedFaceSetPtr faceSet = new VRMLIndexedFaceSet();
+    faceSet->ccw = true;
+    faceSet->solid = mesh->isSolid();
+
+    VRMLCoordinatePtr coord = new VRMLCoordinate();
+    if(mesh->hasVertices()){
+        const SgVertexArray& vertices = *mesh->vertices();
+        coord->point.resize(vertices.size());
+        for(size_t i=0; i < vertices.size(); ++i){
+            coord->point[i] = vertices[i].cast<double>();
+        }
+    }
+    faceSet->coord = coord;
+
+    const SgIndexArray& triangles = mesh->triangleVertices();
+    copyTriangleIndices(triangles, faceSet->coordIndex);
+
+    if(mesh->hasNormals()){
+        const SgNormalArray& normals = *mesh->normals();
+        VRMLNormalPtr normal = new VRMLNormal();
+        normal->vector.resize(normals.size());
+        for(size_t i=0; i < normals.size(); ++i){
+            normal->vector[i] = normals[i].cast<double>();
+        }
+        faceSet->normal = normal;
+        faceSet->normalPerVertex = true;
+        const SgIndexArray& normalIndices = mesh->normalIndices();
+        if(normalIndices.size() == triangles.size()){
+            copyTriangleIndices(normalIndices, faceSet->normalIndex);
+        }
+    }
+
+    // the colors of the faces are given to the corners of the faces in the scene mesh
+    if(mesh->hasColors()){
+        const SgColorArray& colors = *mesh->colors();
+        VRMLColorPtr color = new VRMLColor();
+        color->color.resize(colors.size());
+        for(size_t i=0; i < colors.size(); ++i){
+            color->color[i] = colors[i].cast<SFColor::Scalar>();
+        }
+        faceSet->color = color;
+        faceSet->colorPerVertex = true;
+        const SgIndexArray& colorIndices = mesh->colorIndices();
+        if(colorIndices.size() == triangles.size()){
+            copyTriangleIndices(colorIndices, faceSet->colorIndex);
+        }
+    }
+
+    if(mesh->hasTexCoords()){
+        const SgTexCoordArray& texCoords = *mesh->texCoords();
+        VRMLTextureCoordinatePtr texCoord = new VRMLTextureCoordinate();
+        texCoord->point.resize(texCoords.size());
+        for(size_t i=0; i < texCoords.size(); ++i){
+            texCoord->point[i] = texCoords[i].cast<SFVec2f::Scalar>();
+        }
+        faceSet->texCoord = texCoord;
+        const SgIndexArray& texCoordIndices = mesh->texCoordIndices();
+        if(texCoordIndices.size() == triangles.size()){
+            copyTriangleIndices(texCoordIndices, faceSet->texCoordIndex);
+        }
+    }
+
+    geometryMap[mesh] = faceSet;
+    return faceSet;
+}
+
+
+VRMLMaterialPtr SgToVRMLConverter::convertMaterial(SgMaterial* material)
+{
+    map<SgMaterial*, VRMLMaterialPtr>::iterator p = materialMap.find(material);
+    if(p != materialMap.end()){
+        return p->second;
+    }
+    VRMLMaterialPtr vmaterial = new VRMLMaterial();
+    vmaterial->ambientIntensity = material->ambientIntensity();
+    vmaterial->diffuseColor = material->diffuseColor();
+    vmaterial->emissiveColor = material->emissiveColor();
+    vmaterial->specularColor = material->specularColor();
+    vmaterial->shininess = material->shininess();
+    vmaterial->transparency = material->transparency();
+    materialMap[material] = vmaterial;
+    return vmaterial;
+}
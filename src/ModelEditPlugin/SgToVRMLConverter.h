@@ -0,0 +1,39 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_SG_TO_VRML_CONVERTER_H
+#define CNOID_EDITMODEL_PLUGIN_SG_TO_VRML_CONVERTER_H
+
+#include <cnoid/SceneGraph>
+#include <cnoid/SceneShape>
+#include <cnoid/VRML>
+#include <map>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Regenerates VRML nodes from a scene graph. This is used for the links whose
+   geometry has been modified in the editor and no longer corresponds to the
+   original VRML node.
+*/
+class CNOID_EXPORT SgToVRMLConverter
+{
+public:
+    SgToVRMLConverter();
+
+    VRMLNodePtr convert(SgNode* node);
+
+private:
+    std::map<SgMesh*, VRMLNodePtr> geometryMap;
+    std::map<SgMaterial*, VRMLMaterialPtr> materialMap;
+
+    VRMLNodePtr convertShape(SgShape* shape);
+    VRMLNodePtr convertMesh(SgMesh* mesh);
+    VRMLMaterialPtr convertMaterial(SgMaterial* material);
+};
+
+}
+
+#endif
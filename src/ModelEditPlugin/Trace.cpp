@@ -0,0 +1,171 @@
+/**
+   @file
+*/
+
+#include "Trace.h"
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <map>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The events exceeding this number are dropped to bound the memory usage
+const size_t maxNumEvents = 2000000;
+
+struct TraceEvent
+{
+    const char* name;
+    char phase;
+    int threadIndex;
+    double time;
+    double value; // duration for the spans
+};
+
+QElapsedTimer timer;
+QMutex mutex;
+vector<TraceEvent> events;
+map<Qt::HANDLE, int> threadIndices;
+int numDroppedEvents = 0;
+string defaultFilename;
+
+int currentThreadIndex()
+{
+    Qt::HANDLE id = QThread::currentThreadId();
+    map<Qt::HANDLE, int>::iterator p = threadIndices.find(id);
+    if(p != threadIndices.end()){
+        return p->second;
+    }
+    int index = threadIndices.size();
+    threadIndices[id] = index;
+    return index;
+}
+
+void addEvent(const char* name, char phase, double time, double value)
+{
+    QMutexLocker locker(&mutex);
+    if(events.size() >= maxNumEvents){
+        ++numDroppedEvents;
+        return;
+    }
+    TraceEvent event;
+    event.name = name;
+    event.phase = phase;
+    event.threadIndex = currentThreadIndex();
+    event.time = time;
+    event.value = value;
+    events.push_back(event);
+}
+
+void writeEscaped(FILE* fp, const char* s)
+{
+    for(; *s; ++s){
+        if(*s == '"' || *s == '\\'){
+            fputc('\\', fp);
+        }
+        fputc(*s, fp);
+    }
+}
+
+}
+
+
+bool ModelEditTrace::enabled_ = false;
+
+
+void ModelEditTrace::setEnabled(bool on)
+{
+    if(on && !timer.isValid()){
+        timer.start();
+    }
+    enabled_ = on;
+}
+
+
+void ModelEditTrace::initializeFromEnvironment()
+{
+    const char* filename = getenv("CNOID_MODELEDIT_TRACE");
+    if(filename && *filename){
+        defaultFilename = filename;
+        setEnabled(true);
+    }
+}
+
+
+bool ModelEditTrace::writeToDefaultFile()
+{
+    if(defaultFilename.empty()){
+        return false;
+    }
+    return writeChromeTrace(defaultFilename);
+}
+
+
+void ModelEditTrace::clear()
+{
+    QMutexLocker locker(&mutex);
+    events.clear();
+    numDroppedEvents = 0;
+}
+
+
+int ModelEditTrace::numEvents()
+{
+    QMutexLocker locker(&mutex);
+    return events.size();
+}
+
+
+double ModelEditTrace::now()
+{
+    return timer.isValid() ? timer.nsecsElapsed() * 1.0e-3 : 0.0;
+}
+
+
+void ModelEditTrace::addSpan(const char* name, double beginTime, double endTime)
+{
+    addEvent(name, 'X', beginTime, endTime - beginTime);
+}
+
+
+void ModelEditTrace::addCounter(const char* name, double value)
+{
+    addEvent(name, 'C', now(), value);
+}
+
+
+bool ModelEditTrace::writeChromeTrace(const std::string& filename)
+{
+    QMutexLocker locker(&mutex);
+
+    FILE* fp = fopen(filename.c_str(), "w");
+    if(!fp){
+        return false;
+    }
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", fp);
+    for(size_t i=0; i < events.size(); ++i){
+        const TraceEvent& e = events[i];
+        fputs("{\"name\":\"", fp);
+        writeEscaped(fp, e.name);
+        if(e.phase == 'X'){
+            fprintf(fp, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    e.threadIndex, e.time, e.value);
+        } else {
+            fprintf(fp, "\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%.17g}}",
+                    e.threadIndex, e.time, e.value);
+        }
+        fputs((i + 1 < events.size()) ? ",\n" : "\n", fp);
+    }
+    fprintf(fp, "],\"otherData\":{\"droppedEvents\":%d}}\n", numDroppedEvents);
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
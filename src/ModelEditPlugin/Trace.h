@@ -0,0 +1,78 @@
+/**
+   \file
+   Lightweight tracing of the model editing operations.
+   The spans and counters are recorded only when tracing is enabled and
+   the recorded events can be written in the Chrome trace event format
+   (chrome://tracing, Perfetto).
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_TRACE_H
+#define CNOID_EDITMODEL_PLUGIN_TRACE_H
+
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class CNOID_EXPORT ModelEditTrace
+{
+public:
+    static bool isEnabled() { return enabled_; }
+    static void setEnabled(bool on);
+
+    /**
+       Enables tracing when the CNOID_MODELEDIT_TRACE environment variable is set.
+       The value of the variable is used as the output file of writeToDefaultFile().
+    */
+    static void initializeFromEnvironment();
+    static bool writeToDefaultFile();
+
+    static void clear();
+    static int numEvents();
+
+    /// Elapsed time in microseconds since tracing was initialized
+    static double now();
+
+    // The name must be a string literal or live as long as the trace
+    static void addSpan(const char* name, double beginTime, double endTime);
+    static void addCounter(const char* name, double value);
+
+    static bool writeChromeTrace(const std::string& filename);
+
+private:
+    static bool enabled_;
+};
+
+
+class ModelEditTraceSpan
+{
+public:
+    ModelEditTraceSpan(const char* name)
+        : name(ModelEditTrace::isEnabled() ? name : 0) {
+        if(this->name){
+            beginTime = ModelEditTrace::now();
+        }
+    }
+    ~ModelEditTraceSpan() {
+        if(name){
+            ModelEditTrace::addSpan(name, beginTime, ModelEditTrace::now());
+        }
+    }
+private:
+    const char* name;
+    double beginTime;
+};
+
+}
+
+#define MODELEDIT_TRACE_CAT_SUB(a, b) a##b
+#define MODELEDIT_TRACE_CAT(a, b) MODELEDIT_TRACE_CAT_SUB(a, b)
+
+/// Records the time until the end of the enclosing scope
+#define MODELEDIT_TRACE_SPAN(name) \
+    cnoid::ModelEditTraceSpan MODELEDIT_TRACE_CAT(modelEditTraceSpan, __LINE__)(name)
+
+#define MODELEDIT_TRACE_COUNTER(name, value) \
+    if(!cnoid::ModelEditTrace::isEnabled()){ } else cnoid::ModelEditTrace::addCounter(name, value)
+
+#endif
@@ -0,0 +1,450 @@
+/**
+   @file
+*/
+
+#include "URDFLoader.h"
+#include "ModelImporter.h"
+#include "Trace.h"
+#include <cnoid/EigenUtil>
+#include <boost/format.hpp>
+#include <QFile>
+#include <QXmlStreamReader>
+#include <sstream>
+#include <map>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+struct URDFLink
+{
+    URDFLink() : mass(0.0), centerOfMass(Vector3::Zero()), inertia(Matrix3::Identity()) { }
+    string name;
+    double mass;
+    Vector3 centerOfMass;
+    Matrix3 inertia;
+    vector<ImportedShape> visuals;
+    vector<ImportedShape> collisions;
+};
+
+struct URDFJoint
+{
+    URDFJoint() : origin(Affine3::Identity()), axis(Vector3::UnitX()), hasLimit(false),
+                  lower(0.0), upper(0.0), velocity(0.0) { }
+    string name;
+    string type;
+    string parent;
+    string child;
+    Affine3 origin;
+    Vector3 axis;
+    bool hasLimit;
+    double lower;
+    double upper;
+    double velocity;
+};
+
+class URDFLoader : public ModelImporter
+{
+public:
+    URDFLoader(const string& filename, ostream& os);
+    ModelRootNodePtr load();
+
+private:
+    QXmlStreamReader xml;
+
+    string robotName;
+    vector<URDFLink> links;
+    vector<URDFJoint> joints;
+    map<string, Vector4f> materials;
+
+    bool isElement(const char* name) const { return xml.name() == QLatin1String(name); }
+    string attribute(const char* name) const;
+    Vector3 vectorAttribute(const char* name, const Vector3& defaultValue) const;
+    double doubleAttribute(const char* name, double defaultValue) const;
+
+    bool parse();
+    void readLink();
+    void readInertial(URDFLink& link);
+    void readShape(vector<ImportedShape>& shapes);
+    void readGeometry(ImportedGeometry& geometry);
+    void readMaterial(string& name, bool& hasColor, Vector4f& color);
+    void readJoint();
+    Affine3 readOrigin();
+
+    BodyPtr createBody();
+    void applyMaterials(vector<ImportedShape>& shapes);
+};
+
+
+bool readNumbers(const string& text, double* values, int n)
+{
+    istringstream is(text);
+    for(int i=0; i < n; ++i){
+        if(!(is >> values[i])){
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+
+ModelRootNodePtr cnoid::loadURDFModelTree(const std::string& filename, std::ostream& os)
+{
+    MODELEDIT_TRACE_SPAN("loadURDFModelTree");
+    URDFLoader loader(filename, os);
+    return loader.load();
+}
+
+
+URDFLoader::URDFLoader(const string& filename, ostream& os)
+    : ModelImporter(filename, os)
+{
+
+}
+
+
+ModelRootNodePtr URDFLoader::load()
+{
+    if(!parse()){
+        return 0;
+    }
+    loadMeshes();
+    BodyPtr body = createBody();
+    if(!body){
+        return 0;
+    }
+    return createModelTree(body, filename);
+}
+
+
+string URDFLoader::attribute(const char* name) const
+{
+    return xml.attributes().value(QLatin1String(name)).toString().toStdString();
+}
+
+
+Vector3 URDFLoader::vectorAttribute(const char* name, const Vector3& defaultValue) const
+{
+    double v[3];
+    if(readNumbers(attribute(name), v, 3)){
+        return Vector3(v[0], v[1], v[2]);
+    }
+    return defaultValue;
+}
+
+
+double URDFLoader::doubleAttribute(const char* name, double defaultValue) const
+{
+    double v;
+    if(readNumbers(attribute(name), &v, 1)){
+        return v;
+    }
+    return defaultValue;
+}
+
+
+/**
+   The elements are read in a single pass. The unknown elements such as
+   <gazebo> and <transmission> are skipped.
+*/
+bool URDFLoader::parse()
+{
+    MODELEDIT_TRACE_SPAN("URDFLoader::parse");
+
+    QFile file(QString::fromLocal8Bit(filename.c_str()));
+    if(!file.open(QIODevice::ReadOnly)){
+        os << format("Cannot open \"%1%\".") % filename << endl;
+        return false;
+    }
+    xml.setDevice(&file);
+
+    if(!xml.readNextStartElement() || !isElement("robot")){
+        os << format("\"%1%\" is not a URDF file.") % filename << endl;
+        return false;
+    }
+    robotName = attribute("name");
+
+    while(xml.readNextStartElement()){
+        if(isElement("link")){
+            readLink();
+        } else if(isElement("joint")){
+            readJoint();
+        } else if(isElement("material")){
+            string name;
+            bool hasColor = false;
+            Vector4f color;
+            readMaterial(name, hasColor, color);
+            if(hasColor){
+                materials[name] = color;
+            }
+        } else {
+            xml.skipCurrentElement();
+        }
+    }
+    if(xml.hasError()){
+        os << format("%1%:%2%: %3%") % filename % xml.lineNumber() % xml.errorString().toStdString() << endl;
+        return false;
+    }
+    MODELEDIT_TRACE_COUNTER("URDF links", links.size());
+    return true;
+}
+
+
+void URDFLoader::readLink()
+{
+    URDFLink link;
+    link.name = attribute("name");
+    while(xml.readNextStartElement()){
+        if(isElement("inertial")){
+            readInertial(link);
+        } else if(isElement("visual")){
+            readShape(link.visuals);
+        } else if(isElement("collision")){
+            readShape(link.collisions);
+        } else {
+            xml.skipCurrentElement();
+        }
+    }
+    links.push_back(link);
+}
+
+
+void URDFLoader::readInertial(URDFLink& link)
+{
+    Affine3 origin = Affine3::Identity();
+    Matrix3 I = Matrix3::Identity();
+    while(xml.readNextStartElement()){
+        if(isElement("origin")){
+            origin = readOrigin();
+            continue;
+        } else if(isElement("mass")){
+            link.mass = doubleAttribute("value", 0.0);
+        } else if(isElement("inertia")){
+            I(0, 0) = doubleAttribute("ixx", 0.0);
+            I(1, 1) = doubleAttribute("iyy", 0.0);
+            I(2, 2) = doubleAttribute("izz", 0.0);
+            I(0, 1) = I(1, 0) = doubleAttribute("ixy", 0.0);
+            I(0, 2) = I(2, 0) = doubleAttribute("ixz", 0.0);
+            I(1, 2) = I(2, 1) = doubleAttribute("iyz", 0.0);
+        }
+        xml.skipCurrentElement();
+    }
+    // the inertia is given in the inertial frame
+    link.centerOfMass = origin.translation();
+    link.inertia = origin.linear() * I * origin.linear().transpose();
+}
+
+
+void URDFLoader::readShape(vector<ImportedShape>& shapes)
+{
+    ImportedShape shape;
+    while(xml.readNextStartElement()){
+        if(isElement("origin")){
+            shape.origin = readOrigin();
+        } else if(isElement("geometry")){
+            readGeometry(shape.geometry);
+        } else if(isElement("material")){
+            readMaterial(shape.materialName, shape.hasColor, shape.color);
+        } else {
+            xml.skipCurrentElement();
+        }
+    }
+    if(shape.geometry.type != ImportedGeometry::NONE){
+        shapes.push_back(shape);
+    }
+}
+
+
+void URDFLoader::readGeometry(ImportedGeometry& geometry)
+{
+    while(xml.readNextStartElement()){
+        if(isElement("box")){
+            geometry.type = ImportedGeometry::BOX;
+            geometry.size = vectorAttribute("size", Vector3::Zero());
+        } else if(isElement("cylinder")){
+            geometry.type = ImportedGeometry::CYLINDER;
+            geometry.radius = doubleAttribute("radius", 0.0);
+            geometry.length = doubleAttribute("length", 0.0);
+        } else if(isElement("sphere")){
+            geometry.type = ImportedGeometry::SPHERE;
+            geometry.radius = doubleAttribute("radius", 0.0);
+        } else if(isElement("mesh")){
+            geometry.type = ImportedGeometry::MESH;
+            geometry.meshIndex = addMeshFile(attribute("filename"));
+            geometry.scale = vectorAttribute("scale", Vector3::Ones());
+        }
+        xml.skipCurrentElement();
+    }
+}
+
+
+void URDFLoader::readMaterial(string& name, bool& hasColor, Vector4f& color)
+{
+    name = attribute("name");
+    while(xml.readNextStartElement()){
+        if(isElement("color")){
+            double rgba[4];
+            if(readNumbers(attribute("rgba"), rgba, 4)){
+                color << rgba[0], rgba[1], rgba[2], rgba[3];
+                hasColor = true;
+            }
+        }
+        xml.skipCurrentElement();
+    }
+}
+
+
+void URDFLoader::readJoint()
+{
+    URDFJoint joint;
+    joint.name = attribute("name");
+    joint.type = attribute("type");
+    while(xml.readNextStartElement()){
+        if(isElement("origin")){
+            joint.origin = readOrigin();
+            continue;
+        } else if(isElement("parent")){
+            joint.parent = attribute("link");
+        } else if(isElement("child")){
+            joint.child = attribute("link");
+        } else if(isElement("axis")){
+            joint.axis = vectorAttribute("xyz", Vector3::UnitX());
+        } else if(isElement("limit")){
+            joint.hasLimit = true;
+            joint.lower = doubleAttribute("lower", 0.0);
+            joint.upper = doubleAttribute("upper", 0.0);
+            joint.velocity = doubleAttribute("velocity", 0.0);
+        }
+        xml.skipCurrentElement();
+    }
+    joints.push_back(joint);
+}
+
+
+Affine3 URDFLoader::readOrigin()
+{
+    Vector3 xyz = vectorAttribute("xyz", Vector3::Zero());
+    Vector3 rpy = vectorAttribute("rpy", Vector3::Zero());
+    xml.skipCurrentElement();
+    Affine3 T;
+    T.translation() = xyz;
+    T.linear() = rotFromRpy(rpy);
+    return T;
+}
+
+
+BodyPtr URDFLoader::createBody()
+{
+    MODELEDIT_TRACE_SPAN("URDFLoader::createBody");
+
+    map<string, const URDFJoint*> parentJoints;
+    for(size_t i=0; i < joints.size(); ++i){
+        parentJoints[joints[i].child] = &joints[i];
+    }
+
+    BodyPtr body = new Body;
+    body->setName(robotName);
+    body->setModelName(robotName);
+
+    // The links of the body are named after their joints as in the OpenHRP models
+    map<string, Link*> linkMap;
+    Link* rootLink = 0;
+    for(size_t i=0; i < links.size(); ++i){
+        URDFLink& src = links[i];
+        applyMaterials(src.visuals);
+        Link* link = new Link;
+        map<string, const URDFJoint*>::iterator p = parentJoints.find(src.name);
+        if(p != parentJoints.end()){
+            link->setName(p->second->name);
+        } else if(!rootLink){
+            link->setName(src.name);
+            link->setJointType(Link::FIXED_JOINT);
+            rootLink = link;
+        } else {
+            os << format("\"%1%\" has more than one root link.") % filename << endl;
+            delete link;
+            return 0;
+        }
+        link->setMass(src.mass);
+        link->setCenterOfMass(src.centerOfMass);
+        link->setInertia(src.inertia);
+        SgNode* visual = createShape(src.visuals, src.name);
+        SgNode* collision = src.collisions.empty() ? visual : createShape(src.collisions, src.name);
+        link->setVisualShape(visual);
+        link->setCollisionShape(collision);
+        linkMap[src.name] = link;
+    }
+    if(!rootLink){
+        os << format("\"%1%\" has no root link.") % filename << endl;
+        return 0;
+    }
+    body->setRootLink(rootLink);
+
+    int jointId = 0;
+    for(size_t i=0; i < joints.size(); ++i){
+        const URDFJoint& joint = joints[i];
+        map<string, Link*>::iterator parent = linkMap.find(joint.parent);
+        map<string, Link*>::iterator child = linkMap.find(joint.child);
+        if(parent == linkMap.end() || child == linkMap.end()){
+            os << format("The links of the joint \"%1%\" are not defined.") % joint.name << endl;
+            continue;
+        }
+        Link* link = child->second;
+        link->setOffsetTranslation(joint.origin.translation());
+        link->setOffsetRotation(joint.origin.linear());
+        Vector3 axis = joint.axis;
+        if(axis.norm() > 0.0){
+            axis.normalize();
+        }
+        link->setJointAxis(axis);
+
+        if(joint.type == "revolute" || joint.type == "continuous"){
+            link->setJointType(Link::ROTATIONAL_JOINT);
+        } else if(joint.type == "prismatic"){
+            link->setJointType(Link::SLIDE_JOINT);
+        } else if(joint.type == "floating"){
+            link->setJointType(Link::FREE_JOINT);
+        } else {
+            if(joint.type != "fixed"){
+                os << format("The %1% joint \"%2%\" is loaded as a fixed joint.") % joint.type % joint.name << endl;
+            }
+            link->setJointType(Link::FIXED_JOINT);
+        }
+        if(link->isRotationalJoint() || link->isSlideJoint()){
+            link->setJointId(jointId++);
+            if(joint.hasLimit && joint.type != "continuous"){
+                link->setJointRange(joint.lower, joint.upper);
+            }
+            if(joint.hasLimit && joint.velocity > 0.0){
+                link->setJointVelocityRange(-joint.velocity, joint.velocity);
+            }
+        }
+        parent->second->appendChild(link);
+    }
+    body->updateLinkTree();
+
+    if(body->numLinks() != (int)links.size()){
+        os << format("Some links of \"%1%\" are not connected to the root link.") % filename << endl;
+    }
+    return body;
+}
+
+
+/// The colors of the named materials are applied here because they may be defined after the links
+void URDFLoader::applyMaterials(vector<ImportedShape>& shapes)
+{
+    for(size_t i=0; i < shapes.size(); ++i){
+        ImportedShape& shape = shapes[i];
+        if(!shape.hasColor){
+            map<string, Vector4f>::iterator p = materials.find(shape.materialName);
+            if(p != materials.end()){
+                shape.color = p->second;
+                shape.hasColor = true;
+            }
+        }
+    }
+}
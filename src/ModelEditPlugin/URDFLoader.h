@@ -0,0 +1,24 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_URDF_LOADER_H
+#define CNOID_EDITMODEL_PLUGIN_URDF_LOADER_H
+
+#include "ModelNode.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   Loads a URDF file into a model tree which has a joint node for each URDF joint.
+   The XML is read by a streaming parser, and the mesh files referenced by the
+   links are loaded in the worker threads and shared through ModelAssetCache.
+   The package:// URIs are resolved with ROS_PACKAGE_PATH and the ancestor
+   directories of the URDF file.
+*/
+CNOID_EXPORT ModelRootNodePtr loadURDFModelTree(const std::string& filename, std::ostream& os);
+
+}
+
+#endif
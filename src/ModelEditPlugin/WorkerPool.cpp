@@ -0,0 +1,527 @@
+/**
+   @file
+*/
+
+#include "WorkerPool.h"
+#include "Trace.h"
+#include <cnoid/OptionManager>
+#include <cnoid/LazyCaller>
+#include <cnoid/MessageView>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/tss.hpp>
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/format.hpp>
+#include <QAtomicPointer>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+namespace po = boost::program_options;
+
+namespace {
+
+struct Worker
+{
+    boost::mutex mutex;
+    deque<ModelEditWorkerTaskPtr> queues[ModelEditWorkerPool::NUM_PRIORITIES];
+    boost::thread thread;
+};
+
+struct CompletionNode
+{
+    ModelEditWorkerTaskPtr task;
+    CompletionNode* next;
+};
+
+/**
+   Shared state of parallelFor. The helper tasks which start after all the
+   indices have been taken just return, so the state is kept by shared_ptr.
+*/
+struct ParallelLoop
+{
+    boost::function<void(int index)> func;
+    int n;
+    int nextIndex;
+    int numFinished;
+    string errorMessage;
+    boost::mutex mutex;
+    boost::condition_variable finished;
+
+    void run() {
+        while(true){
+            int index;
+            {
+                boost::mutex::scoped_lock lock(mutex);
+                if(nextIndex >= n){
+                    return;
+                }
+                index = nextIndex++;
+            }
+            string error;
+            try {
+                func(index);
+            } catch(const std::exception& ex){
+                error = ex.what();
+            }
+            boost::mutex::scoped_lock lock(mutex);
+            if(!error.empty() && errorMessage.empty()){
+                errorMessage = error;
+            }
+            if(++numFinished == n){
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+void runParallelLoop(boost::shared_ptr<ParallelLoop> loop)
+{
+    loop->run();
+}
+
+template<class T> T* loadPointer(QAtomicPointer<T>& p)
+{
+#if QT_VERSION >= 0x050000
+    return p.load();
+#else
+    return p;
+#endif
+}
+
+void onOptionsParsed(po::variables_map& v)
+{
+    if(v.count("modeledit-worker-threads")){
+        ModelEditWorkerPool::instance()->setNumThreads(v["modeledit-worker-threads"].as<int>());
+    }
+}
+
+}
+
+
+namespace cnoid {
+
+class ModelEditWorkerPoolImpl
+{
+public:
+    ModelEditWorkerPool* self;
+    int numThreads;
+    vector<Worker*> workers;
+    boost::thread_specific_ptr<int> currentWorkerIndex;
+
+    // guards the following variables, the start and stop of the workers and their sleep
+    boost::mutex mutex;
+    boost::condition_variable wakeup;
+    int numQueuedTasks;
+    int nextWorkerIndex;
+    bool isStopping;
+
+    // lock-free stack of the finished tasks which is taken at once by the GUI thread
+    QAtomicPointer<CompletionNode> completions;
+
+    ModelEditWorkerPoolImpl(ModelEditWorkerPool* self);
+    int numThreadsToStart() const;
+    void startIfNotStarted();
+    void start();
+    void stop();
+    void push(const ModelEditWorkerTaskPtr& task);
+    ModelEditWorkerTaskPtr take(int index);
+    void run(int index);
+    void execute(const ModelEditWorkerTaskPtr& task);
+    void complete(const ModelEditWorkerTaskPtr& task);
+    void flushCompletions();
+    bool isStopRequested();
+};
+
+}
+
+
+ModelEditWorkerTask::ModelEditWorkerTask()
+    : isCanceled_(0),
+      isCompleted_(false),
+      priority(ModelEditWorkerPool::NORMAL_PRIORITY)
+{
+
+}
+
+
+void ModelEditWorkerTask::cancel()
+{
+    isCanceled_.fetchAndStoreOrdered(1);
+}
+
+
+bool ModelEditWorkerTask::isCanceled() const
+{
+    return isCanceled_.fetchAndAddOrdered(0) != 0;
+}
+
+
+void ModelEditWorkerPool::initializeClass(ExtensionManager* ext)
+{
+    static bool initialized = false;
+
+    if(!initialized){
+        OptionManager& om = ext->optionManager();
+        om.addOption("modeledit-worker-threads", po::value<int>(),
+                     "number of the worker threads of the model edit plugin");
+        om.sigOptionsParsed().connect(onOptionsParsed);
+        initialized = true;
+    }
+}
+
+
+void ModelEditWorkerPool::finalize()
+{
+    instance()->impl->stop();
+}
+
+
+ModelEditWorkerPool* ModelEditWorkerPool::instance()
+{
+    // never deleted because the queued completions may refer to it
+    static ModelEditWorkerPool* pool = new ModelEditWorkerPool;
+    return pool;
+}
+
+
+ModelEditWorkerPool::ModelEditWorkerPool()
+{
+    impl = new ModelEditWorkerPoolImpl(this);
+}
+
+
+ModelEditWorkerPoolImpl::ModelEditWorkerPoolImpl(ModelEditWorkerPool* self)
+    : self(self),
+      numThreads(0),
+      numQueuedTasks(0),
+      nextWorkerIndex(0),
+      isStopping(false),
+      completions(0)
+{
+
+}
+
+
+ModelEditWorkerPool::~ModelEditWorkerPool()
+{
+    impl->stop();
+    delete impl;
+}
+
+
+void ModelEditWorkerPool::setNumThreads(int n)
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    if(impl->workers.empty()){
+        impl->numThreads = std::max(n, 0);
+    }
+}
+
+
+int ModelEditWorkerPool::numThreads() const
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    if(!impl->workers.empty()){
+        return impl->workers.size();
+    }
+    return impl->numThreadsToStart();
+}
+
+
+int ModelEditWorkerPoolImpl::numThreadsToStart() const
+{
+    if(numThreads > 0){
+        return numThreads;
+    }
+    return std::max((int)boost::thread::hardware_concurrency() - 1, 1);
+}
+
+
+/**
+   The first submissions may come from several threads at the same time, so the
+   workers are started under the lock. The started workers wait for the lock
+   before they sleep, which is released after all of them have been started.
+*/
+void ModelEditWorkerPoolImpl::startIfNotStarted()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    if(workers.empty() && !isStopping){
+        start();
+    }
+}
+
+
+void ModelEditWorkerPoolImpl::start()
+{
+    int n = numThreadsToStart();
+    for(int i=0; i < n; ++i){
+        workers.push_back(new Worker);
+    }
+    for(int i=0; i < n; ++i){
+        workers[i]->thread = boost::thread(boost::bind(&ModelEditWorkerPoolImpl::run, this, i));
+    }
+}
+
+
+void ModelEditWorkerPoolImpl::stop()
+{
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        isStopping = true;
+    }
+    wakeup.notify_all();
+
+    // the workers run the remaining tasks as canceled ones before they quit
+    for(size_t i=0; i < workers.size(); ++i){
+        workers[i]->thread.join();
+    }
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        for(size_t i=0; i < workers.size(); ++i){
+            delete workers[i];
+        }
+        workers.clear();
+    }
+
+    // the completions are not called any more because the items may have been deleted
+    CompletionNode* node = completions.fetchAndStoreOrdered(0);
+    while(node){
+        CompletionNode* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+
+ModelEditWorkerTaskPtr ModelEditWorkerPool::submit
+(const boost::function<void(ModelEditWorkerTask* task)>& work,
+ const boost::function<void(bool canceled)>& onCompleted, Priority priority)
+{
+    ModelEditWorkerTaskPtr task(new ModelEditWorkerTask);
+    task->work = work;
+    task->onCompleted = onCompleted;
+    task->priority = priority;
+
+    if(impl->isStopRequested()){
+        // the task is skipped but its completion is called as that of a canceled task
+        task->cancel();
+        task->work.clear();
+        impl->complete(task);
+        return task;
+    }
+    impl->startIfNotStarted();
+    impl->push(task);
+    return task;
+}
+
+
+bool ModelEditWorkerPoolImpl::isStopRequested()
+{
+    boost::mutex::scoped_lock lock(mutex);
+    return isStopping;
+}
+
+
+void ModelEditWorkerPoolImpl::push(const ModelEditWorkerTaskPtr& task)
+{
+    int* current = currentWorkerIndex.get();
+    int index;
+    if(current){
+        index = *current;
+    } else {
+        boost::mutex::scoped_lock lock(mutex);
+        index = nextWorkerIndex;
+        nextWorkerIndex = (nextWorkerIndex + 1) % workers.size();
+    }
+    Worker* worker = workers[index];
+    {
+        boost::mutex::scoped_lock lock(worker->mutex);
+        worker->queues[task->priority].push_back(task);
+    }
+    {
+        boost::mutex::scoped_lock lock(mutex);
+        ++numQueuedTasks;
+        MODELEDIT_TRACE_COUNTER("Queued worker tasks", numQueuedTasks);
+    }
+    wakeup.notify_one();
+}
+
+
+void ModelEditWorkerPool::parallelFor
+(int n, const boost::function<void(int index)>& func, Priority priority)
+{
+    if(n <= 0){
+        return;
+    }
+    boost::shared_ptr<ParallelLoop> loop = boost::make_shared<ParallelLoop>();
+    loop->func = func;
+    loop->n = n;
+    loop->nextIndex = 0;
+    loop->numFinished = 0;
+
+    if(n > 1 && !impl->isStopRequested()){
+        impl->startIfNotStarted();
+        int numHelpers = std::min(n - 1, (int)impl->workers.size());
+        for(int i=0; i < numHelpers; ++i){
+            // the helpers have no completion, so nothing is passed to the GUI thread
+            ModelEditWorkerTaskPtr helper(new ModelEditWorkerTask);
+            helper->work = boost::bind(runParallelLoop, loop);
+            helper->priority = priority;
+            impl->push(helper);
+        }
+    }
+    loop->run();
+
+    boost::mutex::scoped_lock lock(loop->mutex);
+    while(loop->numFinished < n){
+        loop->finished.wait(lock);
+    }
+    if(!loop->errorMessage.empty()){
+        throw std::runtime_error(loop->errorMessage);
+    }
+}
+
+
+int ModelEditWorkerPool::numQueuedTasks() const
+{
+    boost::mutex::scoped_lock lock(impl->mutex);
+    return impl->numQueuedTasks;
+}
+
+
+/**
+   A worker takes the newest task of its own queue, which is usually the last
+   one split from the task it has just run, and steals the oldest one of the
+   other workers.
+*/
+ModelEditWorkerTaskPtr ModelEditWorkerPoolImpl::take(int index)
+{
+    ModelEditWorkerTaskPtr task;
+    const int n = workers.size();
+    for(int p=0; p < ModelEditWorkerPool::NUM_PRIORITIES && !task; ++p){
+        for(int i=0; i < n; ++i){
+            Worker* worker = workers[(index + i) % n];
+            boost::mutex::scoped_lock lock(worker->mutex);
+            deque<ModelEditWorkerTaskPtr>& queue = worker->queues[p];
+            if(!queue.empty()){
+                if(i == 0){
+                    task = queue.back();
+                    queue.pop_back();
+                } else {
+                    task = queue.front();
+                    queue.pop_front();
+                }
+                break;
+            }
+        }
+    }
+    if(task){
+        boost::mutex::scoped_lock lock(mutex);
+        --numQueuedTasks;
+    }
+    return task;
+}
+
+
+void ModelEditWorkerPoolImpl::run(int index)
+{
+    currentWorkerIndex.reset(new int(index));
+
+    while(true){
+        ModelEditWorkerTaskPtr task = take(index);
+        if(task){
+            if(isStopRequested()){
+                task->cancel();
+            }
+            execute(task);
+            continue;
+        }
+        boost::mutex::scoped_lock lock(mutex);
+        while(numQueuedTasks == 0 && !isStopping){
+            wakeup.wait(lock);
+        }
+        if(isStopping && numQueuedTasks == 0){
+            break;
+        }
+    }
+}
+
+
+void ModelEditWorkerPoolImpl::execute(const ModelEditWorkerTaskPtr& task)
+{
+    if(!task->isCanceled()){
+        MODELEDIT_TRACE_SPAN("ModelEditWorkerPool::execute");
+        try {
+            task->work(task.get());
+        } catch(const std::exception& ex){
+            task->errorMessage_ = ex.what();
+        }
+    }
+    // the bound objects of the work are released in this thread before the GUI thread takes the task
+    task->work.clear();
+    complete(task);
+}
+
+
+void ModelEditWorkerPoolImpl::complete(const ModelEditWorkerTaskPtr& task)
+{
+    // nothing is delivered to the GUI thread for the tasks such as the helpers of parallelFor
+    if(!task->onCompleted && task->errorMessage_.empty()){
+        task->isCompleted_ = true;
+        return;
+    }
+    CompletionNode* node = new CompletionNode;
+    node->task = task;
+    node->next = loadPointer(completions);
+    while(!completions.testAndSetOrdered(node->next, node)){
+        node->next = loadPointer(completions);
+    }
+    // The GUI thread takes all the nodes at once, so the first node pushed after
+    // that requests the next flush
+    if(!node->next){
+        callLater(boost::bind(&ModelEditWorkerPoolImpl::flushCompletions, this));
+    }
+}
+
+
+void ModelEditWorkerPool::flushCompletions()
+{
+    impl->flushCompletions();
+}
+
+
+void ModelEditWorkerPoolImpl::flushCompletions()
+{
+    CompletionNode* node = completions.fetchAndStoreOrdered(0);
+
+    // restore the order of the completions
+    CompletionNode* ordered = 0;
+    while(node){
+        CompletionNode* next = node->next;
+        node->next = ordered;
+        ordered = node;
+        node = next;
+    }
+    while(ordered){
+        CompletionNode* next = ordered->next;
+        ModelEditWorkerTask* task = ordered->task.get();
+        task->isCompleted_ = true;
+        if(!task->errorMessage_.empty()){
+            MessageView::instance()->putln(format(_("A worker task failed: %1%")) % task->errorMessage_);
+        }
+        if(task->onCompleted){
+            task->onCompleted(task->isCanceled() || !task->errorMessage_.empty());
+            task->onCompleted.clear();
+        }
+        delete ordered;
+        ordered = next;
+    }
+}
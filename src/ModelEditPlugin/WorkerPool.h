@@ -0,0 +1,128 @@
+/**
+   \file
+   Worker threads of the plugin. The work of a task runs in a worker thread and
+   must not touch the items or the scene graphs shown in the views. The completion
+   function of the task is called in the GUI thread, where the results can be
+   applied to the items.
+
+   The task is shared by the threads, so it is held by boost::shared_ptr whose
+   counter is atomic. The work function is destroyed in the worker thread after
+   it has run and the completion function in the GUI thread after it has been
+   called, so only the latter can hold the references of the items and the scene
+   objects.
+*/
+
+#ifndef CNOID_EDITMODEL_PLUGIN_WORKER_POOL_H
+#define CNOID_EDITMODEL_PLUGIN_WORKER_POOL_H
+
+#include <cnoid/ExtensionManager>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <QAtomicInt>
+#include <string>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ModelEditWorkerPoolImpl;
+
+class CNOID_EXPORT ModelEditWorkerTask
+{
+public:
+    /**
+       Requests the cancellation. A task which has not been started is skipped and
+       a running task is stopped when its work checks isCanceled().
+       The completion function is called in either case.
+    */
+    void cancel();
+    bool isCanceled() const;
+
+    /**
+       True after the completion function has been called. The task without
+       the completion function is completed when its work has finished.
+    */
+    bool isCompleted() const { return isCompleted_; }
+
+    /// Message of the exception thrown by the work
+    const std::string& errorMessage() const { return errorMessage_; }
+
+private:
+    ModelEditWorkerTask();
+
+    mutable QAtomicInt isCanceled_;
+    bool isCompleted_;
+    std::string errorMessage_;
+    int priority;
+    boost::function<void(ModelEditWorkerTask* task)> work;
+    boost::function<void(bool canceled)> onCompleted;
+
+    friend class ModelEditWorkerPool;
+    friend class ModelEditWorkerPoolImpl;
+};
+typedef boost::shared_ptr<ModelEditWorkerTask> ModelEditWorkerTaskPtr;
+
+
+class CNOID_EXPORT ModelEditWorkerPool
+{
+public:
+    enum Priority { HIGH_PRIORITY, NORMAL_PRIORITY, LOW_PRIORITY, NUM_PRIORITIES };
+
+    /**
+       Registers the option
+         --modeledit-worker-threads <n>
+       which sets the number of the worker threads. The number of the hardware
+       threads minus one is used by default.
+    */
+    static void initializeClass(ExtensionManager* ext);
+
+    /**
+       Cancels the queued tasks and joins the worker threads.
+       The completion functions of the remaining tasks are not called.
+    */
+    static void finalize();
+
+    static ModelEditWorkerPool* instance();
+
+    /// Must be called before the first task is submitted
+    void setNumThreads(int n);
+    /// Number of the worker threads, which are started on the first submission
+    int numThreads() const;
+
+    /**
+       Queues the work. The tasks submitted from a worker thread are queued to the
+       worker itself and the other workers steal them when they are idle.
+       The tasks with higher priorities are taken first. The task submitted
+       after finalize() is not run and completed as a canceled one.
+    */
+    ModelEditWorkerTaskPtr submit(
+        const boost::function<void(ModelEditWorkerTask* task)>& work,
+        const boost::function<void(bool canceled)>& onCompleted = boost::function<void(bool)>(),
+        Priority priority = NORMAL_PRIORITY);
+
+    /**
+       Calls func(0) ... func(n - 1) in the worker threads and the calling thread,
+       and returns when all of them have finished. This can also be called from
+       the work of a task. The exception thrown by func is rethrown as
+       std::runtime_error after all the calls have finished.
+       The calling thread waits for the helper tasks by itself and neither the
+       event loop nor the message view is used, so the model tree can call this
+       without the GUI.
+    */
+    void parallelFor(int n, const boost::function<void(int index)>& func, Priority priority = NORMAL_PRIORITY);
+
+    /// Number of the tasks which have not been started
+    int numQueuedTasks() const;
+
+    /// Calls the completion functions of the finished tasks. This is done by the event loop.
+    void flushCompletions();
+
+private:
+    ModelEditWorkerPool();
+    ~ModelEditWorkerPool();
+
+    ModelEditWorkerPoolImpl* impl;
+};
+
+}
+
+#endif
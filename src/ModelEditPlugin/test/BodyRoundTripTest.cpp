@@ -0,0 +1,294 @@
+/**
+   @file
+   Exports a synthetic model loaded as a model tree to the YAML body format,
+   loads the body back with BodyLoader and compares each link with the joint
+   node of the tree. The test fails when any of them differs.
+*/
+
+#include "ModelGenerator.h"
+#include "ModelNode.h"
+#include "BodyWriter.h"
+#include <cnoid/BodyLoader>
+#include <cnoid/VRML>
+#include <cnoid/SceneDrawables>
+#include <cnoid/ForceSensor>
+#include <cnoid/RateGyroSensor>
+#include <cnoid/AccelerationSensor>
+#include <cnoid/RangeSensor>
+#include <cnoid/Camera>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+struct RoundTripResult
+{
+    RoundTripResult() : numLinks(0), numDevices(0) { }
+    int numLinks;
+    int numDevices;
+    vector<string> mismatches;
+};
+
+const double roundTripTolerance = 1.0e-6;
+
+int bodyJointType(const string& type)
+{
+    if(type == "rotate"){
+        return Link::REVOLUTE_JOINT;
+    } else if(type == "slide"){
+        return Link::SLIDE_JOINT;
+    } else if(type == "free"){
+        return Link::FREE_JOINT;
+    }
+    return Link::FIXED_JOINT;
+}
+
+/// Index of the type of the shape, which is the primitive type of SgMesh
+typedef map<int, int> ShapeCounts;
+
+void countShapes(VRMLNode* node, ShapeCounts& counts)
+{
+    if(VRMLShape* shape = dynamic_cast<VRMLShape*>(node)){
+        if(dynamic_cast<VRMLBox*>(shape->geometry.get())){
+            counts[SgMesh::BOX]++;
+        } else if(dynamic_cast<VRMLSphere*>(shape->geometry.get())){
+            counts[SgMesh::SPHERE]++;
+        } else if(dynamic_cast<VRMLCylinder*>(shape->geometry.get())){
+            counts[SgMesh::CYLINDER]++;
+        } else if(dynamic_cast<VRMLCone*>(shape->geometry.get())){
+            counts[SgMesh::CONE]++;
+        } else if(shape->geometry){
+            counts[SgMesh::MESH]++;
+        }
+    } else if(VRMLGroup* group = dynamic_cast<VRMLGroup*>(node)){
+        for(size_t i=0; i < group->children.size(); ++i){
+            countShapes(group->children[i].get(), counts);
+        }
+    }
+}
+
+void countShapes(SgNode* node, ShapeCounts& counts)
+{
+    if(SgShape* shape = dynamic_cast<SgShape*>(node)){
+        if(shape->mesh()){
+            counts[shape->mesh()->primitiveType()]++;
+        }
+    } else if(SgGroup* group = dynamic_cast<SgGroup*>(node)){
+        for(int i=0; i < group->numChildren(); ++i){
+            countShapes(group->child(i), counts);
+        }
+    }
+}
+
+int countShapes(const ShapeCounts& counts)
+{
+    int n = 0;
+    for(ShapeCounts::const_iterator p = counts.begin(); p != counts.end(); ++p){
+        n += p->second;
+    }
+    return n;
+}
+
+bool isDeviceOfSensorType(Device* device, const string& type)
+{
+    if(type == "force"){
+        return dynamic_cast<ForceSensor*>(device);
+    } else if(type == "gyro"){
+        return dynamic_cast<RateGyroSensor*>(device);
+    } else if(type == "acceleration"){
+        return dynamic_cast<AccelerationSensor*>(device);
+    } else if(type == "range"){
+        return dynamic_cast<RangeSensor*>(device);
+    } else if(type == "camera"){
+        return dynamic_cast<Camera*>(device) && !dynamic_cast<RangeSensor*>(device);
+    }
+    return false;
+}
+
+/**
+   Compares the link of the loaded body with the joint node and its link,
+   primitive and sensor nodes, which are written as the link and its elements.
+*/
+void compareLink(const JointNode* joint, Body* body, vector<string>& mismatches)
+{
+    Link* link = body->link(joint->name);
+    if(!link){
+        mismatches.push_back(str(format("%1%: the link is not loaded") % joint->name));
+        return;
+    }
+    const int jointType = bodyJointType(joint->jointType);
+    if(link->jointType() != jointType){
+        mismatches.push_back(str(format("%1%: joint type %2% / %3%") % joint->name % link->jointType() % jointType));
+    }
+    if((jointType == Link::REVOLUTE_JOINT || jointType == Link::SLIDE_JOINT) &&
+       !link->jointAxis().isApprox(joint->jointAxis, roundTripTolerance)){
+        mismatches.push_back(str(format("%1%: joint axis") % joint->name));
+    }
+
+    double mass;
+    Vector3 c;
+    Matrix3 I;
+    joint->getMassProperties(mass, c, I);
+    const double massTolerance = roundTripTolerance * std::max(1.0, mass);
+    if(fabs(link->mass() - mass) > massTolerance){
+        mismatches.push_back(str(format("%1%: mass %2% / %3%") % joint->name % link->mass() % mass));
+    }
+    if((link->c() - c).cwiseAbs().maxCoeff() > roundTripTolerance){
+        mismatches.push_back(str(format("%1%: center of mass") % joint->name));
+    }
+    if((link->I() - I).cwiseAbs().maxCoeff() > roundTripTolerance * std::max(1.0, I.cwiseAbs().maxCoeff())){
+        mismatches.push_back(str(format("%1%: inertia") % joint->name));
+    }
+
+    ShapeCounts expectedShapes;
+    vector<const SensorNode*> sensors;
+    for(int i=0; i < joint->numChildren(); ++i){
+        const ModelNode* child = joint->child(i);
+        if(const LinkNode* linkNode = dynamic_cast<const LinkNode*>(child)){
+            MFNode shapes;
+            linkNode->getShapeVRML(shapes);
+            for(size_t j=0; j < shapes.size(); ++j){
+                countShapes(shapes[j].get(), expectedShapes);
+            }
+        } else if(const PrimitiveShapeNode* primitive = dynamic_cast<const PrimitiveShapeNode*>(child)){
+            const string& pt = primitive->primitiveType;
+            expectedShapes[pt == "Box" ? SgMesh::BOX : pt == "Sphere" ? SgMesh::SPHERE :
+                           pt == "Cylinder" ? SgMesh::CYLINDER : SgMesh::CONE]++;
+        } else if(const SensorNode* sensor = dynamic_cast<const SensorNode*>(child)){
+            sensors.push_back(sensor);
+        }
+    }
+    ShapeCounts loadedShapes;
+    if(link->visualShape()){
+        countShapes(link->visualShape(), loadedShapes);
+    }
+    // the meshes of the VRML primitives may be loaded as the primitives or as the meshes
+    if(countShapes(loadedShapes) != countShapes(expectedShapes)){
+        mismatches.push_back(str(format("%1%: %2% shapes / %3%")
+                                 % joint->name % countShapes(loadedShapes) % countShapes(expectedShapes)));
+    } else {
+        const int primitiveTypes[] = { SgMesh::BOX, SgMesh::SPHERE, SgMesh::CYLINDER, SgMesh::CONE };
+        for(int i=0; i < 4; ++i){
+            if(loadedShapes[primitiveTypes[i]] < expectedShapes[primitiveTypes[i]]){
+                mismatches.push_back(str(format("%1%: shapes of primitive type %2%") % joint->name % primitiveTypes[i]));
+            }
+        }
+    }
+
+    int numLoadedDevices = 0;
+    for(int i=0; i < body->numDevices(); ++i){
+        if(body->device(i)->link() == link){
+            ++numLoadedDevices;
+        }
+    }
+    if(numLoadedDevices != static_cast<int>(sensors.size())){
+        mismatches.push_back(str(format("%1%: %2% devices / %3%") % joint->name % numLoadedDevices % sensors.size()));
+    }
+    for(size_t i=0; i < sensors.size(); ++i){
+        Device* device = 0;
+        for(int j=0; j < body->numDevices(); ++j){
+            if(body->device(j)->name() == sensors[i]->name && body->device(j)->link() == link){
+                device = body->device(j);
+                break;
+            }
+        }
+        if(!device || !isDeviceOfSensorType(device, sensors[i]->sensorType)){
+            mismatches.push_back(str(format("%1%: device %2% of type %3%")
+                                     % joint->name % sensors[i]->name % sensors[i]->sensorType));
+        }
+    }
+}
+
+/// Compares the joints under the node and counts them and the sensors
+void compareLinks(const ModelNode* node, Body* body, RoundTripResult& result)
+{
+    for(int i=0; i < node->numChildren(); ++i){
+        const ModelNode* child = node->child(i);
+        if(const JointNode* joint = dynamic_cast<const JointNode*>(child)){
+            compareLink(joint, body, result.mismatches);
+            ++result.numLinks;
+            compareLinks(joint, body, result);
+        } else if(dynamic_cast<const SensorNode*>(child)){
+            ++result.numDevices;
+        }
+    }
+}
+
+
+bool checkBodyRoundTrip(const filesystem::path& workDir)
+{
+    SyntheticModelSpec spec;
+    const string modelFile = (workDir / "synthetic.wrl").string();
+    const string bodyFile = (workDir / "synthetic.body").string();
+    if(!writeSyntheticModel(modelFile, spec)){
+        cerr << "The synthetic model cannot be written." << endl;
+        return false;
+    }
+    ModelRootNodePtr root = loadModelTree(modelFile, cerr);
+    if(!root){
+        cerr << "The synthetic model cannot be loaded." << endl;
+        return false;
+    }
+    if(!writeBodyFile(root.get(), bodyFile, cerr)){
+        cerr << "The body file cannot be written." << endl;
+        return false;
+    }
+    BodyLoader loader;
+    loader.setMessageSink(cerr);
+    BodyPtr body = loader.load(bodyFile);
+    if(!body){
+        cerr << "The exported body cannot be loaded." << endl;
+        return false;
+    }
+
+    // only the first root joint is exported
+    RoundTripResult r;
+    for(int i=0; i < root->numChildren(); ++i){
+        if(const JointNode* joint = dynamic_cast<const JointNode*>(root->child(i))){
+            compareLink(joint, body.get(), r.mismatches);
+            ++r.numLinks;
+            compareLinks(joint, body.get(), r);
+            break;
+        }
+    }
+    if(body->numLinks() != r.numLinks){
+        r.mismatches.push_back(str(format("%1% links / %2%") % body->numLinks() % r.numLinks));
+    }
+    if(body->numDevices() != r.numDevices){
+        r.mismatches.push_back(str(format("%1% devices / %2%") % body->numDevices() % r.numDevices));
+    }
+
+    cout << format("Body round trip: %1% links, %2% devices, %3% mismatches")
+        % r.numLinks % r.numDevices % r.mismatches.size() << endl;
+    for(size_t i=0; i < r.mismatches.size(); ++i){
+        cerr << r.mismatches[i] << endl;
+    }
+    return r.mismatches.empty();
+}
+
+}
+
+
+int main()
+{
+    filesystem::path workDir =
+        filesystem::temp_directory_path() / filesystem::unique_path("modeledit-test-%%%%-%%%%");
+    filesystem::create_directories(workDir);
+
+    bool passed = checkBodyRoundTrip(workDir);
+
+    boost::system::error_code ec;
+    filesystem::remove_all(workDir, ec);
+
+    return passed ? 0 : 1;
+}
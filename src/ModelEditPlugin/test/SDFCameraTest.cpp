@@ -0,0 +1,102 @@
+/**
+   @file
+   Imports an SDF model with a camera which looks along +Y and checks that the
+   optical axis of the loaded camera, which is -Z in Choreonoid, is +Y and its
+   up vector is +Z.
+*/
+
+#include "SDFLoader.h"
+#include <cnoid/Camera>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const double tolerance = 1.0e-6;
+
+bool writeModel(const string& filename)
+{
+    ofstream of(filename.c_str());
+    of << "<?xml version=\"1.0\"?>\n"
+       << "<sdf version=\"1.5\">\n"
+       << "  <model name=\"camera_test\">\n"
+       << "    <link name=\"base\">\n"
+       << "      <inertial><mass>1.0</mass></inertial>\n"
+       << "      <sensor name=\"front_camera\" type=\"camera\">\n"
+       << "        <pose>0.1 0 0.5 0 0 1.5707963267948966</pose>\n"
+       << "        <camera>\n"
+       << "          <horizontal_fov>1.0</horizontal_fov>\n"
+       << "          <image><width>320</width><height>240</height></image>\n"
+       << "          <clip><near>0.1</near><far>10.0</far></clip>\n"
+       << "        </camera>\n"
+       << "      </sensor>\n"
+       << "    </link>\n"
+       << "  </model>\n"
+       << "</sdf>\n";
+    return of.good();
+}
+
+bool checkCameraAxis(const filesystem::path& workDir)
+{
+    const string modelFile = (workDir / "camera.sdf").string();
+    if(!writeModel(modelFile)){
+        cerr << "The SDF model cannot be written." << endl;
+        return false;
+    }
+    ModelRootNodePtr root = loadSDFModelTree(modelFile, cerr);
+    if(!root || !root->body){
+        cerr << "The SDF model cannot be loaded." << endl;
+        return false;
+    }
+    Camera* camera = 0;
+    for(int i=0; i < root->body->numDevices(); ++i){
+        camera = dynamic_cast<Camera*>(root->body->device(i));
+        if(camera){
+            break;
+        }
+    }
+    if(!camera){
+        cerr << "The camera is not loaded." << endl;
+        return false;
+    }
+
+    const Matrix3& R = camera->localRotation();
+    const Vector3 opticalAxis = R * -Vector3::UnitZ();
+    const Vector3 up = R * Vector3::UnitY();
+    bool passed = true;
+    if(!opticalAxis.isApprox(Vector3::UnitY(), tolerance)){
+        cerr << "Optical axis: " << opticalAxis.transpose() << " / 0 1 0" << endl;
+        passed = false;
+    }
+    if(!up.isApprox(Vector3::UnitZ(), tolerance)){
+        cerr << "Up vector: " << up.transpose() << " / 0 0 1" << endl;
+        passed = false;
+    }
+    if(!camera->localTranslation().isApprox(Vector3(0.1, 0.0, 0.5), tolerance)){
+        cerr << "Position: " << camera->localTranslation().transpose() << " / 0.1 0 0.5" << endl;
+        passed = false;
+    }
+    return passed;
+}
+
+}
+
+
+int main()
+{
+    filesystem::path workDir =
+        filesystem::temp_directory_path() / filesystem::unique_path("modeledit-test-%%%%-%%%%");
+    filesystem::create_directories(workDir);
+
+    bool passed = checkCameraAxis(workDir);
+
+    boost::system::error_code ec;
+    filesystem::remove_all(workDir, ec);
+
+    return passed ? 0 : 1;
+}